@@ -0,0 +1,144 @@
+#include "frame_recorder.hpp"
+
+FrameRecorder::FrameRecorder(
+    FrameEncoder encoder, int thread_count, int queue_capacity,
+    void *encoder_data):
+    m_encoder(encoder), m_encoder_data(encoder_data),
+    m_readback(2, GL_UNSIGNED_BYTE),
+    m_queue_capacity(queue_capacity), m_dropped_count(0), m_busy_count(0),
+    m_stop(false) {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+    m_threads = std::vector<pthread_t>(thread_count);
+    for (auto &thread: m_threads)
+        pthread_create(&thread, NULL, FrameRecorder::encode_loop, this);
+    #endif
+}
+
+/* Keep track of the file name and dimensions of a read that
+has just been requested, until it is retrieved.*/
+void FrameRecorder::push_read(
+    const std::string &fname, int width, int height, int policy) {
+    m_reads.push_back(
+        {.fname=fname, .width=width, .height=height, .pixels={}});
+    this->collect(false, policy);
+}
+
+void FrameRecorder::push(
+    const Quad &quad, const std::string &fname, int policy) {
+    if (m_readback.is_full())
+        this->collect(policy == WAIT_FOR_ENCODERS, policy);
+    if (!m_readback.request(quad)) {
+        m_dropped_count++;
+        return;
+    }
+    this->push_read(fname, quad.width(), quad.height(), policy);
+}
+
+void FrameRecorder::push(
+    const RenderTarget &target, const std::string &fname, int policy) {
+    if (m_readback.is_full())
+        this->collect(policy == WAIT_FOR_ENCODERS, policy);
+    if (!m_readback.request(target)) {
+        m_dropped_count++;
+        return;
+    }
+    IVec2 d = target.texture_dimensions();
+    this->push_read(fname, d[0], d[1], policy);
+}
+
+/* Pass on every completed read to the encoders. If wait is set,
+block until at least the oldest read is complete.*/
+void FrameRecorder::collect(bool wait, int policy) {
+    int tag = 0;
+    while (!m_reads.empty()) {
+        Frame &frame = m_reads.front();
+        if (!m_readback.retrieve(frame.pixels, tag, wait))
+            return;
+        wait = false;
+        this->enqueue(frame, policy);
+        m_reads.pop_front();
+    }
+}
+
+void FrameRecorder::enqueue(Frame &frame, int policy) {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    if (m_queue.size() >= m_queue_capacity && policy == DROP_FRAMES) {
+        m_dropped_count++;
+        pthread_mutex_unlock(&m_mutex);
+        return;
+    }
+    while (m_queue.size() >= m_queue_capacity)
+        pthread_cond_wait(&m_cond, &m_mutex);
+    m_queue.push_back(std::move(frame));
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    #else
+    m_encoder(frame.fname, frame.pixels, frame.width, frame.height,
+              m_encoder_data);
+    #endif
+}
+
+#ifndef __EMSCRIPTEN__
+void *FrameRecorder::encode_loop(void *void_recorder) {
+    FrameRecorder *recorder = (FrameRecorder *)void_recorder;
+    pthread_mutex_lock(&recorder->m_mutex);
+    while (true) {
+        while (recorder->m_queue.empty() && !recorder->m_stop)
+            pthread_cond_wait(&recorder->m_cond, &recorder->m_mutex);
+        if (recorder->m_queue.empty())
+            break;
+        Frame frame = std::move(recorder->m_queue.front());
+        recorder->m_queue.pop_front();
+        recorder->m_busy_count++;
+        pthread_cond_broadcast(&recorder->m_cond);
+        pthread_mutex_unlock(&recorder->m_mutex);
+        recorder->m_encoder(
+            frame.fname, frame.pixels, frame.width, frame.height,
+            recorder->m_encoder_data);
+        pthread_mutex_lock(&recorder->m_mutex);
+        recorder->m_busy_count--;
+        pthread_cond_broadcast(&recorder->m_cond);
+    }
+    pthread_mutex_unlock(&recorder->m_mutex);
+    return NULL;
+}
+#endif
+
+/* Wait until every frame that was pushed has been read back and queued
+to be encoded. The encoders are not waited on.*/
+void FrameRecorder::finish() {
+    while (!m_reads.empty())
+        this->collect(true, WAIT_FOR_ENCODERS);
+}
+
+/* Wait until every frame that was pushed has been encoded. */
+void FrameRecorder::wait() {
+    this->finish();
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    while (!m_queue.empty() || m_busy_count > 0)
+        pthread_cond_wait(&m_cond, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+    #endif
+}
+
+int FrameRecorder::dropped_count() const {
+    return m_dropped_count;
+}
+
+FrameRecorder::~FrameRecorder() {
+    this->finish();
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    for (auto &thread: m_threads)
+        pthread_join(thread, NULL);
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_cond);
+    #endif
+}
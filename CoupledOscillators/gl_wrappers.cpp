@@ -20,6 +20,7 @@ introduction to OpenGL without any prior graphics knowledge.
 #include <GLES3/gl32.h>
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
 size_t s_frames_count = 0;
 
@@ -1163,6 +1164,18 @@ void RenderTarget::clear() {
     glBindRenderbuffer(GL_RENDERBUFFER, (GLint)NULL);
 }
 
+void RenderTarget::reset(const TextureParams &new_tex_params) {
+    if (this->id == 0)
+        return;
+    glDeleteTextures(1, &this->texture);
+    glDeleteFramebuffers(1, &this->fbo);
+    glDeleteRenderbuffers(1, &this->rbo);
+    this->params = new_tex_params;
+    this->init_texture();
+    this->init_buffer();
+    unbind();
+}
+
 void RenderTarget::draw(
     uint32_t program,
     const Uniforms &uniforms, WireFrame &wire_frame,
@@ -1758,6 +1771,148 @@ void MainQuad::draw(const RenderTarget &t) {
     );
 }
 
+/* How long to block for when waiting on a read, in nanoseconds. */
+#define READBACK_WAIT_TIMEOUT 1000000000
+
+PixelReadback::PixelReadback(int buffer_count, uint32_t pixel_type) {
+    m_pixel_type = pixel_type;
+    this->resize(buffer_count);
+}
+
+void PixelReadback::release() {
+    for (auto &r: m_reads) {
+        #ifndef __EMSCRIPTEN__
+        if (r.in_use)
+            glDeleteSync(r.fence);
+        glDeleteBuffers(1, &r.pbo);
+        #endif
+    }
+    m_reads.clear();
+}
+
+/* Change the number of reads that can be pending at once.
+Any reads that have not yet been retrieved are discarded.*/
+void PixelReadback::resize(int buffer_count) {
+    this->release();
+    m_reads = std::vector<Read>(buffer_count);
+    for (auto &r: m_reads) {
+        r.pbo = 0;
+        r.fence = 0;
+        r.size = 0;
+        r.in_use = false;
+        r.tag = 0;
+        #ifndef __EMSCRIPTEN__
+        glGenBuffers(1, &r.pbo);
+        #endif
+    }
+    m_next_request = 0;
+    m_next_retrieve = 0;
+}
+
+int PixelReadback::buffer_count() const {
+    return m_reads.size();
+}
+
+int PixelReadback::pending() const {
+    int count = 0;
+    for (auto &r: m_reads)
+        count += (r.in_use)? 1: 0;
+    return count;
+}
+
+bool PixelReadback::is_full() const {
+    return m_reads.empty() || m_reads[m_next_request].in_use;
+}
+
+bool PixelReadback::request(
+    uint32_t fbo, bool is_default_fbo,
+    const TextureParams &params, int tag) {
+    if (this->is_full())
+        return false;
+    Read &r = m_reads[m_next_request];
+    size_t size = params.width*params.height*number_of_channels(params.format)
+        *((m_pixel_type == GL_FLOAT)? sizeof(float): sizeof(uint8_t));
+    if (!is_default_fbo)
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    #ifndef __EMSCRIPTEN__
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+    if (r.size != size)
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    glReadPixels(0, 0, params.width, params.height,
+                 to_base(params.format), m_pixel_type, NULL);
+    r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    #else
+    r.data.resize(size);
+    glReadPixels(0, 0, params.width, params.height,
+                 to_base(params.format), m_pixel_type, (void *)&r.data[0]);
+    #endif
+    unbind();
+    r.size = size;
+    r.tag = tag;
+    r.in_use = true;
+    m_next_request = (m_next_request + 1) % m_reads.size();
+    return true;
+}
+
+bool PixelReadback::request(const Quad &quad, int tag) {
+    return this->request(quad.fbo, quad.id == 0, quad.params, tag);
+}
+
+bool PixelReadback::request(const RenderTarget &target, int tag) {
+    return this->request(target.fbo, target.id == 0, target.params, tag);
+}
+
+/* Copy the oldest read to data if it is ready, or if wait is true,
+block until it is. Returns false if there is nothing to retrieve,
+or if the read is not yet ready and wait is false.*/
+template <typename T>
+bool PixelReadback::retrieve_as(std::vector<T> &data, int &tag, bool wait) {
+    if (m_reads.empty() || !m_reads[m_next_retrieve].in_use)
+        return false;
+    Read &r = m_reads[m_next_retrieve];
+    #ifndef __EMSCRIPTEN__
+    GLenum status = glClientWaitSync(
+        r.fence, (wait)? GL_SYNC_FLUSH_COMMANDS_BIT: 0,
+        (wait)? READBACK_WAIT_TIMEOUT: 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(r.fence);
+    r.fence = 0;
+    data.resize(r.size/sizeof(T));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+    void *ptr = glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, r.size, GL_MAP_READ_BIT);
+    if (ptr != NULL) {
+        memcpy(&data[0], ptr, r.size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        fprintf(stderr, "Unable to map pixel buffer.\n");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    #else
+    data.resize(r.size/sizeof(T));
+    memcpy(&data[0], &r.data[0], r.size);
+    #endif
+    tag = r.tag;
+    r.in_use = false;
+    m_next_retrieve = (m_next_retrieve + 1) % m_reads.size();
+    return true;
+}
+
+bool PixelReadback::retrieve(std::vector<float> &data, int &tag, bool wait) {
+    return this->retrieve_as(data, tag, wait);
+}
+
+bool PixelReadback::retrieve(
+    std::vector<uint8_t> &data, int &tag, bool wait) {
+    return this->retrieve_as(data, tag, wait);
+}
+
+PixelReadback::~PixelReadback() {
+    this->release();
+}
+
 /*
 static double floor(double a) {
     return  (double)((int)(a));
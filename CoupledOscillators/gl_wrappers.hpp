@@ -445,11 +445,13 @@ class RenderTarget {
     void init_texture();
     void init_buffer();
     void adjust_viewport_before_drawing(const Config config);
+    friend class PixelReadback;
     public:
     RenderTarget(TextureParams const &);
     int get_id() const;
     IVec2 texture_dimensions() const;
     void clear();
+    void reset(const TextureParams &);
     void draw(uint32_t program, 
               const Uniforms &uniforms, 
               WireFrame &wire_frame,
@@ -469,6 +471,7 @@ class Quad {
     void init(const TextureParams &);
     friend class MultidimensionalDataQuad;
     friend class MainQuad;
+    friend class PixelReadback;
     void substitute_array(void *array, IVec4 viewport);
     public:
     Quad(const TextureParams &);
@@ -525,6 +528,53 @@ class MainQuad {
     void draw(const RenderTarget &);
 };
 
+/* Read back the contents of frames without stalling the render loop.
+
+Each read is issued into one of a ring of pixel buffer objects, followed
+by a fence. The buffer is only mapped to host memory once this fence
+has signalled that the GPU has finished the read, which is usually a
+frame or two later, so that glReadPixels returns immediately instead of
+waiting for all of the previously issued draw calls to finish. Reads are
+retrieved in the same order that they are requested.
+
+WebGL does not support mapping buffers, so when compiling with
+Emscripten reads are done synchronously when they are requested,
+and then kept until they are retrieved.
+*/
+class PixelReadback {
+    struct Read {
+        uint32_t pbo;
+        GLsync fence;
+        size_t size;
+        bool in_use;
+        int tag;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Read> m_reads;
+    size_t m_next_request;
+    size_t m_next_retrieve;
+    uint32_t m_pixel_type;
+    bool request(uint32_t fbo, bool is_default_fbo,
+                 const TextureParams &params, int tag);
+    template <typename T>
+    bool retrieve_as(std::vector<T> &data, int &tag, bool wait);
+    void release();
+    PixelReadback(const PixelReadback &);
+    PixelReadback& operator=(const PixelReadback &);
+    public:
+    // The pixel type is either GL_FLOAT or GL_UNSIGNED_BYTE.
+    PixelReadback(int buffer_count, uint32_t pixel_type);
+    void resize(int buffer_count);
+    int buffer_count() const;
+    int pending() const;
+    bool is_full() const;
+    bool request(const Quad &quad, int tag=0);
+    bool request(const RenderTarget &target, int tag=0);
+    bool retrieve(std::vector<float> &data, int &tag, bool wait=false);
+    bool retrieve(std::vector<uint8_t> &data, int &tag, bool wait=false);
+    ~PixelReadback();
+};
+
 IVec2 get_2d_from_3d_dimensions(const IVec3 &dimensions_3d);
 
 IVec2 get_2d_from_width_height_length(
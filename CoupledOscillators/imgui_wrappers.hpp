@@ -106,6 +106,7 @@ void imgui_controls(void *void_params) {
         ImGui::EndMenu();
     }
     ImGui::Checkbox("Display samples in normal coordinates", &params->showNormalCoordSamples);
+    ImGui::Checkbox("Use the FFT to transform samples to position coordinates (when the number of oscillators allows it)", &params->useFastTransform);
     ImGui::Text("--------------------------------------------------------------------------------");
     ImGui::Text("Normal mode analytic wave function display");
     ImGui::Checkbox("Colour phase", &params->colorPhase);
@@ -145,6 +146,29 @@ void imgui_controls(void *void_params) {
         ImGui::EndMenu();
     }
     ImGui::Checkbox("Take screenshots", &params->imageRecord);
+    if (ImGui::BeginMenu("When screenshots cannot be saved fast enough")) {
+        if (ImGui::MenuItem( "Drop frames"))
+            s_selection_set(params->IMAGE_RECORD_POLICY, 0);
+        if (ImGui::MenuItem( "Slow down the simulation"))
+            s_selection_set(params->IMAGE_RECORD_POLICY, 1);
+        ImGui::EndMenu();
+    }
+    ImGui::Checkbox("Record video", &params->videoRecord);
+    if (ImGui::BeginMenu("Video format")) {
+        if (ImGui::MenuItem( "YUV4MPEG2 file"))
+            s_selection_set(params->VIDEO_FORMAT, 0);
+        if (ImGui::MenuItem( "Raw RGB file"))
+            s_selection_set(params->VIDEO_FORMAT, 1);
+        if (ImGui::MenuItem( "YUV4MPEG2 to standard output"))
+            s_selection_set(params->VIDEO_FORMAT, 2);
+        if (ImGui::MenuItem( "Raw RGB to standard output"))
+            s_selection_set(params->VIDEO_FORMAT, 3);
+        ImGui::EndMenu();
+    }
+    ImGui::Checkbox("Show trails of past trajectory frames", &params->showTrajectoryTrails);
+    if (ImGui::SliderInt("Number of past trajectory frames in trails", &params->trajectoryHistoryLength, 0, 64))
+            s_sim_params_set(params->TRAJECTORY_HISTORY_LENGTH, params->trajectoryHistoryLength);
+    ImGui::Checkbox("Stream trajectories to file", &params->streamTrajectories);
 
 }
 
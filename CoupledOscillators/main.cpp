@@ -58,6 +58,10 @@ void oscillators(MainGLFWQuad main_render,
                 params.displayType.selected = val;
             if (c == params.CLICK_ACTION_NORMAL)
                 params.clickActionNormal.selected = val;
+            if (c == params.IMAGE_RECORD_POLICY)
+                params.imageRecordPolicy.selected = val;
+            if (c == params.VIDEO_FORMAT)
+                params.videoFormat.selected = val;
             if (c == params.BOUNDARY_TYPE) {
                 params.boundaryType.selected = val;
                 sim.modify_boundaries(params);
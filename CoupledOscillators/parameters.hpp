@@ -42,6 +42,7 @@ struct NotUsed {};
     Vec3 colorOfSamples2 = (Vec3)(Vec3 {.ind={0.0, 1.0, 0.0}});
     SelectionList displayType = SelectionList{1, {"Lines", "Scatter", "Multi-coloured histogram"}};
     bool showNormalCoordSamples = (bool)(true);
+    bool useFastTransform = (bool)(true);
     LineDivider lineDivNormalModeWaveFunc = LineDivider{};
     Label labelNormalModeWaveFunc = Label{};
     bool colorPhase = (bool)(false);
@@ -66,6 +67,12 @@ struct NotUsed {};
     Label DispersionOptionsLabel = Label{};
     SelectionList presetDispersionRelation = SelectionList{0, {"2*sin((pi/2)*(abs(k)/k_max))", "pi*(abs(k)/k_max)"}};
     BoolRecord imageRecord = BoolRecord{false};
+    SelectionList imageRecordPolicy = SelectionList{0, {"Drop frames", "Slow down the simulation"}};
+    bool videoRecord = (bool)(false);
+    SelectionList videoFormat = SelectionList{0, {"YUV4MPEG2 file", "Raw RGB file", "YUV4MPEG2 to standard output", "Raw RGB to standard output"}};
+    bool showTrajectoryTrails = (bool)(false);
+    int trajectoryHistoryLength = (int)(8);
+    bool streamTrajectories = (bool)(false);
     enum {
         STEPS_PER_FRAME=0,
         DT=1,
@@ -86,30 +93,37 @@ struct NotUsed {};
         COLOR_OF_SAMPLES2=16,
         DISPLAY_TYPE=17,
         SHOW_NORMAL_COORD_SAMPLES=18,
-        LINE_DIV_NORMAL_MODE_WAVE_FUNC=19,
-        LABEL_NORMAL_MODE_WAVE_FUNC=20,
-        COLOR_PHASE=21,
-        MODES_BRIGHTNESS=22,
-        LINE_DIV_WAVE_FUNC_OPTIONS=23,
-        WAVE_FUNC_CONFIG_LABEL=24,
-        USE_COHERENT_STATES=25,
-        USE_SQUEEZED=26,
-        USE_STATIONARY=27,
-        USE_SINGLE_EXCITATIONS=28,
-        NOTE_FOR_USE_SINGLE_EXCITATIONS=29,
-        COHERENT_OR_SQUEEZED_SELECTED_LABEL=30,
-        CLICK_ACTION_NORMAL=31,
-        SQUEEZED_SELECTED_LABEL=32,
-        SQUEEZED_FACTOR_GLOBAL=33,
-        SQUEEZED_FACTOR=34,
-        SQUEEZED_STATE_REL_ST_DEV_LABEL=35,
-        ENERGY_EIGENSTATES_SELECTED_LABEL=36,
-        ADD_ENERGY=37,
-        REMOVE_ENERGY=38,
-        LINE_DIV_ADDITIONAL_OPTIONS=39,
-        DISPERSION_OPTIONS_LABEL=40,
-        PRESET_DISPERSION_RELATION=41,
-        IMAGE_RECORD=42,
+        USE_FAST_TRANSFORM=19,
+        LINE_DIV_NORMAL_MODE_WAVE_FUNC=20,
+        LABEL_NORMAL_MODE_WAVE_FUNC=21,
+        COLOR_PHASE=22,
+        MODES_BRIGHTNESS=23,
+        LINE_DIV_WAVE_FUNC_OPTIONS=24,
+        WAVE_FUNC_CONFIG_LABEL=25,
+        USE_COHERENT_STATES=26,
+        USE_SQUEEZED=27,
+        USE_STATIONARY=28,
+        USE_SINGLE_EXCITATIONS=29,
+        NOTE_FOR_USE_SINGLE_EXCITATIONS=30,
+        COHERENT_OR_SQUEEZED_SELECTED_LABEL=31,
+        CLICK_ACTION_NORMAL=32,
+        SQUEEZED_SELECTED_LABEL=33,
+        SQUEEZED_FACTOR_GLOBAL=34,
+        SQUEEZED_FACTOR=35,
+        SQUEEZED_STATE_REL_ST_DEV_LABEL=36,
+        ENERGY_EIGENSTATES_SELECTED_LABEL=37,
+        ADD_ENERGY=38,
+        REMOVE_ENERGY=39,
+        LINE_DIV_ADDITIONAL_OPTIONS=40,
+        DISPERSION_OPTIONS_LABEL=41,
+        PRESET_DISPERSION_RELATION=42,
+        IMAGE_RECORD=43,
+        IMAGE_RECORD_POLICY=44,
+        VIDEO_RECORD=45,
+        VIDEO_FORMAT=46,
+        SHOW_TRAJECTORY_TRAILS=47,
+        TRAJECTORY_HISTORY_LENGTH=48,
+        STREAM_TRAJECTORIES=49,
     };
     void set(int enum_val, Uniform val) {
         switch(enum_val) {
@@ -149,6 +163,9 @@ struct NotUsed {};
             case SHOW_NORMAL_COORD_SAMPLES:
             showNormalCoordSamples = val.b32;
             break;
+            case USE_FAST_TRANSFORM:
+            useFastTransform = val.b32;
+            break;
             case COLOR_PHASE:
             colorPhase = val.b32;
             break;
@@ -179,6 +196,18 @@ struct NotUsed {};
             case REMOVE_ENERGY:
             removeEnergy = val.b32;
             break;
+            case VIDEO_RECORD:
+            videoRecord = val.b32;
+            break;
+            case SHOW_TRAJECTORY_TRAILS:
+            showTrajectoryTrails = val.b32;
+            break;
+            case TRAJECTORY_HISTORY_LENGTH:
+            trajectoryHistoryLength = val.i32;
+            break;
+            case STREAM_TRAJECTORIES:
+            streamTrajectories = val.b32;
+            break;
         }
     }
     Uniform get(int enum_val) const {
@@ -207,6 +236,8 @@ struct NotUsed {};
             return {(Vec3)colorOfSamples2};
             case SHOW_NORMAL_COORD_SAMPLES:
             return {(bool)showNormalCoordSamples};
+            case USE_FAST_TRANSFORM:
+            return {(bool)useFastTransform};
             case COLOR_PHASE:
             return {(bool)colorPhase};
             case MODES_BRIGHTNESS:
@@ -227,6 +258,14 @@ struct NotUsed {};
             return {(bool)addEnergy};
             case REMOVE_ENERGY:
             return {(bool)removeEnergy};
+            case VIDEO_RECORD:
+            return {(bool)videoRecord};
+            case SHOW_TRAJECTORY_TRAILS:
+            return {(bool)showTrajectoryTrails};
+            case TRAJECTORY_HISTORY_LENGTH:
+            return {(int)trajectoryHistoryLength};
+            case STREAM_TRAJECTORIES:
+            return {(bool)streamTrajectories};
         }
         return Uniform(0);
     }
@@ -0,0 +1,78 @@
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+/* Arrange the normal coordinates of each sample of a trajectories tile
+into the complex input of an inverse FFT of length fftSize, so that the
+position coordinates can be recovered from its output in fft-unpack.frag.
+The FFT scratch texture places the fftSize elements of each sample where
+the trajectories tile places its numberOfOscillators coordinates.
+
+For the type I DST with n oscillators the transform is
+    x_p = A sum_{m=0}^{n-1} q_m sin(pi (p + 1)(m + 1)/(n + 1)),
+with A = 2/sqrt(2(n + 1)), which is A times the imaginary part of
+element p + 1 of the inverse DFT of length 2(n + 1) of the sequence
+(0, q_0, q_1, ..., q_{n-1}, 0, ..., 0).
+
+For the discrete sine cosine transform (see orthogonal_transforms.cpp),
+the coordinate of index j corresponds to the wavenumber k = j - n/2 + 1,
+where positive k multiply cosines and negative k sines. Pairing
+the coordinates of k = m and k = -m into c (q_{+m} - i q_{-m}),
+the positions are the real part of the inverse DFT of length n.
+*/
+
+uniform sampler2D trajectoriesTex;
+uniform ivec2 fftTexDimensions;
+uniform int fftSize;
+uniform int transformType;
+#define DST_I 0
+#define DSCT 1
+
+#define complex vec2
+
+float normalCoordinate(float normInd, float sampleInd) {
+    return texture2D(trajectoriesTex, getUV(vec2(normInd, sampleInd)))[0];
+}
+
+void main() {
+    float width = float(fftTexDimensions[0]);
+    float height = float(fftTexDimensions[1]);
+    float n = float(numberOfOscillators);
+    float m = float(fftSize);
+    float xInd = floor(UV.x*width);
+    float yInd = floor(UV.y*height);
+    float k = mod(xInd, m);
+    float sampleInd = height*floor(xInd/m) + yInd;
+    complex z = complex(0.0);
+    if (transformType == DST_I) {
+        if (k >= 1.0 && k <= n)
+            z = complex(normalCoordinate(k - 1.0, sampleInd), 0.0);
+    } else {
+        float halfN = n/2.0;
+        if (k == 0.0)
+            z = sqrt(1.0/n)*complex(
+                normalCoordinate(halfN - 1.0, sampleInd), 0.0);
+        else if (k == halfN)
+            z = sqrt(1.0/n)*complex(
+                normalCoordinate(n - 1.0, sampleInd), 0.0);
+        else if (k < halfN)
+            z = sqrt(2.0/n)*complex(
+                normalCoordinate(halfN - 1.0 + k, sampleInd),
+                -normalCoordinate(halfN - 1.0 - k, sampleInd));
+    }
+    fragColor = vec4(z, 0.0, 1.0);
+}
@@ -0,0 +1,67 @@
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+/* A single radix-2 pass of an unnormalized inverse FFT using the Stockham
+formulation, applied to every row of fftSize complex elements of the
+texture. Starting with stride = 1 and doubling it for each pass up to
+fftSize/2, the output is in natural order after log2(fftSize) passes,
+without needing any bit reversal permutation.
+
+Reference:
+
+Govindaraju N. et al., "High Performance Discrete Fourier Transforms on
+Graphics Processors", SC '08.
+*/
+
+uniform sampler2D tex;
+uniform ivec2 texDimensions;
+uniform int fftSize;
+uniform int stride;
+
+#define complex vec2
+
+const float PI = 3.141592653589793;
+
+complex mul(complex z, complex w) {
+    return complex(z.x*w.x - z.y*w.y, z.x*w.y + z.y*w.x);
+}
+
+complex expI(float angle) {
+    return complex(cos(angle), sin(angle));
+}
+
+complex getElement(float offset, float index) {
+    float width = float(texDimensions[0]);
+    return texture2D(tex, vec2((offset + index + 0.5)/width, UV.y)).xy;
+}
+
+void main() {
+    float width = float(texDimensions[0]);
+    float m = float(fftSize);
+    float ns = float(stride);
+    float xInd = floor(UV.x*width);
+    float outputInd = mod(xInd, m);
+    float offset = xInd - outputInd;
+    float q = mod(outputInd, 2.0*ns);
+    float butterflyInd = mod(q, ns);
+    float inputInd = floor(outputInd/(2.0*ns))*ns + butterflyInd;
+    complex a = getElement(offset, inputInd);
+    complex b = mul(getElement(offset, inputInd + m/2.0),
+                    expI(PI*butterflyInd/ns));
+    fragColor = vec4((q < ns)? a + b: a - b, 0.0, 1.0);
+}
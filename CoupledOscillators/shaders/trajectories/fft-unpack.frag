@@ -0,0 +1,43 @@
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+/* Get the position coordinates of each sample of a trajectories tile from
+the output of the inverse FFT of the sequence that fft-pack.frag
+has made from its normal coordinates.*/
+
+uniform sampler2D fftTex;
+uniform ivec2 fftTexDimensions;
+uniform int fftSize;
+uniform int transformType;
+#define DST_I 0
+#define DSCT 1
+
+void main() {
+    vec2 indices = getOscillatorSampleIndices(UV);
+    float posInd = indices[0];
+    float sampleInd = indices[1];
+    float n = float(numberOfOscillators);
+    float m = float(fftSize);
+    float column = floor(sampleInd/float(trajectoriesTexDimensions[1]));
+    float fftInd = (transformType == DST_I)? posInd + 1.0: posInd;
+    vec2 uv = vec2((m*column + fftInd + 0.5)/float(fftTexDimensions[0]),
+                   UV.y);
+    vec2 z = texture2D(fftTex, uv).xy;
+    float pos = (transformType == DST_I)? 2.0*z.y/sqrt(2.0*(n + 1.0)): z.x;
+    fragColor = vec4(pos, pos, pos, 1.0);
+}
@@ -0,0 +1,47 @@
+#if __VERSION__ <= 120
+attribute vec2 position;
+varying vec2 UV;
+#else
+in vec2 position;
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+
+/* Scatter each texel of a trajectories tile to a single pixel of the
+histogram render target, where the column is the oscillator index and
+the row is found by binning the texel's value plus valueOffset over
+the interval [minValue, minValue + valueRange). These points are then
+summed with additive blending to give the histogram counts.
+
+The input vertex attribute array holds the oscillator index and the
+sample index for each point. Points whose sample index is at least
+sampleCount correspond to the padding of the last tile, and are moved
+outside of the clip volume.
+*/
+
+uniform sampler2D trajectoriesTex;
+uniform int sampleCount;
+uniform float valueOffset;
+uniform float minValue;
+uniform float valueRange;
+
+void main() {
+    UV = getUV(position);
+    float value = texture2D(trajectoriesTex, UV).r + valueOffset;
+    float x = (position.x + 0.5)/float(numberOfOscillators);
+    float y = (value - minValue)/valueRange;
+    gl_Position = vec4(2.0*x - 1.0, 2.0*y - 1.0, 0.0, 1.0);
+    if (position.y >= float(sampleCount))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    gl_PointSize = 1.0;
+}
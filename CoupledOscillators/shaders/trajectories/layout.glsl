@@ -0,0 +1,40 @@
+/* Helper functions for locating a Monte Carlo sample inside of a
+trajectories texture tile. This file is prepended to the sources of the
+shaders that read from or write to these tiles, so it must only contain
+declarations. See trajectories_layout.hpp for a description of the layout.
+*/
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform int numberOfOscillators;
+uniform ivec2 trajectoriesTexDimensions;
+
+/* Get the oscillator index and the sample index that is local to
+the tile from the texture coordinates of a texel of the tile.*/
+vec2 getOscillatorSampleIndices(vec2 uv) {
+    float width = float(trajectoriesTexDimensions[0]);
+    float height = float(trajectoriesTexDimensions[1]);
+    float n = float(numberOfOscillators);
+    float xInd = floor(uv.x*width);
+    float yInd = floor(uv.y*height);
+    float oscillatorInd = mod(xInd, n);
+    float sampleInd = height*floor(xInd/n) + yInd;
+    return vec2(oscillatorInd, sampleInd);
+}
+
+/* Get the texture coordinates of the centre of the texel that holds
+a given oscillator of a sample, where the sample index is local to
+the tile. Fractional oscillator indices are measured from the centre
+of the texel.*/
+vec2 getUV(vec2 oscillatorSampleIndices) {
+    float width = float(trajectoriesTexDimensions[0]);
+    float height = float(trajectoriesTexDimensions[1]);
+    float n = float(numberOfOscillators);
+    float oscillatorInd = oscillatorSampleIndices[0];
+    float sampleInd = oscillatorSampleIndices[1];
+    float xInd = n*floor(sampleInd/height) + oscillatorInd;
+    float yInd = mod(sampleInd, height);
+    return vec2((xInd + 0.5)/width, (yInd + 0.5)/height);
+}
@@ -16,9 +16,6 @@ in vec2 UV;
 out vec4 fragColor;
 #endif
 
-uniform int numberOfOscillators;
-uniform ivec2 trajectoriesTexDimensions;
-
 uniform sampler2D trajectoriesTex;
 uniform bool useTransformTex;
 uniform sampler2D transformTex;
@@ -63,28 +60,6 @@ float dsctElement(int i, int j, int n) {
         cos(2.0*PI*float(i*k)/float(n)));
 }
 
-vec2 getOscillatorSampleIndices(vec2 uv) {
-    float width = float(trajectoriesTexDimensions[0]);
-    float height = float(trajectoriesTexDimensions[1]);
-    float n = float(numberOfOscillators);
-    float xInd = uv.x*width - 0.5;
-    float yInd = uv.y*height - 0.5;
-    float oscillatorInd = mod(xInd, n);
-    float sampleInd = height*floor(xInd/n) + yInd;
-    return vec2(oscillatorInd, sampleInd);
-}
-
-vec2 getUV(vec2 oscillatorSampleIndices) {
-    float width = float(trajectoriesTexDimensions[0]);
-    float height = float(trajectoriesTexDimensions[1]);
-    float n = float(numberOfOscillators);
-    float oscillatorInd = oscillatorSampleIndices[0];
-    float sampleInd = oscillatorSampleIndices[1];
-    float xInd = n*floor(sampleInd/height) + oscillatorInd;
-    float yInd = mod(sampleInd, height);
-    return vec2((xInd + 0.5)/width, (yInd + 0.5)/height);
-}
-
 vec4 sampleTrajectoryTex(float posInd, float sampleInd) {
     vec2 uv = getUV(vec2(posInd, sampleInd));
     return texture2D(trajectoriesTex, uv);
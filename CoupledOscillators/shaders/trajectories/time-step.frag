@@ -16,13 +16,11 @@ in vec2 UV;
 out vec4 fragColor;
 #endif
 
-uniform int numberOfOscillators;
 uniform float t;
 uniform float dt;
 uniform float m;
 uniform float hbar;
 uniform sampler2D initialValuesTex;
-uniform int trajectoriesTexWidth;
 uniform sampler2D trajectoriesTex;
 
 const float PI = 3.141592653589793;
@@ -75,9 +73,7 @@ float squeezedTrajectory(
 
 void main() {
     float x = texture2D(trajectoriesTex, UV).x;
-    float ind = mod(
-        float(trajectoriesTexWidth)*UV.x-0.5, 
-        float(numberOfOscillators)) + 0.5;
+    float ind = getOscillatorSampleIndices(UV)[0] + 0.5;
     vec4 initialValues = texture2D(
         initialValuesTex, vec2(ind/float(numberOfOscillators), 0.5));
     vec4 initialXPOmegaSigma = initialValues;
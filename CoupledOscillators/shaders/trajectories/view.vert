@@ -19,58 +19,46 @@ precision highp float;
 uniform float scaleY;
 uniform float yOffset;
 
-uniform int numberOfOscillators;
-uniform ivec2 trajectoryTexDimensions;
+uniform int sampleCount;
 uniform sampler2D trajectoriesTex;
 uniform int boundaryCond;
+// Where the tile is inside of trajectoriesTex, as the texture
+// coordinates of its corner and its size, for when trajectoriesTex
+// holds several tiles, as with the frames of the trajectory history.
+uniform vec2 slotOffset;
+uniform vec2 slotScale;
 const int ZERO_ENDPOINTS = 0;
 const int PERIODIC = 1;
 
 /* 
-This function transforms the normalized x oscillator index of
-the vertex attribute array and its y Monte Carlo sample index into 
-the coordinates of the trajectories input texture which contains
-the actual position offsets of each oscillator.
+The normalized x oscillator index of the vertex attribute array and
+its y Monte Carlo sample index are transformed into the coordinates
+of the trajectories input texture which contains the actual position
+offsets of each oscillator, using getUV from layout.glsl.
 
 The input vertex attribute array that dictates how the vertices are
-arranged has a height that is equal to the number of Monte Carlo steps,
-and a width that is equal to numberOfOscillators, or 
-numberOfOscillators + 2, or 2*numberOfOscillators: the first is used for
-drawing lines without the endpoints included, the second includes the
-endpoints, and the last is for disconnected lines without the endpoints
-included. To get the actual position offsets of the oscillators a texture
-containing these must be sampled, but this texture has dimensions
-(numberOfOscillators*stackW) x ((number of Monte Carlo steps)/stackW),
-where stackW is a chosen integer value that minimizes the perimeter of
-this texture.
+arranged has a height that is equal to the number of samples held by a
+single trajectories texture tile, and a width that is equal to
+numberOfOscillators, or numberOfOscillators + 2, or 2*numberOfOscillators:
+the first is used for drawing lines without the endpoints included,
+the second includes the endpoints, and the last is for disconnected lines
+without the endpoints included. Rows past sampleCount correspond to the
+padding of the last tile and are moved outside of the clip volume.
 */
-vec2 getTextureCoordinates(float oscillatorIndex, float trajectoryIndex) {
-    float width = float(trajectoryTexDimensions[0]);
-    float height = float(trajectoryTexDimensions[1]);
-    float n = float(numberOfOscillators);
-    oscillatorIndex += 0.5;
-    return vec2(
-        (oscillatorIndex + floor(trajectoryIndex/height)*n)/width,
-        mod((trajectoryIndex + 0.5), height)/height);
-}
-
 void main() {
     float x = (position.x + 0.5)/float(numberOfOscillators);
     float trajectoryIndex = position.y;
-    // float trajectoryTexW = float(trajectoryTexDimensions[0]);
-    // float trajectoryTexH = float(trajectoryTexDimensions[1]);
-    // float stackSize = trajectoryTexH/float(numberOfOscillators);
-    UV = getTextureCoordinates(position.x, trajectoryIndex);
+    UV = getUV(vec2(position.x, trajectoryIndex));
     if (boundaryCond == PERIODIC && x < 0.0)
-        UV = getTextureCoordinates(
-            (float(numberOfOscillators) - 0.5)/float(numberOfOscillators),
-            trajectoryIndex);
+        UV = getUV(vec2(float(numberOfOscillators - 1), trajectoryIndex));
     if (boundaryCond == PERIODIC && x >= 1.0)
-        UV = getTextureCoordinates(
-            0.5/float(numberOfOscillators), trajectoryIndex);
+        UV = getUV(vec2(0.0, trajectoryIndex));
+    UV = slotOffset + slotScale*UV;
     float oscillatorOffset = texture2D(trajectoriesTex, UV).r;
     if (boundaryCond == ZERO_ENDPOINTS && (x < 0.0 || x >= 1.0))
         oscillatorOffset = 0.0;
     gl_Position = vec4(
         2.0*x - 1.0, oscillatorOffset*scaleY + yOffset, vec2(0.0, 1.0));
+    if (trajectoryIndex >= float(sampleCount))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
 }
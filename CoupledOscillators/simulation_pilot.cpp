@@ -4,64 +4,76 @@
 #include "write_to_png.hpp"
 #include "orthogonal_transforms.hpp"
 
-static struct IVec2 decompose(unsigned int n) {
-    struct IVec2 d = {.ind={(int)n, 1}};
-    int i = 1;
-    for (; i*i < n; i++) {}
-    for (; n % i; i--) {}
-    d.ind[0] = ((n / i) > i)? (n / i): i;
-    d.ind[1] = ((n / i) < i)? (n / i): i;
-    return d;
-}
-
-static struct IVec3 decompose_3(unsigned int n) {
-    struct IVec3 d = {.ind={(int)n, 1, 1}};
-    int i = 1;
-    for (; i*i*i < n; i++) {}
-    for (; n % i; i--) {}
-    IVec2 d_2d = decompose(n/i);
-    d.ind[0] = d_2d[0];
-    d.ind[1] = d_2d[1];
-    d.ind[2] = i; 
-    return d;
-}
-
-IVec2 get_dimensions(int n_large, int n_small) {
-    IVec3 prod3 = decompose_3(n_large);
-    printf("%d, %d, %d\n", prod3[0], prod3[1], prod3[2]);
-    IVec2 d1 = {.ind{prod3[0]*n_small, prod3[1]*prod3[2]}};
-    IVec2 d2 = {.ind{prod3[1]*n_small, prod3[0]*prod3[2]}};
-    IVec2 d3 = {.ind{prod3[2]*n_small, prod3[0]*prod3[1]}};
-    int d1_size = d1[0] + d1[1];
-    int d2_size = d2[0] + d2[1];
-    int d3_size = d3[0] + d3[1];
-    if (d1_size <= d2_size && d1_size <= d3_size)
-        return d1;
-    else if (d2_size <= d1_size && d2_size <= d3_size)
-        return d2;
-    else
-        return d3;
+#include <fstream>
+#include <sstream>
+
+static std::string get_shader_source(const std::string &fname) {
+    std::ifstream f(fname);
+    if (!f.is_open())
+        fprintf(stderr, "Opening %s failed.\n", fname.c_str());
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
 }
 
-namespace sim_pilot {
+/* Get the source of a shader that accesses the trajectories textures,
+where the layout helper functions are placed in front of it.*/
+static std::string get_trajectories_shader_source(const std::string &fname) {
+    return get_shader_source("./shaders/trajectories/layout.glsl")
+        + get_shader_source(fname);
+}
 
-Frames::Frames(const sim_2d::SimParams &sim_params, 
-    int view_width, int view_height): 
-    trajectories_tex_params {
+static TextureParams get_trajectories_tex_params(
+    const TrajectoriesLayout &layout) {
+    IVec2 d = layout.tile_dimensions();
+    return {
         .format=GL_R32F,
-            .width=(uint32_t)get_dimensions(
-                sim_params.numberOfMCSteps,
-                sim_params.numberOfOscillators
-            ).ind[0],
-            .height=(uint32_t)get_dimensions(
-                sim_params.numberOfMCSteps,
-                sim_params.numberOfOscillators
-            ).ind[1],
+            .width=(uint32_t)d[0],
+            .height=(uint32_t)d[1],
             .wrap_s=GL_REPEAT,
             .wrap_t=GL_REPEAT,
             .min_filter=GL_NEAREST,
             .mag_filter=GL_NEAREST,
-    },
+    };
+}
+
+/* Write a frame read back by the FrameRecorder to a PNG file.*/
+static void encode_png(
+    const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height, [[maybe_unused]] void *encoder_data) {
+    if (pixels.size() == (size_t)4*width*height) {
+        for (int i = 0; i < width*height; i++) {
+            pixels[3*i] = pixels[4*i];
+            pixels[3*i + 1] = pixels[4*i + 1];
+            pixels[3*i + 2] = pixels[4*i + 2];
+        }
+    }
+    write_rgb8_png(fname.c_str(), &pixels[0], width, height);
+}
+
+static bool is_power_of_two(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static std::vector<Quad> make_tiles(
+    const TextureParams &tex_params, int tile_count) {
+    std::vector<Quad> tiles {};
+    // Reserve beforehand so that the Quads are never copied
+    // when the vector grows.
+    tiles.reserve(tile_count);
+    for (int i = 0; i < tile_count; i++)
+        tiles.emplace_back(tex_params);
+    return tiles;
+}
+
+namespace sim_pilot {
+
+Frames::Frames(const sim_2d::SimParams &sim_params, 
+    int view_width, int view_height): 
+    trajectories_layout(get_trajectories_layout(
+        sim_params.numberOfMCSteps, sim_params.numberOfOscillators)),
+    trajectories_tex_params(
+        get_trajectories_tex_params(trajectories_layout)),
     transform_tex_params {
         .format=GL_R32F,
             .width=(uint32_t)sim_params.numberOfOscillators,
@@ -76,46 +88,205 @@ Frames::Frames(const sim_2d::SimParams &sim_params,
     // tmp2{Quad(trajectories_tex_params)},
     // tmp3{Quad(trajectories_tex_params)},
     // tmp4{Quad(trajectories_tex_params)},
-    position_trajectories{Quad(trajectories_tex_params)},
+    position_trajectories{make_tiles(
+        trajectories_tex_params, trajectories_layout.tile_count)},
     trajectories {.x={
-        Quad{trajectories_tex_params},
-        Quad{trajectories_tex_params}},
+        make_tiles(trajectories_tex_params, trajectories_layout.tile_count),
+        make_tiles(trajectories_tex_params, trajectories_layout.tile_count)},
         .next=1, .prev=0},
     discrete_sine{Quad(transform_tex_params)},
     discrete_sine_cosine{Quad(transform_tex_params)},
     trajectories_view_wire_frame {trajectories_wire_frame::get(
-        sim_params.numberOfMCSteps, sim_params.numberOfOscillators,
+        trajectories_layout.samples_per_tile,
+        sim_params.numberOfOscillators,
         trajectories_wire_frame::DISCONNECTED_LINES
-    )} {
+    )},
+    fft_tex_params {
+        .format=GL_RG32F,
+            .width=0,
+            .height=0,
+            .wrap_s=GL_REPEAT,
+            .wrap_t=GL_REPEAT,
+            .min_filter=GL_NEAREST,
+            .mag_filter=GL_NEAREST,
+    },
+    hist_tex_params {
+        .format=GL_R32F,
+            .width=(uint32_t)sim_params.numberOfOscillators,
+            .height=(uint32_t)view_height/2,
+            .wrap_s=GL_REPEAT,
+            .wrap_t=GL_REPEAT,
+            .min_filter=GL_NEAREST,
+            .mag_filter=GL_NEAREST,
+    },
+    hist(hist_tex_params),
+    histogram_wire_frame {trajectories_wire_frame::get(
+        trajectories_layout.samples_per_tile,
+        sim_params.numberOfOscillators,
+        trajectories_wire_frame::POINTS
+    )},
+    trajectory_history {
+        .frames={}, .requested_length=0, .length=0,
+        .columns=1, .count=0, .newest=0} {
+    this->reset_trajectory_history(sim_params.trajectoryHistoryLength);
+}
+
+IVec4 TrajectoryHistory::slot_viewport(
+    int slot, IVec2 tile_dimensions) const {
+    return IVec4{.ind{
+        tile_dimensions[0]*(slot % columns),
+        tile_dimensions[1]*(slot / columns),
+        tile_dimensions[0], tile_dimensions[1]}};
+}
 
+/* Get the position of a slot in texture coordinates, for sampling
+its frame in the shaders.*/
+Vec2 TrajectoryHistory::slot_offset(int slot) const {
+    int rows = (length + columns - 1)/columns;
+    return Vec2{.x=float(slot % columns)/float(columns),
+                .y=float(slot / columns)/float(rows)};
+}
+
+/* Get the size of a slot in texture coordinates.*/
+Vec2 TrajectoryHistory::slot_scale() const {
+    int rows = (length + columns - 1)/columns;
+    return Vec2{.x=1.0F/float(columns), .y=1.0F/float(rows)};
+}
+
+/* Get the slot that holds the frame that was recorded age time steps
+before the most recent one.*/
+int TrajectoryHistory::slot_of_age(int age) const {
+    return (newest - age + length) % length;
+}
+
+/* Allocate the textures for keeping the given number of past
+frames of each trajectories tile, where the slots for these frames are
+placed in as many columns as the maximum texture width allows.*/
+void Frames::reset_trajectory_history(int length) {
+    TrajectoryHistory &history = trajectory_history;
+    IVec2 d = trajectories_layout.tile_dimensions();
+    int max_size = trajectories_layout.max_texture_size;
+    int max_columns = max_size/d[0], max_rows = max_size/d[1];
+    history.frames.clear();
+    history.requested_length = length;
+    history.count = 0;
+    history.newest = 0;
+    if (length > max_columns*max_rows) {
+        fprintf(stderr, "Only %d trajectory frames fit in a texture.\n",
+                max_columns*max_rows);
+        length = max_columns*max_rows;
+    }
+    history.length = length;
+    if (length <= 0)
+        return;
+    history.columns = (length < max_columns)? length: max_columns;
+    int rows = (length + history.columns - 1)/history.columns;
+    TextureParams tex_params = trajectories_tex_params;
+    tex_params.width = d[0]*history.columns;
+    tex_params.height = d[1]*rows;
+    history.frames = make_tiles(tex_params, trajectories_layout.tile_count);
+}
+
+void Frames::reset_trajectories(
+    int number_of_samples, int number_of_oscillators) {
+    trajectories_layout = get_trajectories_layout(
+        number_of_samples, number_of_oscillators);
+    trajectories_tex_params = get_trajectories_tex_params(trajectories_layout);
+    int tile_count = trajectories_layout.tile_count;
+    // Release the old textures first so that their ids get reused.
+    position_trajectories.clear();
+    trajectories.x[0].clear();
+    trajectories.x[1].clear();
+    position_trajectories = make_tiles(trajectories_tex_params, tile_count);
+    trajectories.x[0] = make_tiles(trajectories_tex_params, tile_count);
+    trajectories.x[1] = make_tiles(trajectories_tex_params, tile_count);
+    trajectories.prev = 0;
+    trajectories.next = 1;
+    trajectories_view_wire_frame = trajectories_wire_frame::get(
+        trajectories_layout.samples_per_tile, number_of_oscillators,
+        trajectories_wire_frame::DISCONNECTED_LINES);
+    histogram_wire_frame = trajectories_wire_frame::get(
+        trajectories_layout.samples_per_tile, number_of_oscillators,
+        trajectories_wire_frame::POINTS);
+    this->reset_trajectory_history(trajectory_history.requested_length);
+    if (hist_tex_params.width != number_of_oscillators) {
+        hist_tex_params.width = number_of_oscillators;
+        hist.reset(hist_tex_params);
+    }
+    fft_scratch.clear();
+}
+
+/* Make sure that there are two FFT scratch textures that
+hold fft_size elements for each sample of a trajectories tile,
+or release them if fft_size is zero.*/
+void Frames::reset_fft_scratch(int fft_size) {
+    if (fft_size == 0) {
+        fft_scratch.clear();
+        return;
+    }
+    IVec2 d = trajectories_layout.tile_dimensions();
+    uint32_t width = fft_size*trajectories_layout.columns_per_tile;
+    uint32_t height = d[1];
+    if (fft_scratch.size() == 2 && fft_tex_params.width == width
+        && fft_tex_params.height == height)
+        return;
+    fft_tex_params.width = width;
+    fft_tex_params.height = height;
+    fft_scratch.clear();
+    fft_scratch = make_tiles(fft_tex_params, 2);
 }
 
 GLSLPrograms::GLSLPrograms() {
     this->time_step 
-        = Quad::make_program_from_path(
-            "./shaders/trajectories/time-step.frag");
+        = Quad::make_program_from_source(get_trajectories_shader_source(
+            "./shaders/trajectories/time-step.frag"));
     this->trajectories_view
-        = make_program_from_paths(
-            "./shaders/trajectories/view.vert", 
-            "./shaders/util/uniform-color.frag");
+        = make_program_from_sources(
+            get_trajectories_shader_source(
+                "./shaders/trajectories/view.vert"), 
+            get_shader_source("./shaders/util/uniform-color.frag"));
     this->norms2pos
-        = Quad::make_program_from_path(
-            "./shaders/trajectories/norms2pos.frag");
+        = Quad::make_program_from_source(get_trajectories_shader_source(
+            "./shaders/trajectories/norms2pos.frag"));
     this->orthogonal_transforms
         = Quad::make_program_from_path(
             "./shaders/util/orthogonal-transforms.frag");
+    this->histogram
+        = make_program_from_sources(
+            get_trajectories_shader_source(
+                "./shaders/trajectories/histogram.vert"), 
+            get_shader_source("./shaders/util/uniform-color.frag"));
+    this->fft_pack
+        = Quad::make_program_from_source(get_trajectories_shader_source(
+            "./shaders/trajectories/fft-pack.frag"));
+    this->fft_pass
+        = Quad::make_program_from_path(
+            "./shaders/trajectories/fft-stockham.frag");
+    this->fft_unpack
+        = Quad::make_program_from_source(get_trajectories_shader_source(
+            "./shaders/trajectories/fft-unpack.frag"));
 
 };
 
 Simulation::Simulation(const sim_2d::SimParams &sim_params,
         int view_width, int view_height):
         sim_2d::Simulation(sim_params, view_width, view_height),
-        m_programs(), m_frames(sim_params, view_width, view_height) {
+        m_programs(), m_frames(sim_params, view_width, view_height),
+        m_frame_recorder(encode_png),
+        // A single encoder thread keeps the video frames in order.
+        m_video_recorder(VideoStream::encode, 1, 8, &m_video_stream),
+        m_video_recording(false) {
     this->make_transform_textures(sim_params.numberOfOscillators);
 }
 
 void Simulation::make_transform_textures(int number_of_oscillators) {
     int n = number_of_oscillators;
+    if (m_frames.discrete_sine.width() != n) {
+        m_frames.transform_tex_params.width = n;
+        m_frames.transform_tex_params.height = n;
+        m_frames.discrete_sine.reset(m_frames.transform_tex_params);
+        m_frames.discrete_sine_cosine.reset(m_frames.transform_tex_params);
+    }
     std::vector<float> transform (n*n, 0.0);
     std::vector<float> i_transform ( n*n, 0.0);
     make_dst(transform, i_transform, n);
@@ -127,22 +298,25 @@ void Simulation::make_transform_textures(int number_of_oscillators) {
 }
 
 void Simulation::load_config_to_texture(int number_of_oscillators) {
-    int w = m_frames.trajectories_tex_params.width;
-    int h = m_frames.trajectories_tex_params.height;
-    printf("Dimensions: %d, %d\n", w, h);
-    int stack_w = w/number_of_oscillators;
-    const std::vector<double> configs = get_configs();
-    for (int i = 0; i < stack_w; i++) {
-        int sub_size = number_of_oscillators*h;
-        int offset = i*sub_size;
-        std::vector<float> sub_configs (sub_size, 0.0);
-        for (int k = 0; k < sub_size; k++)
-            sub_configs[k] = configs[k + offset];
-        int tex_x_offset = number_of_oscillators*i;
-        m_frames.trajectories.x[0].set_pixels(
-            sub_configs, IVec4{.ind{
-                tex_x_offset, 0,
-                number_of_oscillators, h}});
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    int n = number_of_oscillators;
+    int h = layout.samples_per_column;
+    const std::vector<double> &configs = get_configs();
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        int tile_sample_count = layout.samples_in_tile(tile);
+        int first_sample = layout.first_sample_of_tile(tile);
+        // The last column of the last tile may only be partially filled.
+        for (int i = 0; i*h < tile_sample_count; i++) {
+            int rows = tile_sample_count - i*h;
+            rows = (rows < h)? rows: h;
+            int sub_size = n*rows;
+            int offset = (first_sample + i*h)*n;
+            std::vector<float> sub_configs (sub_size, 0.0);
+            for (int k = 0; k < sub_size; k++)
+                sub_configs[k] = configs[k + offset];
+            m_frames.trajectories.x[0][tile].set_pixels(
+                sub_configs, IVec4{.ind{n*i, 0, n, rows}});
+        }
     }
     m_frames.trajectories.prev = 0;
     m_frames.trajectories.next = 1;
@@ -150,89 +324,341 @@ void Simulation::load_config_to_texture(int number_of_oscillators) {
 
 void Simulation::time_step(const sim_2d::SimParams &sim_params) {
     int next = m_frames.trajectories.next, prev = m_frames.trajectories.prev;
-    m_frames.trajectories.x[next].draw(
-        m_programs.time_step,
-        {
-            {"numberOfOscillators", int(sim_params.numberOfOscillators)},
-            {"t", sim_params.t},
-            {"dt", sim_params.dt},
-            {"m", 1.0F},
-            {"hbar", 1.0F},
-            {"initialValuesTex",
-                &sim_2d::Simulation::get_frames().initial_values},
-            {"trajectoriesTexWidth",
-                int(m_frames.trajectories.x[prev].width())},
-            {"trajectoriesTex",
-                &m_frames.trajectories.x[prev]}
-        }
-    );
+    IVec2 tile_dimensions = m_frames.trajectories_layout.tile_dimensions();
+    for (int tile = 0; tile < m_frames.trajectories_layout.tile_count;
+         tile++) {
+        m_frames.trajectories.x[next][tile].draw(
+            m_programs.time_step,
+            {
+                {"numberOfOscillators", int(sim_params.numberOfOscillators)},
+                {"t", sim_params.t},
+                {"dt", sim_params.dt},
+                {"m", 1.0F},
+                {"hbar", 1.0F},
+                {"initialValuesTex",
+                    &sim_2d::Simulation::get_frames().initial_values},
+                {"trajectoriesTexDimensions", tile_dimensions},
+                {"trajectoriesTex",
+                    &m_frames.trajectories.x[prev][tile]}
+            }
+        );
+    }
     // m_frames.trajectories.next = prev;
     // m_frames.trajectories.prev = next;
 }
 
+/* Copy the newest position trajectories to the history ring buffer if
+trails are shown, and if streaming to file, queue them to be read back
+and written. This must come after normals2positions.*/
+void Simulation::record_trajectories(const sim_2d::SimParams &sim_params) {
+    const sim_2d::GLSLPrograms &super_programs 
+        = sim_2d::Simulation::get_programs();
+    TrajectoryHistory &history = m_frames.trajectory_history;
+    std::vector<Quad> &x = m_frames.position_trajectories;
+    if (history.requested_length != sim_params.trajectoryHistoryLength)
+        m_frames.reset_trajectory_history(
+            sim_params.trajectoryHistoryLength);
+    // Nothing else reads the history, so it is only kept while the
+    // trails are shown, and starts over when they are shown again.
+    if (!sim_params.showTrajectoryTrails)
+        history.count = 0;
+    else if (history.length > 0) {
+        history.newest = (history.count == 0)?
+            0: (history.newest + 1) % history.length;
+        if (history.count < history.length)
+            history.count++;
+        IVec4 v = history.slot_viewport(
+            history.newest, m_frames.trajectories_layout.tile_dimensions());
+        for (int tile = 0; tile < (int)x.size(); tile++)
+            history.frames[tile].draw(
+                super_programs.copy, {{"tex", &x[tile]}},
+                Config::viewport(v[0], v[1], v[2], v[3]));
+    }
+    #ifndef __EMSCRIPTEN__
+    if (sim_params.streamTrajectories && !m_trajectory_stream.is_open())
+        m_trajectory_stream.open(
+            "trajectories_" + std::to_string(sim_params.stepCount) + ".bin",
+            m_frames.trajectories_layout);
+    else if (!sim_params.streamTrajectories
+             && m_trajectory_stream.is_open())
+        m_trajectory_stream.close();
+    m_trajectory_stream.push(x, sim_params.t);
+    #endif
+}
+
+/* Start or stop the video stream when the videoRecord parameter
+changes, and queue the current image to be written to it.*/
+void Simulation::record_video(const sim_2d::SimParams &sim_params) {
+    sim_2d::Frames &super_frames = sim_2d::Simulation::get_frames();
+    if (sim_params.videoRecord != m_video_recording) {
+        // The stream is only ever written to by the encoder thread,
+        // so it must be idle before the stream is changed.
+        m_video_recorder.wait();
+        m_video_stream.close();
+        m_video_recording = sim_params.videoRecord;
+        if (m_video_recording) {
+            enum {Y4M_FILE=0, RAW_FILE=1, Y4M_STDOUT=2, RAW_STDOUT=3};
+            int selected = sim_params.videoFormat.selected;
+            int format = (selected == RAW_FILE || selected == RAW_STDOUT)?
+                VideoStream::RAW_RGB: VideoStream::Y4M;
+            std::string fname = (selected == Y4M_STDOUT
+                                 || selected == RAW_STDOUT)? "-":
+                "oscillators_" + std::to_string(sim_params.stepCount)
+                + ((format == VideoStream::Y4M)? ".y4m": ".rgb");
+            m_video_stream.open(
+                fname,
+                super_frames.image.width(), super_frames.image.height(),
+                format);
+        }
+    }
+    if (m_video_stream.is_open())
+        m_video_recorder.push(
+            super_frames.image, "", sim_params.imageRecordPolicy.selected);
+}
+
 void Simulation::plot_non_hist_normals(const sim_2d::SimParams &sim_params) {
     sim_2d::Frames &super_frames = sim_2d::Simulation::get_frames();
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
     Vec3 c = sim_params.colorOfSamples2;
-    IVec2 trajectories_dimensions = IVec2{.ind{
-        (int)m_frames.trajectories_tex_params.width,
-        (int)m_frames.trajectories_tex_params.height}};
-    super_frames.configs_view.draw(
-        m_programs.trajectories_view,
-        {
-            {"scaleY", float(1.0F/40.0F)},
-            {"color", Vec4{.r=c.r, c.g, c.b, sim_params.alphaBrightness}},
-            {"yOffset", float(-0.5)},
-            {"numberOfOscillators", sim_params.numberOfOscillators},
-            {"trajectoryTexDimensions", trajectories_dimensions},
-            {"trajectoriesTex", &m_frames.trajectories.x[1]},
-            {"boundaryCond", sim_params.boundaryType.selected}
-        },
-        m_frames.trajectories_view_wire_frame
-    );
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        super_frames.configs_view.draw(
+            m_programs.trajectories_view,
+            {
+                {"scaleY", float(1.0F/40.0F)},
+                {"color", Vec4{.r=c.r, c.g, c.b, sim_params.alphaBrightness}},
+                {"yOffset", float(-0.5)},
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"sampleCount", layout.samples_in_tile(tile)},
+                {"trajectoriesTex", &m_frames.trajectories.x[1][tile]},
+                {"slotOffset", Vec2{.x=0.0F, .y=0.0F}},
+                {"slotScale", Vec2{.x=1.0F, .y=1.0F}},
+                {"boundaryCond", sim_params.boundaryType.selected}
+            },
+            m_frames.trajectories_view_wire_frame
+        );
+    }
+}
+
+/* Smaller transforms are done faster with the dense matrix,
+since the FFT requires at least log2(size) + 2 passes.*/
+#define MIN_FFT_SIZE 16
+
+/* Get the length of the FFT used for transforming the samples to
+position coordinates, or zero if the dense transform matrix must be used.
+
+The type I DST for n oscillators is computed with an FFT of length
+2(n + 1), while the discrete sine cosine transform uses one of length n.
+Only radix-2 FFTs are implemented, so these lengths must be powers of two.
+The scratch textures are also wider than the trajectories textures, and
+therefore may not fit within the maximum texture size.
+*/
+int Simulation::get_fft_size(const sim_2d::SimParams &sim_params) {
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    int n = sim_params.numberOfOscillators;
+    enum {ZERO_AT_ENDPOINTS=0, PERIODIC=1};
+    int fft_size = 0;
+    if (sim_params.boundaryType.selected == ZERO_AT_ENDPOINTS
+        && is_power_of_two(n + 1))
+        fft_size = 2*(n + 1);
+    else if (sim_params.boundaryType.selected == PERIODIC
+             && is_power_of_two(n))
+        fft_size = n;
+    if (fft_size < MIN_FFT_SIZE ||
+        fft_size*layout.columns_per_tile > layout.max_texture_size)
+        return 0;
+    return fft_size;
+}
+
+/* Transform the normal coordinates to position coordinates with an
+FFT, which takes O(N log N) operations per sample instead of
+the O(N^2) of the dense matrix multiplication done in norms2pos.frag.
+See fft-pack.frag for how the transforms are expressed as FFTs.*/
+void Simulation::fft_normals2positions(
+    const sim_2d::SimParams &sim_params, int fft_size) {
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    m_frames.reset_fft_scratch(fft_size);
+    std::vector<Quad> &scratch = m_frames.fft_scratch;
+    IVec2 fft_dimensions = IVec2{.ind{
+        (int)m_frames.fft_tex_params.width,
+        (int)m_frames.fft_tex_params.height}};
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        scratch[0].draw(
+            m_programs.fft_pack,
+            {
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"trajectoriesTex", &m_frames.trajectories.x[1][tile]},
+                {"fftTexDimensions", fft_dimensions},
+                {"fftSize", fft_size},
+                {"transformType", sim_params.boundaryType.selected},
+            }
+        );
+        int src = 0;
+        for (int stride = 1; stride < fft_size; stride *= 2) {
+            scratch[1 - src].draw(
+                m_programs.fft_pass,
+                {
+                    {"tex", &scratch[src]},
+                    {"texDimensions", fft_dimensions},
+                    {"fftSize", fft_size},
+                    {"stride", stride},
+                }
+            );
+            src = 1 - src;
+        }
+        m_frames.position_trajectories[tile].draw(
+            m_programs.fft_unpack,
+            {
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"fftTex", &scratch[src]},
+                {"fftTexDimensions", fft_dimensions},
+                {"fftSize", fft_size},
+                {"transformType", sim_params.boundaryType.selected},
+            }
+        );
+    }
 }
 
 void Simulation::normals2positions(const sim_2d::SimParams &sim_params) {
-    IVec2 trajectories_dimensions = IVec2{.ind{
-        (int)m_frames.trajectories_tex_params.width,
-        (int)m_frames.trajectories_tex_params.height}};
+    int fft_size = (sim_params.useFastTransform)?
+        this->get_fft_size(sim_params): 0;
+    if (fft_size > 0) {
+        this->fft_normals2positions(sim_params, fft_size);
+        return;
+    }
+    m_frames.reset_fft_scratch(0);
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
     Quad *transform_quad;
     enum {ZERO_AT_ENDPOINTS=0, PERIODIC=1};
     if (sim_params.boundaryType.selected == ZERO_AT_ENDPOINTS)
         transform_quad = &m_frames.discrete_sine;
     else if (sim_params.boundaryType.selected == PERIODIC)
         transform_quad = &m_frames.discrete_sine_cosine;
-    m_frames.position_trajectories.draw(
-        m_programs.norms2pos,
-        {
-            {"numberOfOscillators", sim_params.numberOfOscillators},
-            {"trajectoriesTexDimensions", trajectories_dimensions},
-            {"trajectoriesTex", &m_frames.trajectories.x[1]},
-            {"transformTex", transform_quad},
-            {"useTransformTex", int(1)},
-            {"boundaryType", sim_params.boundaryType.selected},
-        }
-    );
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        m_frames.position_trajectories[tile].draw(
+            m_programs.norms2pos,
+            {
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"trajectoriesTex", &m_frames.trajectories.x[1][tile]},
+                {"transformTex", transform_quad},
+                {"useTransformTex", int(1)},
+                {"boundaryType", sim_params.boundaryType.selected},
+            }
+        );
+    }
 }
 
 void Simulation::plot_non_hist_positions(const sim_2d::SimParams &sim_params) {
     sim_2d::Frames &super_frames = sim_2d::Simulation::get_frames();
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    Vec3 c = sim_params.colorOfSamples1;
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        super_frames.configs_view.draw(
+            m_programs.trajectories_view,
+            {
+                {"scaleY", float(1.0F/20.0F)},
+                {"color", Vec4{.r=c.r, c.g, c.b, sim_params.alphaBrightness}},
+                {"yOffset", float(0.5)},
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"sampleCount", layout.samples_in_tile(tile)},
+                {"trajectoriesTex", &m_frames.position_trajectories[tile]},
+                {"slotOffset", Vec2{.x=0.0F, .y=0.0F}},
+                {"slotScale", Vec2{.x=1.0F, .y=1.0F}},
+                {"boundaryCond", sim_params.boundaryType.selected}
+            },
+            m_frames.trajectories_view_wire_frame
+        );
+    }
+}
+
+/* Draw the past frames of the position trajectories behind the current
+one, where the older a frame is, the fainter it is drawn.*/
+void Simulation::plot_trajectory_trails(const sim_2d::SimParams &sim_params) {
+    sim_2d::Frames &super_frames = sim_2d::Simulation::get_frames();
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    const TrajectoryHistory &history = m_frames.trajectory_history;
     Vec3 c = sim_params.colorOfSamples1;
-    IVec2 trajectories_dimensions = IVec2{.ind{
-        (int)m_frames.trajectories_tex_params.width,
-        (int)m_frames.trajectories_tex_params.height}};
-    Quad *position_trajectories = &m_frames.position_trajectories;
+    // The frame of age zero is the current one, which is drawn
+    // by plot_non_hist_positions.
+    for (int age = history.count - 1; age > 0; age--) {
+        int slot = history.slot_of_age(age);
+        float fade = 1.0F - float(age)/float(history.count);
+        for (int tile = 0; tile < layout.tile_count; tile++) {
+            super_frames.configs_view.draw(
+                m_programs.trajectories_view,
+                {
+                    {"scaleY", float(1.0F/20.0F)},
+                    {"color", Vec4{.r=c.r, c.g, c.b,
+                                   fade*sim_params.alphaBrightness}},
+                    {"yOffset", float(0.5)},
+                    {"numberOfOscillators", sim_params.numberOfOscillators},
+                    {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                    {"sampleCount", layout.samples_in_tile(tile)},
+                    {"trajectoriesTex", &history.frames[tile]},
+                    {"slotOffset", history.slot_offset(slot)},
+                    {"slotScale", history.slot_scale()},
+                    {"boundaryCond", sim_params.boundaryType.selected}
+                },
+                m_frames.trajectories_view_wire_frame
+            );
+        }
+    }
+}
+
+/* Fill the histogram of the samples on the GPU and plot it.
+The samples are binned in the same way as in
+sim_2d::Simulation::fill_plot_color_hist, but instead of reading them
+back to the CPU, every texel of the trajectories is drawn as a point to
+the histogram render target, where additive blending sums them up.*/
+void Simulation::fill_plot_color_hist(const sim_2d::SimParams &sim_params) {
+    sim_2d::Frames &super_frames = sim_2d::Simulation::get_frames();
+    const sim_2d::GLSLPrograms &super_programs 
+        = sim_2d::Simulation::get_programs();
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    float hist_amp = sim_params.alphaBrightness*
+        (25000.0/sim_params.numberOfMCSteps);
+    m_frames.hist.clear();
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int tile = 0; tile < layout.tile_count; tile++) {
+        if (sim_params.showNormalCoordSamples)
+            m_frames.hist.draw(
+                m_programs.histogram,
+                {
+                    {"numberOfOscillators", sim_params.numberOfOscillators},
+                    {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                    {"sampleCount", layout.samples_in_tile(tile)},
+                    {"trajectoriesTex", &m_frames.trajectories.x[1][tile]},
+                    {"valueOffset", float(-20.0F)},
+                    {"minValue", float(-40.0F)},
+                    {"valueRange", float(80.0F)},
+                    {"color", Vec4{.r=hist_amp, 0.0, 0.0, 1.0}},
+                },
+                m_frames.histogram_wire_frame
+            );
+        m_frames.hist.draw(
+            m_programs.histogram,
+            {
+                {"numberOfOscillators", sim_params.numberOfOscillators},
+                {"trajectoriesTexDimensions", layout.tile_dimensions()},
+                {"sampleCount", layout.samples_in_tile(tile)},
+                {"trajectoriesTex", &m_frames.position_trajectories[tile]},
+                {"valueOffset", float(10.0F)},
+                {"minValue", float(-20.0F)},
+                {"valueRange", float(40.0F)},
+                {"color", Vec4{.r=hist_amp, 0.0, 0.0, 1.0}},
+            },
+            m_frames.histogram_wire_frame
+        );
+    }
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     super_frames.configs_view.draw(
-        m_programs.trajectories_view,
-        {
-            {"scaleY", float(1.0F/20.0F)},
-            {"color", Vec4{.r=c.r, c.g, c.b, sim_params.alphaBrightness}},
-            {"yOffset", float(0.5)},
-            {"numberOfOscillators", sim_params.numberOfOscillators},
-            {"trajectoriesTexDimensions", trajectories_dimensions},
-            {"trajectoriesTex", position_trajectories},
-            {"boundaryCond", sim_params.boundaryType.selected}
-        },
-        m_frames.trajectories_view_wire_frame
+        super_programs.height_map, 
+        {{"tex", &m_frames.hist}}, 
+        super_frames.quad_wire_frame
     );
 }
 
@@ -246,16 +672,21 @@ const RenderTarget &Simulation::render_view(
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     enum DisplayType {LINES=0, SCATTER=1, COLOR_HIST=2};
     if (sim_params.displayType.selected == DisplayType::COLOR_HIST) {
-        // this->fill_plot_color_hist(sim_params);
+        this->normals2positions(sim_params);
+        this->record_trajectories(sim_params);
+        this->fill_plot_color_hist(sim_params);
     } else {
         if (sim_params.showNormalCoordSamples)
             this->plot_non_hist_normals(sim_params);
         this->normals2positions(sim_params);
+        this->record_trajectories(sim_params);
     }
     if (sim_params.modesBrightness > 0.0)
         this->plot_exact_normals(sim_params);
     if (sim_params.displayType.selected == DisplayType::LINES ||
         sim_params.displayType.selected == DisplayType::SCATTER) {
+        if (sim_params.showTrajectoryTrails)
+            this->plot_trajectory_trails(sim_params);
         this->plot_non_hist_positions(sim_params);
     }
     glDisable(GL_BLEND);
@@ -267,21 +698,31 @@ const RenderTarget &Simulation::render_view(
         super_frames.quad_wire_frame
     );
     #ifndef __EMSCRIPTEN__
-    if (sim_params.imageRecord) {
+    if (sim_params.imageRecord || sim_params.videoRecord)
         super_frames.image.draw(
             super_programs.copy, {{"tex", &super_frames.view}});
-        auto pixels = super_frames.image.get_byte_pixels();
-        std::string fname = std::to_string(sim_params.stepCount) + ".png";
-        write_rgb8_png(&fname[0],
-            &pixels[0], 
-            super_frames.image.width(), super_frames.image.height());
+    if (sim_params.imageRecord) {
+        m_frame_recorder.push(
+            super_frames.image,
+            std::to_string(sim_params.stepCount) + ".png",
+            sim_params.imageRecordPolicy.selected);
     }
+    this->record_video(sim_params);
     #endif
     return super_frames.view;
 }
 
 void Simulation::compute_configurations(sim_2d::SimParams &sim_params) {
     sim_2d::Simulation::compute_configurations(sim_params);
+    const TrajectoriesLayout &layout = m_frames.trajectories_layout;
+    if (layout.number_of_samples != sim_params.numberOfMCSteps ||
+        layout.number_of_oscillators != sim_params.numberOfOscillators) {
+        // The streamed file only holds a single layout,
+        // so a new one is started on the next time step.
+        m_trajectory_stream.close();
+        m_frames.reset_trajectories(
+            sim_params.numberOfMCSteps, sim_params.numberOfOscillators);
+    }
     this->load_config_to_texture(sim_params.numberOfOscillators);
 }
 
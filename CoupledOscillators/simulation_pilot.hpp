@@ -1,4 +1,8 @@
 #include "simulation.hpp"
+#include "trajectories_layout.hpp"
+#include "trajectory_stream.hpp"
+#include "frame_recorder.hpp"
+#include "video_stream.hpp"
 
 #ifndef _SIMULATION_PILOT_
 #define _SIMULATION_PILOT_
@@ -6,12 +10,32 @@
 namespace sim_pilot {
 
 struct Trajectories {
-    Quad x[2];
+    // Each of these holds one texture per tile of the trajectories layout.
+    std::vector<Quad> x[2];
     int prev;
     int next;
 };
 
+/* Ring buffer of the most recent frames of the position trajectories,
+kept on the GPU for drawing trails. For each trajectories tile, the
+frames are stored next to each other inside a single texture as a grid
+of slots, so that the whole history only uses a single texture unit
+per tile.*/
+struct TrajectoryHistory {
+    std::vector<Quad> frames;
+    int requested_length;
+    int length;  // May be less than requested to fit the texture size.
+    int columns;
+    int count;
+    int newest;
+    IVec4 slot_viewport(int slot, IVec2 tile_dimensions) const;
+    Vec2 slot_offset(int slot) const;
+    Vec2 slot_scale() const;
+    int slot_of_age(int age) const;
+};
+
 struct Frames {
+    TrajectoriesLayout trajectories_layout;
     TextureParams trajectories_tex_params;
     TextureParams transform_tex_params;
     // Quad tmp0;
@@ -19,14 +43,25 @@ struct Frames {
     // Quad tmp2;
     // Quad tmp3;
     // Quad tmp4;
-    Quad position_trajectories;
+    std::vector<Quad> position_trajectories;
     Trajectories trajectories;
     Quad discrete_sine;
     Quad discrete_sine_cosine;
     WireFrame trajectories_view_wire_frame;
+    // Scratch textures for transforming to position coordinates
+    // with the FFT. These are empty when it is not used.
+    TextureParams fft_tex_params;
+    std::vector<Quad> fft_scratch;
+    TextureParams hist_tex_params;
+    RenderTarget hist;
+    WireFrame histogram_wire_frame;
+    TrajectoryHistory trajectory_history;
     Frames(const sim_2d::SimParams &sim_params, 
         int view_width, int view_height);
-    void change_simulation_dimensions(IVec2 d_2d);
+    void reset_trajectories(
+        int number_of_samples, int number_of_oscillators);
+    void reset_fft_scratch(int fft_size);
+    void reset_trajectory_history(int length);
 };
 
 struct GLSLPrograms {
@@ -34,6 +69,10 @@ struct GLSLPrograms {
     uint32_t trajectories_view;
     uint32_t norms2pos;
     uint32_t orthogonal_transforms;
+    uint32_t fft_pack;
+    uint32_t fft_pass;
+    uint32_t fft_unpack;
+    uint32_t histogram;
     GLSLPrograms();
 };
 
@@ -41,10 +80,22 @@ class Simulation: sim_2d::Simulation {
     // sim_2d::Simulation m_simulation;
     GLSLPrograms m_programs;
     Frames m_frames;
+    TrajectoryStream m_trajectory_stream;
+    FrameRecorder m_frame_recorder;
+    VideoStream m_video_stream;
+    FrameRecorder m_video_recorder;
+    bool m_video_recording;
+    void record_trajectories(const sim_2d::SimParams &sim_params);
+    void record_video(const sim_2d::SimParams &sim_params);
     void load_config_to_texture(int number_of_oscillators);
+    int get_fft_size(const sim_2d::SimParams &sim_params);
+    void fft_normals2positions(
+        const sim_2d::SimParams &sim_params, int fft_size);
     void normals2positions(const sim_2d::SimParams &sim_params);
+    void fill_plot_color_hist(const sim_2d::SimParams &sim_params);
     void plot_non_hist_normals(const sim_2d::SimParams &sim_params);
     void plot_non_hist_positions(const sim_2d::SimParams &sim_params);
+    void plot_trajectory_trails(const sim_2d::SimParams &sim_params);
     void make_transform_textures(int number_of_oscillators);
     public:
     Simulation(const sim_2d::SimParams &sim_params,
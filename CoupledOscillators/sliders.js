@@ -257,27 +257,34 @@ createVectorParameterSliders(controls, 15, "Colour 1 (r, g, b)", "Vec3", {'value
 createVectorParameterSliders(controls, 16, "Colour 2 (r, g, b)", "Vec3", {'value': [0.0, 1.0, 0.0], 'min': [0.0, 0.0, 0.0], 'max': [1.0, 1.0, 1.0], 'step': [0.002, 0.002, 0.002]});
 createSelectionList(controls, 17, 1, "Plot type", [ "Lines",  "Scatter",  "Multi-coloured histogram"]);
 createCheckbox(controls, 18, "Display samples in normal coordinates", true);
+createCheckbox(controls, 19, "Use the FFT to transform samples to position coordinates (when the number of oscillators allows it)", true);
 createLineDivider(controls);
-createLabel(controls, 20, "Normal mode analytic wave function display", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createCheckbox(controls, 21, "Colour phase", false);
-createScalarParameterSlider(controls, 22, "Brightness", "float", {'value': 1.25, 'min': 0.0, 'max': 10.0, 'step': 0.01});
+createLabel(controls, 21, "Normal mode analytic wave function display", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createCheckbox(controls, 22, "Colour phase", false);
+createScalarParameterSlider(controls, 23, "Brightness", "float", {'value': 1.25, 'min': 0.0, 'max': 10.0, 'step': 0.01});
 createLineDivider(controls);
-createLabel(controls, 24, "Wave function modification options", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createCheckbox(controls, 25, "Coherent (Single product of coherent modes)", true, "waveFuncOptions");
-createCheckbox(controls, 26, "Squeezed (Single product)", false, "waveFuncOptions");
-createCheckbox(controls, 27, "Energy eigenstate (Expect poor Metropolis convergence for highly excited modes. Single product of normal mode eigenstates only.)", false, "waveFuncOptions");
-createCheckbox(controls, 28, "Superposition of singly-excited normal modes", false, "waveFuncOptions");
-createLabel(controls, 29, "(Will be difficult to differentiate any differences from the ground unless a large number of samples are used.)", "");
-createLabel(controls, 30, "If 'Coherent' or 'Squeezed' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createSelectionList(controls, 31, 0, "Behaviour when modifying a selected normal mode amplitude expectation value with the mouse cursor:", [ "Change selected while setting others to zero",  "Modify selection only"]);
-createLabel(controls, 32, "If 'Squeezed' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createScalarParameterSlider(controls, 33, "Global squeezing factor (compared to coherent)", "float", {'value': 1.0, 'min': 0.5, 'max': 10.0, 'step': 0.01});
-createScalarParameterSlider(controls, 34, "Squeeze factor for an individual normal mode", "float", {'value': 1.0, 'min': 0.5, 'max': 10.0, 'step': 0.01});
-createLabel(controls, 35, "(Click on a normal mode for this slider to take effect)", "");
-createLabel(controls, 36, "If 'Energy eigenstate' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createCheckbox(controls, 37, "Click on normal mode to add energy", true, "stationaryOptions");
-createCheckbox(controls, 38, "Remove energy instead", false, "stationaryOptions");
+createLabel(controls, 25, "Wave function modification options", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createCheckbox(controls, 26, "Coherent (Single product of coherent modes)", true, "waveFuncOptions");
+createCheckbox(controls, 27, "Squeezed (Single product)", false, "waveFuncOptions");
+createCheckbox(controls, 28, "Energy eigenstate (Expect poor Metropolis convergence for highly excited modes. Single product of normal mode eigenstates only.)", false, "waveFuncOptions");
+createCheckbox(controls, 29, "Superposition of singly-excited normal modes", false, "waveFuncOptions");
+createLabel(controls, 30, "(Will be difficult to differentiate any differences from the ground unless a large number of samples are used.)", "");
+createLabel(controls, 31, "If 'Coherent' or 'Squeezed' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createSelectionList(controls, 32, 0, "Behaviour when modifying a selected normal mode amplitude expectation value with the mouse cursor:", [ "Change selected while setting others to zero",  "Modify selection only"]);
+createLabel(controls, 33, "If 'Squeezed' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createScalarParameterSlider(controls, 34, "Global squeezing factor (compared to coherent)", "float", {'value': 1.0, 'min': 0.5, 'max': 10.0, 'step': 0.01});
+createScalarParameterSlider(controls, 35, "Squeeze factor for an individual normal mode", "float", {'value': 1.0, 'min': 0.5, 'max': 10.0, 'step': 0.01});
+createLabel(controls, 36, "(Click on a normal mode for this slider to take effect)", "");
+createLabel(controls, 37, "If 'Energy eigenstate' selected:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createCheckbox(controls, 38, "Click on normal mode to add energy", true, "stationaryOptions");
+createCheckbox(controls, 39, "Remove energy instead", false, "stationaryOptions");
 createLineDivider(controls);
-createLabel(controls, 40, "Dispersion relation options", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createSelectionList(controls, 41, 0, "Preset dispersion relation ω(k)", [ "2*sin((pi/2)*(abs(k)/k_max))",  "pi*(abs(k)/k_max)"]);
+createLabel(controls, 41, "Dispersion relation options", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createSelectionList(controls, 42, 0, "Preset dispersion relation ω(k)", [ "2*sin((pi/2)*(abs(k)/k_max))",  "pi*(abs(k)/k_max)"]);
+createSelectionList(controls, 44, 0, "When screenshots cannot be saved fast enough", [ "Drop frames",  "Slow down the simulation"]);
+createCheckbox(controls, 45, "Record video", false);
+createSelectionList(controls, 46, 0, "Video format", [ "YUV4MPEG2 file",  "Raw RGB file",  "YUV4MPEG2 to standard output",  "Raw RGB to standard output"]);
+createCheckbox(controls, 47, "Show trails of past trajectory frames", false);
+createScalarParameterSlider(controls, 48, "Number of past trajectory frames in trails", "int", {'value': 8, 'min': 0, 'max': 64});
+createCheckbox(controls, 49, "Stream trajectories to file", false);
 
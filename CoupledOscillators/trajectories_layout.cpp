@@ -0,0 +1,91 @@
+#include "trajectories_layout.hpp"
+
+IVec2 TrajectoriesLayout::tile_dimensions() const {
+    return IVec2{.ind{
+        number_of_oscillators*columns_per_tile, samples_per_column}};
+}
+
+int TrajectoriesLayout::first_sample_of_tile(int tile_index) const {
+    return tile_index*samples_per_tile;
+}
+
+int TrajectoriesLayout::samples_in_tile(int tile_index) const {
+    int remaining = number_of_samples - first_sample_of_tile(tile_index);
+    if (remaining <= 0)
+        return 0;
+    return (remaining < samples_per_tile)? remaining: samples_per_tile;
+}
+
+int get_max_texture_size() {
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    // Every implementation must support at least this size.
+    return (max_texture_size >= 2048)? max_texture_size: 2048;
+}
+
+/* Choose the number of columns of samples that is placed in each tile,
+and the number of samples that are stacked in each of these columns.
+
+For every possible column count, the column height is chosen as small as
+possible while still fitting all of the tile's samples. Of these
+candidates, the one that minimizes the number of padding texels
+plus the half perimeter of the texture is chosen. The first term
+avoids wasting memory, while the second keeps the tile from becoming
+too skinny, which is bad for texture cache locality.
+*/
+TrajectoriesLayout get_trajectories_layout(
+    int number_of_samples, int number_of_oscillators,
+    int max_texture_size) {
+    int n = number_of_oscillators;
+    int max_columns = max_texture_size/n;
+    long tile_capacity = (long)max_columns*(long)max_texture_size;
+    int tile_count = (int)((number_of_samples + tile_capacity - 1)
+                           /tile_capacity);
+    if (tile_count < 1)
+        tile_count = 1;
+    int target = (number_of_samples + tile_count - 1)/tile_count;
+    TrajectoriesLayout layout {
+        .number_of_oscillators=n,
+        .number_of_samples=number_of_samples,
+        .samples_per_column=target,
+        .columns_per_tile=1,
+        .samples_per_tile=target,
+        .tile_count=tile_count,
+        .max_texture_size=max_texture_size,
+    };
+    long best_cost = -1;
+    for (int columns = 1; columns <= max_columns; columns++) {
+        int height = (target + columns - 1)/columns;
+        if (height > max_texture_size)
+            continue;
+        long padding = (long)columns*height - target;
+        long cost = padding*n + (long)columns*n + height;
+        if (best_cost < 0 || cost < best_cost) {
+            best_cost = cost;
+            layout.samples_per_column = height;
+            layout.columns_per_tile = columns;
+            layout.samples_per_tile = columns*height;
+        }
+        if (height == 1)
+            break;
+    }
+    // Rounding up the column height can leave the last tile empty,
+    // so count the tiles again.
+    layout.tile_count = (number_of_samples + layout.samples_per_tile - 1)
+        /layout.samples_per_tile;
+    if (layout.tile_count < 1)
+        layout.tile_count = 1;
+    if (layout.tile_count > 1)
+        fprintf(stdout,
+                "Splitting %d samples across %d trajectory textures "
+                "of dimensions %d x %d.\n",
+                number_of_samples, layout.tile_count,
+                layout.tile_dimensions()[0], layout.tile_dimensions()[1]);
+    return layout;
+}
+
+TrajectoriesLayout get_trajectories_layout(
+    int number_of_samples, int number_of_oscillators) {
+    return get_trajectories_layout(
+        number_of_samples, number_of_oscillators, get_max_texture_size());
+}
@@ -0,0 +1,45 @@
+#include "gl_wrappers.hpp"
+
+#ifndef _TRAJECTORIES_LAYOUT_
+#define _TRAJECTORIES_LAYOUT_
+
+/*
+Arrangement of the Monte Carlo samples inside the trajectory textures.
+
+Each sample occupies a row of number_of_oscillators texels. These rows are
+stacked into columns that are samples_per_column texels tall, and the
+columns are then placed side by side, so that inside a single texture
+the oscillator i of the sample s is found at the texel
+    x = number_of_oscillators*floor(s/samples_per_column) + i,
+    y = s mod samples_per_column.
+A single texture cannot exceed GL_MAX_TEXTURE_SIZE in either dimension,
+so if all of the samples do not fit then they are split across
+tile_count textures ("tiles") of identical dimensions, where the first
+samples_per_tile samples go into the first tile, the next samples_per_tile
+into the second, and so on. Only whole samples are ever stored in a tile.
+Texels at the end of the last column of a tile that do not correspond
+to any sample are padding and must be ignored.
+*/
+struct TrajectoriesLayout {
+    int number_of_oscillators;
+    int number_of_samples;
+    int samples_per_column;
+    int columns_per_tile;
+    int samples_per_tile;
+    int tile_count;
+    int max_texture_size;
+    IVec2 tile_dimensions() const;
+    int samples_in_tile(int tile_index) const;
+    int first_sample_of_tile(int tile_index) const;
+};
+
+int get_max_texture_size();
+
+TrajectoriesLayout get_trajectories_layout(
+    int number_of_samples, int number_of_oscillators,
+    int max_texture_size);
+
+TrajectoriesLayout get_trajectories_layout(
+    int number_of_samples, int number_of_oscillators);
+
+#endif
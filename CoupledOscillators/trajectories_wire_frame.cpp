@@ -67,6 +67,22 @@ static std::vector<float> get_vertices_set_elements_with_endpoints(
     return vertices;
 }
 
+static std::vector<float> get_vertices_set_elements_points(
+    std::vector<int> &elements, int n_oscillators, int total_count) {
+    int elem_count = 0;
+    std::vector<float> vertices {};
+    for (int row_count = 0; row_count < total_count; row_count++) {
+        for (int column_count = 0; column_count < n_oscillators;
+            column_count++) {
+            vertices.push_back(float(column_count));
+            vertices.push_back(float(row_count));
+            elements.push_back(elem_count);
+            elem_count++;
+        }
+    }
+    return vertices;
+}
+
 WireFrame trajectories_wire_frame::get(
         int total_trajectory_count, int n_oscillators, int view_type) {
     std::vector<int> elements {};
@@ -81,6 +97,10 @@ WireFrame trajectories_wire_frame::get(
         vertices = get_vertices_set_elements_with_disconnected(
             elements, n_oscillators, total_trajectory_count);
         break;
+        case POINTS:
+        vertices = get_vertices_set_elements_points(
+            elements, n_oscillators, total_trajectory_count);
+        break;
         default:
         vertices = get_vertices_set_elements(
             elements, n_oscillators, total_trajectory_count);
@@ -91,6 +111,7 @@ WireFrame trajectories_wire_frame::get(
                 .size=2, .type=GL_FLOAT, .normalized=false,
                 .stride=0, .offset=0}}};
     return WireFrame(
-        attributes, vertices, elements, WireFrame::LINES
+        attributes, vertices, elements,
+        (view_type == POINTS)? WireFrame::POINTS: WireFrame::LINES
     );
 }
@@ -8,7 +8,7 @@ namespace trajectories_wire_frame {
 
     enum {
         LINES_WITH_ZERO_ENDPOINTS, LINES_PERIODIC,
-        LINES_NO_ENDPOINTS, DISCONNECTED_LINES
+        LINES_NO_ENDPOINTS, DISCONNECTED_LINES, POINTS
     };
 
     WireFrame get(
@@ -0,0 +1,154 @@
+#include "trajectory_stream.hpp"
+#include <cstring>
+
+/* Number of pixel buffers per trajectories tile. */
+#define READS_PER_TILE 3
+
+/* Maximum number of tiles that may wait to be written to file
+before the render loop is made to wait. */
+#define MAX_QUEUED_CHUNKS 16
+
+/* Size of the file buffer, which keeps the writes large and sequential. */
+#define FILE_BUFFER_SIZE (1 << 22)
+
+static const int FORMAT_VERSION = 1;
+
+TrajectoryStream::TrajectoryStream():
+    m_readback(0, GL_FLOAT), m_file(NULL), m_stop(false) {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+    #endif
+}
+
+bool TrajectoryStream::open(
+    const std::string &fname, const TrajectoriesLayout &layout) {
+    this->close();
+    m_file = fopen(fname.c_str(), "wb");
+    if (m_file == NULL) {
+        fprintf(stderr, "Unable to open %s for writing.\n", fname.c_str());
+        return false;
+    }
+    setvbuf(m_file, NULL, _IOFBF, FILE_BUFFER_SIZE);
+    m_layout = layout;
+    int32_t header[3] = {
+        FORMAT_VERSION,
+        layout.number_of_oscillators, layout.number_of_samples};
+    fwrite("TRAJ", sizeof(char), 4, m_file);
+    fwrite(header, sizeof(int32_t), 3, m_file);
+    m_readback.resize(READS_PER_TILE*layout.tile_count);
+    m_times.clear();
+    m_stop = false;
+    #ifndef __EMSCRIPTEN__
+    pthread_create(&m_thread, NULL, TrajectoryStream::write_loop, this);
+    #endif
+    fprintf(stdout, "Streaming trajectories to %s.\n", fname.c_str());
+    return true;
+}
+
+bool TrajectoryStream::is_open() const {
+    return m_file != NULL;
+}
+
+/* Request reads of the trajectories tiles for the current time step,
+and pass on any earlier reads that have completed to be written.*/
+void TrajectoryStream::push(const std::vector<Quad> &tiles, double t) {
+    if (m_file == NULL)
+        return;
+    m_times.push_back(t);
+    for (int i = 0; i < (int)tiles.size(); i++) {
+        while (m_readback.is_full())
+            this->collect(true);
+        m_readback.request(tiles[i], i);
+    }
+    this->collect(false);
+}
+
+/* Pass on every completed read to be written. If wait is set, block
+until at least the oldest read is complete.*/
+void TrajectoryStream::collect(bool wait) {
+    Chunk chunk {};
+    while (m_readback.retrieve(chunk.data, chunk.tile, wait)) {
+        wait = false;
+        if (chunk.tile == 0) {
+            chunk.t = m_times.front();
+            m_times.pop_front();
+        }
+        this->enqueue(chunk);
+    }
+}
+
+void TrajectoryStream::enqueue(Chunk &chunk) {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    while (m_queue.size() >= MAX_QUEUED_CHUNKS)
+        pthread_cond_wait(&m_cond, &m_mutex);
+    m_queue.push_back(std::move(chunk));
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    #else
+    this->write_chunk(chunk);
+    #endif
+}
+
+/* Write the samples of a single tile, without the padding.*/
+void TrajectoryStream::write_chunk(const Chunk &chunk) {
+    int n = m_layout.number_of_oscillators;
+    int h = m_layout.samples_per_column;
+    int width = m_layout.tile_dimensions()[0];
+    int count = m_layout.samples_in_tile(chunk.tile);
+    if (chunk.tile == 0)
+        fwrite(&chunk.t, sizeof(double), 1, m_file);
+    m_samples.resize(count*n);
+    for (int s = 0; s < count; s++) {
+        int x = n*(s/h), y = s % h;
+        memcpy(&m_samples[s*n], &chunk.data[y*width + x], n*sizeof(float));
+    }
+    fwrite(&m_samples[0], sizeof(float), count*n, m_file);
+}
+
+#ifndef __EMSCRIPTEN__
+void *TrajectoryStream::write_loop(void *void_stream) {
+    TrajectoryStream *stream = (TrajectoryStream *)void_stream;
+    pthread_mutex_lock(&stream->m_mutex);
+    while (true) {
+        while (stream->m_queue.empty() && !stream->m_stop)
+            pthread_cond_wait(&stream->m_cond, &stream->m_mutex);
+        if (stream->m_queue.empty())
+            break;
+        Chunk chunk = std::move(stream->m_queue.front());
+        stream->m_queue.pop_front();
+        pthread_cond_broadcast(&stream->m_cond);
+        pthread_mutex_unlock(&stream->m_mutex);
+        stream->write_chunk(chunk);
+        pthread_mutex_lock(&stream->m_mutex);
+    }
+    pthread_mutex_unlock(&stream->m_mutex);
+    return NULL;
+}
+#endif
+
+/* Finish writing every frame that has been pushed, then close the file.*/
+void TrajectoryStream::close() {
+    if (m_file == NULL)
+        return;
+    while (m_readback.pending() > 0)
+        this->collect(true);
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    pthread_join(m_thread, NULL);
+    #endif
+    fclose(m_file);
+    m_file = NULL;
+}
+
+TrajectoryStream::~TrajectoryStream() {
+    this->close();
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_cond);
+    #endif
+}
@@ -0,0 +1,68 @@
+#include "gl_wrappers.hpp"
+#include "trajectories_layout.hpp"
+#include <deque>
+#include <string>
+#include <stdio.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#ifndef _TRAJECTORY_STREAM_
+#define _TRAJECTORY_STREAM_
+
+/*
+Stream the position trajectories of every frame to a compact
+binary file.
+
+The file starts with the four characters "TRAJ", followed by the
+format version, the number of oscillators, and the number of
+samples, each as a 32 bit integer. Each frame is then stored as the
+time as a 64 bit float, followed by the position of every oscillator of
+every sample as 32 bit floats, where the oscillator index varies the
+fastest. These are the positions that are plotted, after the normal
+mode coordinates that are time stepped have been transformed by
+normals2positions. The padding of the trajectories textures is not
+included.
+All values are in the byte order of the host.
+
+The trajectories textures are read back asynchronously using a
+PixelReadback, and what is read is written to the file from a separate
+thread, so that neither the reads nor the file writes stall the
+render loop. No frame is ever dropped: if all of the pixel buffers
+or the write queue are full, the render loop instead waits for them.
+*/
+class TrajectoryStream {
+    struct Chunk {
+        int tile;
+        double t;
+        std::vector<float> data;
+    };
+    PixelReadback m_readback;
+    TrajectoriesLayout m_layout;
+    std::deque<double> m_times;
+    std::deque<Chunk> m_queue;
+    std::vector<float> m_samples;
+    FILE *m_file;
+    bool m_stop;
+    #ifndef __EMSCRIPTEN__
+    pthread_t m_thread;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    static void *write_loop(void *void_stream);
+    #endif
+    void collect(bool wait);
+    void enqueue(Chunk &chunk);
+    void write_chunk(const Chunk &chunk);
+    TrajectoryStream(const TrajectoryStream &);
+    TrajectoryStream& operator=(const TrajectoryStream &);
+    public:
+    TrajectoryStream();
+    bool open(const std::string &fname, const TrajectoriesLayout &layout);
+    bool is_open() const;
+    void push(const std::vector<Quad> &tiles, double t);
+    void close();
+    ~TrajectoryStream();
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "adi.hpp"
+
+typedef std::complex<float> Complex;
+typedef std::complex<double> ComplexDouble;
+
+/* Smallest number of columns that are swept together by a thread. */
+#define MIN_COLUMNS_PER_CHUNK 16
+
+ADICrankNicolson::ADICrankNicolson():
+    m_params({.m=0.0, .hbar=0.0, .dt=0.0, .dx=0.0, .dy=0.0}),
+    m_potential_changed(true) {}
+
+/* Mark the factorizations to be remade on the next step. */
+void ADICrankNicolson::set_potential_changed() {
+    m_potential_changed = true;
+}
+
+/* Factor every line, where diagonal(line, k) gives the diagonal
+of entry k of a line, and index(line, k) where it is stored.*/
+template <typename Diagonal, typename Index>
+static void factor_lines(
+    CyclicTridiagonalLines &lines,
+    int line_length, int line_count, Complex off_diagonal,
+    Diagonal diagonal, Index index, ThreadPool &pool) {
+    int n = line_length;
+    lines.line_length = line_length;
+    lines.line_count = line_count;
+    lines.off_diagonal = off_diagonal;
+    lines.c_prime.resize(n*line_count);
+    lines.inv_pivot.resize(n*line_count);
+    lines.z.resize(n*line_count);
+    lines.gamma.resize(line_count);
+    lines.inv_denominator.resize(line_count);
+    ComplexDouble b = off_diagonal;
+    pool.parallel_for(0, line_count, [&](int line_begin, int line_end) {
+        std::vector<ComplexDouble> c_prime(n), z(n);
+        for (int l = line_begin; l < line_end; l++) {
+            // Sherman-Morrison: with u = (gamma, 0, ..., 0, b) and
+            // v = (1, 0, ..., 0, b/gamma), the cyclic matrix is T + u v^T,
+            // where T is tridiagonal.
+            ComplexDouble gamma = -(ComplexDouble)diagonal(l, 0);
+            ComplexDouble pivot;
+            for (int k = 0; k < n; k++) {
+                ComplexDouble d = diagonal(l, k);
+                if (k == 0)
+                    d -= gamma;
+                if (k == n - 1)
+                    d -= b*b/gamma;
+                pivot = (k == 0)? d: d - b*c_prime[k - 1];
+                c_prime[k] = b/pivot;
+                ComplexDouble u = (k == 0)? gamma:
+                    ((k == n - 1)? b: ComplexDouble(0.0));
+                z[k] = (k == 0)? u/pivot: (u - b*z[k - 1])/pivot;
+                lines.c_prime[index(l, k)] = (Complex)c_prime[k];
+                lines.inv_pivot[index(l, k)] = (Complex)(1.0/pivot);
+            }
+            for (int k = n - 2; k >= 0; k--)
+                z[k] -= c_prime[k]*z[k + 1];
+            for (int k = 0; k < n; k++)
+                lines.z[index(l, k)] = (Complex)z[k];
+            lines.gamma[l] = (Complex)gamma;
+            lines.inv_denominator[l]
+                = (Complex)(1.0/(1.0 + z[0] + b*z[n - 1]/gamma));
+        }
+    });
+}
+
+void ADICrankNicolson::factor(
+    const ComplexField &potential, const ADIParams &params,
+    ThreadPool &pool) {
+    int width = potential.width, height = potential.height;
+    // With a = i dt/(2 hbar), the implicit side of each half step has
+    // 1 + a(hbar^2/(m dx^2) + V/2) on the diagonal,
+    // and -a hbar^2/(2m dx^2) off the diagonal.
+    Complex a = Complex(0.0, params.dt/(2.0*params.hbar));
+    float c_x = params.hbar*params.hbar/(2.0*params.m*params.dx*params.dx);
+    float c_y = params.hbar*params.hbar/(2.0*params.m*params.dy*params.dy);
+    auto potential_at = [&](int i, int j) {
+        return Complex(potential.re[i*width + j], potential.im[i*width + j]);
+    };
+    factor_lines(
+        m_rows, width, height, -a*c_x,
+        [&](int i, int j) {
+            return 1.0F + a*(2.0F*c_x + 0.5F*potential_at(i, j));
+        },
+        [&](int i, int j) {return i*width + j;}, pool);
+    factor_lines(
+        m_columns, height, width, -a*c_y,
+        [&](int j, int i) {
+            return 1.0F + a*(2.0F*c_y + 0.5F*potential_at(i, j));
+        },
+        [&](int j, int i) {return i*width + j;}, pool);
+}
+
+/* Solve along every row in place, where the rows are done in parallel.*/
+void ADICrankNicolson::solve_rows(
+    ComplexField &field, ThreadPool &pool) const {
+    const CyclicTridiagonalLines &lines = m_rows;
+    int n = lines.line_length;
+    Complex b = lines.off_diagonal;
+    pool.parallel_for(0, lines.line_count, [&](int row_begin, int row_end) {
+        std::vector<Complex> y(n);
+        for (int i = row_begin; i < row_end; i++) {
+            int offset = i*n;
+            const Complex *c_prime = &lines.c_prime[offset];
+            const Complex *inv_pivot = &lines.inv_pivot[offset];
+            const Complex *z = &lines.z[offset];
+            float *re = &field.re[offset], *im = &field.im[offset];
+            y[0] = Complex(re[0], im[0])*inv_pivot[0];
+            for (int k = 1; k < n; k++)
+                y[k] = (Complex(re[k], im[k]) - b*y[k - 1])*inv_pivot[k];
+            for (int k = n - 2; k >= 0; k--)
+                y[k] -= c_prime[k]*y[k + 1];
+            Complex f = (y[0] + b*y[n - 1]/lines.gamma[i])
+                *lines.inv_denominator[i];
+            for (int k = 0; k < n; k++) {
+                Complex x = y[k] - f*z[k];
+                re[k] = x.real();
+                im[k] = x.imag();
+            }
+        }
+    });
+}
+
+/* Solve along every column in place. Each thread takes a block of
+adjacent columns, which are swept together one row at a time so that
+the memory is read in order.*/
+void ADICrankNicolson::solve_columns(
+    ComplexField &field, ThreadPool &pool) const {
+    const CyclicTridiagonalLines &lines = m_columns;
+    int width = lines.line_count, height = lines.line_length;
+    Complex b = lines.off_diagonal;
+    pool.parallel_for(0, width, [&](int j_begin, int j_end) {
+        int block_width = j_end - j_begin;
+        std::vector<Complex> y(height*block_width);
+        auto y_at = [&](int i, int j) -> Complex & {
+            return y[i*block_width + j - j_begin];
+        };
+        for (int i = 0; i < height; i++) {
+            for (int j = j_begin; j < j_end; j++) {
+                int k = i*width + j;
+                Complex r = Complex(field.re[k], field.im[k]);
+                y_at(i, j) = (i == 0)? r*lines.inv_pivot[k]:
+                    (r - b*y_at(i - 1, j))*lines.inv_pivot[k];
+            }
+        }
+        for (int i = height - 2; i >= 0; i--)
+            for (int j = j_begin; j < j_end; j++)
+                y_at(i, j) -= lines.c_prime[i*width + j]*y_at(i + 1, j);
+        std::vector<Complex> f(block_width);
+        for (int j = j_begin; j < j_end; j++)
+            f[j - j_begin] = (y_at(0, j) + b*y_at(height - 1, j)
+                              /lines.gamma[j])*lines.inv_denominator[j];
+        for (int i = 0; i < height; i++) {
+            for (int j = j_begin; j < j_end; j++) {
+                int k = i*width + j;
+                Complex x = y_at(i, j) - f[j - j_begin]*lines.z[k];
+                field.re[k] = x.real();
+                field.im[k] = x.imag();
+            }
+        }
+    }, MIN_COLUMNS_PER_CHUNK);
+}
+
+/* Advance psi by a single time step in place. */
+void ADICrankNicolson::step(
+    ComplexField &psi, const ComplexField &potential,
+    const ADIParams &params, ThreadPool &pool) {
+    int width = psi.width, height = psi.height;
+    if (width < 3 || height < 3)
+        return;
+    bool changed = (m_potential_changed
+                    || m_rows.line_length != width
+                    || m_columns.line_length != height
+                    || params.m != m_params.m
+                    || params.hbar != m_params.hbar
+                    || params.dt != m_params.dt
+                    || params.dx != m_params.dx
+                    || params.dy != m_params.dy);
+    if (changed)
+        this->factor(potential, params, pool);
+    m_params = params;
+    m_potential_changed = false;
+    Complex a = Complex(0.0, params.dt/(2.0*params.hbar));
+    float c_x = params.hbar*params.hbar/(2.0*params.m*params.dx*params.dx);
+    float c_y = params.hbar*params.hbar/(2.0*params.m*params.dy*params.dy);
+    // Apply (1 - a A) along one direction, where the neighbours
+    // of an entry are given by their offsets into the arrays.
+    auto apply_explicit = [&](ComplexField &dst, const ComplexField &src,
+                              float c, bool along_rows) {
+        pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+            for (int i = row_begin; i < row_end; i++) {
+                for (int j = 0; j < width; j++) {
+                    int k = i*width + j;
+                    int k0 = (along_rows)? i*width + (j - 1 + width) % width:
+                        ((i - 1 + height) % height)*width + j;
+                    int k1 = (along_rows)? i*width + (j + 1) % width:
+                        ((i + 1) % height)*width + j;
+                    Complex p = Complex(src.re[k], src.im[k]);
+                    Complex p0 = Complex(src.re[k0], src.im[k0]);
+                    Complex p1 = Complex(src.re[k1], src.im[k1]);
+                    Complex v = Complex(potential.re[k], potential.im[k]);
+                    Complex r = p - a*(-c*(p1 - 2.0F*p + p0) + 0.5F*v*p);
+                    dst.re[k] = r.real();
+                    dst.im[k] = r.imag();
+                }
+            }
+        });
+    };
+    m_tmp.resize(width, height);
+    apply_explicit(m_tmp, psi, c_y, false);
+    this->solve_rows(m_tmp, pool);
+    apply_explicit(psi, m_tmp, c_x, true);
+    this->solve_columns(psi, pool);
+}
@@ -0,0 +1,75 @@
+#include "cpu_wave_function.hpp"
+#include <complex>
+#include <vector>
+
+#ifndef _ADI_
+#define _ADI_
+
+struct ADIParams {
+    float m, hbar, dt;
+    float dx, dy;
+};
+
+/* Factorization of the periodic (cyclic) tridiagonal systems
+along every line of the grid in one direction, where each line has
+its own diagonal but the same off diagonal. The cyclic corners are
+handled with the Sherman-Morrison formula, so each line only needs
+an ordinary tridiagonal solve.
+
+The per entry arrays are indexed in the same way as the grid, whether
+the lines are its rows or its columns.*/
+struct CyclicTridiagonalLines {
+    typedef std::complex<float> Complex;
+    int line_length, line_count;
+    Complex off_diagonal;
+    std::vector<Complex> c_prime, inv_pivot, z;
+    // One of each per line.
+    std::vector<Complex> gamma, inv_denominator;
+    CyclicTridiagonalLines(): line_length(0), line_count(0) {}
+};
+
+/*
+Crank-Nicolson time step using the Peaceman-Rachford alternating
+direction implicit (ADI) method, where
+
+    (1 + i dt/(2 hbar) A_x) psi* = (1 - i dt/(2 hbar) A_y) psi(t),
+    (1 + i dt/(2 hbar) A_y) psi(t + dt) = (1 - i dt/(2 hbar) A_x) psi*,
+
+with A_x = -hbar^2/(2m) d^2/dx^2 + V/2 and likewise for A_y, using
+second order central differences with periodic boundaries. Higher
+orders would need a wider than tridiagonal solve, so unlike the other
+backends this always has the dispersion of the second order stencil.
+Each half step is implicit along one direction, so it only needs
+a tridiagonal solve along every line in that direction. These are
+done for many lines at once: the rows in parallel, and the columns
+in parallel blocks that are swept together row by row.
+
+The scheme is unconditionally stable, including with absorbing
+boundaries, so much larger time steps can be taken than with
+the explicit leapfrog scheme.
+
+The factorizations are kept between steps, and are only remade
+when the grid, the parameters, or the potential change.
+
+Reference:
+
+Wikipedia - Alternating-direction implicit method
+https://en.wikipedia.org/wiki/Alternating-direction_implicit_method
+*/
+class ADICrankNicolson {
+    CyclicTridiagonalLines m_rows, m_columns;
+    ComplexField m_tmp;
+    ADIParams m_params;
+    bool m_potential_changed;
+    void factor(const ComplexField &potential, const ADIParams &params,
+                ThreadPool &pool);
+    void solve_rows(ComplexField &field, ThreadPool &pool) const;
+    void solve_columns(ComplexField &field, ThreadPool &pool) const;
+    public:
+    ADICrankNicolson();
+    void set_potential_changed();
+    void step(ComplexField &psi, const ComplexField &potential,
+              const ADIParams &params, ThreadPool &pool);
+};
+
+#endif
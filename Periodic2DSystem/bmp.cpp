@@ -1,5 +1,6 @@
 #include "bmp.hpp"
 #include <cstdio>
+#include <cstring>
 
 
 unsigned int get_bmp_row_byte_size(int width) {
@@ -41,3 +42,46 @@ void print_bmp_header(const BMPHeader &h) {
     printf("Color pallete count: %d\n", h.color_pallete_count);
     printf("Imporant colors count: %d\n", h.important_colors_count);
 }
+
+void fill_bmp_image(
+    std::vector<uint8_t> &data, const uint8_t *pixels,
+    int width, int height, int channels) {
+    BMPHeader header(width, height);
+    unsigned int row_size = get_bmp_row_byte_size(width);
+    data.resize(sizeof(BMPHeader) + row_size*height);
+    memcpy(&data[0], &header, sizeof(BMPHeader));
+    for (int i = 0; i < height; i++) {
+        const uint8_t *src = pixels + (size_t)channels*width*i;
+        uint8_t *dst = &data[sizeof(BMPHeader) + (size_t)row_size*i];
+        // BMP stores its colour channels in the order blue, green, red.
+        for (int j = 0; j < width; j++) {
+            dst[3*j] = src[channels*j + 2];
+            dst[3*j + 1] = src[channels*j + 1];
+            dst[3*j + 2] = src[channels*j];
+        }
+        memset(dst + 3*width, 0, row_size - 3*width);
+    }
+}
+
+void write_bmp(
+    const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height) {
+    if (width*height <= 0)
+        return;
+    int channels = pixels.size()/(width*height);
+    if (channels < 3) {
+        fprintf(stderr, "Unable to write %s: "
+                "expected at least three channels per pixel.\n",
+                fname.c_str());
+        return;
+    }
+    std::vector<uint8_t> data;
+    fill_bmp_image(data, &pixels[0], width, height, channels);
+    FILE *f = fopen(fname.c_str(), "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Unable to open %s.\n", fname.c_str());
+        return;
+    }
+    fwrite(&data[0], 1, data.size(), f);
+    fclose(f);
+}
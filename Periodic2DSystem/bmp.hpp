@@ -1,6 +1,10 @@
 #ifndef _BMP_
 #define _BMP_
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 unsigned int get_bmp_row_byte_size(int width);
 
 /* Struct for keeping track of bitmap header image information.
@@ -31,4 +35,17 @@ struct __attribute__((packed)) BMPHeader {
 
 void print_bmp_header(const BMPHeader &);
 
+/* Fill data with a 24 bit BMP image, including its header. The pixels
+are stored row by row from the bottom of the image, with channels
+bytes per pixel, where only the first three are used.*/
+void fill_bmp_image(
+    std::vector<uint8_t> &data, const uint8_t *pixels,
+    int width, int height, int channels);
+
+/* Write pixels to a BMP file, where the number of channels
+is pixels.size()/(width*height).*/
+void write_bmp(
+    const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "checkpoint.hpp"
+#include <cstring>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(CheckpointHeader) == 80,
+              "The checkpoint header must be 80 bytes.");
+static_assert(sizeof(float) == 4, "Floats must be 32 bits.");
+
+static bool is_little_endian() {
+    uint32_t one = 1;
+    uint8_t first_byte;
+    memcpy(&first_byte, &one, 1);
+    return first_byte == 1;
+}
+
+size_t checkpoint_array_length(const CheckpointHeader &header, int array) {
+    if (array == CHECKPOINT_WEIGHTS && !header.weighted_particles)
+        return 0;
+    if (array == CHECKPOINT_PARTICLES || array == CHECKPOINT_WEIGHTS)
+        return 2*(size_t)header.particles_width*header.particles_height;
+    return 2*(size_t)header.width*header.height;
+}
+
+/* Offset in bytes of an array from the start of the checkpoint. */
+static size_t checkpoint_array_offset(
+    const CheckpointHeader &header, int array) {
+    size_t offset = sizeof(CheckpointHeader);
+    for (int i = 0; i < array; i++)
+        offset += sizeof(float)*checkpoint_array_length(header, i);
+    return offset;
+}
+
+size_t checkpoint_size(const CheckpointHeader &header) {
+    return checkpoint_array_offset(header, CHECKPOINT_ARRAY_COUNT);
+}
+
+CheckpointHeader make_checkpoint_header() {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(CheckpointHeader);
+    return header;
+}
+
+CheckpointWriter::CheckpointWriter(): m_pending(false), m_stop(false) {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+    pthread_create(&m_thread, NULL, CheckpointWriter::write_loop, this);
+    #endif
+}
+
+void CheckpointWriter::begin(const CheckpointHeader &header) {
+    this->wait();
+    m_buffer.resize(checkpoint_size(header));
+    memcpy(&m_buffer[0], &header, sizeof(header));
+}
+
+float *CheckpointWriter::array(int array) {
+    const CheckpointHeader *header = (const CheckpointHeader *)&m_buffer[0];
+    return (float *)&m_buffer[checkpoint_array_offset(*header, array)];
+}
+
+void CheckpointWriter::write_file() {
+    std::string tmp_fname = m_fname + ".tmp";
+    FILE *f = fopen(tmp_fname.c_str(), "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Unable to open %s.\n", tmp_fname.c_str());
+        return;
+    }
+    size_t written = fwrite(&m_buffer[0], 1, m_buffer.size(), f);
+    if (fclose(f) != 0 || written != m_buffer.size()) {
+        fprintf(stderr, "Unable to write %s.\n", tmp_fname.c_str());
+        remove(tmp_fname.c_str());
+        return;
+    }
+    if (rename(tmp_fname.c_str(), m_fname.c_str()) != 0)
+        fprintf(stderr, "Unable to rename %s to %s.\n",
+                tmp_fname.c_str(), m_fname.c_str());
+}
+
+void CheckpointWriter::write(const std::string &fname) {
+    if (!is_little_endian()) {
+        fprintf(stderr, "Checkpoints can only be written "
+                "on little endian machines.\n");
+        return;
+    }
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    m_fname = fname;
+    m_pending = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    #else
+    m_fname = fname;
+    this->write_file();
+    #endif
+}
+
+void CheckpointWriter::wait() {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    while (m_pending)
+        pthread_cond_wait(&m_cond, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+    #endif
+}
+
+#ifndef __EMSCRIPTEN__
+void *CheckpointWriter::write_loop(void *void_writer) {
+    CheckpointWriter *writer = (CheckpointWriter *)void_writer;
+    pthread_mutex_lock(&writer->m_mutex);
+    while (true) {
+        while (!writer->m_pending && !writer->m_stop)
+            pthread_cond_wait(&writer->m_cond, &writer->m_mutex);
+        if (!writer->m_pending)
+            break;
+        // The buffer is left alone by the render thread until
+        // m_pending is cleared, so it is written without the lock.
+        pthread_mutex_unlock(&writer->m_mutex);
+        writer->write_file();
+        pthread_mutex_lock(&writer->m_mutex);
+        writer->m_pending = false;
+        pthread_cond_broadcast(&writer->m_cond);
+    }
+    pthread_mutex_unlock(&writer->m_mutex);
+    return NULL;
+}
+#endif
+
+CheckpointWriter::~CheckpointWriter() {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    pthread_join(m_thread, NULL);
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_cond);
+    #endif
+}
+
+MappedCheckpoint::MappedCheckpoint(): m_data(NULL), m_size(0) {}
+
+bool MappedCheckpoint::open(const std::string &fname) {
+    this->close();
+    if (!is_little_endian()) {
+        fprintf(stderr, "Checkpoints can only be read "
+                "on little endian machines.\n");
+        return false;
+    }
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open %s.\n", fname.c_str());
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0
+        || file_stat.st_size < (off_t)sizeof(CheckpointHeader)) {
+        fprintf(stderr, "%s is not a checkpoint.\n", fname.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_t size = file_stat.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed.
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Unable to map %s.\n", fname.c_str());
+        return false;
+    }
+    m_data = (const uint8_t *)data;
+    m_size = size;
+    const CheckpointHeader &h = this->header();
+    if (strncmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) {
+        fprintf(stderr, "%s is not a checkpoint.\n", fname.c_str());
+        this->close();
+        return false;
+    }
+    // The header of other versions may have a different size,
+    // so the version is checked before the rest of it.
+    if (h.version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "%s is a version %u checkpoint, "
+                "but only version %d is supported.\n",
+                fname.c_str(), h.version, CHECKPOINT_VERSION);
+        this->close();
+        return false;
+    }
+    if (h.header_size != sizeof(CheckpointHeader)
+        || h.width <= 0 || h.height <= 0
+        || h.particles_width <= 0 || h.particles_height <= 0
+        || (h.weighted_particles != 0 && h.weighted_particles != 1)) {
+        fprintf(stderr, "%s is not a checkpoint.\n", fname.c_str());
+        this->close();
+        return false;
+    }
+    if (checkpoint_size(h) != m_size) {
+        fprintf(stderr, "%s is truncated.\n", fname.c_str());
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void MappedCheckpoint::close() {
+    if (m_data != NULL)
+        munmap((void *)m_data, m_size);
+    m_data = NULL;
+    m_size = 0;
+}
+
+const CheckpointHeader &MappedCheckpoint::header() const {
+    return *(const CheckpointHeader *)m_data;
+}
+
+const float *MappedCheckpoint::array(int array) const {
+    return (const float *)
+        &m_data[checkpoint_array_offset(this->header(), array)];
+}
+
+MappedCheckpoint::~MappedCheckpoint() {
+    this->close();
+}
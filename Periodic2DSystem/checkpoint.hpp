@@ -0,0 +1,107 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#ifndef _CHECKPOINT_
+#define _CHECKPOINT_
+
+#define CHECKPOINT_MAGIC "PILOT2D"
+#define CHECKPOINT_VERSION 2
+
+/* Arrays that follow the header of a checkpoint, in order. Each one
+has two little endian floats per texel: the real and imaginary parts
+for the wave functions and the potential, the x and y positions
+for the particles, and the weight and zero for the weights of the
+particles. The weights are empty unless the particles are weighted.*/
+enum CheckpointArray {
+    CHECKPOINT_PSI0=0, CHECKPOINT_PSI1, CHECKPOINT_PSI2,
+    CHECKPOINT_POTENTIAL, CHECKPOINT_PARTICLES, CHECKPOINT_WEIGHTS,
+    CHECKPOINT_ARRAY_COUNT
+};
+
+/* Header at the start of a checkpoint file. It is 80 bytes long, so
+that the arrays after it are aligned. The three wave functions are
+stored in the order of the simulation's m_psi_ptr, so that the
+leapfrog steps continue exactly as they would have.*/
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t width, height;
+    int32_t particles_width, particles_height;
+    float simulation_width, simulation_height;
+    float dt, hbar, m;
+    int32_t time_step_count;
+    double t;
+    // One if the checkpoint has the weights of the particles.
+    int32_t weighted_particles;
+    int32_t reserved[3];
+};
+
+/* Number of floats in the given array of a checkpoint. */
+size_t checkpoint_array_length(const CheckpointHeader &header, int array);
+
+/* Total size in bytes of a checkpoint with this header. */
+size_t checkpoint_size(const CheckpointHeader &header);
+
+CheckpointHeader make_checkpoint_header();
+
+/*
+Write checkpoints to files on a separate thread.
+
+The caller fills in the buffer returned by begin, which blocks
+until the previous checkpoint has been written, and then calls
+write, which returns immediately. Each checkpoint is first written
+to a temporary file that is then renamed, so that a checkpoint that
+is being written never replaces a complete one.
+
+When compiling with Emscripten, the checkpoint is written
+as soon as write is called.
+*/
+class CheckpointWriter {
+    std::vector<uint8_t> m_buffer;
+    std::string m_fname;
+    bool m_pending, m_stop;
+    #ifndef __EMSCRIPTEN__
+    pthread_t m_thread;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    static void *write_loop(void *void_writer);
+    #endif
+    void write_file();
+    CheckpointWriter(const CheckpointWriter &);
+    CheckpointWriter& operator=(const CheckpointWriter &);
+    public:
+    CheckpointWriter();
+    void begin(const CheckpointHeader &header);
+    float *array(int array);
+    void write(const std::string &fname);
+    void wait();
+    ~CheckpointWriter();
+};
+
+/*
+Read only view of a checkpoint file, which is memory mapped instead of
+read, so that its arrays can be given straight to glTexSubImage2D
+without first being copied.
+*/
+class MappedCheckpoint {
+    const uint8_t *m_data;
+    size_t m_size;
+    MappedCheckpoint(const MappedCheckpoint &);
+    MappedCheckpoint& operator=(const MappedCheckpoint &);
+    public:
+    MappedCheckpoint();
+    bool open(const std::string &fname);
+    void close();
+    const CheckpointHeader &header() const;
+    const float *array(int array) const;
+    ~MappedCheckpoint();
+};
+
+#endif
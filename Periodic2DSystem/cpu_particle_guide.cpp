@@ -0,0 +1,517 @@
+#include "cpu_particle_guide.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Smallest number of particles that are given to a thread at a time. */
+#define MIN_PARTICLES_PER_CHUNK 1024
+
+/* Largest number of substeps that a particle's step is split into,
+which is the same as in shaders/integration/adaptive-rk4.frag. */
+#define MAX_SUBSTEPS 16
+
+/* Smallest number of rows of the velocity field that are given
+to a thread at a time. */
+#define MIN_ROWS_PER_CHUNK 8
+
+void Particles2D::resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    if (!w.empty())
+        w.resize(count, 1.0F);
+}
+
+int Particles2D::count() const {
+    return x.size();
+}
+
+void Particles2D::from_interleaved(const float *arr, ThreadPool &pool) {
+    pool.parallel_for(0, this->count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            x[n] = arr[2*n];
+            y[n] = arr[2*n + 1];
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+void Particles2D::to_interleaved(float *arr, ThreadPool &pool) const {
+    pool.parallel_for(0, this->count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            arr[2*n] = x[n];
+            arr[2*n + 1] = y[n];
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+VelocityField::VelocityField(): width(0), height(0) {}
+
+static inline int wrap(int i, int n) {
+    if (i >= 0 && i < n)
+        return i;
+    i %= n;
+    return (i < 0)? i + n: i;
+}
+
+/* Rows of both parts of psi that are read by the gradient for one
+row of the velocity field, where rows[RADIUS + k] is k rows away.*/
+template <int ORDER>
+struct GradientRows {
+    const float *re[2*Stencil<ORDER>::RADIUS + 1];
+    const float *im[2*Stencil<ORDER>::RADIUS + 1];
+};
+
+/* Velocity at column j of a row. Only the columns within RADIUS of
+the edges need to WRAP, so that the rest are done without any
+modular arithmetic.*/
+template <int ORDER, bool WRAP>
+static inline void texel_velocity(
+    const GradientRows<ORDER> &r, int j, int width,
+    float inv_dx, float inv_dy, float hbar_m, float &vx, float &vy) {
+    typedef Stencil<ORDER> S;
+    constexpr int RADIUS = S::RADIUS;
+    const float *c_re = r.re[RADIUS], *c_im = r.im[RADIUS];
+    float dx_re = 0.0F, dx_im = 0.0F, dy_re = 0.0F, dy_im = 0.0F;
+    for (int k = 1; k <= RADIUS; k++) {
+        int right = (WRAP)? wrap(j + k, width): j + k;
+        int left = (WRAP)? wrap(j - k, width): j - k;
+        dx_re += S::GRADIENT[k]*(c_re[right] - c_re[left]);
+        dx_im += S::GRADIENT[k]*(c_im[right] - c_im[left]);
+        dy_re += S::GRADIENT[k]*(r.re[RADIUS + k][j] - r.re[RADIUS - k][j]);
+        dy_im += S::GRADIENT[k]*(r.im[RADIUS + k][j] - r.im[RADIUS - k][j]);
+    }
+    // Im(grad psi/psi) = Im(grad psi conj(psi))/|psi|^2.
+    float re = c_re[j], im = c_im[j];
+    float abs2 = re*re + im*im;
+    float c = (abs2 > 0.0F)? hbar_m/abs2: 0.0F;
+    vx = c*inv_dx*(dx_im*re - dx_re*im);
+    vy = c*inv_dy*(dy_im*re - dy_re*im);
+}
+
+/* Velocity of rows row_begin to row_end - 1 of psi, which is put in
+the rows of velocity starting from zero. With wrap_rows, the rows of psi
+are periodic, and otherwise the RADIUS rows past either end are read
+directly, so they must be valid, as with the halos of a slab.*/
+template <int ORDER>
+static void compute_velocity_rows(
+    float *velocity_x, float *velocity_y, const ComplexRows &psi,
+    int row_begin, int row_end, bool wrap_rows,
+    float inv_dx, float inv_dy, float hbar_m, ThreadPool &pool) {
+    constexpr int RADIUS = Stencil<ORDER>::RADIUS;
+    int width = psi.width, height = psi.height;
+    pool.parallel_for(row_begin, row_end, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            GradientRows<ORDER> r;
+            for (int k = -RADIUS; k <= RADIUS; k++) {
+                ptrdiff_t offset = (ptrdiff_t)width
+                    *((wrap_rows)? wrap(i + k, height): i + k);
+                r.re[RADIUS + k] = psi.re + offset;
+                r.im[RADIUS + k] = psi.im + offset;
+            }
+            float *vx = velocity_x + (size_t)width*(i - row_begin);
+            float *vy = velocity_y + (size_t)width*(i - row_begin);
+            int j = 0;
+            for (; j < width && j < RADIUS; j++)
+                texel_velocity<ORDER, true>(
+                    r, j, width, inv_dx, inv_dy, hbar_m, vx[j], vy[j]);
+            for (; j < width - RADIUS; j++)
+                texel_velocity<ORDER, false>(
+                    r, j, width, inv_dx, inv_dy, hbar_m, vx[j], vy[j]);
+            for (; j < width; j++)
+                texel_velocity<ORDER, true>(
+                    r, j, width, inv_dx, inv_dy, hbar_m, vx[j], vy[j]);
+        }
+    }, MIN_ROWS_PER_CHUNK);
+}
+
+static void compute_velocity_rows(
+    float *velocity_x, float *velocity_y, const ComplexRows &psi,
+    int row_begin, int row_end, bool wrap_rows,
+    float inv_dx, float inv_dy, float hbar_m, int stencil_order,
+    ThreadPool &pool) {
+    switch (stencil_order) {
+        case 2:
+        compute_velocity_rows<2>(velocity_x, velocity_y, psi,
+                                 row_begin, row_end, wrap_rows,
+                                 inv_dx, inv_dy, hbar_m, pool);
+        break;
+        case 6:
+        compute_velocity_rows<6>(velocity_x, velocity_y, psi,
+                                 row_begin, row_end, wrap_rows,
+                                 inv_dx, inv_dy, hbar_m, pool);
+        break;
+        default:
+        compute_velocity_rows<4>(velocity_x, velocity_y, psi,
+                                 row_begin, row_end, wrap_rows,
+                                 inv_dx, inv_dy, hbar_m, pool);
+    }
+}
+
+void compute_velocity_field(VelocityField &velocity, const ComplexField &psi,
+                            const GuideParams &params, ThreadPool &pool) {
+    velocity.width = psi.width;
+    velocity.height = psi.height;
+    velocity.x.resize((size_t)psi.width*psi.height);
+    velocity.y.resize((size_t)psi.width*psi.height);
+    compute_velocity_rows(
+        &velocity.x[0], &velocity.y[0], psi.rows(), 0, psi.height, true,
+        psi.width/params.width, psi.height/params.height,
+        params.hbar/params.m, params.stencil_order, pool);
+}
+
+void compute_velocity_field(VelocityField &velocity, const ComplexRows &psi,
+                            int row_begin, int row_end, float dx, float dy,
+                            const GuideParams &params, ThreadPool &pool) {
+    velocity.width = psi.width;
+    velocity.height = row_end - row_begin;
+    velocity.x.resize((size_t)velocity.width*velocity.height);
+    velocity.y.resize((size_t)velocity.width*velocity.height);
+    compute_velocity_rows(
+        &velocity.x[0], &velocity.y[0], psi, row_begin, row_end, false,
+        1.0F/dx, 1.0F/dy, params.hbar/params.m, params.stencil_order, pool);
+}
+
+/* Same as absorbingBoundaries in shaders/particles/guide.frag. */
+static inline void absorbing_boundaries(
+    float x, float y, const GuideParams &params, float &vx, float &vy) {
+    float u = x/params.width, v = y/params.height;
+    float s = 0.02F;
+    float norm = sqrtf(vx*vx + vy*vy);
+    float nx = (norm > 0.0F)? vx/norm: 0.0F;
+    float ny = (norm > 0.0F)? vy/norm: 0.0F;
+    if (u > (1.0F - 2.5F*s) || u <= 2.5F*s) {
+        vx = 0.5F*nx;
+        vy = 0.0F;
+    }
+    if (v > (1.0F - 2.5F*s) || v <= 2.5F*s) {
+        vx = 0.0F;
+        vy = 0.5F*ny;
+    }
+    if (u <= 0.1F*s || u > (1.0F - 0.1F*s)
+        || v <= 0.1F*s || v > (1.0F - 0.1F*s))
+        vx = vy = 0.0F;
+}
+
+/* Texel below the position r along one axis, and the weight a
+of the texel above it. Texel centers are at (i + 1/2) grid
+spacings, as they are for texture coordinates.*/
+static inline int lower_texel(float r, float inv_d, int n, float &a) {
+    float g = r*inv_d - 0.5F;
+    float g0 = floorf(g);
+    a = g - g0;
+    return wrap((int)g0, n);
+}
+
+/* Velocity at (x, y), interpolated bilinearly from the velocity field,
+for a single particle.*/
+static inline void bilinear_velocity(
+    const VelocityField &velocity, float x, float y,
+    float inv_dx, float inv_dy, float &vx, float &vy) {
+    int width = velocity.width, height = velocity.height;
+    float ax, ay;
+    int j = lower_texel(x, inv_dx, width, ax);
+    int i = lower_texel(y, inv_dy, height, ay);
+    int j1 = (j + 1 == width)? 0: j + 1;
+    int i1 = (i + 1 == height)? 0: i + 1;
+    const float *field[2] = {&velocity.x[0], &velocity.y[0]};
+    float *out[2] = {&vx, &vy};
+    for (int d = 0; d < 2; d++) {
+        const float *f = field[d];
+        float lower = f[(size_t)width*i + j]
+            + ax*(f[(size_t)width*i + j1] - f[(size_t)width*i + j]);
+        float upper = f[(size_t)width*i1 + j]
+            + ax*(f[(size_t)width*i1 + j1] - f[(size_t)width*i1 + j]);
+        *out[d] = lower + ay*(upper - lower);
+    }
+}
+
+#ifdef __SSE2__
+static inline __m128 gather4(const float *arr, const size_t index[4]) {
+    return _mm_set_ps(arr[index[3]], arr[index[2]],
+                      arr[index[1]], arr[index[0]]);
+}
+
+/* floor for SSE2, which only has truncation. */
+static inline __m128 floor4(__m128 x) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0F)));
+}
+#endif
+
+/* Velocities of the particles at q + dt q_dot, or at q if q_dot
+is NULL, interpolated bilinearly from the velocity field.*/
+static void interpolate_velocities(
+    Particles2D &velocities,
+    const VelocityField &velocity, const Particles2D &q,
+    float dt, const Particles2D *q_dot,
+    const GuideParams &params, ThreadPool &pool) {
+    velocities.resize(q.count());
+    int width = velocity.width, height = velocity.height;
+    float inv_dx = width/params.width, inv_dy = height/params.height;
+    const float *field[2] = {&velocity.x[0], &velocity.y[0]};
+    float *out[2] = {&velocities.x[0], &velocities.y[0]};
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        auto position = [&](int n, float &x, float &y) {
+            x = q.x[n];
+            y = q.y[n];
+            if (q_dot != NULL) {
+                x += dt*q_dot->x[n];
+                y += dt*q_dot->y[n];
+            }
+        };
+        int n = begin;
+        #ifdef __SSE2__
+        __m128 dt4 = _mm_set1_ps(dt);
+        __m128 inv_dx4 = _mm_set1_ps(inv_dx), inv_dy4 = _mm_set1_ps(inv_dy);
+        __m128 half = _mm_set1_ps(0.5F);
+        for (; n + 4 <= end; n += 4) {
+            __m128 x = _mm_loadu_ps(&q.x[n]), y = _mm_loadu_ps(&q.y[n]);
+            if (q_dot != NULL) {
+                x = _mm_add_ps(x, _mm_mul_ps(dt4, _mm_loadu_ps(&q_dot->x[n])));
+                y = _mm_add_ps(y, _mm_mul_ps(dt4, _mm_loadu_ps(&q_dot->y[n])));
+            }
+            __m128 gx = _mm_sub_ps(_mm_mul_ps(x, inv_dx4), half);
+            __m128 gy = _mm_sub_ps(_mm_mul_ps(y, inv_dy4), half);
+            __m128 gx0 = floor4(gx), gy0 = floor4(gy);
+            __m128 ax = _mm_sub_ps(gx, gx0), ay = _mm_sub_ps(gy, gy0);
+            alignas(16) int j0[4], i0[4];
+            _mm_store_si128((__m128i *)j0, _mm_cvttps_epi32(gx0));
+            _mm_store_si128((__m128i *)i0, _mm_cvttps_epi32(gy0));
+            size_t c00[4], c10[4], c01[4], c11[4];
+            for (int l = 0; l < 4; l++) {
+                int j = wrap(j0[l], width), i = wrap(i0[l], height);
+                int j1 = (j + 1 == width)? 0: j + 1;
+                int i1 = (i + 1 == height)? 0: i + 1;
+                c00[l] = (size_t)width*i + j;
+                c10[l] = (size_t)width*i + j1;
+                c01[l] = (size_t)width*i1 + j;
+                c11[l] = (size_t)width*i1 + j1;
+            }
+            for (int d = 0; d < 2; d++) {
+                __m128 f00 = gather4(field[d], c00);
+                __m128 f10 = gather4(field[d], c10);
+                __m128 f01 = gather4(field[d], c01);
+                __m128 f11 = gather4(field[d], c11);
+                __m128 lower = _mm_add_ps(
+                    f00, _mm_mul_ps(ax, _mm_sub_ps(f10, f00)));
+                __m128 upper = _mm_add_ps(
+                    f01, _mm_mul_ps(ax, _mm_sub_ps(f11, f01)));
+                _mm_storeu_ps(out[d] + n, _mm_add_ps(
+                    lower, _mm_mul_ps(ay, _mm_sub_ps(upper, lower))));
+            }
+        }
+        #endif
+        for (; n < end; n++) {
+            float x, y;
+            position(n, x, y);
+            bilinear_velocity(velocity, x, y, inv_dx, inv_dy,
+                              out[0][n], out[1][n]);
+        }
+        if (params.absorbing_boundaries) {
+            for (n = begin; n < end; n++) {
+                float x, y;
+                position(n, x, y);
+                absorbing_boundaries(x, y, params, out[0][n], out[1][n]);
+            }
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+/* Value of the wave function and its gradient at a single texel,
+as {psi, d/dx psi, d/dy psi}.*/
+template <int ORDER>
+static inline void texel_gradient(
+    const ComplexField &psi, int i, int j, float inv_dx, float inv_dy,
+    float re[3], float im[3]) {
+    typedef Stencil<ORDER> S;
+    int width = psi.width, height = psi.height;
+    size_t center = (size_t)width*i + j;
+    re[0] = psi.re[center];
+    im[0] = psi.im[center];
+    float dx_re = 0.0F, dx_im = 0.0F, dy_re = 0.0F, dy_im = 0.0F;
+    for (int k = 1; k <= S::RADIUS; k++) {
+        size_t right = (size_t)width*i + wrap(j + k, width);
+        size_t left = (size_t)width*i + wrap(j - k, width);
+        size_t up = (size_t)width*wrap(i + k, height) + j;
+        size_t down = (size_t)width*wrap(i - k, height) + j;
+        dx_re += S::GRADIENT[k]*(psi.re[right] - psi.re[left]);
+        dx_im += S::GRADIENT[k]*(psi.im[right] - psi.im[left]);
+        dy_re += S::GRADIENT[k]*(psi.re[up] - psi.re[down]);
+        dy_im += S::GRADIENT[k]*(psi.im[up] - psi.im[down]);
+    }
+    re[1] = dx_re*inv_dx;
+    im[1] = dx_im*inv_dx;
+    re[2] = dy_re*inv_dy;
+    im[2] = dy_im*inv_dy;
+}
+
+/* Velocities of the particles at q + dt q_dot, or at q if q_dot
+is NULL, from psi and its gradient interpolated bilinearly.*/
+template <int ORDER>
+static void guide_velocities(
+    Particles2D &velocities,
+    const ComplexField &psi, const Particles2D &q,
+    float dt, const Particles2D *q_dot,
+    const GuideParams &params, ThreadPool &pool) {
+    int width = psi.width, height = psi.height;
+    float inv_dx = width/params.width, inv_dy = height/params.height;
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            float x = q.x[n], y = q.y[n];
+            if (q_dot != NULL) {
+                x += dt*q_dot->x[n];
+                y += dt*q_dot->y[n];
+            }
+            float a[2];
+            int j0 = lower_texel(x, inv_dx, width, a[0]);
+            int i0 = lower_texel(y, inv_dy, height, a[1]);
+            float re[3] = {0.0F}, im[3] = {0.0F};
+            for (int corner = 0; corner < 4; corner++) {
+                int bx = corner & 1, by = corner >> 1;
+                int j = (bx)? wrap(j0 + 1, width): j0;
+                int i = (by)? wrap(i0 + 1, height): i0;
+                float w = ((bx)? a[0]: 1.0F - a[0])
+                    *((by)? a[1]: 1.0F - a[1]);
+                float c_re[3], c_im[3];
+                texel_gradient<ORDER>(psi, i, j, inv_dx, inv_dy, c_re, c_im);
+                for (int p = 0; p < 3; p++) {
+                    re[p] += w*c_re[p];
+                    im[p] += w*c_im[p];
+                }
+            }
+            // Im(grad psi/psi) = Im(grad psi conj(psi))/|psi|^2,
+            // which is left at zero at the nodes of psi.
+            float abs2 = re[0]*re[0] + im[0]*im[0];
+            float c = (abs2 > 0.0F)? params.hbar/(params.m*abs2): 0.0F;
+            float vx = c*(im[1]*re[0] - re[1]*im[0]);
+            float vy = c*(im[2]*re[0] - re[2]*im[0]);
+            if (params.absorbing_boundaries)
+                absorbing_boundaries(x, y, params, vx, vy);
+            velocities.x[n] = vx;
+            velocities.y[n] = vy;
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+static void guide_velocities(
+    Particles2D &velocities,
+    const ComplexField &psi, const Particles2D &q,
+    float dt, const Particles2D *q_dot,
+    const GuideParams &params, ThreadPool &pool) {
+    velocities.resize(q.count());
+    switch (params.stencil_order) {
+        case 2:
+        guide_velocities<2>(velocities, psi, q, dt, q_dot, params, pool);
+        break;
+        case 6:
+        guide_velocities<6>(velocities, psi, q, dt, q_dot, params, pool);
+        break;
+        default:
+        guide_velocities<4>(velocities, psi, q, dt, q_dot, params, pool);
+    }
+}
+
+/* Same as enforcePeriodicity in shaders/integration/rk4.frag. */
+static inline float enforce_periodicity(float x, float size) {
+    x = (x <= 0.0F)? size + x: x;
+    return (x > size)? fmodf(x, size): x;
+}
+
+/* Take the step of a single particle at (x, y) again as several
+smaller RK4 steps, in the same way as adaptive-rk4.frag. The velocity
+fields at the start, middle, and end of the step are interpolated
+quadratically in time.*/
+static void substep(
+    float &x, float &y, int substeps, const VelocityField velocity[3],
+    const GuideParams &params, float dt) {
+    float inv_dx = velocity[0].width/params.width;
+    float inv_dy = velocity[0].height/params.height;
+    auto velocity_at = [&](float rx, float ry, float s,
+                           float &vx, float &vy) {
+        float w[3] = {(1.0F - s)*(1.0F - 2.0F*s), 4.0F*s*(1.0F - s),
+                      s*(2.0F*s - 1.0F)};
+        vx = vy = 0.0F;
+        for (int t = 0; t < 3; t++) {
+            float ux, uy;
+            bilinear_velocity(velocity[t], rx, ry, inv_dx, inv_dy, ux, uy);
+            vx += w[t]*ux;
+            vy += w[t]*uy;
+        }
+        if (params.absorbing_boundaries)
+            absorbing_boundaries(rx, ry, params, vx, vy);
+    };
+    float h = 1.0F/substeps;
+    for (int i = 0; i < substeps; i++) {
+        float s = i*h, hdt = h*dt;
+        float k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+        velocity_at(x, y, s, k1x, k1y);
+        velocity_at(x + 0.5F*hdt*k1x, y + 0.5F*hdt*k1y, s + 0.5F*h,
+                    k2x, k2y);
+        velocity_at(x + 0.5F*hdt*k2x, y + 0.5F*hdt*k2y, s + 0.5F*h,
+                    k3x, k3y);
+        velocity_at(x + hdt*k3x, y + hdt*k3y, s + h, k4x, k4y);
+        x += hdt*(k1x + 2.0F*k2x + 2.0F*k3x + k4x)/6.0F;
+        y += hdt*(k1y + 2.0F*k2y + 2.0F*k3y + k4y)/6.0F;
+    }
+}
+
+void ParticleGuide::rk4_step(
+    Particles2D &q,
+    const ComplexField &psi0, const ComplexField &psi1,
+    const ComplexField &psi2,
+    const GuideParams &params, float dt, ThreadPool &pool) {
+    Particles2D *k = m_stages;
+    // The middle two stages both use psi1.
+    const ComplexField *psi[4] = {&psi0, &psi1, &psi1, &psi2};
+    const VelocityField *velocity[4] = {
+        &m_velocity[0], &m_velocity[1], &m_velocity[1], &m_velocity[2]};
+    float stage_dt[4] = {0.0F, dt/2.0F, dt/2.0F, dt};
+    // The substeps always use the velocity fields.
+    if (params.interpolate_velocity_field || params.adaptive_substeps) {
+        for (int s = 0; s < 3; s++)
+            compute_velocity_field(m_velocity[s], *psi[(s == 2)? 3: s],
+                                   params, pool);
+    }
+    for (int s = 0; s < 4; s++) {
+        const Particles2D *q_dot = (s == 0)? NULL: &k[s - 1];
+        if (params.interpolate_velocity_field)
+            interpolate_velocities(k[s], *velocity[s], q,
+                                   stage_dt[s], q_dot, params, pool);
+        else
+            guide_velocities(k[s], *psi[s], q,
+                             stage_dt[s], q_dot, params, pool);
+    }
+    float texel_width = params.width/psi0.width;
+    float texel_height = params.height/psi0.height;
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            float vx = (k[0].x[n] + 2.0F*k[1].x[n]
+                        + 2.0F*k[2].x[n] + k[3].x[n])/6.0F;
+            float vy = (k[0].y[n] + 2.0F*k[1].y[n]
+                        + 2.0F*k[2].y[n] + k[3].y[n])/6.0F;
+            float x = q.x[n] + dt*vx, y = q.y[n] + dt*vy;
+            if (params.adaptive_substeps) {
+                // Difference from the midpoint method, which only
+                // uses the second stage, in texels.
+                float ex = dt*(vx - k[1].x[n])/texel_width;
+                float ey = dt*(vy - k[1].y[n])/texel_height;
+                float error = sqrtf(ex*ex + ey*ey);
+                // The midpoint method's error goes as the
+                // cube of the step size.
+                int substeps = std::min(
+                    (int)ceilf(cbrtf(error/params.substep_tolerance)),
+                    MAX_SUBSTEPS);
+                if (error > params.substep_tolerance && substeps > 1) {
+                    x = q.x[n];
+                    y = q.y[n];
+                    substep(x, y, substeps, m_velocity, params, dt);
+                }
+            }
+            q.x[n] = enforce_periodicity(x, params.width);
+            q.y[n] = enforce_periodicity(y, params.height);
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
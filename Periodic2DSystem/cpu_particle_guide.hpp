@@ -0,0 +1,96 @@
+#include "cpu_wave_function.hpp"
+
+#ifndef _CPU_PARTICLE_GUIDE_
+#define _CPU_PARTICLE_GUIDE_
+
+/* Positions of particles, with each coordinate in its own array,
+so that several particles are moved at a time with SIMD registers.
+Particles may also have weights, where w is left empty when every
+particle has a weight of one. The weights are kept only on the CPU,
+and are not part of the interleaved positions.*/
+struct Particles2D {
+    std::vector<float> x, y;
+    std::vector<float> w;
+    // Any new weights are one.
+    void resize(int count);
+    int count() const;
+    // Two floats per particle, in the same order
+    // as the texels of an RG texture.
+    void from_interleaved(const float *arr, ThreadPool &pool);
+    void to_interleaved(float *arr, ThreadPool &pool) const;
+};
+
+/* Velocity (hbar/m) Im(grad psi/psi) at each texel of the grid,
+stored in the same order as a ComplexField.*/
+struct VelocityField {
+    int width, height;
+    std::vector<float> x, y;
+    VelocityField();
+};
+
+/* Parameters of the particle guide, which are the same as the
+uniforms of shaders/particles/guide.frag. */
+struct GuideParams {
+    float m, hbar;
+    // Simulation dimensions.
+    float width, height;
+    int stencil_order;
+    // Interpolate the velocity field found at each texel, as
+    // shaders/particles/interpolate-velocity.frag does, instead of
+    // interpolating psi and its gradient.
+    bool interpolate_velocity_field;
+    bool absorbing_boundaries;
+    // Split the steps of particles whose error is larger than
+    // substep_tolerance texels into smaller steps.
+    bool adaptive_substeps;
+    float substep_tolerance;
+};
+
+/* Find the velocity field of psi, using a gradient of the given
+order. The velocity is left at zero at the nodes of psi.*/
+void compute_velocity_field(VelocityField &velocity, const ComplexField &psi,
+                            const GuideParams &params, ThreadPool &pool);
+
+/* Same as the above, but for rows row_begin to row_end - 1 of a part
+of a grid with texels of size dx by dy, where the rows within the
+stencil's radius past either end are also read instead of wrapping
+around, so that a slab can be given with its halo rows. Row i of
+psi is put in row i - row_begin of the velocity field.*/
+void compute_velocity_field(VelocityField &velocity, const ComplexRows &psi,
+                            int row_begin, int row_end, float dx, float dy,
+                            const GuideParams &params, ThreadPool &pool);
+
+/*
+Move particles with the guiding equation
+
+    dq/dt = (hbar/m) Im(grad psi / psi),
+
+in the same way as the particles/guide.frag and integration/rk4.frag
+shaders do, so that the particles can be moved along with the CPU
+time steps without a GPU.
+
+With interpolate_velocity_field, the velocity field of each wave
+function is found once, and is then interpolated bilinearly for four
+particles at a time. Otherwise psi and its gradient are found at the
+corners of the cell that each particle is in, and are interpolated
+to the particle's position.
+
+With adaptive_substeps, the error of each particle's step is
+estimated from the midpoint method embedded in the RK4 stages, and the
+particles where it is too large, which are those close to the nodes
+of psi, take their step again as several smaller steps.
+*/
+class ParticleGuide {
+    Particles2D m_stages[4];
+    VelocityField m_velocity[3];
+    public:
+    /* Take an RK4 step of size dt, where psi0, psi1, and psi2 are the
+    wave function at the start, middle, and end of the step. Positions
+    are then wrapped around the simulation dimensions.*/
+    void rk4_step(Particles2D &q,
+                  const ComplexField &psi0, const ComplexField &psi1,
+                  const ComplexField &psi2,
+                  const GuideParams &params, float dt, ThreadPool &pool);
+};
+
+#endif
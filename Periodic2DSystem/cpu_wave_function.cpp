@@ -0,0 +1,234 @@
+#include "cpu_wave_function.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of columns that are done at a time for each row. For the
+fourth order stencil, the five input rows of both parts of psi1,
+along with one row of each of psi0, psi2 and the potential,
+then take up about 64 KB. */
+#define STRIP_WIDTH 1024
+
+/* Smallest number of rows that are given to a thread at a time. */
+#define MIN_ROWS_PER_CHUNK 8
+
+ComplexField::ComplexField(): width(0), height(0) {}
+
+void ComplexField::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    this->re.resize(width*height);
+    this->im.resize(width*height);
+}
+
+void ComplexField::from_interleaved(const float *arr, ThreadPool &pool) {
+    pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+        for (int k = row_begin*width; k < row_end*width; k++) {
+            re[k] = arr[2*k];
+            im[k] = arr[2*k + 1];
+        }
+    }, MIN_ROWS_PER_CHUNK);
+}
+
+void ComplexField::to_interleaved(float *arr, ThreadPool &pool) const {
+    pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+        for (int k = row_begin*width; k < row_end*width; k++) {
+            arr[2*k] = re[k];
+            arr[2*k + 1] = im[k];
+        }
+    }, MIN_ROWS_PER_CHUNK);
+}
+
+/* Rows of a single part of psi1 that are read by the stencil for one
+row of output, where rows[RADIUS + k] is k rows away from the output.*/
+template <int ORDER>
+struct StencilRows {
+    const float *rows[2*Stencil<ORDER>::RADIUS + 1];
+    const float *center() const {
+        return rows[Stencil<ORDER>::RADIUS];
+    }
+};
+
+/* Get the stencil rows around row i, where rows past the top and bottom
+are either wrapped around, or are read from the halo rows outside
+of the array.*/
+template <int ORDER>
+static StencilRows<ORDER> get_stencil_rows(
+    const float *arr, int i, int width, int height, bool wrap_rows) {
+    constexpr int RADIUS = Stencil<ORDER>::RADIUS;
+    StencilRows<ORDER> r;
+    for (int k = -RADIUS; k <= RADIUS; k++) {
+        int row = (wrap_rows)? (i + k + height) % height: i + k;
+        r.rows[RADIUS + k] = arr + (ptrdiff_t)width*row;
+    }
+    return r;
+}
+
+/* Laplacian at column j, where the horizontal neighbours
+are wrapped around the edges. The loops over the stencil have a
+fixed number of iterations for each order, so they are unrolled.*/
+template <int ORDER>
+static inline float laplacian(
+    const StencilRows<ORDER> &r, int j, int width,
+    float inv_dx2, float inv_dy2) {
+    typedef Stencil<ORDER> S;
+    const float *center = r.center();
+    float lx = S::LAPLACIAN[0]*center[j];
+    float ly = S::LAPLACIAN[0]*center[j];
+    for (int k = 1; k <= S::RADIUS; k++) {
+        lx += S::LAPLACIAN[k]*(center[(j + k) % width]
+                               + center[(j - k + width) % width]);
+        ly += S::LAPLACIAN[k]*(r.rows[S::RADIUS + k][j]
+                               + r.rows[S::RADIUS - k][j]);
+    }
+    return inv_dx2*lx + inv_dy2*ly;
+}
+
+#ifdef __SSE2__
+/* Laplacian at columns j to j + 3, which must all be
+at least RADIUS columns away from the edges.*/
+template <int ORDER>
+static inline __m128 laplacian4(
+    const StencilRows<ORDER> &r, int j, __m128 inv_dx2, __m128 inv_dy2) {
+    typedef Stencil<ORDER> S;
+    const float *center = r.center();
+    __m128 c = _mm_set1_ps(S::LAPLACIAN[0]);
+    __m128 lx = _mm_mul_ps(c, _mm_loadu_ps(center + j));
+    __m128 ly = lx;
+    for (int k = 1; k <= S::RADIUS; k++) {
+        c = _mm_set1_ps(S::LAPLACIAN[k]);
+        lx = _mm_add_ps(lx, _mm_mul_ps(c, _mm_add_ps(
+            _mm_loadu_ps(center + j + k), _mm_loadu_ps(center + j - k))));
+        ly = _mm_add_ps(ly, _mm_mul_ps(c, _mm_add_ps(
+            _mm_loadu_ps(r.rows[S::RADIUS + k] + j),
+            _mm_loadu_ps(r.rows[S::RADIUS - k] + j))));
+    }
+    return _mm_add_ps(_mm_mul_ps(inv_dx2, lx), _mm_mul_ps(inv_dy2, ly));
+}
+#endif
+
+template <int ORDER>
+static void leapfrog_time_step(
+    ComplexRows &psi2,
+    const ComplexRows &psi0, const ComplexRows &psi1,
+    const ComplexRows &potential, const LeapfrogParams &params,
+    bool wrap_rows, ThreadPool &pool) {
+    constexpr int RADIUS = Stencil<ORDER>::RADIUS;
+    int width = psi1.width, height = psi1.height;
+    // With s = dt/hbar and k = -hbar^2/(2m), the real and imaginary
+    // parts of the time step are
+    // Re(psi2) = Re(psi0) + s(k Im(L psi1) + Re(V) Im(psi1) + Im(V) Re(psi0))
+    // Im(psi2) = Im(psi0) + s(Im(V) Im(psi0) - k Re(L psi1) - Re(V) Re(psi1))
+    // where L is the Laplacian.
+    float s = params.dt/params.hbar;
+    float k = -params.hbar*params.hbar/(2.0F*params.m);
+    float inv_dx2 = 1.0F/(params.dx*params.dx);
+    float inv_dy2 = 1.0F/(params.dy*params.dy);
+    auto step_span = [&](int i, int j_begin, int j_end) {
+        StencilRows<ORDER> r_re = get_stencil_rows<ORDER>(
+            psi1.re, i, width, height, wrap_rows);
+        StencilRows<ORDER> r_im = get_stencil_rows<ORDER>(
+            psi1.im, i, width, height, wrap_rows);
+        const float *psi1_re = r_re.center(), *psi1_im = r_im.center();
+        ptrdiff_t offset = (ptrdiff_t)width*i;
+        const float *psi0_re = psi0.re + offset, *psi0_im = psi0.im + offset;
+        const float *v_re = potential.re + offset;
+        const float *v_im = potential.im + offset;
+        float *psi2_re = psi2.re + offset, *psi2_im = psi2.im + offset;
+        auto step_scalar = [&](int j) {
+            float lap_re = laplacian<ORDER>(r_re, j, width, inv_dx2, inv_dy2);
+            float lap_im = laplacian<ORDER>(r_im, j, width, inv_dx2, inv_dy2);
+            psi2_re[j] = psi0_re[j] + s*(k*lap_im + v_re[j]*psi1_im[j]
+                                         + v_im[j]*psi0_re[j]);
+            psi2_im[j] = psi0_im[j] + s*(v_im[j]*psi0_im[j] - k*lap_re
+                                         - v_re[j]*psi1_re[j]);
+        };
+        int j = j_begin;
+        // The first and last RADIUS columns wrap around,
+        // so they are always done one at a time.
+        for (; j < j_end && j < RADIUS; j++)
+            step_scalar(j);
+        #ifdef __SSE2__
+        __m128 s4 = _mm_set1_ps(s), k4 = _mm_set1_ps(k);
+        __m128 inv_dx2_4 = _mm_set1_ps(inv_dx2);
+        __m128 inv_dy2_4 = _mm_set1_ps(inv_dy2);
+        for (; j + 4 <= j_end && j + 4 <= width - RADIUS; j += 4) {
+            __m128 lap_re = laplacian4<ORDER>(r_re, j, inv_dx2_4, inv_dy2_4);
+            __m128 lap_im = laplacian4<ORDER>(r_im, j, inv_dx2_4, inv_dy2_4);
+            __m128 p0_re = _mm_loadu_ps(psi0_re + j);
+            __m128 p0_im = _mm_loadu_ps(psi0_im + j);
+            __m128 vr = _mm_loadu_ps(v_re + j);
+            __m128 vi = _mm_loadu_ps(v_im + j);
+            __m128 re = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(k4, lap_im),
+                           _mm_mul_ps(vr, _mm_loadu_ps(psi1_im + j))),
+                _mm_mul_ps(vi, p0_re));
+            __m128 im = _mm_sub_ps(
+                _mm_sub_ps(_mm_mul_ps(vi, p0_im), _mm_mul_ps(k4, lap_re)),
+                _mm_mul_ps(vr, _mm_loadu_ps(psi1_re + j)));
+            _mm_storeu_ps(psi2_re + j, _mm_add_ps(p0_re, _mm_mul_ps(s4, re)));
+            _mm_storeu_ps(psi2_im + j, _mm_add_ps(p0_im, _mm_mul_ps(s4, im)));
+        }
+        #endif
+        for (; j < j_end; j++)
+            step_scalar(j);
+    };
+    pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+        for (int j = 0; j < width; j += STRIP_WIDTH) {
+            int j_end = (j + STRIP_WIDTH < width)? j + STRIP_WIDTH: width;
+            for (int i = row_begin; i < row_end; i++)
+                step_span(i, j, j_end);
+        }
+    }, MIN_ROWS_PER_CHUNK);
+}
+
+static void leapfrog_time_step(
+    ComplexRows &psi2,
+    const ComplexRows &psi0, const ComplexRows &psi1,
+    const ComplexRows &potential, const LeapfrogParams &params,
+    bool wrap_rows, ThreadPool &pool) {
+    switch (params.stencil_order) {
+        case 2:
+        leapfrog_time_step<2>(
+            psi2, psi0, psi1, potential, params, wrap_rows, pool);
+        break;
+        case 6:
+        leapfrog_time_step<6>(
+            psi2, psi0, psi1, potential, params, wrap_rows, pool);
+        break;
+        default:
+        leapfrog_time_step<4>(
+            psi2, psi0, psi1, potential, params, wrap_rows, pool);
+    }
+}
+
+ComplexRows ComplexField::rows() {
+    return {.width=width, .height=height, .re=&re[0], .im=&im[0]};
+}
+
+ComplexRows ComplexField::rows() const {
+    // The rows of a const field are only ever read from.
+    return {.width=width, .height=height,
+            .re=const_cast<float *>(&re[0]),
+            .im=const_cast<float *>(&im[0])};
+}
+
+void leapfrog_time_step(
+    ComplexField &psi2,
+    const ComplexField &psi0, const ComplexField &psi1,
+    const ComplexField &potential, const LeapfrogParams &params,
+    ThreadPool &pool) {
+    psi2.resize(psi1.width, psi1.height);
+    ComplexRows psi2_rows = psi2.rows();
+    leapfrog_time_step(psi2_rows, psi0.rows(), psi1.rows(), potential.rows(),
+                       params, true, pool);
+}
+
+void leapfrog_time_step(
+    ComplexRows &psi2,
+    const ComplexRows &psi0, const ComplexRows &psi1,
+    const ComplexRows &potential, const LeapfrogParams &params,
+    ThreadPool &pool) {
+    leapfrog_time_step(psi2, psi0, psi1, potential, params, false, pool);
+}
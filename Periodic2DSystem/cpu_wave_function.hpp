@@ -0,0 +1,72 @@
+#include "thread_pool.hpp"
+#include "stencils.hpp"
+#include <cstddef>
+#include <vector>
+
+#ifndef _CPU_WAVE_FUNCTION_
+#define _CPU_WAVE_FUNCTION_
+
+/* Rows of a complex field that are stored elsewhere, where row i of the
+real part starts at re + i*width, and likewise for the imaginary part.
+Unlike a ComplexField, the rows are not periodic: rows just outside of
+0 to height - 1, such as the halo rows of one slab of a larger grid,
+are read directly.*/
+struct ComplexRows {
+    int width, height;
+    float *re, *im;
+};
+
+/* Complex valued field on a periodic 2D grid, where the real and
+imaginary parts are kept in separate arrays. Each array is stored
+row by row, in the same order as the texels of a texture, so that
+complex arithmetic over a row is done on whole SIMD registers.*/
+struct ComplexField {
+    int width, height;
+    std::vector<float> re, im;
+    ComplexField();
+    void resize(int width, int height);
+    void from_interleaved(const float *arr, ThreadPool &pool);
+    void to_interleaved(float *arr, ThreadPool &pool) const;
+    ComplexRows rows();
+    ComplexRows rows() const;
+};
+
+/* Parameters of the leapfrog time step, which are the same as
+the uniforms of shaders/wave-function/time-step.frag, along with
+the order of the Laplacian (2, 4, or 6). */
+struct LeapfrogParams {
+    float m, hbar, dt;
+    float dx, dy;
+    int stencil_order;
+};
+
+/* Largest time step for which the leapfrog steps are stable. The
+split-operator, ADI, and Chebyshev steps are stable for any time step.*/
+#define MAX_LEAPFROG_DT 0.3F
+
+/* Do the same time step as shaders/wave-function/time-step.frag on
+the CPU, where psi2 = psi0 - i dt/hbar (H psi1 + i Im(V) psi0), using a
+Laplacian of the given order with periodic boundaries. The real
+part of the potential is in potential.re, and its imaginary part,
+which is nonzero for absorbing boundaries, is in potential.im.
+
+The rows of the grid are divided among the threads of the pool,
+and each thread goes through its rows in strips of columns,
+so that the rows of psi1 that each output row reads stay in cache.
+Each order has its own specialization of the kernel.*/
+void leapfrog_time_step(
+    ComplexField &psi2,
+    const ComplexField &psi0, const ComplexField &psi1,
+    const ComplexField &potential, const LeapfrogParams &params,
+    ThreadPool &pool);
+
+/* Do the same time step on rows 0 to height - 1 only, where the rows
+of psi1 up to the stencil's radius above and below these must
+also be readable.*/
+void leapfrog_time_step(
+    ComplexRows &psi2,
+    const ComplexRows &psi0, const ComplexRows &psi1,
+    const ComplexRows &potential, const LeapfrogParams &params,
+    ThreadPool &pool);
+
+#endif
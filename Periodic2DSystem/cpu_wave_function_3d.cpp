@@ -0,0 +1,423 @@
+#include "cpu_wave_function_3d.hpp"
+#include <cmath>
+#include <cstddef>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Dimensions of the tiles that the grid is split into for the time
+step, in rows and slices. For the fourth order stencil on a 128 wide
+grid, the rows of both parts of psi1 that are read for one slice of a
+tile, which come from the five nearest slices, take up about 90 KB.*/
+#define TILE_ROWS 16
+#define TILE_SLICES 16
+
+/* Smallest number of particles that are given to a thread at a time. */
+#define MIN_PARTICLES_PER_CHUNK 1024
+
+ComplexField3D::ComplexField3D(): width(0), height(0), length(0) {}
+
+void ComplexField3D::resize(int width, int height, int length) {
+    this->width = width;
+    this->height = height;
+    this->length = length;
+    this->re.resize((size_t)width*height*length);
+    this->im.resize((size_t)width*height*length);
+}
+
+void ComplexField3D::from_tiled(
+    const float *arr, int tiles_across, ThreadPool &pool) {
+    size_t texture_width = (size_t)tiles_across*width;
+    pool.parallel_for(0, length, [&](int slice_begin, int slice_end) {
+        for (int k = slice_begin; k < slice_end; k++) {
+            size_t tile_x = k % tiles_across, tile_y = k / tiles_across;
+            for (int i = 0; i < height; i++) {
+                const float *src = arr + 2*((tile_y*height + i)*texture_width
+                                            + tile_x*width);
+                size_t offset = ((size_t)k*height + i)*width;
+                for (int j = 0; j < width; j++) {
+                    re[offset + j] = src[2*j];
+                    im[offset + j] = src[2*j + 1];
+                }
+            }
+        }
+    });
+}
+
+void ComplexField3D::to_tiled(
+    float *arr, int tiles_across, ThreadPool &pool) const {
+    size_t texture_width = (size_t)tiles_across*width;
+    pool.parallel_for(0, length, [&](int slice_begin, int slice_end) {
+        for (int k = slice_begin; k < slice_end; k++) {
+            size_t tile_x = k % tiles_across, tile_y = k / tiles_across;
+            for (int i = 0; i < height; i++) {
+                float *dst = arr + 2*((tile_y*height + i)*texture_width
+                                      + tile_x*width);
+                size_t offset = ((size_t)k*height + i)*width;
+                for (int j = 0; j < width; j++) {
+                    dst[2*j] = re[offset + j];
+                    dst[2*j + 1] = im[offset + j];
+                }
+            }
+        }
+    });
+}
+
+/* Rows of a single part of psi1 that are read by the stencil for one
+row of output, where y[RADIUS + n] is n rows away from the output in
+the same slice, and z[RADIUS + n] is the same row n slices away.*/
+template <int ORDER>
+struct StencilLines {
+    const float *y[2*Stencil<ORDER>::RADIUS + 1];
+    const float *z[2*Stencil<ORDER>::RADIUS + 1];
+    const float *center() const {
+        return y[Stencil<ORDER>::RADIUS];
+    }
+};
+
+/* Get the stencil rows around row i of slice k,
+which are wrapped around in both directions.*/
+template <int ORDER>
+static StencilLines<ORDER> get_stencil_lines(
+    const float *arr, int i, int k, int width, int height, int length) {
+    constexpr int RADIUS = Stencil<ORDER>::RADIUS;
+    StencilLines<ORDER> l;
+    for (int n = -RADIUS; n <= RADIUS; n++) {
+        int row = (i + n + height) % height;
+        int slice = (k + n + length) % length;
+        l.y[RADIUS + n] = arr + ((ptrdiff_t)k*height + row)*width;
+        l.z[RADIUS + n] = arr + ((ptrdiff_t)slice*height + i)*width;
+    }
+    return l;
+}
+
+/* Laplacian at column j, where the neighbours along the row
+are wrapped around the edges.*/
+template <int ORDER>
+static inline float laplacian(
+    const StencilLines<ORDER> &l, int j, int width,
+    float inv_dx2, float inv_dy2, float inv_dz2) {
+    typedef Stencil<ORDER> S;
+    const float *center = l.center();
+    float lx = S::LAPLACIAN[0]*center[j];
+    float ly = lx, lz = lx;
+    for (int k = 1; k <= S::RADIUS; k++) {
+        lx += S::LAPLACIAN[k]*(center[(j + k) % width]
+                               + center[(j - k + width) % width]);
+        ly += S::LAPLACIAN[k]*(l.y[S::RADIUS + k][j]
+                               + l.y[S::RADIUS - k][j]);
+        lz += S::LAPLACIAN[k]*(l.z[S::RADIUS + k][j]
+                               + l.z[S::RADIUS - k][j]);
+    }
+    return inv_dx2*lx + inv_dy2*ly + inv_dz2*lz;
+}
+
+#ifdef __SSE2__
+/* Laplacian at columns j to j + 3, which must all be
+at least RADIUS columns away from the edges.*/
+template <int ORDER>
+static inline __m128 laplacian4(
+    const StencilLines<ORDER> &l, int j,
+    __m128 inv_dx2, __m128 inv_dy2, __m128 inv_dz2) {
+    typedef Stencil<ORDER> S;
+    const float *center = l.center();
+    __m128 c = _mm_set1_ps(S::LAPLACIAN[0]);
+    __m128 lx = _mm_mul_ps(c, _mm_loadu_ps(center + j));
+    __m128 ly = lx, lz = lx;
+    for (int k = 1; k <= S::RADIUS; k++) {
+        c = _mm_set1_ps(S::LAPLACIAN[k]);
+        lx = _mm_add_ps(lx, _mm_mul_ps(c, _mm_add_ps(
+            _mm_loadu_ps(center + j + k), _mm_loadu_ps(center + j - k))));
+        ly = _mm_add_ps(ly, _mm_mul_ps(c, _mm_add_ps(
+            _mm_loadu_ps(l.y[S::RADIUS + k] + j),
+            _mm_loadu_ps(l.y[S::RADIUS - k] + j))));
+        lz = _mm_add_ps(lz, _mm_mul_ps(c, _mm_add_ps(
+            _mm_loadu_ps(l.z[S::RADIUS + k] + j),
+            _mm_loadu_ps(l.z[S::RADIUS - k] + j))));
+    }
+    return _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(inv_dx2, lx), _mm_mul_ps(inv_dy2, ly)),
+        _mm_mul_ps(inv_dz2, lz));
+}
+#endif
+
+template <int ORDER>
+static void leapfrog_time_step(
+    ComplexField3D &psi2,
+    const ComplexField3D &psi0, const ComplexField3D &psi1,
+    const ComplexField3D &potential, const Leapfrog3DParams &params,
+    ThreadPool &pool) {
+    constexpr int RADIUS = Stencil<ORDER>::RADIUS;
+    int width = psi1.width, height = psi1.height, length = psi1.length;
+    // The same as for the 2D step in cpu_wave_function.cpp, with
+    // s = dt/hbar, k = -hbar^2/(2m), and L the Laplacian,
+    // Re(psi2) = Re(psi0) + s(k Im(L psi1) + Re(V) Im(psi1) + Im(V) Re(psi0))
+    // Im(psi2) = Im(psi0) + s(Im(V) Im(psi0) - k Re(L psi1) - Re(V) Re(psi1))
+    float s = params.dt/params.hbar;
+    float k = -params.hbar*params.hbar/(2.0F*params.m);
+    float inv_dx2 = 1.0F/(params.dx*params.dx);
+    float inv_dy2 = 1.0F/(params.dy*params.dy);
+    float inv_dz2 = 1.0F/(params.dz*params.dz);
+    auto step_row = [&](int i, int slice) {
+        StencilLines<ORDER> l_re = get_stencil_lines<ORDER>(
+            &psi1.re[0], i, slice, width, height, length);
+        StencilLines<ORDER> l_im = get_stencil_lines<ORDER>(
+            &psi1.im[0], i, slice, width, height, length);
+        const float *psi1_re = l_re.center(), *psi1_im = l_im.center();
+        ptrdiff_t offset = ((ptrdiff_t)slice*height + i)*width;
+        const float *psi0_re = &psi0.re[offset], *psi0_im = &psi0.im[offset];
+        const float *v_re = &potential.re[offset];
+        const float *v_im = &potential.im[offset];
+        float *psi2_re = &psi2.re[offset], *psi2_im = &psi2.im[offset];
+        auto step_scalar = [&](int j) {
+            float lap_re = laplacian<ORDER>(
+                l_re, j, width, inv_dx2, inv_dy2, inv_dz2);
+            float lap_im = laplacian<ORDER>(
+                l_im, j, width, inv_dx2, inv_dy2, inv_dz2);
+            psi2_re[j] = psi0_re[j] + s*(k*lap_im + v_re[j]*psi1_im[j]
+                                         + v_im[j]*psi0_re[j]);
+            psi2_im[j] = psi0_im[j] + s*(v_im[j]*psi0_im[j] - k*lap_re
+                                         - v_re[j]*psi1_re[j]);
+        };
+        int j = 0;
+        for (; j < width && j < RADIUS; j++)
+            step_scalar(j);
+        #ifdef __SSE2__
+        __m128 s4 = _mm_set1_ps(s), k4 = _mm_set1_ps(k);
+        __m128 inv_dx2_4 = _mm_set1_ps(inv_dx2);
+        __m128 inv_dy2_4 = _mm_set1_ps(inv_dy2);
+        __m128 inv_dz2_4 = _mm_set1_ps(inv_dz2);
+        for (; j + 4 <= width - RADIUS; j += 4) {
+            __m128 lap_re = laplacian4<ORDER>(
+                l_re, j, inv_dx2_4, inv_dy2_4, inv_dz2_4);
+            __m128 lap_im = laplacian4<ORDER>(
+                l_im, j, inv_dx2_4, inv_dy2_4, inv_dz2_4);
+            __m128 p0_re = _mm_loadu_ps(psi0_re + j);
+            __m128 p0_im = _mm_loadu_ps(psi0_im + j);
+            __m128 vr = _mm_loadu_ps(v_re + j);
+            __m128 vi = _mm_loadu_ps(v_im + j);
+            __m128 re = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(k4, lap_im),
+                           _mm_mul_ps(vr, _mm_loadu_ps(psi1_im + j))),
+                _mm_mul_ps(vi, p0_re));
+            __m128 im = _mm_sub_ps(
+                _mm_sub_ps(_mm_mul_ps(vi, p0_im), _mm_mul_ps(k4, lap_re)),
+                _mm_mul_ps(vr, _mm_loadu_ps(psi1_re + j)));
+            _mm_storeu_ps(psi2_re + j, _mm_add_ps(p0_re, _mm_mul_ps(s4, re)));
+            _mm_storeu_ps(psi2_im + j, _mm_add_ps(p0_im, _mm_mul_ps(s4, im)));
+        }
+        #endif
+        for (; j < width; j++)
+            step_scalar(j);
+    };
+    int tile_rows = (height + TILE_ROWS - 1)/TILE_ROWS;
+    int tile_slices = (length + TILE_SLICES - 1)/TILE_SLICES;
+    // Consecutive tiles are in the same slices, so that the
+    // threads that are given them share the slices in cache.
+    pool.parallel_for(0, tile_rows*tile_slices, [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            int i_begin = (t % tile_rows)*TILE_ROWS;
+            int k_begin = (t / tile_rows)*TILE_SLICES;
+            int i_end = (i_begin + TILE_ROWS < height)?
+                i_begin + TILE_ROWS: height;
+            int k_end = (k_begin + TILE_SLICES < length)?
+                k_begin + TILE_SLICES: length;
+            for (int slice = k_begin; slice < k_end; slice++)
+                for (int i = i_begin; i < i_end; i++)
+                    step_row(i, slice);
+        }
+    });
+}
+
+void leapfrog_time_step(
+    ComplexField3D &psi2,
+    const ComplexField3D &psi0, const ComplexField3D &psi1,
+    const ComplexField3D &potential, const Leapfrog3DParams &params,
+    ThreadPool &pool) {
+    psi2.resize(psi1.width, psi1.height, psi1.length);
+    switch (params.stencil_order) {
+        case 2:
+        leapfrog_time_step<2>(psi2, psi0, psi1, potential, params, pool);
+        break;
+        case 6:
+        leapfrog_time_step<6>(psi2, psi0, psi1, potential, params, pool);
+        break;
+        default:
+        leapfrog_time_step<4>(psi2, psi0, psi1, potential, params, pool);
+    }
+}
+
+void Particles3D::resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+}
+
+int Particles3D::count() const {
+    return x.size();
+}
+
+void Particles3D::from_interleaved(const float *arr, ThreadPool &pool) {
+    pool.parallel_for(0, this->count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            x[n] = arr[4*n];
+            y[n] = arr[4*n + 1];
+            z[n] = arr[4*n + 2];
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+void Particles3D::to_interleaved(float *arr, ThreadPool &pool) const {
+    pool.parallel_for(0, this->count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            arr[4*n] = x[n];
+            arr[4*n + 1] = y[n];
+            arr[4*n + 2] = z[n];
+            arr[4*n + 3] = 0.0F;
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+static inline int wrap(int i, int n) {
+    i %= n;
+    return (i < 0)? i + n: i;
+}
+
+/* Value of the wave function and its gradient at a single texel,
+as {psi, d/dx psi, d/dy psi, d/dz psi}.*/
+template <int ORDER>
+static inline void texel_gradient(
+    const ComplexField3D &psi, const int index[3], const float inv_d[3],
+    float re[4], float im[4]) {
+    typedef Stencil<ORDER> S;
+    int dims[3] = {psi.width, psi.height, psi.length};
+    auto at = [&](int x, int y, int z) -> size_t {
+        return ((size_t)z*psi.height + y)*psi.width + x;
+    };
+    size_t center = at(index[0], index[1], index[2]);
+    re[0] = psi.re[center];
+    im[0] = psi.im[center];
+    for (int d = 0; d < 3; d++) {
+        float dre = 0.0F, dim = 0.0F;
+        for (int k = 1; k <= S::RADIUS; k++) {
+            int forward[3] = {index[0], index[1], index[2]};
+            int backward[3] = {index[0], index[1], index[2]};
+            forward[d] = wrap(index[d] + k, dims[d]);
+            backward[d] = wrap(index[d] - k, dims[d]);
+            size_t f = at(forward[0], forward[1], forward[2]);
+            size_t b = at(backward[0], backward[1], backward[2]);
+            dre += S::GRADIENT[k]*(psi.re[f] - psi.re[b]);
+            dim += S::GRADIENT[k]*(psi.im[f] - psi.im[b]);
+        }
+        re[d + 1] = dre*inv_d[d];
+        im[d + 1] = dim*inv_d[d];
+    }
+}
+
+/* Velocities of the particles at q + dt q_dot, or at q
+if q_dot is NULL.*/
+template <int ORDER>
+static void guide_velocities(
+    Particles3D &velocities,
+    const ComplexField3D &psi, const Particles3D &q,
+    float dt, const Particles3D *q_dot,
+    const Guide3DParams &params, ThreadPool &pool) {
+    int dims[3] = {psi.width, psi.height, psi.length};
+    float sizes[3] = {params.width, params.height, params.length};
+    float inv_d[3];
+    for (int d = 0; d < 3; d++)
+        inv_d[d] = dims[d]/sizes[d];
+    float *out[3] = {&velocities.x[0], &velocities.y[0], &velocities.z[0]};
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            float r[3] = {q.x[n], q.y[n], q.z[n]};
+            if (q_dot != NULL) {
+                r[0] += dt*q_dot->x[n];
+                r[1] += dt*q_dot->y[n];
+                r[2] += dt*q_dot->z[n];
+            }
+            // Texel centers are at (i + 1/2) grid spacings, as they
+            // are for texture coordinates.
+            int i0[3];
+            float a[3];
+            for (int d = 0; d < 3; d++) {
+                float g = r[d]*inv_d[d] - 0.5F;
+                float g0 = floorf(g);
+                a[d] = g - g0;
+                i0[d] = wrap((int)g0, dims[d]);
+            }
+            float re[4] = {0.0F}, im[4] = {0.0F};
+            for (int corner = 0; corner < 8; corner++) {
+                int index[3];
+                float w = 1.0F;
+                for (int d = 0; d < 3; d++) {
+                    int b = (corner >> d) & 1;
+                    index[d] = (b)? wrap(i0[d] + 1, dims[d]): i0[d];
+                    w *= (b)? a[d]: 1.0F - a[d];
+                }
+                float c_re[4], c_im[4];
+                texel_gradient<ORDER>(psi, index, inv_d, c_re, c_im);
+                for (int p = 0; p < 4; p++) {
+                    re[p] += w*c_re[p];
+                    im[p] += w*c_im[p];
+                }
+            }
+            // Im(grad psi/psi) = Im(grad psi conj(psi))/|psi|^2,
+            // which is left at zero at the nodes of psi.
+            float abs2 = re[0]*re[0] + im[0]*im[0];
+            float c = (abs2 > 0.0F)? params.hbar/(params.m*abs2): 0.0F;
+            for (int d = 0; d < 3; d++)
+                out[d][n] = c*(im[d + 1]*re[0] - re[d + 1]*im[0]);
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
+
+static void guide_velocities(
+    Particles3D &velocities,
+    const ComplexField3D &psi, const Particles3D &q,
+    float dt, const Particles3D *q_dot,
+    const Guide3DParams &params, ThreadPool &pool) {
+    velocities.resize(q.count());
+    switch (params.stencil_order) {
+        case 2:
+        guide_velocities<2>(velocities, psi, q, dt, q_dot, params, pool);
+        break;
+        case 6:
+        guide_velocities<6>(velocities, psi, q, dt, q_dot, params, pool);
+        break;
+        default:
+        guide_velocities<4>(velocities, psi, q, dt, q_dot, params, pool);
+    }
+}
+
+/* Same as enforcePeriodicity in shaders/integration/rk4.frag. */
+static inline float enforce_periodicity(float x, float size) {
+    x = (x <= 0.0F)? size + x: x;
+    return (x > size)? fmodf(x, size): x;
+}
+
+void ParticleGuide3D::rk4_step(
+    Particles3D &q,
+    const ComplexField3D &psi0, const ComplexField3D &psi1,
+    const ComplexField3D &psi2,
+    const Guide3DParams &params, float dt, ThreadPool &pool) {
+    Particles3D *k = m_stages;
+    guide_velocities(k[0], psi0, q, 0.0F, NULL, params, pool);
+    guide_velocities(k[1], psi1, q, dt/2.0F, &k[0], params, pool);
+    guide_velocities(k[2], psi1, q, dt/2.0F, &k[1], params, pool);
+    guide_velocities(k[3], psi2, q, dt, &k[2], params, pool);
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            q.x[n] = enforce_periodicity(q.x[n] + dt*(
+                k[0].x[n] + 2.0F*k[1].x[n] + 2.0F*k[2].x[n] + k[3].x[n])
+                /6.0F, params.width);
+            q.y[n] = enforce_periodicity(q.y[n] + dt*(
+                k[0].y[n] + 2.0F*k[1].y[n] + 2.0F*k[2].y[n] + k[3].y[n])
+                /6.0F, params.height);
+            q.z[n] = enforce_periodicity(q.z[n] + dt*(
+                k[0].z[n] + 2.0F*k[1].z[n] + 2.0F*k[2].z[n] + k[3].z[n])
+                /6.0F, params.length);
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+}
@@ -0,0 +1,91 @@
+#include "thread_pool.hpp"
+#include "stencils.hpp"
+#include <vector>
+
+#ifndef _CPU_WAVE_FUNCTION_3D_
+#define _CPU_WAVE_FUNCTION_3D_
+
+/* Complex valued field on a periodic 3D grid, where the real and
+imaginary parts are kept in separate arrays. Each array is stored
+row by row and then slice by slice, so that the texel at (x, y, z)
+is at (z*height + y)*width + x.
+
+On the GPU the same field is kept in a 2D texture, where the slices
+are laid out as tiles, tiles_across to a row of tiles (see
+get_2d_from_3d_dimensions). from_tiled and to_tiled convert
+between the two.*/
+struct ComplexField3D {
+    int width, height, length;
+    std::vector<float> re, im;
+    ComplexField3D();
+    void resize(int width, int height, int length);
+    void from_tiled(const float *arr, int tiles_across, ThreadPool &pool);
+    void to_tiled(float *arr, int tiles_across, ThreadPool &pool) const;
+};
+
+/* Parameters of the 3D leapfrog time step, which are the same as
+the uniforms of shaders/wave-function-3d/time-step.frag, along with
+the order of the Laplacian (2, 4, or 6). */
+struct Leapfrog3DParams {
+    float m, hbar, dt;
+    float dx, dy, dz;
+    int stencil_order;
+};
+
+/* Do the same time step as shaders/wave-function-3d/time-step.frag on
+the CPU, where psi2 = psi0 - i dt/hbar (H psi1 + i Im(V) psi0), using a
+Laplacian of the given order with periodic boundaries.
+
+The grid is split into tiles of a few rows by a few slices, which
+are divided among the threads of the pool. Each thread goes through
+the slices of its tile in order, so that the neighbouring slices
+of psi1 that the stencil reads stay in cache.*/
+void leapfrog_time_step(
+    ComplexField3D &psi2,
+    const ComplexField3D &psi0, const ComplexField3D &psi1,
+    const ComplexField3D &potential, const Leapfrog3DParams &params,
+    ThreadPool &pool);
+
+/* Positions of particles, with each coordinate in its own array. */
+struct Particles3D {
+    std::vector<float> x, y, z;
+    void resize(int count);
+    int count() const;
+    // Four floats per particle, in the same order
+    // as the texels of an RGBA texture.
+    void from_interleaved(const float *arr, ThreadPool &pool);
+    void to_interleaved(float *arr, ThreadPool &pool) const;
+};
+
+/* Parameters of the particle guide, which are the same as the
+uniforms of shaders/particles-3d/guide.frag. */
+struct Guide3DParams {
+    float m, hbar;
+    // Simulation dimensions.
+    float width, height, length;
+    int stencil_order;
+};
+
+/*
+Move particles with the guiding equation
+
+    dq/dt = (hbar/m) Im(grad psi / psi),
+
+in the same way as the particles-3d/guide.frag and integration/rk4.frag
+shaders do. The wave function and its gradient are found at the corners
+of the cell that each particle is in, and are then interpolated
+trilinearly to the particle's position.
+*/
+class ParticleGuide3D {
+    Particles3D m_stages[4];
+    public:
+    /* Take an RK4 step of size dt, where psi0, psi1, and psi2 are the
+    wave function at the start, middle, and end of the step. Positions
+    are then wrapped around the simulation dimensions.*/
+    void rk4_step(Particles3D &q,
+                  const ComplexField3D &psi0, const ComplexField3D &psi1,
+                  const ComplexField3D &psi2,
+                  const Guide3DParams &params, float dt, ThreadPool &pool);
+};
+
+#endif
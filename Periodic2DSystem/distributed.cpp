@@ -0,0 +1,307 @@
+/* Run the leapfrog time steps of a grid that is too large for the GUI,
+across several processes with SlabDecomposition, without any window
+or GPU. The run starts either from a new wave packet, in the same way
+as the GUI places one, or from a checkpoint saved by the GUI whose
+particles are not weighted, and the final state is saved as a
+checkpoint.
+
+Build with make distributed, and run as, for example,
+
+    ./distributed --ranks 8 --size 8192 8192 --steps 1000
+
+The options, and their defaults, are
+
+    --ranks 4              Number of processes.
+    --threads 1            Number of threads for each process.
+    --size 4096 4096       Discretization dimensions.
+    --simulation-size W H  Simulation dimensions, which are the
+                           discretization dimensions by default.
+    --steps 1000           Number of time steps.
+    --dt 0.1, --hbar 1.0, --m 1.0
+    --order 4              Order of the Laplacian (2, 4, or 6).
+    --particles 65536      Number of particles for a new wave packet.
+    --restart <file>       Checkpoint to start from, which also sets
+                           the dimensions, dt, hbar, m, and particles.
+    --output pilot2d_distributed.checkpoint
+*/
+#include "slab_decomposition.hpp"
+#include "checkpoint.hpp"
+#include "metropolis.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <stdio.h>
+
+/* Same as the new wave packet of shaders/wave-function/gaussian.frag,
+with its nearest periodic images, at texture coordinates (u, v).*/
+struct WavePacket {
+    float u0, v0, sigma;
+    float nx, ny;
+};
+
+static void wave_packet(const WavePacket &w, double u, double v,
+                        float &re, float &im) {
+    re = im = 0.0F;
+    double offsets[5][2] = {{0.0, 0.0}, {1.0, 0.0}, {-1.0, 0.0},
+                            {0.0, 1.0}, {0.0, -1.0}};
+    for (auto &offset: offsets) {
+        double x = u - w.u0 + offset[0], y = v - w.v0 + offset[1];
+        double norm = sqrt(w.sigma*sqrt(2.0*M_PI));
+        double g = exp(-0.25*(x*x + y*y)/(w.sigma*w.sigma))/(norm*norm);
+        double phase = 2.0*M_PI*(w.nx*x + w.ny*y);
+        re += g*cos(phase);
+        im += g*sin(phase);
+    }
+}
+
+struct Gaussian2DParams {
+    double u0, v0, sigma;
+};
+
+static double gaussian(const std::vector<double> &r, void *void_params) {
+    Gaussian2DParams *params = (Gaussian2DParams *)void_params;
+    double gx = exp(-0.5*pow((r[0] - params->u0)/params->sigma, 2.0));
+    double gy = exp(-0.5*pow((r[1] - params->v0)/params->sigma, 2.0));
+    return gx*gy;
+}
+
+/* Largest side of the particle texture of a checkpoint, which is the
+smallest that GL_MAX_TEXTURE_SIZE can be, so that any GPU can load it.*/
+#define MAX_PARTICLES_TEXTURE_SIZE 1024
+
+/* Dimensions of a texture with n texels that is as close to square as
+possible. If the closest factorization of n is too wide for a texture,
+as it is when n is prime, the texture has the fewest rows of width
+ceil(sqrt(n)) that n fits in instead, so it has more than n texels.
+Returns false if n does not fit in any texture.*/
+static bool decompose(int n, int &width, int &height) {
+    int i = 1;
+    for (; i*i < n; i++) {}
+    int side = i;
+    for (; n % i; i--) {}
+    width = (n/i > i)? n/i: i;
+    height = n/width;
+    if (width > MAX_PARTICLES_TEXTURE_SIZE) {
+        width = side;
+        height = (n + side - 1)/side;
+    }
+    return width <= MAX_PARTICLES_TEXTURE_SIZE
+        && height <= MAX_PARTICLES_TEXTURE_SIZE;
+}
+
+int main(int argc, char **argv) {
+    SlabParams params = {
+        .width=4096, .height=4096,
+        .simulation_width=0.0F, .simulation_height=0.0F,
+        .m=1.0F, .hbar=1.0F, .dt=0.1F,
+        .stencil_order=4,
+        .rank_count=4, .threads_per_rank=1,
+        .particle_capacity=0,
+        .initial_step_count=0,
+    };
+    int step_count = 1000, particle_count = 65536;
+    std::string restart_fname;
+    std::string output_fname = "pilot2d_distributed.checkpoint";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_one = i + 1 < argc, has_two = i + 2 < argc;
+        if (arg == "--ranks" && has_one) {
+            params.rank_count = atoi(argv[++i]);
+        } else if (arg == "--threads" && has_one) {
+            params.threads_per_rank = atoi(argv[++i]);
+        } else if (arg == "--size" && has_two) {
+            params.width = atoi(argv[++i]);
+            params.height = atoi(argv[++i]);
+        } else if (arg == "--simulation-size" && has_two) {
+            params.simulation_width = atof(argv[++i]);
+            params.simulation_height = atof(argv[++i]);
+        } else if (arg == "--steps" && has_one) {
+            step_count = atoi(argv[++i]);
+        } else if (arg == "--dt" && has_one) {
+            params.dt = atof(argv[++i]);
+        } else if (arg == "--hbar" && has_one) {
+            params.hbar = atof(argv[++i]);
+        } else if (arg == "--m" && has_one) {
+            params.m = atof(argv[++i]);
+        } else if (arg == "--order" && has_one) {
+            params.stencil_order = atoi(argv[++i]);
+        } else if (arg == "--particles" && has_one) {
+            particle_count = atoi(argv[++i]);
+        } else if (arg == "--restart" && has_one) {
+            restart_fname = argv[++i];
+        } else if (arg == "--output" && has_one) {
+            output_fname = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown or incomplete option %s.\n",
+                    arg.c_str());
+            return 1;
+        }
+    }
+    // A checkpoint without particles cannot be loaded again.
+    if (particle_count < 1) {
+        fprintf(stderr, "There must be at least one particle.\n");
+        return 1;
+    }
+    if (particle_count > MAX_PARTICLES_TEXTURE_SIZE
+        *MAX_PARTICLES_TEXTURE_SIZE) {
+        fprintf(stderr, "There can be at most %d particles.\n",
+                MAX_PARTICLES_TEXTURE_SIZE*MAX_PARTICLES_TEXTURE_SIZE);
+        return 1;
+    }
+    // The checkpoint is mapped before forking, so that
+    // every rank reads the same pages.
+    MappedCheckpoint checkpoint;
+    std::vector<float> particles;
+    double t = 0.0;
+    int initial_step_count = 0;
+    if (!restart_fname.empty()) {
+        if (!checkpoint.open(restart_fname))
+            return 1;
+        const CheckpointHeader &h = checkpoint.header();
+        // The ranks only exchange the positions of particles.
+        if (h.weighted_particles) {
+            fprintf(stderr, "%s has weighted particles, which cannot be "
+                    "moved between ranks.\n", restart_fname.c_str());
+            return 1;
+        }
+        params.width = h.width;
+        params.height = h.height;
+        params.simulation_width = h.simulation_width;
+        params.simulation_height = h.simulation_height;
+        params.dt = h.dt;
+        params.hbar = h.hbar;
+        params.m = h.m;
+        t = h.t;
+        initial_step_count = h.time_step_count;
+        const float *q = checkpoint.array(CHECKPOINT_PARTICLES);
+        particles.assign(
+            q, q + checkpoint_array_length(h, CHECKPOINT_PARTICLES));
+    }
+    if (params.simulation_width <= 0.0F || params.simulation_height <= 0.0F) {
+        params.simulation_width = params.width;
+        params.simulation_height = params.height;
+    }
+    WavePacket packet = {.u0=0.25F, .v0=0.25F, .sigma=0.025F,
+                         .nx=10.0F, .ny=10.0F};
+    if (restart_fname.empty()) {
+        Gaussian2DParams gaussian_params = {
+            .u0=packet.u0, .v0=packet.v0, .sigma=packet.sigma};
+        std::vector<double> configs(2*particle_count, 0.0);
+        metropolis(configs, {packet.u0, packet.v0},
+                   {1.5*packet.sigma, 1.5*packet.sigma},
+                   gaussian, particle_count, (void *)&gaussian_params);
+        particles.resize(2*particle_count);
+        for (int k = 0; k < particle_count; k++) {
+            particles[2*k] = configs[2*k]*params.simulation_width;
+            particles[2*k + 1] = configs[2*k + 1]*params.simulation_height;
+            for (int d = 0; d < 2; d++) {
+                float size = (d == 0)?
+                    params.simulation_width: params.simulation_height;
+                particles[2*k + d] = fmod(particles[2*k + d], size);
+                if (particles[2*k + d] < 0.0F)
+                    particles[2*k + d] += size;
+            }
+        }
+    }
+    params.particle_capacity = particles.size()/2;
+    // A checkpoint from the GUI may be at the very first step,
+    // where psi1 has not yet been found from psi0.
+    bool start_with_half_step = initial_step_count == 0;
+    params.initial_step_count = initial_step_count;
+    SlabInitializer initializer = [&](int row, ComplexRows &psi0,
+                                      ComplexRows &psi1,
+                                      ComplexRows &potential) {
+        int width = params.width;
+        if (!restart_fname.empty()) {
+            size_t offset = (size_t)width*row;
+            const float *arrays[3] = {
+                checkpoint.array(CHECKPOINT_PSI0) + 2*offset,
+                checkpoint.array(CHECKPOINT_PSI1) + 2*offset,
+                checkpoint.array(CHECKPOINT_POTENTIAL) + 2*offset};
+            ComplexRows *destinations[3] = {&psi0, &psi1, &potential};
+            for (int k = 0; k < 3; k++) {
+                for (int j = 0; j < width; j++) {
+                    destinations[k]->re[j] = arrays[k][2*j];
+                    destinations[k]->im[j] = arrays[k][2*j + 1];
+                }
+            }
+            return;
+        }
+        double v = (row + 0.5)/params.height;
+        for (int j = 0; j < width; j++) {
+            wave_packet(packet, (j + 0.5)/width, v, psi0.re[j], psi0.im[j]);
+            psi1.re[j] = psi0.re[j];
+            psi1.im[j] = psi0.im[j];
+            potential.re[j] = potential.im[j] = 0.0F;
+        }
+    };
+    SlabDecomposition slabs(params);
+    if (!slabs.is_valid())
+        return 1;
+    printf("%d x %d grid, %d ranks with %d threads each, %d steps\n",
+           params.width, params.height, params.rank_count,
+           params.threads_per_rank, step_count);
+    auto start = std::chrono::steady_clock::now();
+    int previous = 0, current = 1;
+    if (!slabs.run(step_count, start_with_half_step, initializer,
+                   particles, previous, current))
+        return 1;
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    printf("%g s, %g steps/s, %zu particles\n", elapsed.count(),
+           step_count/elapsed.count(), particles.size()/2);
+    CheckpointHeader header = make_checkpoint_header();
+    header.width = params.width;
+    header.height = params.height;
+    if (particles.empty()
+        || !decompose(particles.size()/2,
+                      header.particles_width, header.particles_height)) {
+        fprintf(stderr, "%zu particles cannot be saved in a checkpoint.\n",
+                particles.size()/2);
+        return 1;
+    }
+    // The rest of the texture is filled with copies of the last particle.
+    size_t texel_count
+        = (size_t)header.particles_width*header.particles_height;
+    for (size_t k = particles.size()/2; k < texel_count; k++) {
+        float x = particles[particles.size() - 2];
+        float y = particles[particles.size() - 1];
+        particles.push_back(x);
+        particles.push_back(y);
+    }
+    header.simulation_width = params.simulation_width;
+    header.simulation_height = params.simulation_height;
+    header.dt = params.dt;
+    header.hbar = params.hbar;
+    header.m = params.m;
+    header.time_step_count = initial_step_count + step_count
+        + (start_with_half_step? 1: 0);
+    // Each leapfrog step moves psi forward by dt/2,
+    // as does the initial half step.
+    header.t = t + (step_count + (start_with_half_step? 1: 0))*params.dt/2.0;
+    CheckpointWriter writer;
+    writer.begin(header);
+    // psi2 is only written to by the next step, so it is saved as
+    // another copy of the current wave function.
+    int arrays[4] = {previous, current, current,
+                     SlabDecomposition::POTENTIAL};
+    for (int k = 0; k < 4; k++) {
+        float *arr = writer.array(k);
+        for (int rank = 0; rank < params.rank_count; rank++) {
+            ComplexRows f = slabs.field(rank, arrays[k]);
+            size_t offset = (size_t)params.width*slabs.row_begin(rank);
+            for (size_t n = 0; n < (size_t)f.width*f.height; n++) {
+                arr[2*(offset + n)] = f.re[n];
+                arr[2*(offset + n) + 1] = f.im[n];
+            }
+        }
+    }
+    if (!particles.empty())
+        memcpy(writer.array(CHECKPOINT_PARTICLES), &particles[0],
+               sizeof(float)*particles.size());
+    writer.write(output_fname);
+    writer.wait();
+    return 0;
+}
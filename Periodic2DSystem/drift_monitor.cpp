@@ -0,0 +1,155 @@
+#include "drift_monitor.hpp"
+#include <cmath>
+#include <vector>
+
+/* Smallest number of rows that are given to a thread at a time. */
+#define MIN_ROWS_PER_CHUNK 8
+
+struct RowSums {
+    double norm, kinetic, potential;
+    double max_abs2;
+};
+
+/* Sums over a single row of |psi|^2, Re(conj(psi) L psi), and
+Re(V)|psi|^2, where L is the Laplacian times dx^2 dy^2.*/
+template <int ORDER>
+static RowSums sum_row(const ComplexField &psi,
+                       const ComplexField &potential,
+                       int i, float dx2, float dy2) {
+    typedef Stencil<ORDER> S;
+    int width = psi.width, height = psi.height;
+    const float *rows_re[2*S::RADIUS + 1], *rows_im[2*S::RADIUS + 1];
+    for (int k = -S::RADIUS; k <= S::RADIUS; k++) {
+        int offset = width*((i + k + height) % height);
+        rows_re[S::RADIUS + k] = &psi.re[offset];
+        rows_im[S::RADIUS + k] = &psi.im[offset];
+    }
+    const float *re = rows_re[S::RADIUS], *im = rows_im[S::RADIUS];
+    const float *v = &potential.re[width*i];
+    RowSums sums = {0.0, 0.0, 0.0, 0.0};
+    for (int j = 0; j < width; j++) {
+        double lx_re = S::LAPLACIAN[0]*re[j], lx_im = S::LAPLACIAN[0]*im[j];
+        double ly_re = lx_re, ly_im = lx_im;
+        for (int k = 1; k <= S::RADIUS; k++) {
+            int right = (j + k) % width, left = (j - k + width) % width;
+            lx_re += S::LAPLACIAN[k]*(re[right] + re[left]);
+            lx_im += S::LAPLACIAN[k]*(im[right] + im[left]);
+            ly_re += S::LAPLACIAN[k]*(rows_re[S::RADIUS + k][j]
+                                      + rows_re[S::RADIUS - k][j]);
+            ly_im += S::LAPLACIAN[k]*(rows_im[S::RADIUS + k][j]
+                                      + rows_im[S::RADIUS - k][j]);
+        }
+        double lap_re = dy2*lx_re + dx2*ly_re;
+        double lap_im = dy2*lx_im + dx2*ly_im;
+        double abs2 = double(re[j])*re[j] + double(im[j])*im[j];
+        sums.norm += abs2;
+        sums.kinetic += re[j]*lap_re + im[j]*lap_im;
+        sums.potential += v[j]*abs2;
+        if (abs2 > sums.max_abs2)
+            sums.max_abs2 = abs2;
+    }
+    return sums;
+}
+
+template <int ORDER>
+static WaveFunctionMeasures measure(
+    const ComplexField &psi, const ComplexField &potential,
+    const MeasureParams &params, ThreadPool &pool) {
+    double dx2 = params.dx*params.dx, dy2 = params.dy*params.dy;
+    std::vector<RowSums> row_sums(psi.height);
+    pool.parallel_for(0, psi.height, [&](int row_begin, int row_end) {
+        for (int i = row_begin; i < row_end; i++)
+            row_sums[i] = sum_row<ORDER>(psi, potential, i, dx2, dy2);
+    }, MIN_ROWS_PER_CHUNK);
+    RowSums total = {0.0, 0.0, 0.0, 0.0};
+    for (const RowSums &s: row_sums) {
+        total.norm += s.norm;
+        total.kinetic += s.kinetic;
+        total.potential += s.potential;
+        if (!(s.max_abs2 <= total.max_abs2))
+            total.max_abs2 = s.max_abs2;
+    }
+    double kinetic = -params.hbar*params.hbar/(2.0*params.m)
+        *total.kinetic/(dx2*dy2);
+    return {
+        .norm=total.norm*params.dx*params.dy,
+        .energy=(kinetic + total.potential)/total.norm,
+        .max_abs=sqrt(total.max_abs2),
+    };
+}
+
+WaveFunctionMeasures measure_wave_function(
+    const ComplexField &psi, const ComplexField &potential,
+    const MeasureParams &params, ThreadPool &pool) {
+    switch (params.stencil_order) {
+        case 2:
+        return measure<2>(psi, potential, params, pool);
+        case 6:
+        return measure<6>(psi, potential, params, pool);
+        default:
+        return measure<4>(psi, potential, params, pool);
+    }
+}
+
+DriftMonitor::DriftMonitor(): m_log(NULL),
+    m_has_reference(false), m_potential_changed(false) {}
+
+bool DriftMonitor::open_log(const std::string &fname) {
+    this->close_log();
+    m_log = fopen(fname.c_str(), "w");
+    if (m_log == NULL) {
+        fprintf(stderr, "Unable to open %s.\n", fname.c_str());
+        return false;
+    }
+    fprintf(m_log, "step,t,dt,norm,energy,max_abs,"
+            "norm_drift,energy_drift\n");
+    return true;
+}
+
+void DriftMonitor::close_log() {
+    if (m_log != NULL)
+        fclose(m_log);
+    m_log = NULL;
+}
+
+void DriftMonitor::reset() {
+    m_has_reference = false;
+    m_potential_changed = false;
+}
+
+void DriftMonitor::set_potential_changed() {
+    m_potential_changed = true;
+}
+
+static double relative_drift(double value, double reference) {
+    if (!std::isfinite(value))
+        return INFINITY;
+    double scale = fabs(reference);
+    return (scale > 0.0)? fabs(value - reference)/scale: fabs(value);
+}
+
+double DriftMonitor::record(int step, double t, double dt,
+                            const WaveFunctionMeasures &measures) {
+    if (!m_has_reference) {
+        m_reference = measures;
+        m_has_reference = true;
+    } else if (m_potential_changed) {
+        m_reference.energy = measures.energy;
+    }
+    m_potential_changed = false;
+    double norm_drift = relative_drift(measures.norm, m_reference.norm);
+    double energy_drift = relative_drift(measures.energy, m_reference.energy);
+    if (!std::isfinite(measures.max_abs))
+        norm_drift = INFINITY;
+    if (m_log != NULL) {
+        fprintf(m_log, "%d,%g,%g,%.9g,%.9g,%.9g,%g,%g\n",
+                step, t, dt, measures.norm, measures.energy,
+                measures.max_abs, norm_drift, energy_drift);
+        fflush(m_log);
+    }
+    return (norm_drift > energy_drift)? norm_drift: energy_drift;
+}
+
+DriftMonitor::~DriftMonitor() {
+    this->close_log();
+}
@@ -0,0 +1,65 @@
+#include "cpu_wave_function.hpp"
+#include <string>
+#include <stdio.h>
+
+#ifndef _DRIFT_MONITOR_
+#define _DRIFT_MONITOR_
+
+/* Quantities of the wave function that should stay constant
+for a closed system with a static potential. */
+struct WaveFunctionMeasures {
+    double norm;   // sum of |psi|^2 dx dy
+    double energy; // <psi|H|psi>/<psi|psi>, using only Re(V)
+    double max_abs;
+};
+
+struct MeasureParams {
+    float m, hbar;
+    float dx, dy;
+    int stencil_order;
+};
+
+/* Find the norm, energy, and largest magnitude of psi, where the
+Hamiltonian uses the same Laplacian as the leapfrog time step.
+Each thread reduces its own rows, and the partial sums of the rows
+are then added together in order, so the result does not depend
+on the number of threads.*/
+WaveFunctionMeasures measure_wave_function(
+    const ComplexField &psi, const ComplexField &potential,
+    const MeasureParams &params, ThreadPool &pool);
+
+/*
+Keep track of how far the norm and energy of the wave function have
+drifted from their values when monitoring started, and log every
+measurement as a line of comma separated values:
+
+    step, t, dt, norm, energy, max |psi|, norm drift, energy drift
+
+The drifts are relative, and a measurement with any value that is not
+finite, which is how an unstable run usually ends, has an infinite
+drift.
+
+The energy is only conserved for a static potential, so its
+reference value is retaken after the potential changes.
+*/
+class DriftMonitor {
+    FILE *m_log;
+    bool m_has_reference, m_potential_changed;
+    WaveFunctionMeasures m_reference;
+    DriftMonitor(const DriftMonitor &);
+    DriftMonitor& operator=(const DriftMonitor &);
+    public:
+    DriftMonitor();
+    bool open_log(const std::string &fname);
+    void close_log();
+    /* Take the reference values again from the next measurement. */
+    void reset();
+    void set_potential_changed();
+    /* Log a measurement, and return the larger of its norm and
+    energy drifts. The first measurement after a reset has no drift.*/
+    double record(int step, double t, double dt,
+                  const WaveFunctionMeasures &measures);
+    ~DriftMonitor();
+};
+
+#endif
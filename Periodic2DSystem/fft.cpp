@@ -0,0 +1,117 @@
+#include "fft.hpp"
+#include <cmath>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of columns that are copied out and transformed together,
+so that the copies read whole cache lines from each row. */
+#define COLUMN_BLOCK 16
+
+bool is_power_of_two(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+FFTPlan::FFTPlan(): size(0) {}
+
+FFTPlan::FFTPlan(int size): size(size),
+    bit_reversed(size), twiddle_re(size), twiddle_im(size) {
+    int bits = 0;
+    for (; (1 << bits) < size; bits++) {}
+    for (int i = 0; i < size; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        bit_reversed[i] = r;
+    }
+    // The stage whose butterflies are half_size apart
+    // starts at index half_size - 1.
+    for (int half_size = 1; half_size < size; half_size *= 2) {
+        for (int k = 0; k < half_size; k++) {
+            double angle = -M_PI*k/half_size;
+            twiddle_re[half_size - 1 + k] = cos(angle);
+            twiddle_im[half_size - 1 + k] = sin(angle);
+        }
+    }
+}
+
+void FFTPlan::execute(float *re, float *im, bool inverse) const {
+    for (int i = 0; i < size; i++) {
+        int j = bit_reversed[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    float sign = (inverse)? -1.0F: 1.0F;
+    for (int half_size = 1; half_size < size; half_size *= 2) {
+        const float *w_re = &twiddle_re[half_size - 1];
+        const float *w_im = &twiddle_im[half_size - 1];
+        for (int g = 0; g < size; g += 2*half_size) {
+            float *a_re = re + g, *a_im = im + g;
+            float *b_re = a_re + half_size, *b_im = a_im + half_size;
+            int k = 0;
+            #ifdef __SSE2__
+            __m128 sign4 = _mm_set1_ps(sign);
+            for (; k + 4 <= half_size; k += 4) {
+                __m128 wr = _mm_loadu_ps(w_re + k);
+                __m128 wi = _mm_mul_ps(sign4, _mm_loadu_ps(w_im + k));
+                __m128 br = _mm_loadu_ps(b_re + k);
+                __m128 bi = _mm_loadu_ps(b_im + k);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+                __m128 ar = _mm_loadu_ps(a_re + k);
+                __m128 ai = _mm_loadu_ps(a_im + k);
+                _mm_storeu_ps(b_re + k, _mm_sub_ps(ar, tr));
+                _mm_storeu_ps(b_im + k, _mm_sub_ps(ai, ti));
+                _mm_storeu_ps(a_re + k, _mm_add_ps(ar, tr));
+                _mm_storeu_ps(a_im + k, _mm_add_ps(ai, ti));
+            }
+            #endif
+            for (; k < half_size; k++) {
+                float wr = w_re[k], wi = sign*w_im[k];
+                float tr = wr*b_re[k] - wi*b_im[k];
+                float ti = wr*b_im[k] + wi*b_re[k];
+                b_re[k] = a_re[k] - tr;
+                b_im[k] = a_im[k] - ti;
+                a_re[k] += tr;
+                a_im[k] += ti;
+            }
+        }
+    }
+}
+
+void fft2d(ComplexField &field,
+           const FFTPlan &row_plan, const FFTPlan &column_plan,
+           bool inverse, ThreadPool &pool) {
+    int width = field.width, height = field.height;
+    pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+        for (int i = row_begin; i < row_end; i++)
+            row_plan.execute(
+                &field.re[width*i], &field.im[width*i], inverse);
+    });
+    int block_count = (width + COLUMN_BLOCK - 1)/COLUMN_BLOCK;
+    pool.parallel_for(0, block_count, [&](int block_begin, int block_end) {
+        std::vector<float> re(COLUMN_BLOCK*height), im(COLUMN_BLOCK*height);
+        for (int block = block_begin; block < block_end; block++) {
+            int j0 = block*COLUMN_BLOCK;
+            int n = (width - j0 < COLUMN_BLOCK)? width - j0: COLUMN_BLOCK;
+            for (int i = 0; i < height; i++) {
+                for (int c = 0; c < n; c++) {
+                    re[c*height + i] = field.re[width*i + j0 + c];
+                    im[c*height + i] = field.im[width*i + j0 + c];
+                }
+            }
+            for (int c = 0; c < n; c++)
+                column_plan.execute(&re[c*height], &im[c*height], inverse);
+            for (int i = 0; i < height; i++) {
+                for (int c = 0; c < n; c++) {
+                    field.re[width*i + j0 + c] = re[c*height + i];
+                    field.im[width*i + j0 + c] = im[c*height + i];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,29 @@
+#include "cpu_wave_function.hpp"
+#include <vector>
+
+#ifndef _FFT_
+#define _FFT_
+
+/* Precomputed tables for in place radix-2 FFTs of a single size,
+which must be a power of two.
+
+The twiddle factors of every stage are stored one stage after
+the other, so that each butterfly loop reads them contiguously.*/
+struct FFTPlan {
+    int size;
+    std::vector<int> bit_reversed;
+    std::vector<float> twiddle_re, twiddle_im;
+    FFTPlan();
+    FFTPlan(int size);
+    void execute(float *re, float *im, bool inverse) const;
+};
+
+bool is_power_of_two(int n);
+
+/* Unnormalized 2D FFT of a complex field, where the rows are done in
+parallel, followed by the columns in parallel blocks.*/
+void fft2d(ComplexField &field,
+           const FFTPlan &row_plan, const FFTPlan &column_plan,
+           bool inverse, ThreadPool &pool);
+
+#endif
@@ -0,0 +1,75 @@
+#include "gl_wrappers.hpp"
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#ifndef _FRAME_RECORDER_
+#define _FRAME_RECORDER_
+
+/* Function that encodes the pixels of a frame and writes them to a file.
+The pixels are stored row by row from the bottom of the frame,
+where the number of channels is pixels.size()/(width*height).
+The last argument is the encoder data given to the FrameRecorder.*/
+typedef void (*FrameEncoder)(
+    const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height, void *encoder_data);
+
+/*
+Record frames to image files without stalling the render loop.
+
+Pushing a frame only issues an asynchronous read of it into a pair of
+pixel buffer objects (see PixelReadback). Completed reads are placed in
+a bounded queue, which is emptied by a pool of threads that encode
+and write the images. If the encoders cannot keep up, frames
+are either dropped or the render loop is made to wait for them,
+depending on the policy given when pushing a frame.
+
+When compiling with Emscripten, frames are encoded as they are pushed.
+*/
+class FrameRecorder {
+    struct Frame {
+        std::string fname;
+        int width, height;
+        std::vector<uint8_t> pixels;
+    };
+    FrameEncoder m_encoder;
+    void *m_encoder_data;
+    PixelReadback m_readback;
+    std::deque<Frame> m_reads;
+    std::deque<Frame> m_queue;
+    size_t m_queue_capacity;
+    int m_dropped_count;
+    int m_busy_count;
+    bool m_stop;
+    #ifndef __EMSCRIPTEN__
+    std::vector<pthread_t> m_threads;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    static void *encode_loop(void *void_recorder);
+    #endif
+    void push_read(const std::string &fname,
+                   int width, int height, int policy);
+    void collect(bool wait, int policy);
+    void enqueue(Frame &frame, int policy);
+    FrameRecorder(const FrameRecorder &);
+    FrameRecorder& operator=(const FrameRecorder &);
+    public:
+    enum {DROP_FRAMES=0, WAIT_FOR_ENCODERS=1};
+    FrameRecorder(FrameEncoder encoder,
+                  int thread_count=4, int queue_capacity=8,
+                  void *encoder_data=NULL);
+    void push(const Quad &quad, const std::string &fname,
+              int policy=DROP_FRAMES);
+    void push(const RenderTarget &target, const std::string &fname,
+              int policy=DROP_FRAMES);
+    void finish();
+    void wait();
+    int dropped_count() const;
+    ~FrameRecorder();
+};
+
+#endif
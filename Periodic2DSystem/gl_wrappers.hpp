@@ -407,6 +407,7 @@ class WireFrame {
     uint32_t vbo;
     uint32_t ebo;
     int draw_type;
+    int instance_count;
     public:
     enum {
         TRIANGLES=0, LINES, POINTS
@@ -428,6 +429,9 @@ class WireFrame {
               const std::vector<int> &elements, 
               int draw_type=WireFrame::TRIANGLES);*/
     // std::vector<float> get_vertices();
+    /* Draw the wire frame this many times with each draw call,
+    where gl_InstanceID gives which time it is.*/
+    void set_instance_count(int count);
     void draw(uint32_t program);
     WireFrame(const WireFrame &w);
     WireFrame& operator=(const WireFrame &w);
@@ -445,6 +449,7 @@ class RenderTarget {
     void init_texture();
     void init_buffer();
     void adjust_viewport_before_drawing(const Config config);
+    friend class PixelReadback;
     public:
     RenderTarget(TextureParams const &);
     int get_id() const;
@@ -472,6 +477,7 @@ class Quad {
     void init(const TextureParams &);
     friend class MultidimensionalDataQuad;
     friend class MainQuad;
+    friend class PixelReadback;
     void substitute_array(void *array, IVec4 viewport);
     public:
     Quad(const TextureParams &);
@@ -516,6 +522,8 @@ class MultidimensionalDataQuad {
     IVec3 get_3d_dimensions() const;
     uint32_t format() const;
     void draw(uint32_t program, const Uniforms &uniforms);
+    void set_pixels(float *arr);
+    void fill_array_with_contents(float *arr) const;
     static uint32_t make_program_from_path(std::string);
     static uint32_t make_program_from_source(std::string);
 };
@@ -530,6 +538,53 @@ class MainQuad {
     void draw(const RenderTarget &);
 };
 
+/* Read back the contents of frames without stalling the render loop.
+
+Each read is issued into one of a ring of pixel buffer objects, followed
+by a fence. The buffer is only mapped to host memory once this fence
+has signalled that the GPU has finished the read, which is usually a
+frame or two later, so that glReadPixels returns immediately instead of
+waiting for all of the previously issued draw calls to finish. Reads are
+retrieved in the same order that they are requested.
+
+WebGL does not support mapping buffers, so when compiling with
+Emscripten reads are done synchronously when they are requested,
+and then kept until they are retrieved.
+*/
+class PixelReadback {
+    struct Read {
+        uint32_t pbo;
+        GLsync fence;
+        size_t size;
+        bool in_use;
+        int tag;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Read> m_reads;
+    size_t m_next_request;
+    size_t m_next_retrieve;
+    uint32_t m_pixel_type;
+    bool request(uint32_t fbo, bool is_default_fbo,
+                 const TextureParams &params, int tag);
+    template <typename T>
+    bool retrieve_as(std::vector<T> &data, int &tag, bool wait);
+    void release();
+    PixelReadback(const PixelReadback &);
+    PixelReadback& operator=(const PixelReadback &);
+    public:
+    // The pixel type is either GL_FLOAT or GL_UNSIGNED_BYTE.
+    PixelReadback(int buffer_count, uint32_t pixel_type);
+    void resize(int buffer_count);
+    int buffer_count() const;
+    int pending() const;
+    bool is_full() const;
+    bool request(const Quad &quad, int tag=0);
+    bool request(const RenderTarget &target, int tag=0);
+    bool retrieve(std::vector<float> &data, int &tag, bool wait=false);
+    bool retrieve(std::vector<uint8_t> &data, int &tag, bool wait=false);
+    ~PixelReadback();
+};
+
 IVec2 get_2d_from_3d_dimensions(const IVec3 &dimensions_3d);
 
 IVec2 get_2d_from_width_height_length(
@@ -72,8 +72,46 @@ void imgui_controls(void *void_params) {
            s_sim_params_set(params->WAVE_FUNC_SIZE, params->waveFuncSize);
     if (ImGui::SliderFloat("Mass", &params->m, 1.0, 5.0))
            s_sim_params_set(params->M, params->m);
-    if (ImGui::SliderFloat("Time step", &params->dt, 0.0, 0.3))
+    if (ImGui::SliderFloat("Time step (limited to 0.3 for the leapfrog steps, which are unstable above it)", &params->dt, 0.0, 3.0))
            s_sim_params_set(params->DT, params->dt);
+    if (ImGui::BeginMenu("Compute time steps on")) {
+        if (ImGui::MenuItem( "GPU"))
+            s_selection_set(params->TIME_STEP_BACKEND, 0);
+        if (ImGui::MenuItem( "CPU (multithreaded)"))
+            s_selection_set(params->TIME_STEP_BACKEND, 1);
+        if (ImGui::MenuItem( "CPU split-operator (FFT)"))
+            s_selection_set(params->TIME_STEP_BACKEND, 2);
+        if (ImGui::MenuItem( "CPU implicit ADI Crank-Nicolson (2nd order Laplacian only)"))
+            s_selection_set(params->TIME_STEP_BACKEND, 3);
+        if (ImGui::MenuItem( "GPU Chebyshev propagator"))
+            s_selection_set(params->TIME_STEP_BACKEND, 4);
+        ImGui::EndMenu();
+    }
+    if (ImGui::BeginMenu("Finite difference stencil order")) {
+        if (ImGui::MenuItem( "2nd order"))
+            s_selection_set(params->STENCIL_ORDER, 0);
+        if (ImGui::MenuItem( "4th order"))
+            s_selection_set(params->STENCIL_ORDER, 1);
+        if (ImGui::MenuItem( "6th order"))
+            s_selection_set(params->STENCIL_ORDER, 2);
+        ImGui::EndMenu();
+    }
+    if (ImGui::SliderInt("Chebyshev propagator accuracy (digits)", &params->chebyshevDigits, 2, 7))
+            s_sim_params_set(params->CHEBYSHEV_DIGITS, params->chebyshevDigits);
+    ImGui::Checkbox("Monitor norm and energy drift (logged to pilot2d_drift.csv)", &params->monitorDrift);
+    if (ImGui::SliderInt("Steps between drift checks", &params->driftCheckInterval, 1, 600))
+            s_sim_params_set(params->DRIFT_CHECK_INTERVAL, params->driftCheckInterval);
+    if (ImGui::SliderFloat("Relative drift threshold", &params->driftThreshold, 0.0001, 0.5))
+           s_sim_params_set(params->DRIFT_THRESHOLD, params->driftThreshold);
+    if (ImGui::BeginMenu("When the drift exceeds the threshold")) {
+        if (ImGui::MenuItem( "Only log it"))
+            s_selection_set(params->DRIFT_ACTION, 0);
+        if (ImGui::MenuItem( "Halve the time step"))
+            s_selection_set(params->DRIFT_ACTION, 1);
+        if (ImGui::MenuItem( "Stop the simulation"))
+            s_selection_set(params->DRIFT_ACTION, 2);
+        ImGui::EndMenu();
+    }
     if (ImGui::BeginMenu("Use mouse to:")) {
         if (ImGui::MenuItem( "Create new wave function"))
             s_selection_set(params->MOUSE_USAGE_ENTRY, 0);
@@ -85,9 +123,28 @@ void imgui_controls(void *void_params) {
     }
     if (ImGui::SliderInt("Particle count upon placement of new wave function", &params->numberOfParticles, 4096, 1048576))
             s_sim_params_set(params->NUMBER_OF_PARTICLES, params->numberOfParticles);
+    if (ImGui::BeginMenu("Place new particles with")) {
+        if (ImGui::MenuItem( "Random points"))
+            s_selection_set(params->PARTICLE_PLACEMENT, 0);
+        if (ImGui::MenuItem( "Quasi-random points (scrambled Sobol))
+            s_selection_set(params->PARTICLE_PLACEMENT, 1);
+        if (ImGui::MenuItem( smoother for fewer particles)"))
+            s_selection_set(params->PARTICLE_PLACEMENT, 2);
+        ImGui::EndMenu();
+    }
     ImGui::Checkbox("Show particle trails", &params->showTrails);
+    if (ImGui::SliderInt("Draw the particles as a density above this many particles", &params->particleDensityBudget, 4096, 1048576))
+            s_sim_params_set(params->PARTICLE_DENSITY_BUDGET, params->particleDensityBudget);
+    ImGui::Checkbox("Guide particles with a precomputed velocity field (faster, but less accurate near nodes)", &params->interpolateVelocityField);
+    ImGui::Checkbox("Substep particles whose step error is too large (near nodes)", &params->adaptiveSubsteps);
+    if (ImGui::SliderFloat("Largest particle step error (texels)", &params->substepTolerance, 0.001, 1.0))
+           s_sim_params_set(params->SUBSTEP_TOLERANCE, params->substepTolerance);
+    ImGui::Checkbox("Periodically sort particles in Z-order (faster guiding for many particles)", &params->sortParticles);
+    if (ImGui::SliderInt("Particle steps between sorts", &params->particleSortInterval, 1, 1000))
+            s_sim_params_set(params->PARTICLE_SORT_INTERVAL, params->particleSortInterval);
+    ImGui::Checkbox("Place new particles as weighted particles (more of them in the tails of |psi|^2)", &params->weightedParticles);
     ImGui::Text("--------------------------------------------------------------------------------");
-    ImGui::Text("Use sliders to place new wave function:");
+    ImGui::Text("%s", (params->sliderSetWaveFuncTitle.empty())? "Use sliders to place new wave function:": params->sliderSetWaveFuncTitle.c_str());
     ImGui::Text("Initial wavenumber w.r.t. simulation domain dimensions");
     if (ImGui::SliderFloat("sliderNewWaveFuncMomentum[0]", &params->sliderNewWaveFuncMomentum.ind[0], -40.0, 40.0))
            s_sim_params_set(params->SLIDER_NEW_WAVE_FUNC_MOMENTUM, params->sliderNewWaveFuncMomentum);
@@ -116,8 +173,48 @@ void imgui_controls(void *void_params) {
             s_selection_set(params->PRESET_POTENTIAL_DROPDOWN, 6);
         ImGui::EndMenu();
     }
-    ImGui::Text("(Please note: to ensure stability, clamping is applied to the potential so that |V(x, y, t)| < 1.)");
+    ImGui::Text("%s", (params->userWarningLabel.empty())? "(Please note: to ensure stability, clamping is applied to the potential so that |V(x, y, t)| < 1.)": params->userWarningLabel.c_str());
     ImGui::Checkbox("Add absorbing boundaries (MAY INCUR INSTABILITY, particularly if the potential is non-zero at the boundaries!)", &params->addAbsorbingBoundaries);
+    if (ImGui::SliderInt("Particle steps between removals of absorbed particles", &params->compactionInterval, 1, 1000))
+            s_sim_params_set(params->COMPACTION_INTERVAL, params->compactionInterval);
+    ImGui::Text("%s", (params->liveParticlesLabel.empty())? "Live particles: all": params->liveParticlesLabel.c_str());
+    if (ImGui::BeginMenu("When screenshots cannot be saved fast enough")) {
+        if (ImGui::MenuItem( "Drop frames"))
+            s_selection_set(params->SCREENSHOT_POLICY, 0);
+        if (ImGui::MenuItem( "Slow down the simulation"))
+            s_selection_set(params->SCREENSHOT_POLICY, 1);
+        ImGui::EndMenu();
+    }
+    ImGui::Checkbox("Record video", &params->videoRecord);
+    if (ImGui::BeginMenu("Video format")) {
+        if (ImGui::MenuItem( "YUV4MPEG2 file"))
+            s_selection_set(params->VIDEO_FORMAT, 0);
+        if (ImGui::MenuItem( "Raw RGB file"))
+            s_selection_set(params->VIDEO_FORMAT, 1);
+        if (ImGui::MenuItem( "YUV4MPEG2 to standard output"))
+            s_selection_set(params->VIDEO_FORMAT, 2);
+        if (ImGui::MenuItem( "Raw RGB to standard output"))
+            s_selection_set(params->VIDEO_FORMAT, 3);
+        ImGui::EndMenu();
+    }
+    ImGui::Text("--------------------------------------------------------------------------------");
+    ImGui::Checkbox("Simulate in 3D (new wave functions and particles are placed on the slice)", &params->simulate3D);
+    if (ImGui::BeginMenu("Show planar slice")) {
+        if (ImGui::MenuItem( "xy"))
+            s_selection_set(params->PLANAR_SLICE_SELECT, 0);
+        if (ImGui::MenuItem( "yz"))
+            s_selection_set(params->PLANAR_SLICE_SELECT, 1);
+        if (ImGui::MenuItem( "xz"))
+            s_selection_set(params->PLANAR_SLICE_SELECT, 2);
+        ImGui::EndMenu();
+    }
+    ImGui::Text("Planar slices offsets (in normalized coordinates) for xy, yz, xz");
+    if (ImGui::SliderFloat("planarNormCoordOffsets[0]", &params->planarNormCoordOffsets.ind[0], 0.0, 1.0))
+           s_sim_params_set(params->PLANAR_NORM_COORD_OFFSETS, params->planarNormCoordOffsets);
+    if (ImGui::SliderFloat("planarNormCoordOffsets[1]", &params->planarNormCoordOffsets.ind[1], 0.0, 1.0))
+           s_sim_params_set(params->PLANAR_NORM_COORD_OFFSETS, params->planarNormCoordOffsets);
+    if (ImGui::SliderFloat("planarNormCoordOffsets[2]", &params->planarNormCoordOffsets.ind[2], 0.0, 1.0))
+           s_sim_params_set(params->PLANAR_NORM_COORD_OFFSETS, params->planarNormCoordOffsets);
 
 }
 
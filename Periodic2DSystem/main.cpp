@@ -6,6 +6,7 @@
 #include "parse.hpp"
 #include "user_edit_glsl.hpp"
 #include "simulation.hpp"
+#include "simulation_3d.hpp"
 
 #include <GLFW/glfw3.h>
 
@@ -14,11 +15,16 @@
 #include <emscripten/bind.h>
 #endif
 #include <functional>
+#include <memory>
 #include <utility>
 
 #include "wasm_wrappers.hpp"
 
 
+/* File that checkpoints are saved to and restarted from
+using the buttons. */
+#define CHECKPOINT_FNAME "pilot2d.checkpoint"
+
 static std::function <void()> s_loop;
 #ifdef __EMSCRIPTEN__
 static void s_main_loop() {
@@ -32,11 +38,21 @@ using namespace sim_2d;
 void simulation_ui_interface_handler(
     MainGLFWQuad main_render,
     TextureParams default_tex_params,  // Default texture parameters
-    SimParams &params  // Parameters of the simulations
+    SimParams &params,  // Parameters of the simulations
+    const std::string &restart_fname // Checkpoint to start from, if any
 ) {
     Interactor interactor(main_render.get_window());
     Simulation sim(default_tex_params, params);
+    if (!restart_fname.empty() && !sim.load_checkpoint(params, restart_fname))
+        fprintf(stderr, "Starting without the checkpoint %s.\n",
+                restart_fname.c_str());
+    // Only made once the 3D simulation is first turned on, and made
+    // again whenever its volume dimensions change.
+    std::unique_ptr<Simulation3D> sim_3d;
     SimParams modified_params {};
+    // Last live particle count shown, so that its label
+    // is only edited when it changes.
+    int shown_live_particle_count = -1;
     UserProgramsManager user_text_edit {};
 
     // For handling mouse or touch interation.
@@ -77,7 +93,7 @@ void simulation_ui_interface_handler(
             }
         };
         /* Perform an action upon the press of a button. */
-        s_button_pressed = [&params, &sim]
+        s_button_pressed = [&params, &sim, &sim_3d]
             (int param_code) {
             if (param_code == params.ENTER_WAVE_FUNC) {
                 Vec2 position = {
@@ -86,12 +102,28 @@ void simulation_ui_interface_handler(
                     .y=params.sliderNewWaveFuncPosition.y
                         / float(params.waveSimulationDimensions.y)
                 };
+                if (params.simulate3D && sim_3d) {
+                    Vec3 position_3d = sim_3d->slice_position(
+                        params, position);
+                    sim_3d->new_wave_function(
+                        params, position_3d,
+                        sim_3d->slice_direction(
+                            params, params.sliderNewWaveFuncMomentum));
+                    sim_3d->new_particles(params, position_3d);
+                    return;
+                }
                 sim.new_wave_function(
                         params, 
                         position,
                         params.sliderNewWaveFuncMomentum);
                 sim.new_particles(params, position);
             }
+            if (param_code == params.SAVE_CHECKPOINT) {
+                sim.save_checkpoint(params, CHECKPOINT_FNAME);
+            }
+            if (param_code == params.LOAD_CHECKPOINT) {
+                sim.load_checkpoint(params, CHECKPOINT_FNAME);
+            }
         };
         /* Floating-point value parameters and their associated sliders
         can be created by the user. This notifies and keeps track of any
@@ -121,6 +153,24 @@ void simulation_ui_interface_handler(
             if (c == params.MOUSE_USAGE_ENTRY) {
                 params.mouseUsageEntry.selected = val;
             }
+            if (c == params.TIME_STEP_BACKEND) {
+                params.timeStepBackend.selected = val;
+            }
+            if (c == params.STENCIL_ORDER) {
+                params.stencilOrder.selected = val;
+            }
+            if (c == params.DRIFT_ACTION) {
+                params.driftAction.selected = val;
+            }
+            if (c == params.SCREENSHOT_POLICY) {
+                params.screenshotPolicy.selected = val;
+            }
+            if (c == params.VIDEO_FORMAT) {
+                params.videoFormat.selected = val;
+            }
+            if (c == params.PLANAR_SLICE_SELECT) {
+                params.planarSliceSelect.selected = val;
+            }
         };
         s_image_set = [&params, &sim] (int c, const std::string &image_data,
             int width, int height) {
@@ -158,7 +208,33 @@ void simulation_ui_interface_handler(
         enum {
             MOUSE_USAGE_NEW_WAVE_FUNC=0, 
             MOUSE_USAGE_DRAW_V=1, MOUSE_USAGE_ERASE_V=2};
-        if (start_position.has_value()) {
+        if (params.simulate3D) {
+            IVec3 d = params.volumeTexelDimensions3D;
+            if (!sim_3d || sim_3d->texel_dimensions()[0] != d[0]
+                || sim_3d->texel_dimensions()[1] != d[1]
+                || sim_3d->texel_dimensions()[2] != d[2]) {
+                // The old textures are freed before the new ones are made.
+                sim_3d.reset();
+                sim_3d.reset(new Simulation3D(default_tex_params, params));
+            }
+        }
+        if (start_position.has_value() && params.simulate3D) {
+            // Only new wave functions can be placed in 3D,
+            // on the plane of the viewed slice.
+            Vec3 position = sim_3d->slice_position(
+                params, start_position.value());
+            Vec3 wave_num = sim_3d->slice_direction(
+                params, cursor_positions.back() - start_position.value());
+            for (int i = 0; i < 3; i++)
+                wave_num[i] *= float(params.volumeTexelDimensions3D[i])/4.0;
+            if (params.mouseUsageEntry.selected
+                    == MOUSE_USAGE_NEW_WAVE_FUNC) {
+                sim_3d->new_wave_function(params, position, wave_num);
+                if (cursor_positions.size() <= 1)
+                    sim_3d->new_particles(params, position);
+            }
+            params.t = 0.0;
+        } else if (start_position.has_value()) {
             if (cursor_positions.size() > 1) {
                 Vec2 delta_2d = interactor.get_mouse_delta();
                 Vec3 delta {.ind={delta_2d[0], delta_2d[1], 0.0}};
@@ -204,12 +280,28 @@ void simulation_ui_interface_handler(
             && !(start_position.has_value() 
                  && params.mouseUsageEntry.selected 
                  == MOUSE_USAGE_NEW_WAVE_FUNC); i++) {
+            if (params.simulate3D) {
+                float step_size = sim_3d->time_step_size(params);
+                sim_3d->time_step(params);
+                params.t += step_size;
+                continue;
+            }
+            float step_size = sim.time_step_size(params);
             sim.time_step(params);
-            params.t += params.dt;
+            params.t += step_size;
+            sim.monitor_drift(params);
+        }
+        if (!params.simulate3D
+            && sim.live_particle_count() != shown_live_particle_count) {
+            shown_live_particle_count = sim.live_particle_count();
+            edit_label_display(
+                params.LIVE_PARTICLES_LABEL,
+                "Live particles: "
+                + std::to_string(shown_live_particle_count));
         }
         
         main_render.draw(
-            sim.view(params));
+            (params.simulate3D)? sim_3d->view(params): sim.view(params));
         
         if (params.takeScreenshots.is_recording) {
             #ifdef __EMSCRIPTEN__
@@ -279,16 +371,24 @@ void simulation_ui_interface_handler(
 }
 
 
+/* Usage: ./program [width height [nearest]] [--restart checkpoint] */
 int main(int argc, char *argv[]) {
+    std::string restart_fname;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--restart" && i + 1 < argc)
+            restart_fname = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
     int window_width = 1024, window_height = 1024;
-    if (argc >= 3) {
-        window_width = std::atoi(argv[1]);
-        window_height = std::atoi(argv[2]);
+    if (args.size() >= 2) {
+        window_width = std::atoi(args[0].c_str());
+        window_height = std::atoi(args[1].c_str());
     }
     int filter_type = GL_LINEAR;
-    if (argc >= 4) {
-        std::string s(argv[3]);
-        if (s == "nearest")
+    if (args.size() >= 3) {
+        if (args[2] == "nearest")
             filter_type = GL_NEAREST;
     }
     SimParams params {};
@@ -307,6 +407,6 @@ int main(int argc, char *argv[]) {
     MainGLFWQuad 
     main_render (default_tex_params.width, default_tex_params.height);
     simulation_ui_interface_handler(
-        main_render, default_tex_params, params);
+        main_render, default_tex_params, params, restart_fname);
     return 0;
 }
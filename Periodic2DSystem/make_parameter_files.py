@@ -725,6 +725,11 @@ IMGUI_TEXT = \
 """    ImGui::Text("{}");
 """
 
+# Labels show their name, until edit_label_display gives them new text.
+IMGUI_LABEL = \
+"""    ImGui::Text("%s", (params->{1}.empty())? "{0}": params->{1}.c_str());
+"""
+
 IMGUI_MENU = \
 """    if (ImGui::MenuItem({}))
             s_selection_set({}, {});
@@ -779,7 +784,7 @@ def write_imgui_controls(
         if 'BoolRecord' in type_:
             file_contents += IMGUI_CHECKBOX.format(name, k)
         if 'Label' in type_:
-            file_contents += IMGUI_TEXT.format(name)
+            file_contents += IMGUI_LABEL.format(name, k)
         if 'LineDivider' in type_:
             file_contents += f"    ImGui::Text(\"{'-'*80}\");\n"
         if 'SelectionList' in type_:
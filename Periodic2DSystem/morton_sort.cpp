@@ -0,0 +1,110 @@
+#include "morton_sort.hpp"
+#include <algorithm>
+
+/* Bits of the keys that are sorted in each pass, so that the
+20 bit keys take two passes, with 1024 counts for each chunk. */
+#define DIGIT_BITS 10
+#define DIGIT_COUNT (1 << DIGIT_BITS)
+#define PASS_COUNT ((2*MORTON_BITS + DIGIT_BITS - 1)/DIGIT_BITS)
+
+/* Smallest number of particles that are given to a thread at a time. */
+#define MIN_PARTICLES_PER_CHUNK 16384
+
+/* Spread the lower 16 bits of x out to the even bits. */
+static inline uint32_t spread_bits(uint32_t x) {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+uint32_t morton_index(uint32_t j, uint32_t i) {
+    return spread_bits(j) | (spread_bits(i) << 1);
+}
+
+static inline uint32_t cell(float r, float size) {
+    constexpr int CELLS = 1 << MORTON_BITS;
+    int c = (int)(r/size*CELLS);
+    return (c < 0)? 0: ((c >= CELLS)? CELLS - 1: c);
+}
+
+void MortonSort::sort(Particles2D &q, std::vector<uint32_t> &ids,
+                      float width, float height, ThreadPool &pool) {
+    int count = q.count();
+    // The chunks of each pass have to be the same, so rather than
+    // letting parallel_for divide the particles, each of its
+    // indices is a whole chunk.
+    int chunk_count = std::max(1, std::min(
+        pool.thread_count(), count/MIN_PARTICLES_PER_CHUNK));
+    auto chunk_begin = [&](int c) {
+        return (int)((long long)count*c/chunk_count);
+    };
+    for (int k = 0; k < 2; k++) {
+        m_keys[k].resize(count);
+        m_order[k].resize(count);
+    }
+    m_counts.resize((size_t)chunk_count*DIGIT_COUNT);
+    uint32_t *keys = &m_keys[0][0], *keys_tmp = &m_keys[1][0];
+    uint32_t *order = &m_order[0][0], *order_tmp = &m_order[1][0];
+    pool.parallel_for(0, count, [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            keys[n] = morton_index(cell(q.x[n], width),
+                                   cell(q.y[n], height));
+            order[n] = n;
+        }
+    }, MIN_PARTICLES_PER_CHUNK);
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        int shift = pass*DIGIT_BITS;
+        pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+            for (int c = c_begin; c < c_end; c++) {
+                uint32_t *counts = &m_counts[(size_t)c*DIGIT_COUNT];
+                std::fill(counts, counts + DIGIT_COUNT, 0);
+                for (int n = chunk_begin(c); n < chunk_begin(c + 1); n++)
+                    counts[(keys[n] >> shift) & (DIGIT_COUNT - 1)]++;
+            }
+        });
+        // Turn the counts into where each chunk starts writing each
+        // digit, with the digits in order, and then the chunks.
+        uint32_t offset = 0;
+        for (int d = 0; d < DIGIT_COUNT; d++) {
+            for (int c = 0; c < chunk_count; c++) {
+                uint32_t &counts = m_counts[(size_t)c*DIGIT_COUNT + d];
+                uint32_t digit_count = counts;
+                counts = offset;
+                offset += digit_count;
+            }
+        }
+        pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+            for (int c = c_begin; c < c_end; c++) {
+                uint32_t *offsets = &m_counts[(size_t)c*DIGIT_COUNT];
+                for (int n = chunk_begin(c); n < chunk_begin(c + 1); n++) {
+                    uint32_t dst
+                        = offsets[(keys[n] >> shift) & (DIGIT_COUNT - 1)]++;
+                    keys_tmp[dst] = keys[n];
+                    order_tmp[dst] = order[n];
+                }
+            }
+        });
+        std::swap(keys, keys_tmp);
+        std::swap(order, order_tmp);
+    }
+    // Gather the positions and ids into their new order.
+    m_tmp.resize(count);
+    m_tmp_ids.resize(count);
+    std::vector<float> *coordinates[3] = {&q.x, &q.y, &q.w};
+    for (int d = 0; d < ((q.w.empty())? 2: 3); d++) {
+        std::vector<float> &r = *coordinates[d];
+        pool.parallel_for(0, count, [&](int begin, int end) {
+            for (int n = begin; n < end; n++)
+                m_tmp[n] = r[order[n]];
+        }, MIN_PARTICLES_PER_CHUNK);
+        r.swap(m_tmp);
+    }
+    pool.parallel_for(0, count, [&](int begin, int end) {
+        for (int n = begin; n < end; n++)
+            m_tmp_ids[n] = ids[order[n]];
+    }, MIN_PARTICLES_PER_CHUNK);
+    ids.swap(m_tmp_ids);
+}
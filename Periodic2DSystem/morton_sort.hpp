@@ -0,0 +1,39 @@
+#include "cpu_particle_guide.hpp"
+#include <cstdint>
+
+#ifndef _MORTON_SORT_
+#define _MORTON_SORT_
+
+/* Number of bits of each coordinate in a Morton index, so that
+the simulation domain is divided into 1024 by 1024 cells. */
+#define MORTON_BITS 10
+
+/* Z-order (Morton) index of the cell at column j and row i, where
+the bits of j and i are interleaved, with those of j first.*/
+uint32_t morton_index(uint32_t j, uint32_t i);
+
+/*
+Reorder particles by the Morton index of the cell that each is in,
+so that particles that are next to each other in memory are also
+close together in space, and read the same parts of the wave
+function when they are guided.
+
+The sort is a least significant digit radix sort, where each pass
+counts and then scatters the keys of each thread's share of the
+particles, so that the order of particles in the same cell is kept.
+*/
+class MortonSort {
+    std::vector<uint32_t> m_keys[2];
+    std::vector<uint32_t> m_order[2];
+    std::vector<uint32_t> m_counts;
+    std::vector<float> m_tmp;
+    std::vector<uint32_t> m_tmp_ids;
+    public:
+    /* Sort the particles in a domain of the given width and height,
+    along with their weights. The same permutation is applied to ids,
+    which keeps the original index of each particle.*/
+    void sort(Particles2D &q, std::vector<uint32_t> &ids,
+              float width, float height, ThreadPool &pool);
+};
+
+#endif
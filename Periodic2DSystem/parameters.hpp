@@ -39,9 +39,24 @@ struct SimParams {
     float waveFuncSize = (float)(0.025F);
     float m = (float)(1.0F);
     float dt = (float)(0.3F);
+    SelectionList timeStepBackend = SelectionList{0, {"GPU", "CPU (multithreaded)", "CPU split-operator (FFT)", "CPU implicit ADI Crank-Nicolson (2nd order Laplacian only)", "GPU Chebyshev propagator"}};
+    SelectionList stencilOrder = SelectionList{1, {"2nd order", "4th order", "6th order"}};
+    int chebyshevDigits = (int)(6);
+    bool monitorDrift = (bool)(false);
+    int driftCheckInterval = (int)(60);
+    float driftThreshold = (float)(0.01F);
+    SelectionList driftAction = SelectionList{0, {"Only log it", "Halve the time step", "Stop the simulation"}};
     SelectionList mouseUsageEntry = SelectionList{0, {"Create new wave function", "Draw potential barrier", "Erase potential barrier"}};
     int numberOfParticles = (int)(65536);
+    SelectionList particlePlacement = SelectionList{0, {"Random points", "Quasi-random points (scrambled Sobol, smoother for fewer particles)"}};
     bool showTrails = (bool)(false);
+    int particleDensityBudget = (int)(262144);
+    bool interpolateVelocityField = (bool)(true);
+    bool adaptiveSubsteps = (bool)(false);
+    float substepTolerance = (float)(0.05F);
+    bool sortParticles = (bool)(false);
+    int particleSortInterval = (int)(50);
+    bool weightedParticles = (bool)(false);
     LineDivider lineDiv = LineDivider{};
     Label sliderSetWaveFuncTitle = Label{};
     Vec2 sliderNewWaveFuncMomentum = (Vec2)(Vec2 {.ind={0.0, 40.0}});
@@ -56,8 +71,21 @@ struct SimParams {
     EntryBoxes userTextEntry = EntryBoxes{"0"};
     Label userWarningLabel = Label{};
     bool addAbsorbingBoundaries = (bool)(false);
+    int compactionInterval = (int)(50);
+    Label liveParticlesLabel = Label{};
     UploadImage imagePotential = UploadImage{};
     BMPRecord takeScreenshots = BMPRecord{false, 2160, 2160};
+    SelectionList screenshotPolicy = SelectionList{0, {"Drop frames", "Slow down the simulation"}};
+    bool videoRecord = (bool)(false);
+    SelectionList videoFormat = SelectionList{0, {"YUV4MPEG2 file", "Raw RGB file", "YUV4MPEG2 to standard output", "Raw RGB to standard output"}};
+    Button saveCheckpoint = Button{};
+    Button loadCheckpoint = Button{};
+    LineDivider lineDiv3 = LineDivider{};
+    bool simulate3D = (bool)(false);
+    IVec3 volumeTexelDimensions3D = (IVec3)(IVec3 {.ind={128, 128, 128}});
+    Vec3 waveSimulationDimensions3D = (Vec3)(Vec3 {.ind={256.0, 256.0, 256.0}});
+    SelectionList planarSliceSelect = SelectionList{0, {"xy", "yz", "xz"}};
+    Vec3 planarNormCoordOffsets = (Vec3)(Vec3 {.ind={0.5, 0.5, 0.5}});
     int dummyValue = (int)(0);
     enum {
         T=0,
@@ -69,26 +97,54 @@ struct SimParams {
         WAVE_FUNC_SIZE=6,
         M=7,
         DT=8,
-        MOUSE_USAGE_ENTRY=9,
-        NUMBER_OF_PARTICLES=10,
-        SHOW_TRAILS=11,
-        LINE_DIV=12,
-        SLIDER_SET_WAVE_FUNC_TITLE=13,
-        SLIDER_NEW_WAVE_FUNC_MOMENTUM=14,
-        SLIDER_NEW_WAVE_FUNC_POSITION=15,
-        ENTER_WAVE_FUNC=16,
-        LINE_DIV2=17,
-        WAVE_DISCRETIZATION_DIMENSIONS=18,
-        POTENTIAL_GRID_WIDTH=19,
-        POTENTIAL_GRID_HEIGHT=20,
-        WAVE_SIMULATION_DIMENSIONS=21,
-        PRESET_POTENTIAL_DROPDOWN=22,
-        USER_TEXT_ENTRY=23,
-        USER_WARNING_LABEL=24,
-        ADD_ABSORBING_BOUNDARIES=25,
-        IMAGE_POTENTIAL=26,
-        TAKE_SCREENSHOTS=27,
-        DUMMY_VALUE=28,
+        TIME_STEP_BACKEND=9,
+        STENCIL_ORDER=10,
+        CHEBYSHEV_DIGITS=11,
+        MONITOR_DRIFT=12,
+        DRIFT_CHECK_INTERVAL=13,
+        DRIFT_THRESHOLD=14,
+        DRIFT_ACTION=15,
+        MOUSE_USAGE_ENTRY=16,
+        NUMBER_OF_PARTICLES=17,
+        PARTICLE_PLACEMENT=18,
+        SHOW_TRAILS=19,
+        PARTICLE_DENSITY_BUDGET=20,
+        INTERPOLATE_VELOCITY_FIELD=21,
+        ADAPTIVE_SUBSTEPS=22,
+        SUBSTEP_TOLERANCE=23,
+        SORT_PARTICLES=24,
+        PARTICLE_SORT_INTERVAL=25,
+        WEIGHTED_PARTICLES=26,
+        LINE_DIV=27,
+        SLIDER_SET_WAVE_FUNC_TITLE=28,
+        SLIDER_NEW_WAVE_FUNC_MOMENTUM=29,
+        SLIDER_NEW_WAVE_FUNC_POSITION=30,
+        ENTER_WAVE_FUNC=31,
+        LINE_DIV2=32,
+        WAVE_DISCRETIZATION_DIMENSIONS=33,
+        POTENTIAL_GRID_WIDTH=34,
+        POTENTIAL_GRID_HEIGHT=35,
+        WAVE_SIMULATION_DIMENSIONS=36,
+        PRESET_POTENTIAL_DROPDOWN=37,
+        USER_TEXT_ENTRY=38,
+        USER_WARNING_LABEL=39,
+        ADD_ABSORBING_BOUNDARIES=40,
+        COMPACTION_INTERVAL=41,
+        LIVE_PARTICLES_LABEL=42,
+        IMAGE_POTENTIAL=43,
+        TAKE_SCREENSHOTS=44,
+        SCREENSHOT_POLICY=45,
+        VIDEO_RECORD=46,
+        VIDEO_FORMAT=47,
+        SAVE_CHECKPOINT=48,
+        LOAD_CHECKPOINT=49,
+        LINE_DIV3=50,
+        SIMULATE3_D=51,
+        VOLUME_TEXEL_DIMENSIONS3_D=52,
+        WAVE_SIMULATION_DIMENSIONS3_D=53,
+        PLANAR_SLICE_SELECT=54,
+        PLANAR_NORM_COORD_OFFSETS=55,
+        DUMMY_VALUE=56,
     };
     void set(int enum_val, Uniform val) {
         switch(enum_val) {
@@ -119,12 +175,45 @@ struct SimParams {
             case DT:
             dt = val.f32;
             break;
+            case CHEBYSHEV_DIGITS:
+            chebyshevDigits = val.i32;
+            break;
+            case MONITOR_DRIFT:
+            monitorDrift = val.b32;
+            break;
+            case DRIFT_CHECK_INTERVAL:
+            driftCheckInterval = val.i32;
+            break;
+            case DRIFT_THRESHOLD:
+            driftThreshold = val.f32;
+            break;
             case NUMBER_OF_PARTICLES:
             numberOfParticles = val.i32;
             break;
             case SHOW_TRAILS:
             showTrails = val.b32;
             break;
+            case PARTICLE_DENSITY_BUDGET:
+            particleDensityBudget = val.i32;
+            break;
+            case INTERPOLATE_VELOCITY_FIELD:
+            interpolateVelocityField = val.b32;
+            break;
+            case ADAPTIVE_SUBSTEPS:
+            adaptiveSubsteps = val.b32;
+            break;
+            case SUBSTEP_TOLERANCE:
+            substepTolerance = val.f32;
+            break;
+            case SORT_PARTICLES:
+            sortParticles = val.b32;
+            break;
+            case PARTICLE_SORT_INTERVAL:
+            particleSortInterval = val.i32;
+            break;
+            case WEIGHTED_PARTICLES:
+            weightedParticles = val.b32;
+            break;
             case SLIDER_NEW_WAVE_FUNC_MOMENTUM:
             sliderNewWaveFuncMomentum = val.vec2;
             break;
@@ -146,6 +235,24 @@ struct SimParams {
             case ADD_ABSORBING_BOUNDARIES:
             addAbsorbingBoundaries = val.b32;
             break;
+            case COMPACTION_INTERVAL:
+            compactionInterval = val.i32;
+            break;
+            case VIDEO_RECORD:
+            videoRecord = val.b32;
+            break;
+            case SIMULATE3_D:
+            simulate3D = val.b32;
+            break;
+            case VOLUME_TEXEL_DIMENSIONS3_D:
+            volumeTexelDimensions3D = val.ivec3;
+            break;
+            case WAVE_SIMULATION_DIMENSIONS3_D:
+            waveSimulationDimensions3D = val.vec3;
+            break;
+            case PLANAR_NORM_COORD_OFFSETS:
+            planarNormCoordOffsets = val.vec3;
+            break;
             case DUMMY_VALUE:
             dummyValue = val.i32;
             break;
@@ -171,10 +278,32 @@ struct SimParams {
             return {(float)m};
             case DT:
             return {(float)dt};
+            case CHEBYSHEV_DIGITS:
+            return {(int)chebyshevDigits};
+            case MONITOR_DRIFT:
+            return {(bool)monitorDrift};
+            case DRIFT_CHECK_INTERVAL:
+            return {(int)driftCheckInterval};
+            case DRIFT_THRESHOLD:
+            return {(float)driftThreshold};
             case NUMBER_OF_PARTICLES:
             return {(int)numberOfParticles};
             case SHOW_TRAILS:
             return {(bool)showTrails};
+            case PARTICLE_DENSITY_BUDGET:
+            return {(int)particleDensityBudget};
+            case INTERPOLATE_VELOCITY_FIELD:
+            return {(bool)interpolateVelocityField};
+            case ADAPTIVE_SUBSTEPS:
+            return {(bool)adaptiveSubsteps};
+            case SUBSTEP_TOLERANCE:
+            return {(float)substepTolerance};
+            case SORT_PARTICLES:
+            return {(bool)sortParticles};
+            case PARTICLE_SORT_INTERVAL:
+            return {(int)particleSortInterval};
+            case WEIGHTED_PARTICLES:
+            return {(bool)weightedParticles};
             case SLIDER_NEW_WAVE_FUNC_MOMENTUM:
             return {(Vec2)sliderNewWaveFuncMomentum};
             case SLIDER_NEW_WAVE_FUNC_POSITION:
@@ -189,6 +318,18 @@ struct SimParams {
             return {(Vec2)waveSimulationDimensions};
             case ADD_ABSORBING_BOUNDARIES:
             return {(bool)addAbsorbingBoundaries};
+            case COMPACTION_INTERVAL:
+            return {(int)compactionInterval};
+            case VIDEO_RECORD:
+            return {(bool)videoRecord};
+            case SIMULATE3_D:
+            return {(bool)simulate3D};
+            case VOLUME_TEXEL_DIMENSIONS3_D:
+            return {(IVec3)volumeTexelDimensions3D};
+            case WAVE_SIMULATION_DIMENSIONS3_D:
+            return {(Vec3)waveSimulationDimensions3D};
+            case PLANAR_NORM_COORD_OFFSETS:
+            return {(Vec3)planarNormCoordOffsets};
             case DUMMY_VALUE:
             return {(int)dummyValue};
         }
@@ -205,6 +346,9 @@ struct SimParams {
             case USER_WARNING_LABEL:
             userWarningLabel = val;
             break;
+            case LIVE_PARTICLES_LABEL:
+            liveParticlesLabel = val;
+            break;
         }
     }
 };
@@ -0,0 +1,345 @@
+/* Measure how fast the CPU particle guide moves particles, for several
+particle counts, either by interpolating psi and its gradient, or by
+interpolating a precomputed velocity field. The velocity field is also
+timed with the particles sorted in Z-order by MortonSort.
+
+Placing new particles from |psi|^2 with ParticleSampler is also
+checked against the spread of |psi|^2 on the grid, and timed against the
+Metropolis algorithm that was used to place them before. How evenly
+random and quasi-random (scrambled Sobol) particles fill out |psi|^2
+is compared by binning them, as is how well weighted particles resolve
+the tails of |psi|^2.
+
+Before the timings, both are checked against a plane wave, where every
+particle moves with the same velocity hbar k/m. Adaptive substeps are
+checked with particles orbiting a single vortex, whose radii should
+stay the same.
+
+Build with make particle_benchmark, and run as
+
+    ./particle_benchmark [grid size] [thread count]
+
+*/
+#include "cpu_particle_guide.hpp"
+#include "morton_sort.hpp"
+#include "particle_sampler.hpp"
+#include "metropolis.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#define REPEAT_COUNT 10
+
+static const int PARTICLE_COUNTS[] = {65536, 262144, 1048576, 4194304};
+
+/* Wave numbers of the plane wave, in periods across the grid. */
+static const int NX = 5, NY = -3;
+
+/* Width of the wave packet that the particles are timed in, relative
+to the grid, which is wide enough that the particles are spread over
+most of it.*/
+static const double SIGMA = 0.15;
+
+/* Particles that are spread out over the middle of the grid
+in a deterministic way, using the R2 low discrepancy sequence.*/
+static void place_particles(Particles2D &q, int count, float size) {
+    q.resize(count);
+    double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+    for (int n = 0; n < count; n++) {
+        double u = fmod(0.5 + a1*n, 1.0), v = fmod(0.5 + a2*n, 1.0);
+        q.x[n] = (0.2 + 0.6*u)*size;
+        q.y[n] = (0.2 + 0.6*v)*size;
+    }
+}
+
+static double plane_wave_error(int n, bool interpolate_velocity_field,
+                               ThreadPool &pool) {
+    ComplexField psi;
+    psi.resize(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double phase = 2.0*M_PI*(NX*(j + 0.5) + NY*(i + 0.5))/n;
+            psi.re[i*n + j] = cos(phase);
+            psi.im[i*n + j] = sin(phase);
+        }
+    }
+    GuideParams params = {
+        .m=1.0F, .hbar=1.0F, .width=float(n), .height=float(n),
+        .stencil_order=4,
+        .interpolate_velocity_field=interpolate_velocity_field,
+        .absorbing_boundaries=false,
+        .adaptive_substeps=false, .substep_tolerance=0.05F,
+    };
+    Particles2D q, q0;
+    place_particles(q, 4096, n);
+    q0 = q;
+    // The particles move across several texels, so that the rounding
+    // of their positions does not swamp the error of the velocity.
+    float dt = 20.0F;
+    ParticleGuide guide;
+    guide.rk4_step(q, psi, psi, psi, params, dt, pool);
+    double vx = 2.0*M_PI*NX/n, vy = 2.0*M_PI*NY/n;
+    double max_error = 0.0;
+    for (int k = 0; k < q.count(); k++) {
+        double ex = q.x[k] - q0.x[k] - dt*vx;
+        double ey = q.y[k] - q0.y[k] - dt*vy;
+        max_error = fmax(max_error, sqrt(ex*ex + ey*ey)
+                         /(dt*sqrt(vx*vx + vy*vy)));
+    }
+    return max_error;
+}
+
+/* Size of the grid, and centre of the vortex, used to check adaptive
+substeps. The centre is off the texel centres, so that no particle
+starts on a grid line through it.*/
+#define VORTEX_GRID 256
+static const double VORTEX_X0 = 128.3, VORTEX_Y0 = 127.8;
+
+/* Move particles around a single vortex, psi = ((x - x0) + i(y - y0))
+times a wide Gaussian, until t = 100. Close to the node the particles
+circle it with speed hbar/(m r), so they should keep their distance
+from it. Returns the largest change in this distance, in texels, and
+puts the time taken in seconds into elapsed_time.*/
+static double vortex_orbit_drift(float dt, bool adaptive_substeps,
+                                 double &elapsed_time, ThreadPool &pool) {
+    int n = VORTEX_GRID;
+    ComplexField psi;
+    psi.resize(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double x = j + 0.5 - VORTEX_X0, y = i + 0.5 - VORTEX_Y0;
+            double g = exp(-(x*x + y*y)/(2.0*60.0*60.0));
+            psi.re[i*n + j] = x*g;
+            psi.im[i*n + j] = y*g;
+        }
+    }
+    GuideParams params = {
+        .m=1.0F, .hbar=1.0F, .width=float(n), .height=float(n),
+        .stencil_order=4,
+        .interpolate_velocity_field=true,
+        .absorbing_boundaries=false,
+        .adaptive_substeps=adaptive_substeps, .substep_tolerance=0.01F,
+    };
+    // Radii from 1 to 5 texels, at angles that follow the golden angle.
+    int count = 1000;
+    Particles2D q;
+    q.resize(count);
+    std::vector<double> r0(count);
+    for (int k = 0; k < count; k++) {
+        r0[k] = 1.0 + 4.0*k/count;
+        q.x[k] = VORTEX_X0 + r0[k]*cos(2.4*k);
+        q.y[k] = VORTEX_Y0 + r0[k]*sin(2.4*k);
+    }
+    ParticleGuide guide;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < int(100.0F/dt); s++)
+        guide.rk4_step(q, psi, psi, psi, params, dt, pool);
+    auto end = std::chrono::steady_clock::now();
+    elapsed_time = std::chrono::duration<double>(end - start).count();
+    double max_drift = 0.0;
+    for (int k = 0; k < count; k++) {
+        double r = hypot(q.x[k] - VORTEX_X0, q.y[k] - VORTEX_Y0);
+        max_drift = fmax(max_drift, fabs(r - r0[k]));
+    }
+    return max_drift;
+}
+
+static double particles_per_second(
+    const ComplexField &psi, int count, bool interpolate_velocity_field,
+    bool z_order, ThreadPool &pool) {
+    int n = psi.width;
+    GuideParams params = {
+        .m=1.0F, .hbar=1.0F, .width=float(n), .height=float(n),
+        .stencil_order=4,
+        .interpolate_velocity_field=interpolate_velocity_field,
+        .absorbing_boundaries=false,
+        .adaptive_substeps=false, .substep_tolerance=0.05F,
+    };
+    Particles2D q;
+    place_particles(q, count, n);
+    if (z_order) {
+        std::vector<uint32_t> ids(count);
+        MortonSort morton_sort;
+        morton_sort.sort(q, ids, n, n, pool);
+    }
+    ParticleGuide guide;
+    guide.rk4_step(q, psi, psi, psi, params, 0.1F, pool);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT_COUNT; r++)
+        guide.rk4_step(q, psi, psi, psi, params, 0.1F, pool);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return count*REPEAT_COUNT/elapsed.count();
+}
+
+static double gaussian(const std::vector<double> &r, void *) {
+    double x = r[0] - 0.5, y = r[1] - 0.5;
+    return exp(-0.5*(x*x + y*y)/(SIGMA*SIGMA));
+}
+
+/* Number of bins across each side of the grid when comparing how
+evenly the particles are placed.*/
+#define BINS 32
+
+/* Relative L2 difference between the weight of the particles in each
+bin and the weight that |psi|^2 gives for it. With tails_only, only
+the bins with less than an even share of |psi|^2 are included.*/
+static double binned_error(const Particles2D &q, const ComplexField &psi,
+                           bool tails_only=false) {
+    int n = psi.width;
+    std::vector<double> expected(BINS*BINS, 0.0), counts(BINS*BINS, 0.0);
+    double w_sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double w = psi.re[i*n + j]*psi.re[i*n + j]
+                + psi.im[i*n + j]*psi.im[i*n + j];
+            expected[(i*BINS/n)*BINS + j*BINS/n] += w;
+            w_sum += w;
+        }
+    }
+    for (int k = 0; k < q.count(); k++) {
+        int bx = std::min(BINS - 1, (int)(q.x[k]*BINS));
+        int by = std::min(BINS - 1, (int)(q.y[k]*BINS));
+        counts[by*BINS + bx] += (q.w.empty())? 1.0: q.w[k];
+    }
+    double error = 0.0, norm = 0.0;
+    for (int b = 0; b < BINS*BINS; b++) {
+        if (tails_only && expected[b]/w_sum >= 1.0/(BINS*BINS))
+            continue;
+        double e = expected[b]/w_sum*q.count();
+        error += (counts[b] - e)*(counts[b] - e);
+        norm += e*e;
+    }
+    return sqrt(error/norm);
+}
+
+/* Place count particles from |psi|^2, and print how long this takes
+compared to the Metropolis algorithm, along with the standard
+deviation of the particles' positions, which should be that of |psi|^2
+on the grid. This is a little less than SIGMA, since the grid cuts
+off the tails of the Gaussian.*/
+static void time_placement(const ComplexField &psi, int count,
+                           ThreadPool &pool) {
+    int n = psi.width;
+    std::vector<float> psi_interleaved(2*n*n);
+    psi.to_interleaved(&psi_interleaved[0], pool);
+    Particles2D q;
+    ParticleSampler sampler;
+    auto start = std::chrono::steady_clock::now();
+    sampler.sample(q, count, &psi_interleaved[0], n, n, 1.0F, 1.0F,
+                   12345, pool);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> sampler_time = end - start;
+    double sx = 0.0, sy = 0.0;
+    for (int k = 0; k < count; k++) {
+        sx += (q.x[k] - 0.5)*(q.x[k] - 0.5);
+        sy += (q.y[k] - 0.5)*(q.y[k] - 0.5);
+    }
+    double w_sum = 0.0, wx = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double x = (j + 0.5)/n - 0.5;
+            double w = psi.re[i*n + j]*psi.re[i*n + j]
+                + psi.im[i*n + j]*psi.im[i*n + j];
+            w_sum += w;
+            wx += w*x*x;
+        }
+    }
+    // The uniform spread within each texel adds 1/(12 n^2).
+    double expected = sqrt(wx/w_sum + 1.0/(12.0*n*n));
+    std::vector<double> configs, x0 = {0.5, 0.5};
+    std::vector<double> delta = {1.5*SIGMA, 1.5*SIGMA};
+    start = std::chrono::steady_clock::now();
+    metropolis(configs, x0, delta, gaussian, count, nullptr);
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> metropolis_time = end - start;
+    start = std::chrono::steady_clock::now();
+    sampler.sample_quasi_random(q, count, &psi_interleaved[0], n, n,
+                                1.0F, 1.0F, 12345, pool);
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> quasi_random_time = end - start;
+    printf("Placing %d particles from |psi|^2:\n", count);
+    printf("  alias table: %.2f ms, Sobol: %.2f ms, Metropolis: %.2f ms\n",
+           1000.0*sampler_time.count(), 1000.0*quasi_random_time.count(),
+           1000.0*metropolis_time.count());
+    printf("  standard deviation: %.4f, %.4f (expected %.4f)\n\n",
+           sqrt(sx/count), sqrt(sy/count), expected);
+}
+
+int main(int argc, char **argv) {
+    int n = (argc > 1)? atoi(argv[1]): 512;
+    int thread_count = (argc > 2)? atoi(argv[2]): 0;
+    ThreadPool pool(thread_count);
+    printf("%d x %d grid, %d threads\n\n", n, n, pool.thread_count());
+    printf("Largest relative velocity error for a plane wave:\n");
+    printf("  interpolating psi: %.3e\n",
+           plane_wave_error(n, false, pool));
+    printf("  interpolating the velocity field: %.3e\n\n",
+           plane_wave_error(n, true, pool));
+    printf("Largest drift in orbit radius around a vortex, to t = 100:\n");
+    printf("%6s %20s %20s\n", "dt", "without substeps", "adaptive substeps");
+    for (float dt: {0.5F, 2.0F}) {
+        double times[2], drifts[2] = {
+            vortex_orbit_drift(dt, false, times[0], pool),
+            vortex_orbit_drift(dt, true, times[1], pool)};
+        printf("%6.1f %9.2f (%5.1f ms) %9.2f (%5.1f ms)\n",
+               dt, drifts[0], 1000.0*times[0], drifts[1], 1000.0*times[1]);
+    }
+    printf("\n");
+    ComplexField psi;
+    psi.resize(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double x = (j + 0.5)/n - 0.5, y = (i + 0.5)/n - 0.5;
+            double g = exp(-0.25*(x*x + y*y)/(SIGMA*SIGMA));
+            double phase = 2.0*M_PI*(NX*x + NY*y);
+            psi.re[i*n + j] = g*cos(phase);
+            psi.im[i*n + j] = g*sin(phase);
+        }
+    }
+    time_placement(psi, 1048576, pool);
+    std::vector<float> psi_interleaved(2*n*n);
+    psi.to_interleaved(&psi_interleaved[0], pool);
+    printf("Relative error of particles in %d x %d bins:\n", BINS, BINS);
+    printf("%10s %10s %13s\n", "particles", "random", "quasi-random");
+    for (int count: {4096, 16384, 65536, 262144}) {
+        Particles2D q;
+        ParticleSampler sampler;
+        sampler.sample(q, count, &psi_interleaved[0], n, n,
+                       1.0F, 1.0F, 12345, pool);
+        double random_error = binned_error(q, psi);
+        sampler.sample_quasi_random(q, count, &psi_interleaved[0], n, n,
+                                    1.0F, 1.0F, 12345, pool);
+        printf("%10d %10.4f %13.4f\n",
+               count, random_error, binned_error(q, psi));
+    }
+    printf("\nRelative error in the bins of the tails of |psi|^2:\n");
+    printf("%10s %10s %10s\n", "particles", "random", "weighted");
+    for (int count: {4096, 16384, 65536, 262144}) {
+        Particles2D q;
+        ParticleSampler sampler;
+        double errors[2];
+        sampler.sample(q, count, &psi_interleaved[0], n, n,
+                       1.0F, 1.0F, 12345, pool);
+        errors[0] = binned_error(q, psi, true);
+        sampler.sample(q, count, &psi_interleaved[0], n, n,
+                       1.0F, 1.0F, 12345, pool, true);
+        errors[1] = binned_error(q, psi, true);
+        printf("%10d %10.4f %10.4f\n", count, errors[0], errors[1]);
+    }
+    printf("\n");
+    printf("Millions of particles per second:\n");
+    printf("%10s %10s %10s %18s\n",
+           "particles", "psi", "velocity", "velocity, Z-order");
+    for (int count: PARTICLE_COUNTS) {
+        double rates[3] = {
+            particles_per_second(psi, count, false, false, pool),
+            particles_per_second(psi, count, true, false, pool),
+            particles_per_second(psi, count, true, true, pool)};
+        printf("%10d %10.2f %10.2f %18.2f\n",
+               count, rates[0]/1e6, rates[1]/1e6, rates[2]/1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "particle_compaction.hpp"
+#include <algorithm>
+
+/* Smallest number of particles that are given to a thread at a time. */
+#define MIN_PARTICLES_PER_CHUNK 16384
+
+bool is_absorbed(float x, float y, float width, float height) {
+    // Same as the innermost band of absorbingBoundaries.
+    float u = x/width, v = y/height;
+    float s = 0.02F;
+    return u <= 0.1F*s || u > (1.0F - 0.1F*s)
+        || v <= 0.1F*s || v > (1.0F - 0.1F*s);
+}
+
+int ParticleCompaction::partition(
+    Particles2D &q, std::vector<uint32_t> &ids,
+    float width, float height, ThreadPool &pool) {
+    int count = q.count();
+    // As with MortonSort, each index of parallel_for is a whole chunk,
+    // so that the counting and the scattering use the same chunks.
+    int chunk_count = std::max(1, std::min(
+        pool.thread_count(), count/MIN_PARTICLES_PER_CHUNK));
+    auto chunk_begin = [&](int c) {
+        return (int)((long long)count*c/chunk_count);
+    };
+    m_live.resize(count);
+    m_live_counts.resize(chunk_count + 1);
+    pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+        for (int c = c_begin; c < c_end; c++) {
+            uint32_t live_count = 0;
+            for (int n = chunk_begin(c); n < chunk_begin(c + 1); n++) {
+                m_live[n] = !is_absorbed(q.x[n], q.y[n], width, height);
+                live_count += m_live[n];
+            }
+            m_live_counts[c + 1] = live_count;
+        }
+    });
+    m_live_counts[0] = 0;
+    for (int c = 0; c < chunk_count; c++)
+        m_live_counts[c + 1] += m_live_counts[c];
+    int live_count = m_live_counts[chunk_count];
+    if (live_count == count)
+        return count;
+    bool weighted = !q.w.empty();
+    m_tmp.resize(((weighted)? 3: 2)*count);
+    m_tmp_ids.resize(count);
+    float *x = &m_tmp[0], *y = &m_tmp[count];
+    float *w = (weighted)? &m_tmp[2*count]: nullptr;
+    pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+        for (int c = c_begin; c < c_end; c++) {
+            // The absorbed particles of each chunk go after all of the
+            // live particles, and those of the chunks before it.
+            uint32_t live_dst = m_live_counts[c];
+            uint32_t absorbed_dst = live_count
+                + (chunk_begin(c) - m_live_counts[c]);
+            for (int n = chunk_begin(c); n < chunk_begin(c + 1); n++) {
+                uint32_t dst = (m_live[n])? live_dst++: absorbed_dst++;
+                x[dst] = q.x[n];
+                y[dst] = q.y[n];
+                if (weighted)
+                    w[dst] = q.w[n];
+                m_tmp_ids[dst] = ids[n];
+            }
+        }
+    });
+    std::copy(x, x + count, q.x.begin());
+    std::copy(y, y + count, q.y.begin());
+    if (weighted)
+        std::copy(w, w + count, q.w.begin());
+    ids.swap(m_tmp_ids);
+    return live_count;
+}
+
+void ParticleCompaction::truncate(
+    Particles2D &q, std::vector<uint32_t> &ids, int count) {
+    // The rank of each kept id among all of the kept ids.
+    m_ranks.assign(ids.size(), 0);
+    for (int n = 0; n < count; n++)
+        m_ranks[ids[n]] = 1;
+    uint32_t rank = 0;
+    for (size_t k = 0; k < m_ranks.size(); k++) {
+        uint32_t kept = m_ranks[k];
+        m_ranks[k] = rank;
+        rank += kept;
+    }
+    for (int n = 0; n < count; n++)
+        ids[n] = m_ranks[ids[n]];
+    q.resize(count);
+    ids.resize(count);
+}
@@ -0,0 +1,40 @@
+#include "cpu_particle_guide.hpp"
+#include <cstdint>
+
+#ifndef _PARTICLE_COMPACTION_
+#define _PARTICLE_COMPACTION_
+
+/* Whether the particle at (x, y) has been absorbed, which is when it
+is close enough to the edges of a domain of the given width and height
+that absorbingBoundaries in shaders/particles/guide.frag sets its
+velocity to zero, so that it never moves again.*/
+bool is_absorbed(float x, float y, float width, float height);
+
+/*
+Remove the particles that have been absorbed, so that they no longer
+have to be guided or drawn.
+
+The particles are first partitioned, so that those that are still live
+come first, in the same order as before, followed by the absorbed ones.
+Each thread counts the live particles of its share, and a prefix sum
+of these counts gives where each share is written to. The particles
+past some count can then be dropped.
+*/
+class ParticleCompaction {
+    std::vector<uint32_t> m_live_counts;
+    std::vector<uint8_t> m_live;
+    std::vector<float> m_tmp;
+    std::vector<uint32_t> m_tmp_ids;
+    std::vector<uint32_t> m_ranks;
+    public:
+    /* Partition the particles in a domain of the given width and height,
+    and return the number of live particles. The same permutation is
+    applied to their weights and to ids.*/
+    int partition(Particles2D &q, std::vector<uint32_t> &ids,
+                  float width, float height, ThreadPool &pool);
+    /* Keep only the first count particles. Their ids are renumbered from
+    0 to count - 1, in the same order as before.*/
+    void truncate(Particles2D &q, std::vector<uint32_t> &ids, int count);
+};
+
+#endif
@@ -0,0 +1,376 @@
+#include "particle_sampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+/* Smallest number of texels that are given to a thread at a time. */
+#define MIN_TEXELS_PER_CHUNK 16384
+
+/* Number of particles drawn with each random number generator. */
+#define PARTICLES_PER_BLOCK 4096
+
+bool AliasTable::build(const float *weights, int count, ThreadPool &pool) {
+    if (count <= 0)
+        return false;
+    // Sum the weights in a fixed number of chunks, so that the
+    // total is the same for any number of threads.
+    int chunk_count = std::max(1, std::min(
+        pool.thread_count(), count/MIN_TEXELS_PER_CHUNK));
+    auto chunk_begin = [&](int c) {
+        return (int)((long long)count*c/chunk_count);
+    };
+    m_partial_sums.resize(chunk_count);
+    pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+        for (int c = c_begin; c < c_end; c++) {
+            double sum = 0.0;
+            for (int k = chunk_begin(c); k < chunk_begin(c + 1); k++)
+                sum += weights[k];
+            m_partial_sums[c] = sum;
+        }
+    });
+    double total = 0.0;
+    for (double sum: m_partial_sums)
+        total += sum;
+    if (!(total > 0.0))
+        return false;
+    // Scale the weights so that they average to one.
+    m_scaled.resize(count);
+    m_thresholds.resize(count);
+    m_aliases.resize(count);
+    double scale = count/total;
+    pool.parallel_for(0, count, [&](int begin, int end) {
+        for (int k = begin; k < end; k++)
+            m_scaled[k] = weights[k]*scale;
+    }, MIN_TEXELS_PER_CHUNK);
+    // Each index with a weight less than one, a light one, is filled up
+    // with some of an index with a weight of at least one, a heavy one.
+    // This is Vose's method done as a sweep over the light and heavy
+    // indices in order, where the current heavy index fills up each
+    // light one until it is no longer heavy itself, and is then filled
+    // up by the next heavy index. Which of the two the sweep does next
+    // only depends on prefix sums of the light indices' deficits and
+    // the heavy indices' excesses, so that it is a merge of these sums,
+    // and each thread can find where it starts in the sweep with a
+    // binary search. See Hubschle-Schneider L., Sanders P., "Parallel
+    // Weighted Random Sampling," ACM Transactions on Mathematical
+    // Software, 48(3), 2022.
+    m_chunk_lights.resize(chunk_count + 1);
+    m_chunk_heavies.resize(chunk_count + 1);
+    m_chunk_deficits.resize(chunk_count + 1);
+    m_chunk_excesses.resize(chunk_count + 1);
+    pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+        for (int c = c_begin; c < c_end; c++) {
+            int lights = 0;
+            double deficit = 0.0, excess = 0.0;
+            for (int k = chunk_begin(c); k < chunk_begin(c + 1); k++) {
+                if (m_scaled[k] < 1.0) {
+                    lights++;
+                    deficit += 1.0 - m_scaled[k];
+                } else {
+                    excess += m_scaled[k] - 1.0;
+                }
+            }
+            m_chunk_lights[c + 1] = lights;
+            m_chunk_heavies[c + 1]
+                = chunk_begin(c + 1) - chunk_begin(c) - lights;
+            m_chunk_deficits[c + 1] = deficit;
+            m_chunk_excesses[c + 1] = excess;
+        }
+    });
+    m_chunk_lights[0] = m_chunk_heavies[0] = 0;
+    m_chunk_deficits[0] = m_chunk_excesses[0] = 0.0;
+    for (int c = 0; c < chunk_count; c++) {
+        m_chunk_lights[c + 1] += m_chunk_lights[c];
+        m_chunk_heavies[c + 1] += m_chunk_heavies[c];
+        m_chunk_deficits[c + 1] += m_chunk_deficits[c];
+        m_chunk_excesses[c + 1] += m_chunk_excesses[c];
+    }
+    int light_count = m_chunk_lights[chunk_count];
+    int heavy_count = m_chunk_heavies[chunk_count];
+    m_small.resize(light_count);
+    m_large.resize(heavy_count);
+    // Both prefix sums start with a zero.
+    m_deficits.resize(light_count + 1);
+    m_excesses.resize(heavy_count + 1);
+    m_deficits[0] = m_excesses[0] = 0.0;
+    pool.parallel_for(0, chunk_count, [&](int c_begin, int c_end) {
+        for (int c = c_begin; c < c_end; c++) {
+            int l = m_chunk_lights[c], h = m_chunk_heavies[c];
+            double deficit = m_chunk_deficits[c];
+            double excess = m_chunk_excesses[c];
+            for (int k = chunk_begin(c); k < chunk_begin(c + 1); k++) {
+                if (m_scaled[k] < 1.0) {
+                    deficit += 1.0 - m_scaled[k];
+                    m_small[l] = k;
+                    m_deficits[++l] = deficit;
+                } else {
+                    excess += m_scaled[k] - 1.0;
+                    m_large[h] = k;
+                    m_excesses[++h] = excess;
+                }
+            }
+        }
+    });
+    if (heavy_count == 0) {
+        // Every weight is one, up to rounding.
+        pool.parallel_for(0, count, [&](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                m_thresholds[k] = 1.0F;
+                m_aliases[k] = k;
+            }
+        }, MIN_TEXELS_PER_CHUNK);
+        return true;
+    }
+    // At the state where l light indices have been filled up and h heavy
+    // ones are done, heavy index h has a weight left of
+    // 1 + excesses[h + 1] - deficits[l], and fills up light index l if
+    // that is more than one. The last heavy index fills up every light
+    // index that is left, which only matters for rounding.
+    auto fills_light = [&](int l, int h) {
+        return h == heavy_count - 1 || m_deficits[l] < m_excesses[h + 1];
+    };
+    int step_count = light_count + heavy_count;
+    pool.parallel_for(0, step_count, [&](int begin, int end) {
+        // Find the state after begin steps, which has the smallest number
+        // of light indices l such that light index l is not filled up
+        // before heavy index begin - l - 1 is done.
+        int low = std::max(0, begin - heavy_count);
+        int high = std::min(begin, light_count);
+        while (low < high) {
+            int l = (low + high)/2;
+            if (fills_light(l, begin - l - 1))
+                low = l + 1;
+            else
+                high = l;
+        }
+        int l = low, h = begin - low;
+        for (int step = begin; step < end; step++) {
+            if (l < light_count && fills_light(l, h)) {
+                uint32_t k = m_small[l++];
+                m_thresholds[k] = m_scaled[k];
+                m_aliases[k] = m_large[h];
+            } else {
+                uint32_t k = m_large[h];
+                if (h == heavy_count - 1) {
+                    m_thresholds[k] = 1.0F;
+                    m_aliases[k] = k;
+                } else {
+                    double left = 1.0 + m_excesses[h + 1] - m_deficits[l];
+                    m_thresholds[k] = std::min(std::max(left, 0.0), 1.0);
+                    m_aliases[k] = m_large[h + 1];
+                }
+                h++;
+            }
+        }
+    }, MIN_TEXELS_PER_CHUNK);
+    return true;
+}
+
+static inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+    x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/* Hash of x where each bit only depends on the bits below it, so that
+applying it to the reversed bits of a point permutes each level of
+its binary digits in a way that depends on the digits above them.
+See Burley B., "Practical Hash-based Owen Scrambling," Journal of
+Computer Graphics Techniques, 9(4), 2020.*/
+static inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x*0x6c50b47cu;
+    x ^= x*0xb82f1e52u;
+    x ^= x*0xc7afe638u;
+    x ^= x*0x8d22f6e6u;
+    return x;
+}
+
+static inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+void scrambled_sobol_2d(uint32_t n, uint32_t seed_x, uint32_t seed_y,
+                        uint32_t &x, uint32_t &y) {
+    // The first dimension is the van der Corput sequence, and the
+    // second has the direction numbers of the polynomial x + 1.
+    x = owen_scramble(reverse_bits(n), seed_x);
+    uint32_t sobol_y = 0;
+    for (uint32_t v = 1u << 31; n != 0; n >>= 1, v ^= v >> 1)
+        sobol_y ^= v & (0u - (n & 1));
+    y = owen_scramble(sobol_y, seed_y);
+}
+
+int AliasTable::size() const {
+    return m_thresholds.size();
+}
+
+void ParticleSampler::compute_density(
+    const float *psi, int texel_count, bool weighted, ThreadPool &pool) {
+    m_density.resize(texel_count);
+    pool.parallel_for(0, texel_count, [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            float abs2 = psi[2*k]*psi[2*k] + psi[2*k + 1]*psi[2*k + 1];
+            m_density[k] = (weighted)? sqrt(abs2): abs2;
+        }
+    }, MIN_TEXELS_PER_CHUNK);
+    if (weighted) {
+        // The weight of a particle in texel k is |psi_k|^2/|psi_k|,
+        // relative to their sums, so that the weights average to one.
+        double abs_sum = 0.0, abs2_sum = 0.0;
+        for (int k = 0; k < texel_count; k++) {
+            abs_sum += m_density[k];
+            abs2_sum += (double)m_density[k]*m_density[k];
+        }
+        m_weight_scale = (abs2_sum > 0.0)? abs_sum/abs2_sum: 0.0;
+    }
+}
+
+void ParticleSampler::set_weights(
+    Particles2D &q, bool weighted, ThreadPool &pool) {
+    if (!weighted) {
+        q.w.clear();
+        return;
+    }
+    q.w.resize(q.count());
+    pool.parallel_for(0, q.count(), [&](int begin, int end) {
+        for (int n = begin; n < end; n++)
+            q.w[n] = m_weight_scale*m_density[m_texels[n]];
+    }, PARTICLES_PER_BLOCK);
+}
+
+bool ParticleSampler::sample(
+    Particles2D &q, int count,
+    const float *psi, int grid_width, int grid_height,
+    float width, float height, uint64_t seed, ThreadPool &pool,
+    bool weighted) {
+    int texel_count = grid_width*grid_height;
+    this->compute_density(psi, texel_count, weighted, pool);
+    if (!m_table.build(&m_density[0], texel_count, pool))
+        return false;
+    q.resize(count);
+    m_texels.resize(count);
+    float dx = width/grid_width, dy = height/grid_height;
+    int block_count = (count + PARTICLES_PER_BLOCK - 1)/PARTICLES_PER_BLOCK;
+    pool.parallel_for(0, block_count, [&](int b_begin, int b_end) {
+        for (int b = b_begin; b < b_end; b++) {
+            uint64_t block_seed = seed + b;
+            uint64_t state = splitmix64(block_seed);
+            int end = std::min(count, (b + 1)*PARTICLES_PER_BLOCK);
+            for (int n = b*PARTICLES_PER_BLOCK; n < end; n++) {
+                uint64_t r0 = splitmix64(state), r1 = splitmix64(state);
+                uint32_t k = m_table.sample(r0 >> 32, unit_float(r0));
+                int i = k/grid_width, j = k - i*grid_width;
+                q.x[n] = (j + unit_float(r1 >> 32))*dx;
+                q.y[n] = (i + unit_float(r1))*dy;
+                m_texels[n] = k;
+            }
+        }
+    });
+    this->set_weights(q, weighted, pool);
+    return true;
+}
+
+/* Make the guide table of cdf, which has count increasing entries,
+where guide[g] is the number of entries that are at most g/count.
+The entry that any u falls under is then between guide[g] and
+guide[g + 1] for g = floor(u count), which is usually only one or
+two entries, so that finding it does not need a binary search.
+See Chen H.-C., Asau Y., "On Generating Random Variates from an
+Empirical Distribution," AIIE Transactions, 6(2), 1974.*/
+template <typename T>
+static void make_guide_table(uint32_t *guide, const T *cdf, int count) {
+    int k = 0;
+    for (int g = 0; g < count; g++) {
+        T u = (T)((double)g/count);
+        while (k < count && cdf[k] <= u)
+            k++;
+        guide[g] = k;
+    }
+}
+
+/* Index of the entry of cdf that u falls under, using its guide table,
+along with how far u is between the previous entry, or zero, and
+this one.*/
+template <typename T>
+static inline int invert_cdf(const T *cdf, const uint32_t *guide,
+                             int count, double u, double &t) {
+    int g = std::min(count - 1, (int)(u*count));
+    int k = guide[g];
+    int last = (g + 1 < count)? guide[g + 1]: count - 1;
+    while (k < last && cdf[k] <= (T)u)
+        k++;
+    if (k >= count)
+        k = count - 1;
+    // When rounding leaves u past the last entry, go back
+    // to the last entry that has any weight.
+    while (k > 0 && cdf[k] == cdf[k - 1])
+        k--;
+    double lower = (k > 0)? cdf[k - 1]: 0.0, upper = cdf[k];
+    t = (upper > lower)? (u - lower)/(upper - lower): 0.5;
+    t = std::min(std::max(t, 0.0), 1.0);
+    return k;
+}
+
+bool ParticleSampler::sample_quasi_random(
+    Particles2D &q, int count,
+    const float *psi, int grid_width, int grid_height,
+    float width, float height, uint64_t seed, ThreadPool &pool,
+    bool weighted) {
+    int texel_count = grid_width*grid_height;
+    this->compute_density(psi, texel_count, weighted, pool);
+    m_row_cdf.resize(texel_count);
+    m_row_guide.resize(texel_count);
+    m_rows_cdf.resize(grid_height + 1);
+    m_rows_guide.resize(grid_height);
+    int min_rows = std::max(1, MIN_TEXELS_PER_CHUNK/grid_width);
+    pool.parallel_for(0, grid_height, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const float *density = &m_density[i*grid_width];
+            float *cdf = &m_row_cdf[i*grid_width];
+            double sum = 0.0;
+            for (int j = 0; j < grid_width; j++) {
+                sum += density[j];
+                cdf[j] = sum;
+            }
+            float scale = (sum > 0.0)? 1.0/sum: 0.0;
+            for (int j = 0; j < grid_width; j++)
+                cdf[j] *= scale;
+            make_guide_table(&m_row_guide[i*grid_width], cdf, grid_width);
+            // The unnormalized sum of the row, until
+            // the distribution of the rows is found.
+            m_rows_cdf[i + 1] = sum;
+        }
+    }, min_rows);
+    m_rows_cdf[0] = 0.0;
+    for (int i = 0; i < grid_height; i++)
+        m_rows_cdf[i + 1] += m_rows_cdf[i];
+    double total = m_rows_cdf[grid_height];
+    if (!(total > 0.0))
+        return false;
+    for (int i = 1; i <= grid_height; i++)
+        m_rows_cdf[i] /= total;
+    make_guide_table(&m_rows_guide[0], &m_rows_cdf[1], grid_height);
+    q.resize(count);
+    m_texels.resize(count);
+    float dx = width/grid_width, dy = height/grid_height;
+    uint32_t seed_x = (uint32_t)seed, seed_y = (uint32_t)(seed >> 32);
+    pool.parallel_for(0, count, [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            uint32_t ux, uy;
+            scrambled_sobol_2d(n, seed_x, seed_y, ux, uy);
+            double u = ux*(1.0/4294967296.0), v = uy*(1.0/4294967296.0);
+            double s, t;
+            int i = invert_cdf(&m_rows_cdf[1], &m_rows_guide[0],
+                               grid_height, v, t);
+            int j = invert_cdf(&m_row_cdf[i*grid_width],
+                               &m_row_guide[i*grid_width], grid_width, u, s);
+            q.x[n] = (j + s)*dx;
+            q.y[n] = (i + t)*dy;
+            m_texels[n] = i*grid_width + j;
+        }
+    }, PARTICLES_PER_BLOCK);
+    this->set_weights(q, weighted, pool);
+    return true;
+}
@@ -0,0 +1,125 @@
+#include "cpu_particle_guide.hpp"
+#include <cstdint>
+
+#ifndef _PARTICLE_SAMPLER_
+#define _PARTICLE_SAMPLER_
+
+/* The splitmix64 generator, which is used both to seed the generator
+of each block of particles and as that generator. */
+inline uint64_t splitmix64(uint64_t &state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform number in [0, 1) from the lower 24 bits of r. */
+inline float unit_float(uint64_t r) {
+    return (float)(r & 0xffffff)*(1.0F/16777216.0F);
+}
+
+/*
+Walker's alias table, for drawing indices from a discrete distribution
+in constant time each.
+
+Each index k is given a threshold and an alias. An index is drawn by
+picking k uniformly, then keeping k if a second uniform number is
+below its threshold, and taking its alias otherwise. The table is
+made with Vose's method, in time linear in the number of indices,
+which is split between the threads of the pool.
+*/
+class AliasTable {
+    std::vector<float> m_thresholds;
+    std::vector<uint32_t> m_aliases;
+    std::vector<double> m_scaled;
+    std::vector<double> m_partial_sums;
+    // Light and heavy indices, and the prefix sums of how far their
+    // scaled weights are below or above one.
+    std::vector<uint32_t> m_small, m_large;
+    std::vector<double> m_deficits, m_excesses;
+    // Number of light and heavy indices before each chunk,
+    // and their sums.
+    std::vector<int> m_chunk_lights, m_chunk_heavies;
+    std::vector<double> m_chunk_deficits, m_chunk_excesses;
+    public:
+    /* Make the table for the given weights, which need not be
+    normalized. Return false if they sum to zero, in which case
+    the table cannot be drawn from.*/
+    bool build(const float *weights, int count, ThreadPool &pool);
+    int size() const;
+    /* Index for a uniformly random 32 bit integer r, and a uniform
+    number v in [0, 1).*/
+    inline uint32_t sample(uint32_t r, float v) const {
+        uint32_t k = (uint32_t)(((uint64_t)r*m_thresholds.size()) >> 32);
+        return (v < m_thresholds[k])? k: m_aliases[k];
+    }
+};
+
+/* Point n of the first two dimensions of the Sobol sequence, with
+each dimension given its own nested uniform (Owen) scrambling by
+the seeds. The points are returned as 32 bit fractions of one.*/
+void scrambled_sobol_2d(uint32_t n, uint32_t seed_x, uint32_t seed_y,
+                        uint32_t &x, uint32_t &y);
+
+/*
+Place particles with the probability density |psi|^2 of a wave
+function on a grid.
+
+With sample, each particle picks a texel from an alias table
+of |psi|^2, and is then put at a uniformly random point in that texel,
+so that placing count particles takes time proportional to the number
+of texels plus count. The particles are drawn in fixed size blocks,
+each with its own random number generator seeded from seed and the
+block's index, so that the result does not depend on the number
+of threads.
+
+With sample_quasi_random, the particles are instead the points of a
+scrambled Sobol sequence, which fill the unit square more evenly than
+random points do, mapped through the inverse of the cumulative
+distribution of |psi|^2. The y coordinate is found from the
+distribution of the rows, and the x coordinate from that of the
+particle's row, where each texel's part of the distribution is linear,
+so that the mapping is continuous and keeps the points evenly spread.
+Both take time proportional to the number of texels plus count.
+
+With weighted, either places the particles with the density |psi|
+instead, so that more of them are in the tails of |psi|^2, and gives
+each particle a weight proportional to |psi| at its texel, so that the
+weighted particles still have the density |psi|^2. The weights average
+to one. Otherwise the particles have no weights.
+*/
+class ParticleSampler {
+    AliasTable m_table;
+    std::vector<float> m_density;
+    // Distribution of each row, normalized so that
+    // the last texel of each row is one.
+    std::vector<float> m_row_cdf;
+    // Distribution of the rows, from 0 to 1, with height + 1 entries.
+    std::vector<double> m_rows_cdf;
+    // Guide tables of the distributions, for inverting them quickly.
+    std::vector<uint32_t> m_row_guide, m_rows_guide;
+    // Weight of a particle per unit of the density at its texel,
+    // for weighted particles.
+    double m_weight_scale;
+    // Texel that each particle was placed in.
+    std::vector<uint32_t> m_texels;
+    void compute_density(const float *psi, int texel_count,
+                         bool weighted, ThreadPool &pool);
+    void set_weights(Particles2D &q, bool weighted, ThreadPool &pool);
+    public:
+    /* Draw count particles from psi, which has two floats per texel
+    as in an RG texture, over a domain of the given width and height.
+    Return false, leaving q as it is, if psi is zero everywhere.*/
+    bool sample(Particles2D &q, int count,
+                const float *psi, int grid_width, int grid_height,
+                float width, float height, uint64_t seed, ThreadPool &pool,
+                bool weighted=false);
+    /* Same as sample, but with the quasi-random points.*/
+    bool sample_quasi_random(
+        Particles2D &q, int count,
+        const float *psi, int grid_width, int grid_height,
+        float width, float height, uint64_t seed, ThreadPool &pool,
+        bool weighted=false);
+};
+
+#endif
@@ -0,0 +1,158 @@
+/* RK4 step with adaptive substeps for the particles that need them.
+
+The full step is first taken with the stages found beforehand, as in
+rk4.frag. Its error is estimated by comparing it with the midpoint
+method, which is the second order method embedded in RK4's stages,
+since it only uses the second stage. Particles where this is larger
+than the tolerance, which are those close to the nodes of the wave
+function where the velocity changes quickly, take the step again as
+several smaller RK4 steps. The velocity of these substeps is
+interpolated from the velocity fields at the start, middle, and end
+of the step, both in space and in time.
+
+Reference:
+    Hairer, Norsett, Wanner, "Solving Ordinary Differential Equations I",
+    section II.4, on embedded Runge-Kutta formulas.
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform sampler2D qDotTex1;
+uniform sampler2D qDotTex2;
+uniform sampler2D qDotTex3;
+uniform sampler2D qDotTex4;
+uniform float dt;
+
+// Velocity fields at the start, middle, and end of the step.
+uniform sampler2D velocityTex0;
+uniform sampler2D velocityTex1;
+uniform sampler2D velocityTex2;
+uniform bool nearestSamplingOnly;
+
+uniform vec2 dimensions2D;
+uniform ivec2 textureDimensions2D;
+
+uniform bool imposeAbsorbingBoundaries;
+
+// Largest error of a step, in texels.
+uniform float tolerance;
+
+#define MAX_SUBSTEPS 16
+
+/*Bilinear interpolation. */
+vec4 blI(vec2 r, float x0, float y0, float x1, float y1,
+         vec4 w00, vec4 w10, vec4 w01, vec4 w11) {
+    float dx = x1 - x0, dy = y1 - y0;
+    float ax = (dx == 0.0)? 0.0: (r.x - x0)/dx;
+    float ay = (dy == 0.0)? 0.0: (r.y - y0)/dy;
+    return mix(mix(w00, w10, ax), mix(w01, w11, ax), ay);
+}
+
+/* Some devices do not support linear texture filtering
+for floating point textures. If the sampling is restriced
+to nearest (as set by the nearestSamplingOnly uniform bool),
+then get the nearest four texel values to the texture
+coordinate r, and perform a manual bilinear interpolation of 
+the texture value at r. */
+vec4 customSampler(sampler2D tex, vec2 r) {
+    if (!nearestSamplingOnly)
+        return texture2D(tex, r);
+    float width = float(textureDimensions2D[0]);
+    float height = float(textureDimensions2D[1]);
+    float x0 = (floor(r.x*width - 0.5) + 0.5)/width;
+    float y0 = (floor(r.y*height - 0.5) + 0.5)/height;
+    float x1 = (ceil(r.x*width - 0.5) + 0.5)/width;
+    float y1 = (ceil(r.y*height - 0.5) + 0.5)/height;
+    vec2 r00 = vec2(x0, y0);
+    vec2 r10 = vec2(x1, y0);
+    vec2 r01 = vec2(x0, y1);
+    vec2 r11 = vec2(x1, y1);
+    vec4 f00 = texture2D(tex, r00);
+    vec4 f10 = texture2D(tex, r10);
+    vec4 f01 = texture2D(tex, r01);
+    vec4 f11 = texture2D(tex, r11);
+    return blI(r.xy, x0, y0, x1, y1, f00, f10, f01, f11);
+}
+
+vec2 absorbingBoundaries(vec2 position, vec2 dQDt) {
+    float x = position.x/dimensions2D[0];
+    float y = position.y/dimensions2D[1];
+    float s = 0.02;
+    vec2 dQDt2 = dQDt;
+    if (x > (1.0 - 2.5*s) || x <= 2.5*s)
+        dQDt2 = 0.5*vec2(normalize(dQDt).x, 0.0);
+    if (y > (1.0 - 2.5*s) || y <= 2.5*s)
+        dQDt2 = 0.5*vec2(0.0, normalize(dQDt).y);
+    if (x <= 0.1*s || x > (1.0 - 0.1*s) || 
+        y <= 0.1*s || y > (1.0 - 0.1*s))
+        dQDt2 *= 0.0;
+    return dQDt2;
+}
+
+/* Velocity at position r and at the fraction s of the step, where
+the velocity fields are interpolated quadratically in time. */
+vec2 velocity(vec2 r, float s) {
+    vec2 texPosition = r/dimensions2D;
+    vec2 v0 = customSampler(velocityTex0, texPosition).xy;
+    vec2 v1 = customSampler(velocityTex1, texPosition).xy;
+    vec2 v2 = customSampler(velocityTex2, texPosition).xy;
+    vec2 v = (1.0 - s)*(1.0 - 2.0*s)*v0 + 4.0*s*(1.0 - s)*v1
+        + s*(2.0*s - 1.0)*v2;
+    return (imposeAbsorbingBoundaries)? absorbingBoundaries(r, v): v;
+}
+
+vec2 enforcePeriodicity(vec2 x) {
+    for (int i = 0; i < 2; i++) {
+        x[i] = (x[i] <= 0.0)? dimensions2D[i] + x[i]: x[i]; 
+        x[i] = (x[i] > dimensions2D[i])? mod(x[i], dimensions2D[i]): x[i];
+    }
+    return x;
+}
+
+void main() {
+    vec2 q0 = texture2D(qTex, UV).xy;
+    vec2 qDot1 = texture2D(qDotTex1, UV).xy;
+    vec2 qDot2 = texture2D(qDotTex2, UV).xy;
+    vec2 qDot3 = texture2D(qDotTex3, UV).xy;
+    vec2 qDot4 = texture2D(qDotTex4, UV).xy;
+    vec2 qDot = (qDot1 + 2.0*qDot2 + 2.0*qDot3 + qDot4)/6.0;
+    vec2 texelSize = dimensions2D/vec2(textureDimensions2D);
+    float error = length(dt*(qDot - qDot2)/texelSize);
+    vec2 qF = q0 + dt*qDot;
+    // The midpoint method's error goes as the cube of the step size.
+    float substeps = min(ceil(pow(error/tolerance, 1.0/3.0)),
+                         float(MAX_SUBSTEPS));
+    if (error > tolerance && substeps > 1.0) {
+        float h = 1.0/substeps;
+        vec2 q = q0;
+        for (int i = 0; i < MAX_SUBSTEPS; i++) {
+            if (float(i) >= substeps)
+                break;
+            float s = float(i)*h;
+            vec2 k1 = velocity(q, s);
+            vec2 k2 = velocity(q + 0.5*h*dt*k1, s + 0.5*h);
+            vec2 k3 = velocity(q + 0.5*h*dt*k2, s + 0.5*h);
+            vec2 k4 = velocity(q + h*dt*k3, s + h);
+            q += h*dt*(k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        }
+        qF = q;
+    }
+    vec2 q = enforcePeriodicity(qF);
+    fragColor = vec4(q, q);
+}
@@ -0,0 +1,40 @@
+/* Draw particles in 3D as circles, projected onto a plane.
+The circle of every particle is drawn from the same vertices, with
+one instance per particle, so this needs gl_InstanceID and textureSize,
+which are in GLSL 3.30 and GLSL ES 3.00.*/
+#if __VERSION__ <= 120
+attribute vec2 position;
+varying vec2 UV;
+#else
+in vec2 position;
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform sampler2D coordTex;
+uniform float circleRadius;
+uniform vec3 dimensions3D;
+// Directions along the plane, in normalized coordinates,
+// that are horizontal and vertical on the screen.
+uniform vec3 horizontal;
+uniform vec3 vertical;
+
+void main() {
+    // Each instance is the particle at one texel of coordTex.
+    ivec2 size = textureSize(coordTex, 0);
+    UV = (vec2(gl_InstanceID % size.x, gl_InstanceID / size.x) + 0.5)
+        /vec2(size);
+    vec3 r = texture2D(coordTex, UV).xyz/dimensions3D;
+    vec2 texPos = vec2(dot(r, horizontal), dot(r, vertical))
+        + circleRadius*position;
+    gl_Position = vec4(2.0*texPos - vec2(1.0), 0.0, 1.0);
+}
@@ -0,0 +1,130 @@
+/* Guide the particle using a pilot wave on a 3D grid, where the
+slices of the grid are laid out as tiles of a 2D texture.
+ */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform float hbar;
+uniform float m;
+
+uniform sampler2D psiTex;
+uniform sampler2D qTex;
+uniform float dt;
+uniform sampler2D qDotTex;
+
+uniform vec3 dimensions3D;
+uniform ivec3 texelDimensions3D;
+uniform ivec2 textureDimensions2D;
+
+#define complex vec2
+
+complex conj(complex z) {
+    return complex(z.x, -z.y);
+}
+
+complex mul(complex a, complex b) {
+    return complex(a[0]*b[0] - a[1]*b[1], a[0]*b[1] + a[1]*b[0]);
+}
+
+complex inv(complex z) {
+    return conj(z)/(z.x*z.x + z.y*z.y);
+}
+
+float imag(complex z) {
+    return z.y;
+}
+
+vec2 to2DTextureCoordinates(vec3 r) {
+    vec3 size = vec3(texelDimensions3D);
+    r = mod(r, size);
+    float tilesAcross = floor(
+        float(textureDimensions2D[0])/size.x + 0.5);
+    vec2 tile = vec2(mod(r.z, tilesAcross), floor(r.z/tilesAcross + 0.001));
+    return (tile*size.xy + r.xy + 0.5)/vec2(textureDimensions2D);
+}
+
+/* Trilinear interpolation at r, which is in units of texels, where
+the texel centers are at whole numbers. Texture filtering cannot be
+used for this, since neighbouring slices are in different tiles,
+and the edges of a tile border those of other slices.*/
+complex trilinearSample(sampler2D tex, vec3 r) {
+    vec3 r0 = floor(r);
+    vec3 a = r - r0;
+    complex f000 = texture2D(tex, to2DTextureCoordinates(r0)).xy;
+    complex f100 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(1.0, 0.0, 0.0))).xy;
+    complex f010 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(0.0, 1.0, 0.0))).xy;
+    complex f110 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(1.0, 1.0, 0.0))).xy;
+    complex f001 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(0.0, 0.0, 1.0))).xy;
+    complex f101 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(1.0, 0.0, 1.0))).xy;
+    complex f011 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(0.0, 1.0, 1.0))).xy;
+    complex f111 = texture2D(
+        tex, to2DTextureCoordinates(r0 + vec3(1.0, 1.0, 1.0))).xy;
+    return mix(mix(mix(f000, f100, a.x), mix(f010, f110, a.x), a.y),
+               mix(mix(f001, f101, a.x), mix(f011, f111, a.x), a.y),
+               a.z);
+}
+
+/* The order of accuracy of the gradient, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+complex pairDifference(sampler2D tex, vec3 r, vec3 offset) {
+    return trilinearSample(tex, r + offset)
+        - trilinearSample(tex, r - offset);
+}
+
+/* Central first difference along the direction of a single
+texel offset, without dividing by the grid spacing. */
+complex firstDifference(sampler2D tex, vec3 r, vec3 offset) {
+#if STENCIL_ORDER == 2
+    return pairDifference(tex, r, offset)/2.0;
+#elif STENCIL_ORDER == 6
+    return 3.0*pairDifference(tex, r, offset)/4.0
+        - 3.0*pairDifference(tex, r, 2.0*offset)/20.0
+        + pairDifference(tex, r, 3.0*offset)/60.0;
+#else
+    return 2.0*pairDifference(tex, r, offset)/3.0
+        - pairDifference(tex, r, 2.0*offset)/12.0;
+#endif
+}
+
+void main() {
+    vec3 position = texture2D(qTex, UV).xyz + dt*texture2D(qDotTex, UV).xyz;
+    // Position in units of texels, where the texel centers
+    // are at whole numbers.
+    vec3 r = position/dimensions3D*vec3(texelDimensions3D) - 0.5;
+    vec3 d = dimensions3D/vec3(texelDimensions3D);
+    complex gradPsiX = firstDifference(psiTex, r, vec3(1.0, 0.0, 0.0))/d.x;
+    complex gradPsiY = firstDifference(psiTex, r, vec3(0.0, 1.0, 0.0))/d.y;
+    complex gradPsiZ = firstDifference(psiTex, r, vec3(0.0, 0.0, 1.0))/d.z;
+    complex invPsi = inv(trilinearSample(psiTex, r));
+    vec3 dQDt = (hbar/m)*vec3(
+        imag(mul(gradPsiX, invPsi)),
+        imag(mul(gradPsiY, invPsi)),
+        imag(mul(gradPsiZ, invPsi)));
+    fragColor = vec4(dQDt, 0.0);
+}
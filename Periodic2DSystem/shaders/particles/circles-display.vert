@@ -1,8 +1,11 @@
+/* The circle of every particle is drawn from the same vertices, with
+one instance per particle, so this needs gl_InstanceID and textureSize,
+which are in GLSL 3.30 and GLSL ES 3.00.*/
 #if __VERSION__ <= 120
-attribute vec4 position;
+attribute vec2 position;
 varying vec2 UV;
 #else
-in vec4 position;
+in vec2 position;
 out vec2 UV;
 #endif
 
@@ -20,18 +23,14 @@ uniform sampler2D coordTex;
 uniform float circleRadius;
 uniform vec2 dimensions2D;
 
-const float VERTEX_TYPE_IN_CENTER = 0.0;
-
 void main() {
-    UV = position.xy;
-    float circleAngle = position[2];
-    float vertexType = position[3];
+    // Each instance is the particle at one texel of coordTex.
+    ivec2 size = textureSize(coordTex, 0);
+    UV = (vec2(gl_InstanceID % size.x, gl_InstanceID / size.x) + 0.5)
+        /vec2(size);
     vec4 coord = texture2D(coordTex, UV);
     float texX = coord.x/dimensions2D[0];
     float texY = coord.y/dimensions2D[1];
-    float c = cos(circleAngle), s = sin(circleAngle);
-    vec2 texPos = vec2(texX, texY);
-    if (vertexType != VERTEX_TYPE_IN_CENTER)
-        texPos += circleRadius*vec2(c, s);
+    vec2 texPos = vec2(texX, texY) + circleRadius*position;
     gl_Position = vec4(2.0*texPos - vec2(1.0), 0.0, 1.0);
 }
@@ -0,0 +1,36 @@
+/* Show the number of particles in each pixel, which is in the first
+channel of densityTex, as they would look if each were drawn as a
+circle of area circleTexels, in pixels, with the given color.
+Where n such circles overlap, the alpha of blending them one over
+another is 1 - (1 - color.a)^n, and a particle in a pixel overlaps
+circleTexels pixels on average, so the count in each pixel is
+shown with that many circles.*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D densityTex;
+uniform float circleTexels;
+uniform vec4 color;
+
+void main() {
+    float count = texture2D(densityTex, UV).r;
+    float transparency = max(1.0 - color.a, 1e-6);
+    float alpha = (count > 0.0)?
+        1.0 - exp(count*circleTexels*log(transparency)): 0.0;
+    fragColor = vec4(color.rgb, alpha);
+}
@@ -0,0 +1,36 @@
+/* Every particle is drawn as a single point, from the same vertex,
+with one instance per particle, so that adding the points up gives
+the number of particles in each pixel. As with circles-display.vert,
+this needs gl_InstanceID and textureSize.*/
+#if __VERSION__ <= 120
+attribute vec2 position;
+varying vec2 UV;
+#else
+in vec2 position;
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform sampler2D coordTex;
+uniform vec2 dimensions2D;
+
+void main() {
+    // Each instance is the particle at one texel of coordTex.
+    ivec2 size = textureSize(coordTex, 0);
+    UV = (vec2(gl_InstanceID % size.x, gl_InstanceID / size.x) + 0.5)
+        /vec2(size);
+    vec4 coord = texture2D(coordTex, UV);
+    vec2 texPos = vec2(coord.x/dimensions2D[0], coord.y/dimensions2D[1])
+        + position;
+    gl_Position = vec4(2.0*texPos - vec2(1.0), 0.0, 1.0);
+    gl_PointSize = 1.0;
+}
@@ -88,26 +88,40 @@ vec4 customSampler(sampler2D tex, vec2 r) {
     return blI(r.xy, x0, y0, x1, y1, f00, f10, f01, f11);
 }
 
-complex2 gradient4thOr(sampler2D tex, vec2 uv) {
+/* The order of accuracy of the gradient, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+complex pairDifference(sampler2D tex, vec2 uv, vec2 offset) {
+    return customSampler(tex, uv + offset).xy
+        - customSampler(tex, uv - offset).xy;
+}
+
+/* Central first difference along the direction of a single
+texel offset, without dividing by the grid spacing. */
+complex firstDifference(sampler2D tex, vec2 uv, vec2 offset) {
+#if STENCIL_ORDER == 2
+    return pairDifference(tex, uv, offset)/2.0;
+#elif STENCIL_ORDER == 6
+    return 3.0*pairDifference(tex, uv, offset)/4.0
+        - 3.0*pairDifference(tex, uv, 2.0*offset)/20.0
+        + pairDifference(tex, uv, 3.0*offset)/60.0;
+#else
+    return 2.0*pairDifference(tex, uv, offset)/3.0
+        - pairDifference(tex, uv, 2.0*offset)/12.0;
+#endif
+}
+
+complex2 gradient(sampler2D tex, vec2 uv) {
     float du = 1.0/float(textureDimensions2D[0]);
     float dv = 1.0/float(textureDimensions2D[1]);
     float dx = dimensions2D[0]/float(textureDimensions2D[0]);
     float dy = dimensions2D[1]/float(textureDimensions2D[1]);
-    complex up2, up1, center, down1, down2;
-    complex left2, left1, right1, right2;
-    up2 = customSampler(tex, uv + vec2(0.0, 2.0*dv)).xy;
-    up1 = customSampler(tex, uv + vec2(0.0, dv)).xy;
-    down1 = customSampler(tex, uv + vec2(0.0, -dv)).xy;
-    down2 = customSampler(tex, uv + vec2(0.0, -2.0*dv)).xy;
-    left2 = customSampler(tex, uv + vec2(-2.0*du, 0.0)).xy;
-    left1 = customSampler(tex, uv + vec2(-du, 0.0)).xy;
-    right1 = customSampler(tex, uv + vec2(du, 0.0)).xy;
-    right2 = customSampler(tex, uv + vec2(2.0*du, 0.0)).xy;
-    // center = texture2D(tex, UV);
-    complex dFDx, dFDy; 
-    dFDx = (left2/12.0 - 2.0*left1/3.0 + 2.0*right1/3.0 - right2/12.0)/dx;
-    dFDy = (down2/12.0 - 2.0*down1/3.0 + 2.0*up1/3.0 - up2/12.0)/dy;  
-    return complex2(dFDx, dFDy);
+    return complex2(firstDifference(tex, uv, vec2(du, 0.0))/dx,
+                    firstDifference(tex, uv, vec2(0.0, dv))/dy);
 }
 
 vec2 absorbingBoundaries(vec2 position, vec2 dQDt) {
@@ -142,11 +156,11 @@ void main() {
     vec2 position = texture2D(qTex, UV).xy + dt*texture2D(qDotTex, UV).xy;
     vec2 texPosition = vec2(
         position.x/dimensions2D[0], position.y/dimensions2D[1]);
-    complex2 gradPsi = gradient4thOr(psiTex, texPosition);
+    complex2 gradPsi = gradient(psiTex, texPosition);
     complex gradPsiX = gradPsi.xy;
     complex gradPsiY = gradPsi.zw;
     complex invPsi = inv(texture2D(psiTex, texPosition).xy);
-    // complex2 gradientV = gradient4thOr(potentialTex, texPosition);
+    // complex2 gradientV = gradient(potentialTex, texPosition);
     // vec2 gradImV = vec2(gradientV.y, gradientV.w);
     // complex invImV = 1.0/(texture2D(potentialTex, texPosition).y);
     vec2 dQDt = (hbar/m)*vec2(
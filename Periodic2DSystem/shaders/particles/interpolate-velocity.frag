@@ -0,0 +1,92 @@
+/* Guide the particle by interpolating the velocity field of the
+pilot wave, which is found beforehand at every texel of the grid
+by velocity-field.frag.
+ */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D velocityTex;
+uniform sampler2D qTex;
+uniform float dt;
+uniform sampler2D qDotTex;
+uniform bool nearestSamplingOnly;
+
+uniform vec2 dimensions2D;
+uniform ivec2 textureDimensions2D;
+
+uniform bool imposeAbsorbingBoundaries;
+
+/*Bilinear interpolation. */
+vec4 blI(vec2 r, float x0, float y0, float x1, float y1,
+         vec4 w00, vec4 w10, vec4 w01, vec4 w11) {
+    float dx = x1 - x0, dy = y1 - y0;
+    float ax = (dx == 0.0)? 0.0: (r.x - x0)/dx;
+    float ay = (dy == 0.0)? 0.0: (r.y - y0)/dy;
+    return mix(mix(w00, w10, ax), mix(w01, w11, ax), ay);
+}
+
+/* Some devices do not support linear texture filtering
+for floating point textures. If the sampling is restriced
+to nearest (as set by the nearestSamplingOnly uniform bool),
+then get the nearest four texel values to the texture
+coordinate r, and perform a manual bilinear interpolation of 
+the texture value at r. */
+vec4 customSampler(sampler2D tex, vec2 r) {
+    if (!nearestSamplingOnly)
+        return texture2D(tex, r);
+    float width = float(textureDimensions2D[0]);
+    float height = float(textureDimensions2D[1]);
+    float x0 = (floor(r.x*width - 0.5) + 0.5)/width;
+    float y0 = (floor(r.y*height - 0.5) + 0.5)/height;
+    float x1 = (ceil(r.x*width - 0.5) + 0.5)/width;
+    float y1 = (ceil(r.y*height - 0.5) + 0.5)/height;
+    vec2 r00 = vec2(x0, y0);
+    vec2 r10 = vec2(x1, y0);
+    vec2 r01 = vec2(x0, y1);
+    vec2 r11 = vec2(x1, y1);
+    vec4 f00 = texture2D(tex, r00);
+    vec4 f10 = texture2D(tex, r10);
+    vec4 f01 = texture2D(tex, r01);
+    vec4 f11 = texture2D(tex, r11);
+    return blI(r.xy, x0, y0, x1, y1, f00, f10, f01, f11);
+}
+
+vec2 absorbingBoundaries(vec2 position, vec2 dQDt) {
+    float x = position.x/dimensions2D[0];
+    float y = position.y/dimensions2D[1];
+    float s = 0.02;
+    vec2 dQDt2 = dQDt;
+    if (x > (1.0 - 2.5*s) || x <= 2.5*s)
+        dQDt2 = 0.5*vec2(normalize(dQDt).x, 0.0);
+    if (y > (1.0 - 2.5*s) || y <= 2.5*s)
+        dQDt2 = 0.5*vec2(0.0, normalize(dQDt).y);
+    if (x <= 0.1*s || x > (1.0 - 0.1*s) || 
+        y <= 0.1*s || y > (1.0 - 0.1*s))
+        dQDt2 *= 0.0;
+    return dQDt2;
+}
+
+void main() {
+    vec2 position = texture2D(qTex, UV).xy + dt*texture2D(qDotTex, UV).xy;
+    vec2 texPosition = vec2(
+        position.x/dimensions2D[0], position.y/dimensions2D[1]);
+    vec2 dQDt = customSampler(velocityTex, texPosition).xy;
+    if (imposeAbsorbingBoundaries)
+        dQDt = absorbingBoundaries(position, dQDt);
+    fragColor = vec4(dQDt, dQDt);
+}
@@ -0,0 +1,102 @@
+/* Velocity field (hbar/m) Im(grad psi/psi) of the pilot wave,
+found at every texel of the grid, so that the particles only need
+to interpolate it instead of each finding the gradient of psi.
+ */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform float hbar;
+uniform float m;
+
+uniform sampler2D psiTex;
+
+uniform vec2 dimensions2D;
+uniform ivec2 textureDimensions2D;
+
+#define complex vec2
+#define complex2 vec4
+
+complex conj(complex z) {
+    return complex(z.x, -z.y);
+}
+
+complex mul(complex a, complex b) {
+    return complex(a[0]*b[0] - a[1]*b[1], a[0]*b[1] + a[1]*b[0]);
+}
+
+complex inv(complex z) {
+    return conj(z)/(z.x*z.x + z.y*z.y);
+}
+
+float imag(complex z) {
+    return z.y;
+}
+
+/* The order of accuracy of the gradient, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+/* Only texel centers are sampled, so this is exact
+whatever the texture filtering is. */
+complex pairDifference(sampler2D tex, vec2 offset) {
+    return texture2D(tex, UV + offset).xy - texture2D(tex, UV - offset).xy;
+}
+
+/* Central first difference along the direction of a single
+texel offset, without dividing by the grid spacing. */
+complex firstDifference(sampler2D tex, vec2 offset) {
+#if STENCIL_ORDER == 2
+    return pairDifference(tex, offset)/2.0;
+#elif STENCIL_ORDER == 6
+    return 3.0*pairDifference(tex, offset)/4.0
+        - 3.0*pairDifference(tex, 2.0*offset)/20.0
+        + pairDifference(tex, 3.0*offset)/60.0;
+#else
+    return 2.0*pairDifference(tex, offset)/3.0
+        - pairDifference(tex, 2.0*offset)/12.0;
+#endif
+}
+
+complex2 gradient(sampler2D tex) {
+    float du = 1.0/float(textureDimensions2D[0]);
+    float dv = 1.0/float(textureDimensions2D[1]);
+    float dx = dimensions2D[0]/float(textureDimensions2D[0]);
+    float dy = dimensions2D[1]/float(textureDimensions2D[1]);
+    return complex2(firstDifference(tex, vec2(du, 0.0))/dx,
+                    firstDifference(tex, vec2(0.0, dv))/dy);
+}
+
+void main() {
+    complex2 gradPsi = gradient(psiTex);
+    complex psi = texture2D(psiTex, UV).xy;
+    // As on the CPU, the velocity is left at zero where psi is zero,
+    // since an Inf or NaN here would be interpolated into
+    // every particle near this texel.
+    if (dot(psi, psi) == 0.0) {
+        fragColor = vec4(0.0);
+        return;
+    }
+    complex invPsi = inv(psi);
+    vec2 velocity = (hbar/m)*vec2(
+        imag(mul(gradPsi.xy, invPsi)),
+        imag(mul(gradPsi.zw, invPsi)));
+    fragColor = vec4(velocity, velocity);
+}
@@ -0,0 +1,27 @@
+/* Output the weight of each particle, for adding up the
+weighted particles into a density.*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+// Weights of the particles, in the same layout as coordTex
+// in density-splat.vert, so that UV gives this particle's weight.
+uniform sampler2D weightTex;
+
+void main() {
+    fragColor = vec4(texture2D(weightTex, UV).r);
+}
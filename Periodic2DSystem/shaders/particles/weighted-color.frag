@@ -0,0 +1,29 @@
+/* Give each particle a uniform rgba color, where the alpha is
+scaled by the particle's weight.*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform vec4 color;
+// Weights of the particles, in the same layout as coordTex
+// in circles-display.vert, so that UV gives this particle's weight.
+uniform sampler2D weightTex;
+
+void main() {
+    float weight = texture2D(weightTex, UV).r;
+    fragColor = vec4(color.rgb, min(color.a*weight, 1.0));
+}
@@ -0,0 +1,64 @@
+/* Generate a new wave packet on a 3D grid, where the slices of
+the grid are laid out as tiles of a 2D texture. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+#define complex vec2
+
+#define PI 3.141592653589793
+
+// wave number of the wave packet (w.r.t. simulation domains)
+uniform vec3 waveNumber;
+// Position Offset of the wave packet in 3D texture coordinates
+uniform vec3 texOffset;
+// Amplitude of the wave packet
+uniform float amplitude;
+// Standard deviation of the wave packet, in 3D texture coordinates
+uniform vec3 sigmaXYZ;
+
+uniform ivec3 texelDimensions3D;
+uniform ivec2 textureDimensions2D;
+
+/* 3D texture coordinates of the texel at the 2D texture
+coordinate uv. */
+vec3 to3DTextureCoordinates(vec2 uv) {
+    vec2 texel = floor(uv*vec2(textureDimensions2D));
+    vec3 size = vec3(texelDimensions3D);
+    float tilesAcross = floor(
+        float(textureDimensions2D[0])/size.x + 0.5);
+    vec2 tile = floor((texel + 0.5)/size.xy);
+    vec3 r = vec3(texel - tile*size.xy, tile.y*tilesAcross + tile.x);
+    return (r + 0.5)/size;
+}
+
+complex wavepacket(vec3 r) {
+    vec3 g3 = exp(-0.25*(r/sigmaXYZ)*(r/sigmaXYZ))
+        /sqrt(sigmaXYZ*sqrt(2.0*PI));
+    float g = g3.x*g3.y*g3.z;
+    float phase = 2.0*PI*dot(waveNumber, r);
+    return amplitude*g*complex(cos(phase), sin(phase));
+}
+
+void main() {
+    // Only the nearest periodic image of the packet is used, since
+    // the others are negligible for the sizes of new wave packets.
+    vec3 r = to3DTextureCoordinates(UV) - texOffset;
+    r -= floor(r + 0.5);
+    complex w = wavepacket(r);
+    fragColor = vec4(w, w);
+}
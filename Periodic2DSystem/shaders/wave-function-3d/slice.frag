@@ -0,0 +1,54 @@
+/* Planar slice of a 3D grid, where the slices of the grid
+are laid out as tiles of a 2D texture. The slice is either of
+the xy, yz, or xz plane, at the given offset along the remaining
+axis, and the values along the plane are sampled at the nearest
+texels, to match the grid. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D tex;
+uniform ivec3 texelDimensions3D;
+uniform ivec2 textureDimensions2D;
+
+// 0 for the xy plane, 1 for the yz plane, and 2 for the xz plane.
+uniform int orientation;
+// Offset along the axis normal to the plane,
+// in normalized coordinates.
+uniform float offset;
+
+vec2 to2DTextureCoordinates(vec3 r) {
+    vec3 size = vec3(texelDimensions3D);
+    r = mod(r, size);
+    float tilesAcross = floor(
+        float(textureDimensions2D[0])/size.x + 0.5);
+    vec2 tile = vec2(mod(r.z, tilesAcross), floor(r.z/tilesAcross + 0.001));
+    return (tile*size.xy + r.xy + 0.5)/vec2(textureDimensions2D);
+}
+
+void main() {
+    vec3 uvw;
+    if (orientation == 1)
+        uvw = vec3(offset, UV.x, UV.y);
+    else if (orientation == 2)
+        uvw = vec3(UV.x, offset, UV.y);
+    else
+        uvw = vec3(UV.x, UV.y, offset);
+    vec3 size = vec3(texelDimensions3D);
+    vec3 r = min(floor(uvw*size), size - 1.0);
+    fragColor = texture2D(tex, to2DTextureCoordinates(r));
+}
@@ -0,0 +1,120 @@
+/* Leapfrog time step of a wave function on a 3D grid, where the
+slices of the grid are laid out as tiles of a 2D texture
+(see get_2d_from_3d_dimensions in gl_wrappers.cpp).*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+ 
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform float m;
+uniform float hbar;
+uniform float dt;
+
+uniform sampler2D psi0Tex;
+uniform sampler2D psi1Tex;
+uniform sampler2D potentialTex;
+
+uniform vec3 dimensions3D;
+uniform ivec3 texelDimensions3D;
+uniform ivec2 textureDimensions2D;
+
+#define complex vec2
+#define complex2 vec4
+
+
+complex mul(complex a, complex b) {
+    return complex(a[0]*b[0] - a[1]*b[1], a[0]*b[1] + a[1]*b[0]);
+}
+
+complex2 mul(complex2 a, complex2 b) {
+    return complex2(mul(a.xy, b.xy), mul(a.zw, b.zw));
+}
+
+/* Texel index (x, y, z) of the 3D grid at the 2D texture
+coordinate uv. */
+vec3 to3DIndex(vec2 uv) {
+    vec2 texel = floor(uv*vec2(textureDimensions2D));
+    vec2 tileSize = vec2(texelDimensions3D.xy);
+    float tilesAcross = floor(
+        float(textureDimensions2D[0])/tileSize.x + 0.5);
+    vec2 tile = floor((texel + 0.5)/tileSize);
+    return vec3(texel - tile*tileSize, tile.y*tilesAcross + tile.x);
+}
+
+/* 2D texture coordinate of the center of the texel at index r,
+which is wrapped around the edges of the 3D grid. */
+vec2 to2DTextureCoordinates(vec3 r) {
+    vec3 size = vec3(texelDimensions3D);
+    r = mod(r, size);
+    float tilesAcross = floor(
+        float(textureDimensions2D[0])/size.x + 0.5);
+    vec2 tile = vec2(mod(r.z, tilesAcross), floor(r.z/tilesAcross + 0.001));
+    return (tile*size.xy + r.xy + 0.5)/vec2(textureDimensions2D);
+}
+
+/* The order of accuracy of the Laplacian, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+complex2 pairSum(sampler2D tex, vec3 r, vec3 offset) {
+    return texture2D(tex, to2DTextureCoordinates(r + offset))
+        + texture2D(tex, to2DTextureCoordinates(r - offset));
+}
+
+/* Central second difference along the direction of a single
+texel offset, without dividing by the grid spacing squared. */
+complex2 secondDifference(sampler2D tex, vec3 r, vec3 offset) {
+    complex2 center = texture2D(tex, UV);
+#if STENCIL_ORDER == 2
+    return -2.0*center + pairSum(tex, r, offset);
+#elif STENCIL_ORDER == 6
+    return -49.0*center/18.0 + 3.0*pairSum(tex, r, offset)/2.0
+        - 3.0*pairSum(tex, r, 2.0*offset)/20.0
+        + pairSum(tex, r, 3.0*offset)/90.0;
+#else
+    return -5.0*center/2.0 + 4.0*pairSum(tex, r, offset)/3.0
+        - pairSum(tex, r, 2.0*offset)/12.0;
+#endif
+}
+
+complex2 laplacian(sampler2D tex) {
+    vec3 r = to3DIndex(UV);
+    vec3 d = dimensions3D/vec3(texelDimensions3D);
+    return secondDifference(tex, r, vec3(1.0, 0.0, 0.0))/(d.x*d.x)
+        + secondDifference(tex, r, vec3(0.0, 1.0, 0.0))/(d.y*d.y)
+        + secondDifference(tex, r, vec3(0.0, 0.0, 1.0))/(d.z*d.z);
+}
+
+complex2 hamiltonian(sampler2D psiTex, sampler2D potentialTex) {
+    complex2 psi = texture2D(psiTex, UV);
+    complex2 laplacianPsi = laplacian(psiTex);
+    float potential = texture2D(potentialTex, UV)[0];
+    return (-hbar*hbar)/(2.0*m)*laplacianPsi + psi*potential;
+}
+
+void main() {
+    complex2 psi0 = texture2D(psi0Tex, UV);
+    complex2 iDt = complex2(0.0, dt, 0.0, dt);
+    complex2 imV = complex2(
+        complex(0.0, texture2D(potentialTex, UV)[1]), 
+        complex(0.0, texture2D(potentialTex, UV)[1]));
+    complex2 psi2 = psi0 
+        - mul(iDt/hbar, hamiltonian(psi1Tex, potentialTex) + mul(psi0, imV));
+    fragColor = psi2;
+}
@@ -0,0 +1,47 @@
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+/* Add a term c_k phi_k of the Chebyshev expansion of the propagator
+to the sum of the previous terms. On the last term, the imaginary
+(absorbing) part of the potential is also applied, as the decay
+exp(Im(V) dt/hbar).
+*/
+
+#define complex vec2
+
+uniform complex coefficient;
+uniform bool isFirst;
+uniform bool isLast;
+uniform float dt;
+uniform float hbar;
+
+uniform sampler2D sumTex;
+uniform sampler2D phiTex;
+uniform sampler2D potentialTex;
+
+complex mul(complex a, complex b) {
+    return complex(a[0]*b[0] - a[1]*b[1], a[0]*b[1] + a[1]*b[0]);
+}
+
+void main() {
+    complex term = mul(coefficient, texture2D(phiTex, UV).xy);
+    complex sum = (isFirst)? term: texture2D(sumTex, UV).xy + term;
+    if (isLast)
+        sum *= exp(texture2D(potentialTex, UV)[1]*dt/hbar);
+    fragColor = vec4(sum, 0.0, 1.0);
+}
@@ -0,0 +1,94 @@
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+/* Chebyshev recurrence for the propagator exp(-i H dt/hbar), where
+the Hamiltonian is scaled so that its spectrum lies within [-1, 1]:
+
+    H_norm = (H - spectrumCenter)/halfWidth,
+    phi_1 = H_norm phi_0,
+    phi_(k+1) = 2 H_norm phi_k - phi_(k-1).
+
+The Hamiltonian uses the same Laplacian as time-step.frag,
+with only the real part of the potential. The imaginary part is
+applied separately in chebyshev-accumulate.frag.
+*/
+
+uniform float m;
+uniform float hbar;
+uniform float spectrumCenter;
+uniform float halfWidth;
+uniform bool isFirst;
+
+uniform sampler2D phiTex;
+uniform sampler2D phiPrevTex;
+uniform sampler2D potentialTex;
+
+uniform vec2 dimensions2D;
+uniform ivec2 textureDimensions2D;
+
+#define complex vec2
+
+/* The order of accuracy of the Laplacian, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+complex pairSum(sampler2D tex, vec2 offset) {
+    return texture2D(tex, UV + offset).xy + texture2D(tex, UV - offset).xy;
+}
+
+/* Central second difference along the direction of a single
+texel offset, without dividing by the grid spacing squared. */
+complex secondDifference(sampler2D tex, vec2 offset) {
+    complex center = texture2D(tex, UV).xy;
+#if STENCIL_ORDER == 2
+    return -2.0*center + pairSum(tex, offset);
+#elif STENCIL_ORDER == 6
+    return -49.0*center/18.0 + 3.0*pairSum(tex, offset)/2.0
+        - 3.0*pairSum(tex, 2.0*offset)/20.0
+        + pairSum(tex, 3.0*offset)/90.0;
+#else
+    return -5.0*center/2.0 + 4.0*pairSum(tex, offset)/3.0
+        - pairSum(tex, 2.0*offset)/12.0;
+#endif
+}
+
+complex laplacian(sampler2D tex) {
+    float du = 1.0/float(textureDimensions2D[0]);
+    float dv = 1.0/float(textureDimensions2D[1]);
+    float dx = dimensions2D[0]/float(textureDimensions2D[0]);
+    float dy = dimensions2D[1]/float(textureDimensions2D[1]);
+    return secondDifference(tex, vec2(du, 0.0))/(dx*dx)
+        + secondDifference(tex, vec2(0.0, dv))/(dy*dy);
+}
+
+void main() {
+    complex phi = texture2D(phiTex, UV).xy;
+    float potential = texture2D(potentialTex, UV)[0];
+    complex hPhi = (-hbar*hbar)/(2.0*m)*laplacian(phiTex)
+        + potential*phi;
+    complex hNormPhi = (hPhi - spectrumCenter*phi)/halfWidth;
+    if (isFirst) {
+        fragColor = vec4(hNormPhi, 0.0, 1.0);
+    } else {
+        complex phiPrev = texture2D(phiPrevTex, UV).xy;
+        fragColor = vec4(2.0*hNormPhi - phiPrev, 0.0, 1.0);
+    }
+}
@@ -39,31 +39,45 @@ complex2 mul(complex2 a, complex2 b) {
     return complex2(mul(a.xy, b.xy), mul(a.zw, b.zw));
 }
 
-complex2 laplacian4thOrder9pt(sampler2D tex) {
+/* The order of accuracy of the Laplacian, which is 2, 4, or 6.
+A variant of this shader is made for each one, by defining
+STENCIL_ORDER before the rest of the source. */
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 4
+#endif
+
+complex2 pairSum(sampler2D tex, vec2 offset) {
+    return texture2D(tex, UV + offset) + texture2D(tex, UV - offset);
+}
+
+/* Central second difference along the direction of a single
+texel offset, without dividing by the grid spacing squared. */
+complex2 secondDifference(sampler2D tex, vec2 offset) {
+    complex2 center = texture2D(tex, UV);
+#if STENCIL_ORDER == 2
+    return -2.0*center + pairSum(tex, offset);
+#elif STENCIL_ORDER == 6
+    return -49.0*center/18.0 + 3.0*pairSum(tex, offset)/2.0
+        - 3.0*pairSum(tex, 2.0*offset)/20.0
+        + pairSum(tex, 3.0*offset)/90.0;
+#else
+    return -5.0*center/2.0 + 4.0*pairSum(tex, offset)/3.0
+        - pairSum(tex, 2.0*offset)/12.0;
+#endif
+}
+
+complex2 laplacian(sampler2D tex) {
     float du = 1.0/float(textureDimensions2D[0]);
     float dv = 1.0/float(textureDimensions2D[1]);
     float dx = dimensions2D[0]/float(textureDimensions2D[0]);
     float dy = dimensions2D[1]/float(textureDimensions2D[1]);
-    complex2 up2, up1, center, down1, down2;
-    complex2 left2, left1, right1, right2;
-    up2 = texture2D(tex, UV + vec2(0.0, 2.0*dv));
-    up1 = texture2D(tex, UV + vec2(0.0, dv));
-    down1 = texture2D(tex, UV + vec2(0.0, -dv));
-    down2 = texture2D(tex, UV + vec2(0.0, -2.0*dv));
-    left2 = texture2D(tex, UV + vec2(-2.0*du, 0.0));
-    left1 = texture2D(tex, UV + vec2(-du, 0.0));
-    right1 = texture2D(tex, UV + vec2(du, 0.0));
-    right2 = texture2D(tex, UV + vec2(2.0*du, 0.0));
-    center = texture2D(tex, UV);
-    return (-right2/12.0 + 4.0*right1/3.0 - 5.0*center/2.0 
-	         + 4.0*left1/3.0 - left2/12.0)/(dx*dx)
-    	    + (-up2/12.0 + 4.0*up1/3.0 - 5.0*center/2.0
-	            + 4.0*down1/3.0 - down2/12.0)/(dy*dy);
+    return secondDifference(tex, vec2(du, 0.0))/(dx*dx)
+        + secondDifference(tex, vec2(0.0, dv))/(dy*dy);
 }
 
 complex2 hamiltonian(sampler2D psiTex, sampler2D potentialTex) {
     complex2 psi = texture2D(psiTex, UV);
-    complex2 laplacianPsi = laplacian4thOrder9pt(psiTex);
+    complex2 laplacianPsi = laplacian(psiTex);
     float potential = texture2D(potentialTex, UV)[0];
     return (-hbar*hbar)/(2.0*m)*laplacianPsi + psi*potential;
 }
@@ -2,14 +2,24 @@
 #include "trajectories_wire_frame.hpp"
 #include "metropolis.hpp"
 #include "bmp.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
 
 using namespace sim_2d;
 
+/* Number of terms past the argument of the Bessel functions for which
+they are found. Past this many, the terms are far smaller than
+single precision can represent. */
+#define MAX_CHEBYSHEV_EXTRA_TERMS 64
+
 
 static const std::vector<float> QUAD_VERTICES = {
     -1.0, -1.0, 0.0, -1.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0, -1.0, 0.0};
 static const std::vector<int> QUAD_ELEMENTS = {0, 1, 2, 0, 2, 3};
-static WireFrame get_quad_wire_frame() {
+WireFrame get_quad_wire_frame() {
     return WireFrame(
         {{"position", Attribute{
             3, GL_FLOAT, false,
@@ -19,7 +29,7 @@ static WireFrame get_quad_wire_frame() {
     );
 }
 
-static struct IVec2 decompose(unsigned int n) {
+struct IVec2 decompose(unsigned int n) {
     struct IVec2 d = {.ind={(int)n, 1}};
     int i = 1;
     for (; i*i < n; i++) {}
@@ -29,6 +39,20 @@ static struct IVec2 decompose(unsigned int n) {
     return d;
 }
 
+unsigned int make_stencil_program(
+    const std::string &path, int order) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Unable to open %s.\n", path.c_str());
+        return 0;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return Quad::make_program_from_source(
+        "#define STENCIL_ORDER " + std::to_string(order) + "\n"
+        + contents.str());
+}
+
 Programs::Programs() {
     this->copy = Quad::make_program_from_path(
         "./shaders/util/copy.frag"
@@ -57,18 +81,32 @@ Programs::Programs() {
     this->modify_potential_entry = Quad::make_program_from_path(
         "./shaders/potential/modify-potential-entry.frag"
     );
-    this->time_step = Quad::make_program_from_path(
-        "./shaders/wave-function/time-step.frag"
+    for (int i = 0; i < STENCIL_ORDER_COUNT; i++) {
+        this->time_step[i] = make_stencil_program(
+            "./shaders/wave-function/time-step.frag", STENCIL_ORDERS[i]);
+        this->chebyshev_step[i] = make_stencil_program(
+            "./shaders/wave-function/chebyshev-step.frag",
+            STENCIL_ORDERS[i]);
+        this->guide[i] = make_stencil_program(
+            "./shaders/particles/guide.frag", STENCIL_ORDERS[i]);
+        this->velocity_field[i] = make_stencil_program(
+            "./shaders/particles/velocity-field.frag", STENCIL_ORDERS[i]);
+    }
+    this->interpolate_velocity = Quad::make_program_from_path(
+        "./shaders/particles/interpolate-velocity.frag"
+    );
+    this->chebyshev_accumulate = Quad::make_program_from_path(
+        "./shaders/wave-function/chebyshev-accumulate.frag"
     );
     this->init_wave_packet = Quad::make_program_from_path(
         "./shaders/wave-function/gaussian.frag"
     );
-    this->guide = Quad::make_program_from_path(
-        "./shaders/particles/guide.frag"
-    );
     this->rk4 = Quad::make_program_from_path(
         "./shaders/integration/rk4.frag"
     );
+    this->adaptive_rk4 = Quad::make_program_from_path(
+        "./shaders/integration/adaptive-rk4.frag"
+    );
     this->forward_euler = Quad::make_program_from_path(
         "./shaders/integration/forward-euler.frag"
     );
@@ -76,6 +114,21 @@ Programs::Programs() {
         "./shaders/particles/circles-display.vert",
         "./shaders/util/uniform-color.frag"
     );
+    this->display_weighted_circles = make_program_from_paths(
+        "./shaders/particles/circles-display.vert",
+        "./shaders/particles/weighted-color.frag"
+    );
+    this->splat_particles = make_program_from_paths(
+        "./shaders/particles/density-splat.vert",
+        "./shaders/util/uniform-color.frag"
+    );
+    this->splat_weighted_particles = make_program_from_paths(
+        "./shaders/particles/density-splat.vert",
+        "./shaders/particles/weight.frag"
+    );
+    this->display_particle_density = Quad::make_program_from_path(
+        "./shaders/particles/density-display.frag"
+    );
     this->user_defined = 0;
 }
 
@@ -119,6 +172,7 @@ Frames(const TextureParams &default_tex_params, const SimParams &params):
     },
     trajectories {
         .particles{Quad(trajectories_tex_params)},
+        .weights{Quad(trajectories_tex_params)},
         .tmp{Quad(trajectories_tex_params)},
         .rk4{
             Quad(trajectories_tex_params),
@@ -129,42 +183,90 @@ Frames(const TextureParams &default_tex_params, const SimParams &params):
     },
     potential(Quad(wave_sim_tex_params)),
     tmp(Quad(wave_sim_tex_params)),
+    velocity{
+        Quad(wave_sim_tex_params),
+        Quad(wave_sim_tex_params),
+        Quad(wave_sim_tex_params)},
+    chebyshev{
+        Quad(wave_sim_tex_params),
+        Quad(wave_sim_tex_params),
+        Quad(wave_sim_tex_params),
+        Quad(wave_sim_tex_params)},
     render_intermediates{
         RenderTarget(view_higher_res_tex_params),
         RenderTarget(view_higher_res_tex_params),
         RenderTarget(view_higher_res_tex_params)},
     particles_view(RenderTarget(view_higher_res_tex_params)),
+    particle_density(RenderTarget({
+        .format=GL_R32F,
+        .width=view_higher_res_tex_params.width,
+        .height=view_higher_res_tex_params.height,
+        .generate_mipmap=0,
+        .min_filter=GL_NEAREST,
+        .mag_filter=GL_NEAREST,
+        .wrap_s=view_higher_res_tex_params.wrap_s,
+        .wrap_t=view_higher_res_tex_params.wrap_t
+    })),
     render(view_higher_res_tex_params),
     quad_wire_frame(get_quad_wire_frame()),
-    trajectories_wire_frame(get_trajectories_wire_frame(
-        decompose(params.numberOfParticles)
-    )) {
+    trajectories_wire_frame(get_circle_wire_frame()),
+    trajectories_points_wire_frame(get_point_wire_frame()) {
+    trajectories_wire_frame.set_instance_count(
+        trajectories_tex_params.width*trajectories_tex_params.height);
+    trajectories_points_wire_frame.set_instance_count(
+        trajectories_tex_params.width*trajectories_tex_params.height);
 }
 
 void Frames::reset_wave_function_dimensions(IVec2 texel_dimensions2d) {
     this->wave_sim_tex_params.width = texel_dimensions2d[0];
-    this->wave_sim_tex_params.width = texel_dimensions2d[0];
+    this->wave_sim_tex_params.height = texel_dimensions2d[1];
     potential.reset(this->wave_sim_tex_params);
     this->tmp.reset(this->wave_sim_tex_params);
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < 3; i++) {
         this->psi[i].reset(this->wave_sim_tex_params);
+        this->velocity[i].reset(this->wave_sim_tex_params);
+    }
+    for (int i = 0; i < 4; i++)
+        this->chebyshev[i].reset(this->wave_sim_tex_params);
 
 }
 
 void Frames::reset_trajectories_dimensions(int number_of_particles) {
-    IVec2 dimensions = decompose(number_of_particles);
+    this->reset_trajectories_dimensions(decompose(number_of_particles));
+}
+
+void Frames::reset_trajectories_dimensions(IVec2 dimensions) {
     this->trajectories_tex_params.width = dimensions[0];
     this->trajectories_tex_params.height = dimensions[1];
     this->trajectories.particles.reset(this->trajectories_tex_params);
+    this->trajectories.weights.reset(this->trajectories_tex_params);
     for (int i = 0; i <= 4; i++)
         this->trajectories.rk4[i].reset(this->trajectories_tex_params);
     this->trajectories.tmp.reset(this->trajectories_tex_params);
-    trajectories_wire_frame = get_trajectories_wire_frame(dimensions);
+    trajectories_wire_frame.set_instance_count(
+        dimensions[0]*dimensions[1]);
+    trajectories_points_wire_frame.set_instance_count(
+        dimensions[0]*dimensions[1]);
+}
+
+static void encode_bmp(
+    const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height, [[maybe_unused]] void *encoder_data) {
+    write_bmp(fname, pixels, width, height);
 }
 
 Simulation::
 Simulation(const TextureParams &default_tex_params, const SimParams &params
-) : m_programs(Programs()), m_frames(default_tex_params, params) {
+) : m_programs(Programs()), m_frames(default_tex_params, params),
+    m_frame_recorder(encode_bmp), m_screenshot_count(0),
+    // A single encoder thread keeps the video frames in order.
+    m_video_recorder(VideoStream::encode, 1, 8, &m_video_stream),
+    m_video_recording(false), m_monitoring_drift(false) {
+    m_cpu_frames.stale = true;
+    m_cpu_frames.particles_stale = true;
+    m_particle_steps_since_sort = 0;
+    m_live_particle_count = 0;
+    m_particle_steps_since_compaction = 0;
     m_psi_ptr[0] = &m_frames.psi[0];
     m_psi_ptr[1] = &m_frames.psi[1];
     m_psi_ptr[2] = &m_frames.psi[2];
@@ -181,6 +283,8 @@ void Simulation::new_wave_function(
     const SimParams &params, Vec2 tex_position, Vec2 wave_num
 ) {
     m_time_step_count = 0;
+    m_cpu_frames.stale = true;
+    m_drift_monitor.reset();
     float sigma = params.waveFuncSize;
     for (int i = 0; i < 3; i++)
         m_psi_ptr[i]->draw(
@@ -209,13 +313,11 @@ static double gaussian(const std::vector<double> &r, void *void_params) {
     return gx*gy;
 }
 
-void Simulation::new_particles(
+/* Place particles with the Metropolis algorithm, for a Gaussian
+wave packet centred at tex_position.*/
+static void metropolis_particles(
+    std::vector<float> &configs_f,
     const SimParams &params, Vec2 tex_position) {
-    int old_number_of_particles 
-        = m_frames.trajectories_tex_params.width
-            *m_frames.trajectories_tex_params.height;
-    if (old_number_of_particles != params.numberOfParticles)
-        m_frames.reset_trajectories_dimensions(params.numberOfParticles);
     std::vector<double> x0 = {
     (double)tex_position.x, (double)tex_position.y};
     std::vector<double> delta = {
@@ -232,15 +334,64 @@ void Simulation::new_particles(
         (void *)&gaussian_params);
     // for (int i = 0; i < params.numberOfParticles; i++)
     //     printf("%g, %g\n", configs[2*i], configs[2*i + 1]);
-    std::vector<float> configs_f 
-        = std::vector<float>(params.numberOfParticles*2); 
+    configs_f.resize(params.numberOfParticles*2);
     for (int i = 0; i < params.numberOfParticles; i++) {
         float x = configs[2*i];
         float y = configs[2*i + 1];
         configs_f[2*i] = x*params.waveSimulationDimensions[0];
         configs_f[2*i + 1] = y*params.waveSimulationDimensions[1];
     }
-    m_frames.trajectories.particles.set_pixels(&configs_f[0]);
+}
+
+/* Place the particles with the probability density |psi|^2 of the
+current wave function, either at random using an alias table of its
+texels, or at quasi-random points through its inverse distribution.
+Weighted particles are placed with the density |psi| instead.
+This only falls back on sampling a Gaussian at tex_position with the
+Metropolis algorithm when psi is zero everywhere.*/
+void Simulation::new_particles(
+    const SimParams &params, Vec2 tex_position) {
+    int old_number_of_particles 
+        = m_frames.trajectories_tex_params.width
+            *m_frames.trajectories_tex_params.height;
+    if (old_number_of_particles != params.numberOfParticles)
+        m_frames.reset_trajectories_dimensions(params.numberOfParticles);
+    CPUFrames &cpu = m_cpu_frames;
+    int width = m_frames.wave_sim_tex_params.width;
+    int height = m_frames.wave_sim_tex_params.height;
+    cpu.staging.resize(2*width*height);
+    m_psi_ptr[1]->fill_array_with_contents(&cpu.staging[0]);
+    // New particles only have weights if they are placed as
+    // weighted particles.
+    cpu.particles.w.clear();
+    std::random_device rand_device;
+    uint64_t seed = ((uint64_t)rand_device() << 32) | rand_device();
+    enum ParticlePlacement {RANDOM=0, QUASI_RANDOM=1};
+    float simulation_width = params.waveSimulationDimensions[0];
+    float simulation_height = params.waveSimulationDimensions[1];
+    bool placed = (params.particlePlacement.selected == QUASI_RANDOM)?
+        m_particle_sampler.sample_quasi_random(
+            cpu.particles, params.numberOfParticles,
+            &cpu.staging[0], width, height,
+            simulation_width, simulation_height, seed, m_thread_pool,
+            params.weightedParticles):
+        m_particle_sampler.sample(
+            cpu.particles, params.numberOfParticles,
+            &cpu.staging[0], width, height,
+            simulation_width, simulation_height, seed, m_thread_pool,
+            params.weightedParticles);
+    if (placed) {
+        cpu.staging.resize(2*params.numberOfParticles);
+        cpu.particles.to_interleaved(&cpu.staging[0], m_thread_pool);
+        m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+        this->upload_particle_weights();
+        cpu.particles_stale = false;
+    } else {
+        metropolis_particles(cpu.staging, params, tex_position);
+        m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+        cpu.particles_stale = true;
+    }
+    this->reset_particle_ids();
     if (params.showTrails)
         m_frames.particles_view.clear();
 }
@@ -268,25 +419,63 @@ const RenderTarget &Simulation
     if (!params.showTrails)
         m_frames.particles_view.clear();
     float particle_brightness = params.brightnessParticles;
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    m_frames.particles_view.draw(
-        m_programs.display_circles,
-        {
-            {"coordTex", &m_frames.trajectories.particles},
-            {"circleRadius", 0.001F},
-            {"dimensions2D", params.waveSimulationDimensions},
-            {"color", 
-                    Vec4{
-                        .r=1.0,
-                        .g=1.0,
-                        .b=1.0,
-                        .a=particle_brightness
-                    }
-                }
-        },
-        m_frames.trajectories_wire_frame
-    );
+    float circle_radius = 0.001F;
+    Vec4 particle_color {.r=1.0, .g=1.0, .b=1.0, .a=particle_brightness};
+    // Weighted particles are drawn with their weights as their alpha.
+    bool weighted = !m_cpu_frames.particles.w.empty();
+    int particle_count = m_frames.trajectories_tex_params.width
+        *m_frames.trajectories_tex_params.height;
+    if (particle_count > params.particleDensityBudget) {
+        // Past the budget, the time spent blending the overlapping
+        // circles grows too quickly, so each particle is instead
+        // added to its pixel as a single point, and the density that
+        // this gives is drawn over the view in one pass. The circles
+        // are in texture coordinates, so one covers this many pixels.
+        IVec2 view_size = m_frames.particles_view.texture_dimensions();
+        float circle_texels = 3.141592653589793F*circle_radius*circle_radius
+            *view_size[0]*view_size[1];
+        m_frames.particle_density.clear();
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        m_frames.particle_density.draw(
+            (weighted)?
+                m_programs.splat_weighted_particles:
+                m_programs.splat_particles,
+            {
+                {"coordTex", &m_frames.trajectories.particles},
+                {"weightTex", &m_frames.trajectories.weights},
+                {"dimensions2D", params.waveSimulationDimensions},
+                {"color", Vec4{.r=1.0, .g=1.0, .b=1.0, .a=1.0}}
+            },
+            m_frames.trajectories_points_wire_frame
+        );
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        m_frames.particles_view.draw(
+            m_programs.display_particle_density,
+            {
+                {"densityTex", &m_frames.particle_density},
+                {"circleTexels", circle_texels},
+                {"color", particle_color}
+            },
+            m_frames.quad_wire_frame
+        );
+    } else {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        m_frames.particles_view.draw(
+            (weighted)?
+                m_programs.display_weighted_circles:
+                m_programs.display_circles,
+            {
+                {"coordTex", &m_frames.trajectories.particles},
+                {"weightTex", &m_frames.trajectories.weights},
+                {"circleRadius", circle_radius},
+                {"dimensions2D", params.waveSimulationDimensions},
+                {"color", particle_color}
+            },
+            m_frames.trajectories_wire_frame
+        );
+    }
     glDisable(GL_BLEND);
     m_frames.render.draw(
         m_programs.add3,
@@ -314,49 +503,56 @@ const RenderTarget &Simulation
         );
     }
     if (params.takeScreenshots.is_recording) {
-        std::vector<unsigned char> image_rgba_arr(
-            4*params.takeScreenshots.width*params.takeScreenshots.height,
-            0
-        );
-        BMPHeader header (
-            params.takeScreenshots.width, 
-            params.takeScreenshots.height);
-        memcpy(
-            (unsigned char *)&m_image_data[0], 
-            &header, sizeof(BMPHeader));
+        #ifndef __EMSCRIPTEN__
+        m_frame_recorder.push(
+            m_frames.render,
+            "pilot2d_" + std::to_string(m_screenshot_count++) + ".bmp",
+            params.screenshotPolicy.selected);
+        #else
+        // The image is downloaded from main as soon as this returns,
+        // so it must be read back right away.
+        m_image_rgba.resize(
+            4*params.takeScreenshots.width*params.takeScreenshots.height);
         m_frames.render.fill_array_with_contents(
-            (unsigned char *)&image_rgba_arr[0]);
-        for (int i = 0; i < params.takeScreenshots.height; i++) {
-            for (int j = 0; j < params.takeScreenshots.width; j++) {
-                // unsigned char a = image_rgba_arr[
-                //     4*(i*params.takeScreenshots.width + j)];
-                unsigned char r = image_rgba_arr[
-                    4*(i*params.takeScreenshots.width + j)];
-                unsigned char g = image_rgba_arr[
-                    4*(i*params.takeScreenshots.width + j) + 1];
-                unsigned char b = image_rgba_arr[
-                    4*(i*params.takeScreenshots.width + j) + 2];
-                m_image_data[
-                    54 + 3*(i*params.takeScreenshots.width + j)
-                ] = r;
-                m_image_data[
-                    54 + 3*(i*params.takeScreenshots.width + j) + 1
-                ] = g;
-                m_image_data[
-                    54 + 3*(i*params.takeScreenshots.width + j) + 2
-                ] = b;
-            }
-        }
-        BMPHeader *header_ptr = (BMPHeader *)(&m_image_data[0]);
-        int max_val = 0;
-        for (int i = 54; i < m_image_data.size(); i++)
-            max_val = (m_image_data[i] > max_val)? m_image_data[i]: max_val;
-        printf("Max val: %d\n", max_val);
-        print_bmp_header(*header_ptr);
+            (unsigned char *)&m_image_rgba[0]);
+        fill_bmp_image(
+            m_image_data, &m_image_rgba[0],
+            params.takeScreenshots.width, params.takeScreenshots.height, 4);
+        #endif
     }
+    #ifndef __EMSCRIPTEN__
+    this->record_video(params);
+    #endif
     return m_frames.render;
 }
 
+/* Start or stop the video stream when the videoRecord parameter
+changes, and queue the current frame to be written to it.*/
+void Simulation::record_video(const SimParams &params) {
+    if (params.videoRecord != m_video_recording) {
+        // The stream is only ever written to by the encoder thread,
+        // so it must be idle before the stream is changed.
+        m_video_recorder.wait();
+        m_video_stream.close();
+        m_video_recording = params.videoRecord;
+        if (m_video_recording) {
+            enum {Y4M_FILE=0, RAW_FILE=1, Y4M_STDOUT=2, RAW_STDOUT=3};
+            int selected = params.videoFormat.selected;
+            int format = (selected == RAW_FILE || selected == RAW_STDOUT)?
+                VideoStream::RAW_RGB: VideoStream::Y4M;
+            std::string fname = (selected == Y4M_STDOUT
+                                 || selected == RAW_STDOUT)? "-":
+                "pilot2d_" + std::to_string(m_screenshot_count)
+                + ((format == VideoStream::Y4M)? ".y4m": ".rgb");
+            IVec2 d = m_frames.render.texture_dimensions();
+            m_video_stream.open(fname, d[0], d[1], format);
+        }
+    }
+    if (m_video_stream.is_open())
+        m_video_recorder.push(
+            m_frames.render, "", params.screenshotPolicy.selected);
+}
+
 void Simulation::compute_guide(
     Quad &q2, const Quad *wave, const Quad &q,
         const SimParams &params) {
@@ -364,7 +560,7 @@ void Simulation::compute_guide(
         m_frames.wave_sim_tex_params.min_filter != GL_LINEAR ||
         m_frames.wave_sim_tex_params.mag_filter != GL_LINEAR);
     q2.draw(
-        m_programs.guide,
+        m_programs.guide[params.stencilOrder.selected],
         {
             {"hbar", params.hbar},
             {"m", params.m},
@@ -388,7 +584,7 @@ void Simulation::compute_guide(
         m_frames.wave_sim_tex_params.mag_filter != GL_LINEAR);
     // printf("Use nearest sampling: %d\n", use_nearest_sampling);
     q2.draw(
-        m_programs.guide,
+        m_programs.guide[params.stencilOrder.selected],
         {
             {"hbar", params.hbar},
             {"m", params.m},
@@ -403,62 +599,544 @@ void Simulation::compute_guide(
     );
 }
 
+/* Find the velocity (hbar/m) Im(grad psi/psi) at every texel
+of the grid, so that each stage of the particle guide only has
+to interpolate it.*/
+void Simulation::compute_velocity_field(
+    Quad &velocity, const Quad *wave, const SimParams &params) {
+    velocity.draw(
+        m_programs.velocity_field[params.stencilOrder.selected],
+        {
+            {"hbar", params.hbar},
+            {"m", params.m},
+            {"psiTex", wave},
+            {"dimensions2D", params.waveSimulationDimensions},
+            {"textureDimensions2D", params.waveDiscretizationDimensions}
+        }
+    );
+}
+
+void Simulation::interpolate_velocity(
+    Quad &q2, const Quad &velocity,
+    const Quad &q, double dt, const Quad &q_dot,
+    const SimParams &params) {
+    bool use_nearest_sampling = (
+        m_frames.wave_sim_tex_params.min_filter != GL_LINEAR ||
+        m_frames.wave_sim_tex_params.mag_filter != GL_LINEAR);
+    q2.draw(
+        m_programs.interpolate_velocity,
+        {
+            {"velocityTex", &velocity},
+            {"qTex", &q},
+            {"dt", dt},
+            {"qDotTex", &q_dot},
+            {"nearestSamplingOnly", int(use_nearest_sampling)},
+            {"dimensions2D", params.waveSimulationDimensions},
+            {"textureDimensions2D", params.waveDiscretizationDimensions},
+            {"imposeAbsorbingBoundaries", int(params.addAbsorbingBoundaries)}
+        }
+    );
+}
+
 void Simulation::trajectories_time_step_rk4(const SimParams &params) {
+    m_cpu_frames.particles_stale = true;
     m_frames.trajectories.rk4[0].draw(
         m_programs.copy,
         {
             {"tex", &m_frames.trajectories.particles}
         });
     float dt = params.dt;
-    // q1
-    this->compute_guide(
-        m_frames.trajectories.rk4[1],
-        m_psi_ptr[0],
-        m_frames.trajectories.particles, 
-        params);
-    // q2
-    this->compute_guide(
-        m_frames.trajectories.rk4[2], 
-        m_psi_ptr[1],
-        m_frames.trajectories.particles, dt/2.0, m_frames.trajectories.rk4[1],
-        params);
-    // q3
-    this->compute_guide(
-        m_frames.trajectories.rk4[3], 
-        m_psi_ptr[1],
-        m_frames.trajectories.particles, dt/2.0, m_frames.trajectories.rk4[2],
-        params);
-    // q4
-    this->compute_guide(
-        m_frames.trajectories.rk4[4], 
-        m_psi_ptr[2],
-        m_frames.trajectories.particles, dt, m_frames.trajectories.rk4[3],
-        params);
-    m_frames.trajectories.particles.draw(
-        m_programs.rk4,
-        {
-            {"qTex", &m_frames.trajectories.rk4[0]},
-            {"qDotTex1", &m_frames.trajectories.rk4[1]},
-            {"qDotTex2", &m_frames.trajectories.rk4[2]},
-            {"qDotTex3", &m_frames.trajectories.rk4[3]},
-            {"qDotTex4", &m_frames.trajectories.rk4[4]},
-            {"dt", params.dt},
-            {"periodicizeResult", int(true)},
-            {"minBoundaryVal", Vec4{.ind={0.0}}},
-            {"domainDimensions", Vec4{.ind{
-                   params.waveSimulationDimensions[0],
-                   params.waveSimulationDimensions[1],
-                   params.waveSimulationDimensions[0],
-                   params.waveSimulationDimensions[1]}}},
+    // The middle two stages both use psi1, so only three velocity
+    // fields are needed. The adaptive substeps always use them.
+    if (params.interpolateVelocityField || params.adaptiveSubsteps) {
+        for (int i = 0; i < 3; i++)
+            this->compute_velocity_field(
+                m_frames.velocity[i], m_psi_ptr[i], params);
+    }
+    if (params.interpolateVelocityField) {
+        const Quad &q = m_frames.trajectories.particles;
+        this->interpolate_velocity(
+            m_frames.trajectories.rk4[1], m_frames.velocity[0],
+            q, 0.0, q, params);
+        this->interpolate_velocity(
+            m_frames.trajectories.rk4[2], m_frames.velocity[1],
+            q, dt/2.0, m_frames.trajectories.rk4[1], params);
+        this->interpolate_velocity(
+            m_frames.trajectories.rk4[3], m_frames.velocity[1],
+            q, dt/2.0, m_frames.trajectories.rk4[2], params);
+        this->interpolate_velocity(
+            m_frames.trajectories.rk4[4], m_frames.velocity[2],
+            q, dt, m_frames.trajectories.rk4[3], params);
+    } else {
+        // q1
+        this->compute_guide(
+            m_frames.trajectories.rk4[1],
+            m_psi_ptr[0],
+            m_frames.trajectories.particles,
+            params);
+        // q2
+        this->compute_guide(
+            m_frames.trajectories.rk4[2],
+            m_psi_ptr[1],
+            m_frames.trajectories.particles,
+            dt/2.0, m_frames.trajectories.rk4[1],
+            params);
+        // q3
+        this->compute_guide(
+            m_frames.trajectories.rk4[3],
+            m_psi_ptr[1],
+            m_frames.trajectories.particles,
+            dt/2.0, m_frames.trajectories.rk4[2],
+            params);
+        // q4
+        this->compute_guide(
+            m_frames.trajectories.rk4[4],
+            m_psi_ptr[2],
+            m_frames.trajectories.particles,
+            dt, m_frames.trajectories.rk4[3],
+            params);
+    }
+    if (params.adaptiveSubsteps) {
+        bool use_nearest_sampling = (
+            m_frames.wave_sim_tex_params.min_filter != GL_LINEAR ||
+            m_frames.wave_sim_tex_params.mag_filter != GL_LINEAR);
+        m_frames.trajectories.particles.draw(
+            m_programs.adaptive_rk4,
+            {
+                {"qTex", &m_frames.trajectories.rk4[0]},
+                {"qDotTex1", &m_frames.trajectories.rk4[1]},
+                {"qDotTex2", &m_frames.trajectories.rk4[2]},
+                {"qDotTex3", &m_frames.trajectories.rk4[3]},
+                {"qDotTex4", &m_frames.trajectories.rk4[4]},
+                {"dt", params.dt},
+                {"velocityTex0", &m_frames.velocity[0]},
+                {"velocityTex1", &m_frames.velocity[1]},
+                {"velocityTex2", &m_frames.velocity[2]},
+                {"nearestSamplingOnly", int(use_nearest_sampling)},
+                {"dimensions2D", params.waveSimulationDimensions},
+                {"textureDimensions2D",
+                    params.waveDiscretizationDimensions},
+                {"imposeAbsorbingBoundaries",
+                    int(params.addAbsorbingBoundaries)},
+                {"tolerance", params.substepTolerance},
+            }
+        );
+    } else {
+        m_frames.trajectories.particles.draw(
+            m_programs.rk4,
+            {
+                {"qTex", &m_frames.trajectories.rk4[0]},
+                {"qDotTex1", &m_frames.trajectories.rk4[1]},
+                {"qDotTex2", &m_frames.trajectories.rk4[2]},
+                {"qDotTex3", &m_frames.trajectories.rk4[3]},
+                {"qDotTex4", &m_frames.trajectories.rk4[4]},
+                {"dt", params.dt},
+                {"periodicizeResult", int(true)},
+                {"minBoundaryVal", Vec4{.ind={0.0}}},
+                {"domainDimensions", Vec4{.ind{
+                       params.waveSimulationDimensions[0],
+                       params.waveSimulationDimensions[1],
+                       params.waveSimulationDimensions[0],
+                       params.waveSimulationDimensions[1]}}},
+            }
+        );
+    }
+}
+
+/* Do the same RK4 step of the particles as trajectories_time_step_rk4,
+but on the CPU with the CPU copies of the wave function, then upload
+the particles so that they can be viewed. This is only called after
+a CPU time step, when the CPU copies are up to date.*/
+void Simulation::cpu_trajectories_time_step_rk4(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    this->copy_particles_to_cpu_frames();
+    GuideParams guide_params = {
+        .m=params.m, .hbar=params.hbar,
+        .width=params.waveSimulationDimensions[0],
+        .height=params.waveSimulationDimensions[1],
+        .stencil_order=STENCIL_ORDERS[params.stencilOrder.selected],
+        .interpolate_velocity_field=params.interpolateVelocityField,
+        .absorbing_boundaries=params.addAbsorbingBoundaries,
+        .adaptive_substeps=params.adaptiveSubsteps,
+        .substep_tolerance=params.substepTolerance,
+    };
+    // The CPU copies have already been rotated by finish_cpu_time_step,
+    // so the wave functions at the start, middle, and end of the step
+    // are in psi[2], psi[0], and psi[1].
+    m_particle_guide.rk4_step(
+        cpu.particles, cpu.psi[2], cpu.psi[0], cpu.psi[1],
+        guide_params, params.dt, m_thread_pool);
+    cpu.particles.to_interleaved(&cpu.staging[0], m_thread_pool);
+    m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+}
+
+/* Read the particles back from their texture, if the CPU copy
+of them is stale.*/
+void Simulation::copy_particles_to_cpu_frames() {
+    CPUFrames &cpu = m_cpu_frames;
+    int count = m_frames.trajectories_tex_params.width
+        *m_frames.trajectories_tex_params.height;
+    cpu.staging.resize(2*count);
+    if (cpu.particles_stale) {
+        m_frames.trajectories.particles.fill_array_with_contents(
+            &cpu.staging[0]);
+        cpu.particles.resize(count);
+        cpu.particles.from_interleaved(&cpu.staging[0], m_thread_pool);
+        cpu.particles_stale = false;
+    }
+}
+
+void Simulation::reset_particle_ids() {
+    m_particle_ids.resize(m_frames.trajectories_tex_params.width
+                          *m_frames.trajectories_tex_params.height);
+    for (size_t k = 0; k < m_particle_ids.size(); k++)
+        m_particle_ids[k] = k;
+    m_particle_steps_since_sort = 0;
+    m_live_particle_count = m_particle_ids.size();
+    m_particle_steps_since_compaction = 0;
+}
+
+/* Sort the particles in Z-order on the CPU, so that the particles
+next to each other in the texture read nearby texels of the wave
+function when they are guided, then upload them again. The trails
+are drawn from the particles of earlier frames, so they do not
+depend on the order of the particles.*/
+void Simulation::sort_particles(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    this->copy_particles_to_cpu_frames();
+    if (m_particle_ids.size() != (size_t)cpu.particles.count())
+        this->reset_particle_ids();
+    m_morton_sort.sort(
+        cpu.particles, m_particle_ids,
+        params.waveSimulationDimensions[0],
+        params.waveSimulationDimensions[1], m_thread_pool);
+    cpu.particles.to_interleaved(&cpu.staging[0], m_thread_pool);
+    m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+    this->upload_particle_weights();
+}
+
+/* Remove the particles that have been absorbed by the boundaries,
+so that they are no longer guided or drawn. The particle texture is
+remade with the smallest dimensions that are close to square and hold
+all of the live particles, so up to one row of absorbed particles
+may be kept. These stay where they are, since the guide does not move
+them. The ids of the kept particles are renumbered, so that checkpoints
+keep the particles in their order from before any were removed.*/
+void Simulation::compact_particles(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    this->copy_particles_to_cpu_frames();
+    if (m_particle_ids.size() != (size_t)cpu.particles.count())
+        this->reset_particle_ids();
+    int count = cpu.particles.count();
+    int live_count = m_particle_compaction.partition(
+        cpu.particles, m_particle_ids,
+        params.waveSimulationDimensions[0],
+        params.waveSimulationDimensions[1], m_thread_pool);
+    m_live_particle_count = live_count;
+    if (live_count == count)
+        return;
+    int width = std::max(1, (int)std::ceil(std::sqrt((double)live_count)));
+    int height = std::max(1, (live_count + width - 1)/width);
+    if (width*height < count) {
+        m_particle_compaction.truncate(
+            cpu.particles, m_particle_ids, width*height);
+        m_frames.reset_trajectories_dimensions(IVec2{.ind={width, height}});
+    }
+    cpu.staging.resize(2*cpu.particles.count());
+    cpu.particles.to_interleaved(&cpu.staging[0], m_thread_pool);
+    m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+    this->upload_particle_weights();
+}
+
+/* Upload the weights of the particles, in their current order,
+if they have any.*/
+void Simulation::upload_particle_weights() {
+    CPUFrames &cpu = m_cpu_frames;
+    if (cpu.particles.w.empty())
+        return;
+    int count = cpu.particles.count();
+    cpu.staging.resize(2*count);
+    m_thread_pool.parallel_for(0, count, [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            cpu.staging[2*n] = cpu.particles.w[n];
+            cpu.staging[2*n + 1] = 0.0F;
         }
-    );
+    }, 16384);
+    m_frames.trajectories.weights.set_pixels(&cpu.staging[0]);
 }
 
-void Simulation::time_step(const SimParams &params) {
+int Simulation::live_particle_count() const {
+    return m_live_particle_count;
+}
+
+/* Copy the current and previous wave functions and the potential
+from their textures to the CPU.*/
+void Simulation::copy_to_cpu_frames() {
+    CPUFrames &cpu = m_cpu_frames;
+    int width = m_frames.wave_sim_tex_params.width;
+    int height = m_frames.wave_sim_tex_params.height;
+    cpu.staging.resize(2*width*height);
+    const Quad *sources[3] = {m_psi_ptr[0], m_psi_ptr[1], &m_frames.potential};
+    ComplexField *destinations[3]
+        = {&cpu.psi[0], &cpu.psi[1], &cpu.potential};
+    for (int i = 0; i < 3; i++) {
+        sources[i]->fill_array_with_contents(&cpu.staging[0]);
+        destinations[i]->resize(width, height);
+        destinations[i]->from_interleaved(&cpu.staging[0], m_thread_pool);
+    }
+    m_split_operator.set_potential_changed();
+    m_adi.set_potential_changed();
+    cpu.stale = false;
+}
+
+void Simulation::upload_cpu_psi(const ComplexField &psi, Quad &quad) {
+    m_cpu_frames.staging.resize(2*psi.width*psi.height);
+    psi.to_interleaved(&m_cpu_frames.staging[0], m_thread_pool);
+    quad.set_pixels(&m_cpu_frames.staging[0]);
+}
+
+/* Do the same time step as the time-step.frag shader, but on the CPU,
+then upload the result so that it can be viewed and used to guide
+the particles.*/
+void Simulation::cpu_time_step(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    if (cpu.stale)
+        this->copy_to_cpu_frames();
+    LeapfrogParams leapfrog_params = {
+        .m=params.m, .hbar=params.hbar, .dt=params.dt,
+        .dx=params.waveSimulationDimensions[0]
+            /float(params.waveDiscretizationDimensions[0]),
+        .dy=params.waveSimulationDimensions[1]
+            /float(params.waveDiscretizationDimensions[1]),
+        .stencil_order=STENCIL_ORDERS[params.stencilOrder.selected],
+    };
+    if (m_time_step_count == 0) {
+        // Initial forward Euler step.
+        LeapfrogParams half_step_params = leapfrog_params;
+        half_step_params.dt = params.dt/2.0;
+        leapfrog_time_step(
+            cpu.psi[1], cpu.psi[0], cpu.psi[0], cpu.potential,
+            half_step_params, m_thread_pool);
+        this->upload_cpu_psi(cpu.psi[1], *m_psi_ptr[1]);
+        m_time_step_count++;
+    }
+    leapfrog_time_step(
+        cpu.psi[2], cpu.psi[0], cpu.psi[1], cpu.potential,
+        leapfrog_params, m_thread_pool);
+    this->finish_cpu_time_step();
+}
+
+/* Upload the newest wave function computed on the CPU, and
+rotate the CPU copies in the same way as m_psi_ptr.*/
+void Simulation::finish_cpu_time_step() {
+    CPUFrames &cpu = m_cpu_frames;
+    this->upload_cpu_psi(cpu.psi[2], *m_psi_ptr[2]);
+    std::swap(cpu.psi[0], cpu.psi[1]);
+    std::swap(cpu.psi[1], cpu.psi[2]);
+}
+
+/* Move psi forward by dt/2 with the split-operator step. Like the
+leapfrog steps, the first step also moves psi1 forward by dt/2 from
+psi0, so that the particles' RK4 stages always see the wave function
+at t, t + dt/2, and t + dt.*/
+void Simulation::split_operator_time_step(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    if (cpu.stale)
+        this->copy_to_cpu_frames();
+    SplitOperatorParams split_operator_params = {
+        .m=params.m, .hbar=params.hbar, .dt=params.dt/2.0F,
+        .width=params.waveSimulationDimensions[0],
+        .height=params.waveSimulationDimensions[1]
+    };
+    if (m_time_step_count == 0) {
+        cpu.psi[1] = cpu.psi[0];
+        m_split_operator.step(
+            cpu.psi[1], cpu.potential, split_operator_params,
+            m_thread_pool);
+        this->upload_cpu_psi(cpu.psi[1], *m_psi_ptr[1]);
+        m_time_step_count++;
+    }
+    cpu.psi[2] = cpu.psi[1];
+    m_split_operator.step(
+        cpu.psi[2], cpu.potential, split_operator_params, m_thread_pool);
+    this->finish_cpu_time_step();
+}
+
+/* Move psi forward by dt/2 with the ADI Crank-Nicolson step, starting
+with the same initial half step as split_operator_time_step.*/
+void Simulation::adi_time_step(const SimParams &params) {
+    CPUFrames &cpu = m_cpu_frames;
+    if (cpu.stale)
+        this->copy_to_cpu_frames();
+    ADIParams adi_params = {
+        .m=params.m, .hbar=params.hbar, .dt=params.dt/2.0F,
+        .dx=params.waveSimulationDimensions[0]
+            /float(params.waveDiscretizationDimensions[0]),
+        .dy=params.waveSimulationDimensions[1]
+            /float(params.waveDiscretizationDimensions[1]),
+    };
+    if (m_time_step_count == 0) {
+        cpu.psi[1] = cpu.psi[0];
+        m_adi.step(cpu.psi[1], cpu.potential, adi_params, m_thread_pool);
+        this->upload_cpu_psi(cpu.psi[1], *m_psi_ptr[1]);
+        m_time_step_count++;
+    }
+    cpu.psi[2] = cpu.psi[1];
+    m_adi.step(cpu.psi[2], cpu.potential, adi_params, m_thread_pool);
+    this->finish_cpu_time_step();
+}
+
+/* Bessel functions of the first kind J_0(x), ..., J_n(x), found using
+Miller's backward recurrence, which unlike the forward recurrence
+stays accurate for orders larger than x.
+
+Reference:
+
+Numerical Recipes in C, 2nd edition, section 6.5.
+*/
+static std::vector<double> bessel_j_sequence(int n, double x) {
+    std::vector<double> j(n + 1, 0.0);
+    if (x == 0.0) {
+        j[0] = 1.0;
+        return j;
+    }
+    int start = 2*((std::max(n, (int)x) + 16 + (int)sqrt(40.0*(n + x)))/2);
+    double j_next = 0.0, j_current = 1e-30, normalization = 0.0;
+    for (int k = start; k > 0; k--) {
+        double j_prev = 2.0*k/x*j_current - j_next;
+        j_next = j_current;
+        j_current = j_prev;
+        if (fabs(j_current) > 1e250) {
+            j_next *= 1e-250;
+            j_current *= 1e-250;
+            normalization *= 1e-250;
+            for (int i = k; i <= n; i++)
+                j[i] *= 1e-250;
+        }
+        if (k - 1 <= n)
+            j[k - 1] = j_current;
+        if ((k - 1) % 2 == 0 && k - 1 > 0)
+            normalization += 2.0*j_current;
+    }
+    // J_0(x) + 2 J_2(x) + 2 J_4(x) + ... = 1
+    normalization += j_current;
+    for (auto &v: j)
+        v /= normalization;
+    return j;
+}
+
+/* Put psi advanced by dt into result, with the Chebyshev expansion
+of the propagator,
+
+    exp(-i H dt/hbar) = exp(-i c dt/hbar) sum_k a_k (-i)^k J_k(r dt/hbar)
+                        T_k((H - c)/r),
+
+where a_0 = 1 and a_k = 2 otherwise, and the spectrum of H lies within
+c - r and c + r. The terms decay faster than exponentially once k
+exceeds r dt/hbar, so the expansion is cut off at the first such term
+that is smaller than the requested accuracy. A single step can then be
+far larger than what the leapfrog scheme allows.
+
+Reference:
+
+H. Tal-Ezer, R. Kosloff, "An accurate and efficient scheme for
+propagating the time dependent Schrödinger equation",
+J. Chem. Phys. 81, 3967 (1984).
+*/
+void Simulation::chebyshev_propagate(
+    Quad *result, const Quad *psi, float dt, const SimParams &params) {
+    float dx = params.waveSimulationDimensions[0]
+        /float(params.waveDiscretizationDimensions[0]);
+    float dy = params.waveSimulationDimensions[1]
+        /float(params.waveDiscretizationDimensions[1]);
+    // The largest eigenvalue of the negative Laplacian is
+    // r/dx^2 + r/dy^2, where r is the spectral radius of the one
+    // dimensional stencil, and modify-potential-entry.frag clamps
+    // the real part of the potential to [-1, 1].
+    double r = laplacian_spectral_radius(
+        STENCIL_ORDERS[params.stencilOrder.selected]);
+    double kinetic_max = params.hbar*params.hbar/(2.0*params.m)
+        *r*(1.0/(dx*dx) + 1.0/(dy*dy));
+    double e_min = -1.0, e_max = kinetic_max + 1.0;
+    double center = 0.5*(e_max + e_min);
+    double half_width = 0.5*(e_max - e_min);
+    double alpha = half_width*dt/params.hbar;
+    double tolerance = pow(10.0, -params.chebyshevDigits);
+    std::vector<double> bessel_j
+        = bessel_j_sequence((int)alpha + MAX_CHEBYSHEV_EXTRA_TERMS, alpha);
+    int term_count = 1;
+    for (; term_count < (int)bessel_j.size(); term_count++)
+        if (term_count > alpha && fabs(bessel_j[term_count]) < tolerance)
+            break;
+    double global_phase = -center*dt/params.hbar;
+    auto phi = [&](int k) -> const Quad * {
+        return (k == 0)? psi: &m_frames.chebyshev[(k - 1) % 3];
+    };
+    auto next_phi = [&](int k) -> Quad * {
+        return &m_frames.chebyshev[(k - 1) % 3];
+    };
+    // The partial sums alternate between these two,
+    // such that the last one is written to result.
+    auto sum = [&](int k) -> Quad * {
+        return ((term_count - 1 - k) % 2 == 0)?
+            result: &m_frames.chebyshev[3];
+    };
+    for (int k = 0; k < term_count; k++) {
+        // a_k (-i)^k J_k(alpha) exp(-i c dt/hbar)
+        double a = ((k == 0)? 1.0: 2.0)*bessel_j[k];
+        double phase = global_phase - 0.5*M_PI*k;
+        sum(k)->draw(
+            m_programs.chebyshev_accumulate,
+            {
+                {"coefficient", Vec2{.x=float(a*cos(phase)),
+                                     .y=float(a*sin(phase))}},
+                {"isFirst", int(k == 0)},
+                {"isLast", int(k == term_count - 1)},
+                {"dt", dt},
+                {"hbar", params.hbar},
+                {"sumTex", (k == 0)? phi(k): sum(k - 1)},
+                {"phiTex", phi(k)},
+                {"potentialTex", &m_frames.potential},
+            }
+        );
+        if (k + 1 < term_count)
+            next_phi(k + 1)->draw(
+                m_programs.chebyshev_step[params.stencilOrder.selected],
+                {
+                    {"m", params.m},
+                    {"hbar", params.hbar},
+                    {"spectrumCenter", float(center)},
+                    {"halfWidth", float(half_width)},
+                    {"isFirst", int(k == 0)},
+                    {"phiTex", phi(k)},
+                    {"phiPrevTex", (k == 0)? phi(k): phi(k - 1)},
+                    {"potentialTex", &m_frames.potential},
+                    {"dimensions2D", params.waveSimulationDimensions},
+                    {"textureDimensions2D",
+                        params.waveDiscretizationDimensions}
+                }
+            );
+    }
+}
+
+/* Move psi forward by dt/2 with the Chebyshev propagator, starting
+with the same initial half step as split_operator_time_step.*/
+void Simulation::chebyshev_time_step(const SimParams &params) {
+    m_cpu_frames.stale = true;
+    float dt = params.dt/2.0F;
+    if (m_time_step_count == 0) {
+        this->chebyshev_propagate(m_psi_ptr[1], m_psi_ptr[0], dt, params);
+        m_time_step_count++;
+    }
+    this->chebyshev_propagate(m_psi_ptr[2], m_psi_ptr[1], dt, params);
+}
+
+void Simulation::gpu_time_step(const SimParams &params) {
+    m_cpu_frames.stale = true;
     if (m_time_step_count == 0) {
         // Initial forward Euler step.
         m_psi_ptr[1]->draw(
-            m_programs.time_step,
+            m_programs.time_step[params.stencilOrder.selected],
             {
                 {"m", params.m},
                 {"hbar", params.hbar},
@@ -473,7 +1151,7 @@ void Simulation::time_step(const SimParams &params) {
         m_time_step_count++;
     }
     m_psi_ptr[2]->draw(
-        m_programs.time_step,
+        m_programs.time_step[params.stencilOrder.selected],
         {
             {"m", params.m},
             {"hbar", params.hbar},
@@ -485,8 +1163,98 @@ void Simulation::time_step(const SimParams &params) {
             {"textureDimensions2D", params.waveDiscretizationDimensions}
         }
     );
+}
+
+/* The backend that the time steps are actually done with, which is
+the selected one unless it cannot be used.*/
+int Simulation::time_step_backend(const SimParams &params) const {
+    enum TimeStepBackend {
+        GPU=0, CPU=1, CPU_SPLIT_OPERATOR=2, CPU_ADI=3, GPU_CHEBYSHEV=4};
+    int backend = params.timeStepBackend.selected;
+    if (backend == CPU_SPLIT_OPERATOR && !SplitOperator::supports(
+            m_frames.wave_sim_tex_params.width,
+            m_frames.wave_sim_tex_params.height)) {
+        static bool reported = false;
+        if (!reported)
+            fprintf(stderr, "The split-operator step needs "
+                    "power of two discretization dimensions; "
+                    "using the CPU leapfrog step instead.\n");
+        reported = true;
+        backend = CPU;
+    }
+    if (backend == CPU_ADI
+        && STENCIL_ORDERS[params.stencilOrder.selected] != 2) {
+        static bool reported = false;
+        if (!reported)
+            fprintf(stderr, "The ADI step only has the second order "
+                    "Laplacian, so the selected stencil order is not "
+                    "used by it.\n");
+        reported = true;
+    }
+    return backend;
+}
+
+/* dt, limited to MAX_LEAPFROG_DT for the leapfrog backends. */
+float Simulation::stable_dt(const SimParams &params) const {
+    enum TimeStepBackend {
+        GPU=0, CPU=1, CPU_SPLIT_OPERATOR=2, CPU_ADI=3, GPU_CHEBYSHEV=4};
+    int backend = this->time_step_backend(params);
+    if ((backend == GPU || backend == CPU) && params.dt > MAX_LEAPFROG_DT)
+        return MAX_LEAPFROG_DT;
+    return params.dt;
+}
+
+float Simulation::time_step_size(const SimParams &params) const {
+    float dt = this->stable_dt(params);
+    return (m_time_step_count == 0)? dt: 0.5F*dt;
+}
+
+void Simulation::time_step(const SimParams &params) {
+    enum TimeStepBackend {
+        GPU=0, CPU=1, CPU_SPLIT_OPERATOR=2, CPU_ADI=3, GPU_CHEBYSHEV=4};
+    int backend = this->time_step_backend(params);
+    if (this->stable_dt(params) != params.dt) {
+        static bool reported = false;
+        if (!reported)
+            fprintf(stderr, "The leapfrog steps are unstable for a time "
+                    "step above %g, so it is limited to that.\n",
+                    MAX_LEAPFROG_DT);
+        reported = true;
+        SimParams limited_params = params;
+        limited_params.dt = MAX_LEAPFROG_DT;
+        this->time_step(limited_params);
+        return;
+    }
+    if (backend == CPU_SPLIT_OPERATOR)
+        this->split_operator_time_step(params);
+    else if (backend == CPU_ADI)
+        this->adi_time_step(params);
+    else if (backend == GPU_CHEBYSHEV)
+        this->chebyshev_time_step(params);
+    else if (backend == CPU)
+        this->cpu_time_step(params);
+    else
+        this->gpu_time_step(params);
     if (m_time_step_count % 2 && m_time_step_count != 0) {
-        trajectories_time_step_rk4(params);
+        // The CPU backends also move the particles on the CPU, so that
+        // neither needs to wait on the other.
+        if (backend == CPU || backend == CPU_SPLIT_OPERATOR
+            || backend == CPU_ADI)
+            cpu_trajectories_time_step_rk4(params);
+        else
+            trajectories_time_step_rk4(params);
+        if (params.sortParticles && ++m_particle_steps_since_sort
+            >= params.particleSortInterval) {
+            this->sort_particles(params);
+            m_particle_steps_since_sort = 0;
+        }
+        // Particles are only ever absorbed with absorbing boundaries.
+        if (params.addAbsorbingBoundaries
+            && ++m_particle_steps_since_compaction
+            >= params.compactionInterval) {
+            this->compact_particles(params);
+            m_particle_steps_since_compaction = 0;
+        }
     }
     Quad *psi_ptr[3] = {m_psi_ptr[1], m_psi_ptr[2], m_psi_ptr[0]};
     for (int i = 0; i < 3; i++)
@@ -494,9 +1262,205 @@ void Simulation::time_step(const SimParams &params) {
     m_time_step_count++;
 }
 
+/* Measure the current wave function on the CPU, using the CPU copy
+when it is up to date, and otherwise reading it from its texture.*/
+WaveFunctionMeasures Simulation::measure_wave_function(
+    const SimParams &params) {
+    MeasureParams measure_params = {
+        .m=params.m, .hbar=params.hbar,
+        .dx=params.waveSimulationDimensions[0]
+            /float(params.waveDiscretizationDimensions[0]),
+        .dy=params.waveSimulationDimensions[1]
+            /float(params.waveDiscretizationDimensions[1]),
+        .stencil_order=STENCIL_ORDERS[params.stencilOrder.selected],
+    };
+    if (!m_cpu_frames.stale)
+        return ::measure_wave_function(
+            m_cpu_frames.psi[1], m_cpu_frames.potential,
+            measure_params, m_thread_pool);
+    int width = m_frames.wave_sim_tex_params.width;
+    int height = m_frames.wave_sim_tex_params.height;
+    m_cpu_frames.staging.resize(2*width*height);
+    const Quad *sources[2] = {m_psi_ptr[1], &m_frames.potential};
+    ComplexField *destinations[2] = {&m_drift_psi, &m_drift_potential};
+    for (int i = 0; i < 2; i++) {
+        sources[i]->fill_array_with_contents(&m_cpu_frames.staging[0]);
+        destinations[i]->resize(width, height);
+        destinations[i]->from_interleaved(
+            &m_cpu_frames.staging[0], m_thread_pool);
+    }
+    return ::measure_wave_function(
+        m_drift_psi, m_drift_potential, measure_params, m_thread_pool);
+}
+
+/* Start the time steps again from the current wave function, as is
+needed after dt changes, since the leapfrog step also uses the
+previous wave function.*/
+void Simulation::restart_time_steps() {
+    m_psi_ptr[0]->draw(
+        m_programs.copy,
+        {{"tex", m_psi_ptr[1]}}
+    );
+    m_time_step_count = 0;
+    m_cpu_frames.stale = true;
+}
+
+/* Every driftCheckInterval steps, measure the norm and energy of the
+wave function, and if either has drifted past driftThreshold, do
+whatever driftAction says. With absorbing boundaries the norm and
+energy are not conserved, so the drift is only logged.*/
+void Simulation::monitor_drift(SimParams &params) {
+    if (params.monitorDrift != m_monitoring_drift) {
+        m_monitoring_drift = params.monitorDrift;
+        if (m_monitoring_drift) {
+            m_drift_monitor.open_log("pilot2d_drift.csv");
+            m_drift_monitor.reset();
+        } else {
+            m_drift_monitor.close_log();
+        }
+    }
+    if (!m_monitoring_drift || params.driftCheckInterval < 1
+        || m_time_step_count % params.driftCheckInterval != 0)
+        return;
+    double drift = m_drift_monitor.record(
+        m_time_step_count, params.t, params.dt,
+        this->measure_wave_function(params));
+    if (drift <= params.driftThreshold || params.addAbsorbingBoundaries)
+        return;
+    enum DriftAction {ONLY_LOG=0, HALVE_DT=1, STOP=2};
+    if (params.driftAction.selected == HALVE_DT) {
+        params.dt *= 0.5;
+        fprintf(stderr, "Drift of %g at t = %g is past the threshold; "
+                "the time step is now %g.\n", drift, params.t, params.dt);
+        this->restart_time_steps();
+        m_drift_monitor.reset();
+    } else if (params.driftAction.selected == STOP) {
+        params.stepsPerFrame = 0;
+        fprintf(stderr, "Drift of %g at t = %g is past the threshold; "
+                "stopping the simulation.\n", drift, params.t);
+        m_drift_monitor.reset();
+    }
+}
+
+/* Write the three wave functions, the potential, and the particle
+positions and any weights to a checkpoint file. The textures are read
+here, but the file is written on another thread.*/
+void Simulation::save_checkpoint(
+    const SimParams &params, const std::string &fname) {
+    CheckpointHeader header = make_checkpoint_header();
+    header.width = m_frames.wave_sim_tex_params.width;
+    header.height = m_frames.wave_sim_tex_params.height;
+    header.particles_width = m_frames.trajectories_tex_params.width;
+    header.particles_height = m_frames.trajectories_tex_params.height;
+    header.simulation_width = params.waveSimulationDimensions[0];
+    header.simulation_height = params.waveSimulationDimensions[1];
+    header.dt = params.dt;
+    header.hbar = params.hbar;
+    header.m = params.m;
+    header.time_step_count = m_time_step_count;
+    header.t = params.t;
+    // The weights are kept on the CPU in the same order
+    // as the particles of the texture.
+    const std::vector<float> &weights = m_cpu_frames.particles.w;
+    size_t count = (size_t)header.particles_width*header.particles_height;
+    header.weighted_particles = weights.size() == count;
+    m_checkpoint_writer.begin(header);
+    const Quad *sources[CHECKPOINT_WEIGHTS] = {
+        m_psi_ptr[0], m_psi_ptr[1], m_psi_ptr[2],
+        &m_frames.potential, &m_frames.trajectories.particles};
+    for (int i = 0; i < CHECKPOINT_WEIGHTS; i++)
+        sources[i]->fill_array_with_contents(m_checkpoint_writer.array(i));
+    // Put the particles back in their original order,
+    // in case they have been sorted.
+    bool reorder = m_particle_ids.size() == count;
+    float *particles = m_checkpoint_writer.array(CHECKPOINT_PARTICLES);
+    if (reorder) {
+        m_cpu_frames.staging.assign(particles, particles + 2*count);
+        for (size_t k = 0; k < count; k++) {
+            particles[2*m_particle_ids[k]] = m_cpu_frames.staging[2*k];
+            particles[2*m_particle_ids[k] + 1]
+                = m_cpu_frames.staging[2*k + 1];
+        }
+    }
+    if (header.weighted_particles) {
+        float *w = m_checkpoint_writer.array(CHECKPOINT_WEIGHTS);
+        for (size_t k = 0; k < count; k++) {
+            size_t n = (reorder)? m_particle_ids[k]: k;
+            w[2*n] = weights[k];
+            w[2*n + 1] = 0.0F;
+        }
+    }
+    m_checkpoint_writer.write(fname);
+}
+
+/* Restore the state saved by save_checkpoint, along with the
+parameters in its header. If the checkpoint's grid or particle count
+differs from the current one, the textures are remade to match.*/
+bool Simulation::load_checkpoint(
+    SimParams &params, const std::string &fname) {
+    // Make sure that a checkpoint to the same file is complete.
+    m_checkpoint_writer.wait();
+    MappedCheckpoint checkpoint;
+    if (!checkpoint.open(fname))
+        return false;
+    const CheckpointHeader &header = checkpoint.header();
+    if (header.width != (int)m_frames.wave_sim_tex_params.width
+        || header.height != (int)m_frames.wave_sim_tex_params.height) {
+        m_frames.reset_wave_function_dimensions(
+            IVec2{.ind={header.width, header.height}});
+        params.waveDiscretizationDimensions[0] = header.width;
+        params.waveDiscretizationDimensions[1] = header.height;
+    }
+    int number_of_particles = header.particles_width*header.particles_height;
+    if (header.particles_width
+        != (int)m_frames.trajectories_tex_params.width
+        || header.particles_height
+        != (int)m_frames.trajectories_tex_params.height) {
+        m_frames.reset_trajectories_dimensions(number_of_particles);
+        params.numberOfParticles = number_of_particles;
+    }
+    for (int i = 0; i < 3; i++)
+        m_psi_ptr[i] = &m_frames.psi[i];
+    Quad *destinations[CHECKPOINT_ARRAY_COUNT] = {
+        m_psi_ptr[0], m_psi_ptr[1], m_psi_ptr[2],
+        &m_frames.potential, &m_frames.trajectories.particles,
+        &m_frames.trajectories.weights};
+    // The mapped arrays are only read from by set_pixels.
+    for (int i = 0; i < CHECKPOINT_ARRAY_COUNT; i++) {
+        if (checkpoint_array_length(header, i) > 0)
+            destinations[i]->set_pixels(
+                const_cast<float *>(checkpoint.array(i)));
+    }
+    params.waveSimulationDimensions[0] = header.simulation_width;
+    params.waveSimulationDimensions[1] = header.simulation_height;
+    params.dt = header.dt;
+    params.hbar = header.hbar;
+    params.m = header.m;
+    params.t = header.t;
+    m_time_step_count = header.time_step_count;
+    m_cpu_frames.stale = true;
+    m_cpu_frames.particles_stale = true;
+    // The positions are read back from their texture when they are
+    // next needed, but the weights are only kept on the CPU.
+    std::vector<float> &weights = m_cpu_frames.particles.w;
+    weights.clear();
+    params.weightedParticles = header.weighted_particles;
+    if (header.weighted_particles) {
+        const float *w = checkpoint.array(CHECKPOINT_WEIGHTS);
+        weights.resize(number_of_particles);
+        for (int k = 0; k < number_of_particles; k++)
+            weights[k] = w[2*k];
+    }
+    this->reset_particle_ids();
+    m_drift_monitor.reset();
+    return true;
+}
+
 void Simulation::add_user_defined_potential(
     const SimParams &sim_params,
     unsigned int program, const std::map<std::string, float> &input_uniforms) {
+    m_cpu_frames.stale = true;
+    m_drift_monitor.set_potential_changed();
     this->m_programs.user_defined = program;
     Uniforms uniforms;
     for (const auto &e: input_uniforms)
@@ -537,6 +1501,8 @@ void Simulation::sketch_potential(
     const SimParams &params,
     const Vec2 &position, float amplitude
 ) {
+    m_cpu_frames.stale = true;
+    m_drift_monitor.set_potential_changed();
     m_frames.tmp.draw(
         m_programs.sketch_potential,
         {
@@ -557,6 +1523,8 @@ void Simulation::set_potential_from_image(
     const SimParams &params,
     const uint8_t *image_data,
     IVec2 image_dimensions) {
+    m_cpu_frames.stale = true;
+    m_drift_monitor.set_potential_changed();
     int w = image_dimensions[0];
     int h = image_dimensions[1];
     std::vector<Vec2> potential_tmp (
@@ -1,11 +1,34 @@
 #include "gl_wrappers.hpp"
 #include "parameters.hpp"
+#include "frame_recorder.hpp"
+#include "video_stream.hpp"
+#include "thread_pool.hpp"
+#include "cpu_wave_function.hpp"
+#include "cpu_particle_guide.hpp"
+#include "morton_sort.hpp"
+#include "particle_compaction.hpp"
+#include "particle_sampler.hpp"
+#include "split_operator.hpp"
+#include "adi.hpp"
+#include "drift_monitor.hpp"
+#include "checkpoint.hpp"
 
 #ifndef _SIMULATION_
 #define _SIMULATION_
 
 using namespace sim_2d;
 
+WireFrame get_quad_wire_frame();
+
+/* Dimensions of a texture with n texels that is as close to
+square as possible.*/
+struct IVec2 decompose(unsigned int n);
+
+/* Make a program from a fragment shader that uses STENCIL_ORDER,
+where it is defined before the rest of the source so that the
+finite differences of the given order are built into the shader.*/
+unsigned int make_stencil_program(const std::string &path, int order);
+
 struct Frames {
     TextureParams wave_sim_tex_params;
     TextureParams trajectories_tex_params;
@@ -13,19 +36,48 @@ struct Frames {
     Quad psi[3];
     struct {
         Quad particles;
+        // Weights of the particles, in the first channel, for
+        // when they are placed as weighted particles.
+        Quad weights;
         Quad tmp;
         Quad rk4[5];
     } trajectories;
     Quad potential;
     Quad tmp;
+    // Velocity fields of the particles, for psi at the start,
+    // middle, and end of each RK4 step of the trajectories.
+    Quad velocity[3];
+    // Terms of the Chebyshev propagator, and its partial sum.
+    Quad chebyshev[4];
     RenderTarget render_intermediates[3];
     RenderTarget particles_view;
+    // Number of particles in each pixel of particles_view, for
+    // showing very many particles as a density instead of circles.
+    RenderTarget particle_density;
     RenderTarget render;
     WireFrame quad_wire_frame;
+    // One circle, which is drawn once for each particle.
     WireFrame trajectories_wire_frame;
+    // One point, which is likewise drawn once for each particle.
+    WireFrame trajectories_points_wire_frame;
     Frames(const TextureParams &default_tex_params, const SimParams &params);
     void reset_wave_function_dimensions(IVec2 texel_dimensions_2d);
     void reset_trajectories_dimensions(int number_of_particles);
+    void reset_trajectories_dimensions(IVec2 dimensions);
+};
+
+/* Copy of the wave function and potential, for computing
+the time steps on the CPU. This is stale whenever the textures
+have been changed on the GPU since the last copy. The particles
+have their own copy, which is likewise stale whenever they have
+been placed or moved on the GPU.*/
+struct CPUFrames {
+    ComplexField psi[3];
+    ComplexField potential;
+    Particles2D particles;
+    std::vector<float> staging;
+    bool stale;
+    bool particles_stale;
 };
 
 struct Programs {
@@ -38,12 +90,22 @@ struct Programs {
     unsigned int gray_scale;
     unsigned int modify_potential_entry;
     unsigned int sketch_potential;
-    unsigned int time_step;
+    // One of each for every order in STENCIL_ORDERS.
+    unsigned int time_step[STENCIL_ORDER_COUNT];
+    unsigned int chebyshev_step[STENCIL_ORDER_COUNT];
+    unsigned int chebyshev_accumulate;
     unsigned int init_wave_packet;
-    unsigned int guide;
+    unsigned int guide[STENCIL_ORDER_COUNT];
+    unsigned int velocity_field[STENCIL_ORDER_COUNT];
+    unsigned int interpolate_velocity;
     unsigned int forward_euler;
     unsigned int rk4;
+    unsigned int adaptive_rk4;
     unsigned int display_circles;
+    unsigned int display_weighted_circles;
+    unsigned int splat_particles;
+    unsigned int splat_weighted_particles;
+    unsigned int display_particle_density;
     Programs();
 };
 
@@ -53,6 +115,32 @@ class Simulation {
     Quad *m_psi_ptr[3];
     int m_time_step_count;
     std::vector<unsigned char> m_image_data;
+    std::vector<unsigned char> m_image_rgba;
+    FrameRecorder m_frame_recorder;
+    int m_screenshot_count;
+    VideoStream m_video_stream;
+    FrameRecorder m_video_recorder;
+    bool m_video_recording;
+    ThreadPool m_thread_pool;
+    CPUFrames m_cpu_frames;
+    SplitOperator m_split_operator;
+    ADICrankNicolson m_adi;
+    ParticleGuide m_particle_guide;
+    MortonSort m_morton_sort;
+    ParticleSampler m_particle_sampler;
+    // Original index of each particle, from before any sorting,
+    // so that checkpoints keep the particles in their original order.
+    std::vector<uint32_t> m_particle_ids;
+    int m_particle_steps_since_sort;
+    ParticleCompaction m_particle_compaction;
+    int m_live_particle_count;
+    int m_particle_steps_since_compaction;
+    DriftMonitor m_drift_monitor;
+    bool m_monitoring_drift;
+    // Copies of the wave function and potential for measuring the
+    // drift, for when the CPU frames are stale.
+    ComplexField m_drift_psi, m_drift_potential;
+    CheckpointWriter m_checkpoint_writer;
     void compute_guide(
         Quad &q2, const Quad *wave, const Quad &q,
         const SimParams &params);
@@ -61,7 +149,34 @@ class Simulation {
         const Quad *wave,
         const Quad &q, double dt, const Quad &q_dot,
         const SimParams &params);
+    void compute_velocity_field(
+        Quad &velocity, const Quad *wave, const SimParams &params);
+    void interpolate_velocity(
+        Quad &q2, const Quad &velocity,
+        const Quad &q, double dt, const Quad &q_dot,
+        const SimParams &params);
     void trajectories_time_step_rk4(const SimParams &params);
+    void cpu_trajectories_time_step_rk4(const SimParams &params);
+    void copy_particles_to_cpu_frames();
+    void reset_particle_ids();
+    void sort_particles(const SimParams &params);
+    void compact_particles(const SimParams &params);
+    void upload_particle_weights();
+    void record_video(const SimParams &params);
+    void copy_to_cpu_frames();
+    void upload_cpu_psi(const ComplexField &psi, Quad &quad);
+    void finish_cpu_time_step();
+    void cpu_time_step(const SimParams &params);
+    void split_operator_time_step(const SimParams &params);
+    void adi_time_step(const SimParams &params);
+    void chebyshev_propagate(
+        Quad *result, const Quad *psi, float dt, const SimParams &params);
+    void chebyshev_time_step(const SimParams &params);
+    void gpu_time_step(const SimParams &params);
+    int time_step_backend(const SimParams &params) const;
+    float stable_dt(const SimParams &params) const;
+    WaveFunctionMeasures measure_wave_function(const SimParams &params);
+    void restart_time_steps();
     public:
     Simulation(const TextureParams &default_tex_params,
                const SimParams &params);
@@ -70,7 +185,17 @@ class Simulation {
     void new_particles(
         const SimParams &params, Vec2 tex_position);
     const RenderTarget &view(SimParams &params);
+    /* Time that the next call of time_step moves psi forward by.
+    Every backend moves psi by half of dt in each call, where dt is
+    limited to MAX_LEAPFROG_DT for the leapfrog backends, except for
+    the first call after a new wave function, which also takes the
+    initial half step and so moves psi by all of dt.*/
+    float time_step_size(const SimParams &params) const;
     void time_step(const SimParams &params);
+    void monitor_drift(SimParams &params);
+    int live_particle_count() const;
+    void save_checkpoint(const SimParams &params, const std::string &fname);
+    bool load_checkpoint(SimParams &params, const std::string &fname);
     void add_user_defined_potential(
         const SimParams &params,
         unsigned int program,
@@ -0,0 +1,542 @@
+#include "simulation_3d.hpp"
+#include "trajectories_wire_frame.hpp"
+#include "metropolis.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace sim_2d;
+
+/* Axes of the planar slice of the given orientation, which is the
+index of the selected option of planarSliceSelect: the axes that are
+horizontal and vertical on the screen, followed by the normal axis.*/
+static void get_slice_axes(int orientation, int axes[3]) {
+    enum {XY=0, YZ=1, XZ=2};
+    int xy[3] = {0, 1, 2}, yz[3] = {1, 2, 0}, xz[3] = {0, 2, 1};
+    int *selected = (orientation == YZ)? yz: ((orientation == XZ)? xz: xy);
+    for (int i = 0; i < 3; i++)
+        axes[i] = selected[i];
+}
+
+static IVec2 get_slice_dimensions(int orientation, IVec3 dimensions_3d) {
+    int axes[3];
+    get_slice_axes(orientation, axes);
+    return IVec2{.ind={dimensions_3d[axes[0]], dimensions_3d[axes[1]]}};
+}
+
+Programs3D::Programs3D() {
+    this->copy = Quad::make_program_from_path(
+        "./shaders/util/copy.frag"
+    );
+    this->add2 = Quad::make_program_from_path(
+        "./shaders/util/add2.frag"
+    );
+    this->domain_color = Quad::make_program_from_path(
+        "./shaders/util/domain-color.frag"
+    );
+    for (int i = 0; i < STENCIL_ORDER_COUNT; i++) {
+        this->time_step[i] = make_stencil_program(
+            "./shaders/wave-function-3d/time-step.frag", STENCIL_ORDERS[i]);
+        this->guide[i] = make_stencil_program(
+            "./shaders/particles-3d/guide.frag", STENCIL_ORDERS[i]);
+    }
+    this->init_wave_packet = MultidimensionalDataQuad::make_program_from_path(
+        "./shaders/wave-function-3d/gaussian.frag"
+    );
+    this->slice = Quad::make_program_from_path(
+        "./shaders/wave-function-3d/slice.frag"
+    );
+    this->rk4 = Quad::make_program_from_path(
+        "./shaders/integration/rk4.frag"
+    );
+    this->display_circles = make_program_from_paths(
+        "./shaders/particles-3d/circles-display.vert",
+        "./shaders/util/uniform-color.frag"
+    );
+}
+
+Frames3D::
+Frames3D(const TextureParams &default_tex_params, const SimParams &params):
+    texel_dimensions_3d(params.volumeTexelDimensions3D),
+    // The grids are sampled at the texel centers only, since texture
+    // filtering would mix the edges of neighbouring tiles.
+    wave_sim_tex_params({
+        .format=GL_RG32F,
+        .width=(unsigned int)params.volumeTexelDimensions3D[0],
+        .height=(unsigned int)params.volumeTexelDimensions3D[1],
+        .generate_mipmap=0,
+        .wrap_s=GL_CLAMP_TO_EDGE,
+        .wrap_t=GL_CLAMP_TO_EDGE,
+        .min_filter=GL_NEAREST,
+        .mag_filter=GL_NEAREST
+    }),
+    trajectories_tex_params({
+        .format=GL_RGBA32F,
+        .width=(unsigned int)decompose(params.numberOfParticles)[0],
+        .height=(unsigned int)decompose(params.numberOfParticles)[1],
+        .generate_mipmap=0,
+        .wrap_s=GL_REPEAT,
+        .wrap_t=GL_REPEAT,
+        .min_filter=GL_NEAREST,
+        .mag_filter=GL_NEAREST
+    }),
+    slice_tex_params({
+        .format=GL_RG32F,
+        .width=(unsigned int)get_slice_dimensions(
+            params.planarSliceSelect.selected,
+            params.volumeTexelDimensions3D)[0],
+        .height=(unsigned int)get_slice_dimensions(
+            params.planarSliceSelect.selected,
+            params.volumeTexelDimensions3D)[1],
+        .generate_mipmap=default_tex_params.generate_mipmap,
+        .wrap_s=GL_REPEAT,
+        .wrap_t=GL_REPEAT,
+        .min_filter=default_tex_params.min_filter,
+        .mag_filter=default_tex_params.mag_filter
+    }),
+    view_tex_params({
+        .format=default_tex_params.format,
+        .width=(unsigned int)params.takeScreenshots.width,
+        .height=(unsigned int)params.takeScreenshots.height,
+        .generate_mipmap=default_tex_params.generate_mipmap,
+        .wrap_s=default_tex_params.wrap_s,
+        .wrap_t=default_tex_params.wrap_t,
+        .min_filter=default_tex_params.min_filter,
+        .mag_filter=default_tex_params.mag_filter
+    }),
+    psi{
+        MultidimensionalDataQuad(
+            {texel_dimensions_3d[0], texel_dimensions_3d[1],
+             texel_dimensions_3d[2]}, wave_sim_tex_params),
+        MultidimensionalDataQuad(
+            {texel_dimensions_3d[0], texel_dimensions_3d[1],
+             texel_dimensions_3d[2]}, wave_sim_tex_params),
+        MultidimensionalDataQuad(
+            {texel_dimensions_3d[0], texel_dimensions_3d[1],
+             texel_dimensions_3d[2]}, wave_sim_tex_params)
+    },
+    potential(MultidimensionalDataQuad(
+        {texel_dimensions_3d[0], texel_dimensions_3d[1],
+         texel_dimensions_3d[2]}, wave_sim_tex_params)),
+    trajectories {
+        .particles{Quad(trajectories_tex_params)},
+        .rk4{
+            Quad(trajectories_tex_params),
+            Quad(trajectories_tex_params),
+            Quad(trajectories_tex_params),
+            Quad(trajectories_tex_params),
+            Quad(trajectories_tex_params)}
+    },
+    slice(Quad(slice_tex_params)),
+    wave_function_view(RenderTarget(view_tex_params)),
+    particles_view(RenderTarget(view_tex_params)),
+    render(view_tex_params),
+    quad_wire_frame(get_quad_wire_frame()),
+    trajectories_wire_frame(get_circle_wire_frame()) {
+    trajectories_wire_frame.set_instance_count(
+        trajectories_tex_params.width*trajectories_tex_params.height);
+}
+
+void Frames3D::reset_slice_dimensions(IVec2 texel_dimensions_2d) {
+    this->slice_tex_params.width = texel_dimensions_2d[0];
+    this->slice_tex_params.height = texel_dimensions_2d[1];
+    this->slice.reset(this->slice_tex_params);
+}
+
+void Frames3D::reset_trajectories_dimensions(int number_of_particles) {
+    IVec2 dimensions = decompose(number_of_particles);
+    this->trajectories_tex_params.width = dimensions[0];
+    this->trajectories_tex_params.height = dimensions[1];
+    this->trajectories.particles.reset(this->trajectories_tex_params);
+    for (int i = 0; i <= 4; i++)
+        this->trajectories.rk4[i].reset(this->trajectories_tex_params);
+    trajectories_wire_frame.set_instance_count(
+        dimensions[0]*dimensions[1]);
+}
+
+Simulation3D::
+Simulation3D(const TextureParams &default_tex_params, const SimParams &params
+) : m_programs(Programs3D()), m_frames(default_tex_params, params),
+    m_time_step_count(0) {
+    m_cpu_frames.stale = true;
+    m_psi_ptr[0] = &m_frames.psi[0];
+    m_psi_ptr[1] = &m_frames.psi[1];
+    m_psi_ptr[2] = &m_frames.psi[2];
+    // There is not yet a way to set the potential in 3D,
+    // so the particles are free within the periodic box.
+    m_frames.potential.clear();
+    Vec3 position = this->slice_position(params, Vec2{.x=0.25, .y=0.25});
+    this->new_wave_function(
+        params, position, Vec3{.x=10.0, .y=10.0, .z=0.0});
+    this->new_particles(params, position);
+}
+
+IVec3 Simulation3D::texel_dimensions() const {
+    return m_frames.texel_dimensions_3d;
+}
+
+int Simulation3D::tiles_across() const {
+    return m_frames.psi[0].get_texture_dimensions()[0]
+        /m_frames.texel_dimensions_3d[0];
+}
+
+Vec3 Simulation3D::slice_position(
+    const SimParams &params, Vec2 view_position) const {
+    int orientation = params.planarSliceSelect.selected;
+    int axes[3];
+    get_slice_axes(orientation, axes);
+    Vec3 r;
+    r[axes[0]] = view_position[0];
+    r[axes[1]] = view_position[1];
+    r[axes[2]] = params.planarNormCoordOffsets[orientation];
+    return r;
+}
+
+Vec3 Simulation3D::slice_direction(
+    const SimParams &params, Vec2 view_direction) const {
+    int axes[3];
+    get_slice_axes(params.planarSliceSelect.selected, axes);
+    Vec3 r = {.ind={0.0, 0.0, 0.0}};
+    r[axes[0]] = view_direction[0];
+    r[axes[1]] = view_direction[1];
+    return r;
+}
+
+void Simulation3D::new_wave_function(
+    const SimParams &params, Vec3 tex_position, Vec3 wave_num
+) {
+    m_time_step_count = 0;
+    m_cpu_frames.stale = true;
+    float sigma = params.waveFuncSize;
+    for (int i = 0; i < 3; i++)
+        m_psi_ptr[i]->draw(
+            m_programs.init_wave_packet,
+            {
+                {"waveNumber", wave_num},
+                {"texOffset", tex_position},
+                {"amplitude", 1.0F},
+                {"sigmaXYZ", Vec3{.x=sigma, .y=sigma, .z=sigma}},
+                {"texelDimensions3D", m_frames.texel_dimensions_3d},
+                {"textureDimensions2D",
+                    m_psi_ptr[i]->get_texture_dimensions()}
+            }
+        );
+}
+
+struct Gaussian3DParams {
+    Vec3 texOffset;
+    double sigma;
+};
+
+static double gaussian(const std::vector<double> &r, void *void_params) {
+    Gaussian3DParams *params = (Gaussian3DParams *)void_params;
+    double sigma = params->sigma;
+    double g = 1.0;
+    for (int i = 0; i < 3; i++)
+        g *= std::exp(-0.5*pow((r[i] - params->texOffset[i])/sigma, 2.0));
+    return g;
+}
+
+void Simulation3D::new_particles(
+    const SimParams &params, Vec3 tex_position) {
+    int old_number_of_particles
+        = m_frames.trajectories_tex_params.width
+            *m_frames.trajectories_tex_params.height;
+    if (old_number_of_particles != params.numberOfParticles)
+        m_frames.reset_trajectories_dimensions(params.numberOfParticles);
+    m_cpu_frames.stale = true;
+    std::vector<double> x0 = {
+        (double)tex_position.x, (double)tex_position.y,
+        (double)tex_position.z};
+    double delta = 1.5*params.waveFuncSize;
+    std::vector<double> configs
+        = std::vector<double>(params.numberOfParticles*3, 0.0);
+    Gaussian3DParams gaussian_params = Gaussian3DParams {
+        .texOffset=tex_position,
+        .sigma=params.waveFuncSize
+    };
+    metropolis(
+        configs, x0, {delta, delta, delta},
+        gaussian, params.numberOfParticles,
+        (void *)&gaussian_params);
+    std::vector<float> configs_f
+        = std::vector<float>(params.numberOfParticles*4, 0.0F);
+    for (int i = 0; i < params.numberOfParticles; i++) {
+        for (int k = 0; k < 3; k++)
+            configs_f[4*i + k]
+                = configs[3*i + k]*params.waveSimulationDimensions3D[k];
+    }
+    m_frames.trajectories.particles.set_pixels(&configs_f[0]);
+}
+
+void Simulation3D::compute_guide(
+    Quad &q2, const MultidimensionalDataQuad *wave,
+    const Quad &q, double dt, const Quad &q_dot,
+    const SimParams &params) {
+    q2.draw(
+        m_programs.guide[params.stencilOrder.selected],
+        {
+            {"hbar", params.hbar},
+            {"m", params.m},
+            {"psiTex", wave},
+            {"qTex", &q},
+            {"dt", dt},
+            {"qDotTex", &q_dot},
+            {"dimensions3D", params.waveSimulationDimensions3D},
+            {"texelDimensions3D", m_frames.texel_dimensions_3d},
+            {"textureDimensions2D", wave->get_texture_dimensions()}
+        }
+    );
+}
+
+void Simulation3D::trajectories_time_step_rk4(const SimParams &params) {
+    m_frames.trajectories.rk4[0].draw(
+        m_programs.copy,
+        {
+            {"tex", &m_frames.trajectories.particles}
+        });
+    float dt = params.dt;
+    Quad *rk4 = m_frames.trajectories.rk4;
+    const Quad &q = m_frames.trajectories.particles;
+    // q1, where the velocities that it is offset by are
+    // multiplied by a dt of zero.
+    this->compute_guide(rk4[1], m_psi_ptr[0], q, 0.0, q, params);
+    // q2
+    this->compute_guide(rk4[2], m_psi_ptr[1], q, dt/2.0, rk4[1], params);
+    // q3
+    this->compute_guide(rk4[3], m_psi_ptr[1], q, dt/2.0, rk4[2], params);
+    // q4
+    this->compute_guide(rk4[4], m_psi_ptr[2], q, dt, rk4[3], params);
+    Vec3 d = params.waveSimulationDimensions3D;
+    m_frames.trajectories.particles.draw(
+        m_programs.rk4,
+        {
+            {"qTex", &rk4[0]},
+            {"qDotTex1", &rk4[1]},
+            {"qDotTex2", &rk4[2]},
+            {"qDotTex3", &rk4[3]},
+            {"qDotTex4", &rk4[4]},
+            {"dt", params.dt},
+            {"periodicizeResult", int(true)},
+            {"minBoundaryVal", Vec4{.ind={0.0}}},
+            {"domainDimensions", Vec4{.ind{d[0], d[1], d[2], 1.0}}},
+        }
+    );
+}
+
+/* Copy the current and previous wave functions, the potential, and
+the particles from their textures to the CPU.*/
+void Simulation3D::copy_to_cpu_frames() {
+    CPUFrames3D &cpu = m_cpu_frames;
+    IVec3 d = m_frames.texel_dimensions_3d;
+    IVec2 texture_dimensions = m_frames.psi[0].get_texture_dimensions();
+    cpu.staging.resize(2*texture_dimensions[0]*texture_dimensions[1]);
+    const MultidimensionalDataQuad *sources[3]
+        = {m_psi_ptr[0], m_psi_ptr[1], &m_frames.potential};
+    ComplexField3D *destinations[3]
+        = {&cpu.psi[0], &cpu.psi[1], &cpu.potential};
+    for (int i = 0; i < 3; i++) {
+        sources[i]->fill_array_with_contents(&cpu.staging[0]);
+        destinations[i]->resize(d[0], d[1], d[2]);
+        destinations[i]->from_tiled(
+            &cpu.staging[0], this->tiles_across(), m_thread_pool);
+    }
+    int particle_count = m_frames.trajectories_tex_params.width
+        *m_frames.trajectories_tex_params.height;
+    cpu.staging.resize(4*particle_count);
+    m_frames.trajectories.particles.fill_array_with_contents(
+        &cpu.staging[0]);
+    cpu.particles.resize(particle_count);
+    cpu.particles.from_interleaved(&cpu.staging[0], m_thread_pool);
+    cpu.stale = false;
+}
+
+void Simulation3D::upload_cpu_psi(
+    const ComplexField3D &psi, MultidimensionalDataQuad &quad) {
+    IVec2 texture_dimensions = quad.get_texture_dimensions();
+    m_cpu_frames.staging.resize(
+        2*texture_dimensions[0]*texture_dimensions[1]);
+    psi.to_tiled(&m_cpu_frames.staging[0], this->tiles_across(),
+                 m_thread_pool);
+    quad.set_pixels(&m_cpu_frames.staging[0]);
+}
+
+/* Do the same time step and particle step as the shaders,
+but on the CPU, then upload the results so that they can be viewed.*/
+void Simulation3D::cpu_time_step(const SimParams &params) {
+    CPUFrames3D &cpu = m_cpu_frames;
+    if (cpu.stale)
+        this->copy_to_cpu_frames();
+    IVec3 d = m_frames.texel_dimensions_3d;
+    Vec3 size = params.waveSimulationDimensions3D;
+    Leapfrog3DParams leapfrog_params = {
+        .m=params.m, .hbar=params.hbar, .dt=params.dt,
+        .dx=size[0]/float(d[0]), .dy=size[1]/float(d[1]),
+        .dz=size[2]/float(d[2]),
+        .stencil_order=STENCIL_ORDERS[params.stencilOrder.selected],
+    };
+    if (m_time_step_count == 0) {
+        // Initial forward Euler step.
+        Leapfrog3DParams half_step_params = leapfrog_params;
+        half_step_params.dt = params.dt/2.0;
+        leapfrog_time_step(
+            cpu.psi[1], cpu.psi[0], cpu.psi[0], cpu.potential,
+            half_step_params, m_thread_pool);
+        this->upload_cpu_psi(cpu.psi[1], *m_psi_ptr[1]);
+        m_time_step_count++;
+    }
+    leapfrog_time_step(
+        cpu.psi[2], cpu.psi[0], cpu.psi[1], cpu.potential,
+        leapfrog_params, m_thread_pool);
+    if (m_time_step_count % 2) {
+        Guide3DParams guide_params = {
+            .m=params.m, .hbar=params.hbar,
+            .width=size[0], .height=size[1], .length=size[2],
+            .stencil_order=leapfrog_params.stencil_order,
+        };
+        m_particle_guide.rk4_step(
+            cpu.particles, cpu.psi[0], cpu.psi[1], cpu.psi[2],
+            guide_params, params.dt, m_thread_pool);
+        cpu.staging.resize(4*cpu.particles.count());
+        cpu.particles.to_interleaved(&cpu.staging[0], m_thread_pool);
+        m_frames.trajectories.particles.set_pixels(&cpu.staging[0]);
+    }
+    this->upload_cpu_psi(cpu.psi[2], *m_psi_ptr[2]);
+    std::swap(cpu.psi[0], cpu.psi[1]);
+    std::swap(cpu.psi[1], cpu.psi[2]);
+}
+
+void Simulation3D::gpu_time_step(const SimParams &params) {
+    m_cpu_frames.stale = true;
+    IVec2 texture_dimensions = m_psi_ptr[0]->get_texture_dimensions();
+    if (m_time_step_count == 0) {
+        // Initial forward Euler step.
+        m_psi_ptr[1]->draw(
+            m_programs.time_step[params.stencilOrder.selected],
+            {
+                {"m", params.m},
+                {"hbar", params.hbar},
+                {"dt", float(params.dt/2.0)},
+                {"psi0Tex", m_psi_ptr[0]},
+                {"psi1Tex", m_psi_ptr[0]},
+                {"potentialTex", &m_frames.potential},
+                {"dimensions3D", params.waveSimulationDimensions3D},
+                {"texelDimensions3D", m_frames.texel_dimensions_3d},
+                {"textureDimensions2D", texture_dimensions}
+            }
+        );
+        m_time_step_count++;
+    }
+    m_psi_ptr[2]->draw(
+        m_programs.time_step[params.stencilOrder.selected],
+        {
+            {"m", params.m},
+            {"hbar", params.hbar},
+            {"dt", params.dt},
+            {"psi0Tex", m_psi_ptr[0]},
+            {"psi1Tex", m_psi_ptr[1]},
+            {"potentialTex", &m_frames.potential},
+            {"dimensions3D", params.waveSimulationDimensions3D},
+            {"texelDimensions3D", m_frames.texel_dimensions_3d},
+            {"textureDimensions2D", texture_dimensions}
+        }
+    );
+    if (m_time_step_count % 2)
+        trajectories_time_step_rk4(params);
+}
+
+float Simulation3D::time_step_size(const SimParams &params) const {
+    float dt = std::min(params.dt, MAX_LEAPFROG_DT);
+    return (m_time_step_count == 0)? dt: 0.5F*dt;
+}
+
+void Simulation3D::time_step(const SimParams &params) {
+    if (params.dt > MAX_LEAPFROG_DT) {
+        SimParams limited_params = params;
+        limited_params.dt = MAX_LEAPFROG_DT;
+        this->time_step(limited_params);
+        return;
+    }
+    enum TimeStepBackend {GPU=0, CPU=1};
+    int backend = params.timeStepBackend.selected;
+    if (backend != GPU && backend != CPU) {
+        static bool reported = false;
+        if (!reported)
+            fprintf(stderr, "Only the leapfrog steps are done in 3D; "
+                    "using the GPU leapfrog step instead.\n");
+        reported = true;
+        backend = GPU;
+    }
+    if (backend == CPU)
+        this->cpu_time_step(params);
+    else
+        this->gpu_time_step(params);
+    MultidimensionalDataQuad *psi_ptr[3]
+        = {m_psi_ptr[1], m_psi_ptr[2], m_psi_ptr[0]};
+    for (int i = 0; i < 3; i++)
+        m_psi_ptr[i] = psi_ptr[i];
+    m_time_step_count++;
+}
+
+const RenderTarget &Simulation3D::view(SimParams &params) {
+    int orientation = params.planarSliceSelect.selected;
+    IVec2 slice_dimensions = get_slice_dimensions(
+        orientation, m_frames.texel_dimensions_3d);
+    if (slice_dimensions[0] != (int)m_frames.slice_tex_params.width
+        || slice_dimensions[1] != (int)m_frames.slice_tex_params.height)
+        m_frames.reset_slice_dimensions(slice_dimensions);
+    m_frames.slice.draw(
+        m_programs.slice,
+        {
+            {"tex", m_psi_ptr[1]},
+            {"texelDimensions3D", m_frames.texel_dimensions_3d},
+            {"textureDimensions2D", m_psi_ptr[1]->get_texture_dimensions()},
+            {"orientation", orientation},
+            {"offset", params.planarNormCoordOffsets[orientation]}
+        }
+    );
+    m_frames.wave_function_view.draw(
+        m_programs.domain_color,
+        {
+            {"tex", &m_frames.slice},
+            {"brightness", params.brightness},
+        },
+        m_frames.quad_wire_frame
+    );
+    int axes[3];
+    get_slice_axes(orientation, axes);
+    Vec3 horizontal = {.ind={0.0, 0.0, 0.0}};
+    Vec3 vertical = {.ind={0.0, 0.0, 0.0}};
+    horizontal[axes[0]] = 1.0;
+    vertical[axes[1]] = 1.0;
+    m_frames.particles_view.clear();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    m_frames.particles_view.draw(
+        m_programs.display_circles,
+        {
+            {"coordTex", &m_frames.trajectories.particles},
+            {"circleRadius", 0.001F},
+            {"dimensions3D", params.waveSimulationDimensions3D},
+            {"horizontal", horizontal},
+            {"vertical", vertical},
+            {"color",
+                    Vec4{
+                        .r=1.0,
+                        .g=1.0,
+                        .b=1.0,
+                        .a=params.brightnessParticles
+                    }
+                }
+        },
+        m_frames.trajectories_wire_frame
+    );
+    glDisable(GL_BLEND);
+    m_frames.render.draw(
+        m_programs.add2,
+        {
+            {"tex1", &m_frames.wave_function_view},
+            {"tex2", &m_frames.particles_view},
+        },
+        m_frames.quad_wire_frame);
+    return m_frames.render;
+}
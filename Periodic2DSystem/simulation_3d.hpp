@@ -0,0 +1,115 @@
+#include "simulation.hpp"
+#include "cpu_wave_function_3d.hpp"
+
+#ifndef _SIMULATION_3D_
+#define _SIMULATION_3D_
+
+/* Textures of the 3D simulation. The wave functions and the potential
+are 3D grids whose slices are laid out as the tiles of 2D textures,
+and the particle positions have three components, so that they are
+kept in RGBA textures.*/
+struct Frames3D {
+    IVec3 texel_dimensions_3d;
+    TextureParams wave_sim_tex_params;
+    TextureParams trajectories_tex_params;
+    TextureParams slice_tex_params;
+    TextureParams view_tex_params;
+    MultidimensionalDataQuad psi[3];
+    MultidimensionalDataQuad potential;
+    struct {
+        Quad particles;
+        Quad rk4[5];
+    } trajectories;
+    // Planar slice of the wave function that is being viewed.
+    Quad slice;
+    RenderTarget wave_function_view;
+    RenderTarget particles_view;
+    RenderTarget render;
+    WireFrame quad_wire_frame;
+    // One circle, which is drawn once for each particle.
+    WireFrame trajectories_wire_frame;
+    Frames3D(const TextureParams &default_tex_params, const SimParams &params);
+    void reset_slice_dimensions(IVec2 texel_dimensions_2d);
+    void reset_trajectories_dimensions(int number_of_particles);
+};
+
+/* Copy of the wave function, potential, and particles, for computing
+the time steps on the CPU. This is stale whenever the textures have
+been changed on the GPU since the last copy.*/
+struct CPUFrames3D {
+    ComplexField3D psi[3];
+    ComplexField3D potential;
+    Particles3D particles;
+    std::vector<float> staging;
+    bool stale;
+};
+
+struct Programs3D {
+    unsigned int copy;
+    unsigned int add2;
+    unsigned int domain_color;
+    // One of each for every order in STENCIL_ORDERS.
+    unsigned int time_step[STENCIL_ORDER_COUNT];
+    unsigned int guide[STENCIL_ORDER_COUNT];
+    unsigned int init_wave_packet;
+    unsigned int slice;
+    unsigned int rk4;
+    unsigned int display_circles;
+    Programs3D();
+};
+
+/*
+Pilot-wave simulation on a periodic 3D grid, which is viewed as a
+planar slice of the wave function, with the particles projected
+onto the plane of the slice.
+
+The time steps and particle guide are the same as those of
+Simulation, with 3D stencils, and the wave function is sampled
+trilinearly at the particle positions. They are done either on the
+GPU, or on the CPU with the multithreaded backend, where the 2D
+textures are converted to and from ordinary 3D arrays.
+*/
+class Simulation3D {
+    Programs3D m_programs;
+    Frames3D m_frames;
+    MultidimensionalDataQuad *m_psi_ptr[3];
+    int m_time_step_count;
+    ThreadPool m_thread_pool;
+    CPUFrames3D m_cpu_frames;
+    ParticleGuide3D m_particle_guide;
+    int tiles_across() const;
+    void compute_guide(
+        Quad &q2, const MultidimensionalDataQuad *wave,
+        const Quad &q, double dt, const Quad &q_dot,
+        const SimParams &params);
+    void trajectories_time_step_rk4(const SimParams &params);
+    void copy_to_cpu_frames();
+    void upload_cpu_psi(const ComplexField3D &psi,
+                        MultidimensionalDataQuad &quad);
+    void cpu_time_step(const SimParams &params);
+    void gpu_time_step(const SimParams &params);
+    Simulation3D(const Simulation3D &);
+    Simulation3D& operator=(const Simulation3D &);
+    public:
+    Simulation3D(const TextureParams &default_tex_params,
+                 const SimParams &params);
+    IVec3 texel_dimensions() const;
+    /* Normalized 3D coordinates of the point on the viewed slice
+    that is at the normalized 2D coordinates of the view.*/
+    Vec3 slice_position(const SimParams &params, Vec2 view_position) const;
+    /* Direction along the viewed slice of the given direction
+    on the view, such as that of a wave number.*/
+    Vec3 slice_direction(const SimParams &params, Vec2 view_direction) const;
+    void new_wave_function(
+        const SimParams &params, Vec3 tex_position, Vec3 wave_num);
+    void new_particles(const SimParams &params, Vec3 tex_position);
+    /* Time that the next call of time_step moves psi forward by,
+    which is the same as for Simulation::time_step_size, with dt
+    always limited to MAX_LEAPFROG_DT since only the leapfrog steps
+    are done in 3D.*/
+    float time_step_size(const SimParams &params) const;
+    void time_step(const SimParams &params);
+    const RenderTarget &view(SimParams &params);
+};
+
+#endif
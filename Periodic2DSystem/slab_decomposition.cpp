@@ -0,0 +1,436 @@
+#include "slab_decomposition.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdio.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Alignment of everything in the shared memory, which is the size of
+a cache line, so that no two ranks ever write to the same line. */
+#define SHARED_ALIGNMENT 64
+
+static size_t align_up(size_t size) {
+    return (size + SHARED_ALIGNMENT - 1)/SHARED_ALIGNMENT*SHARED_ALIGNMENT;
+}
+
+bool SharedBarrier::wait() {
+    int generation = this->generation.load();
+    if (this->count.fetch_add(1) + 1 == this->total) {
+        this->count.store(0);
+        this->generation.fetch_add(1);
+    } else {
+        while (this->generation.load() == generation) {
+            if (this->aborted.load())
+                return false;
+            sched_yield();
+        }
+    }
+    return !this->aborted.load();
+}
+
+void SharedBarrier::abort() {
+    this->aborted.store(1);
+}
+
+/* Wait until any of the given child processes exits, and remove it
+from children, returning its pid. Only these children are waited for,
+rather than any child with waitpid(-1, ...), so that those of the
+caller's own are left alone.*/
+static pid_t wait_for_any(std::vector<pid_t> &children, int *status) {
+    for (;;) {
+        for (size_t k = 0; k < children.size(); k++) {
+            pid_t pid = waitpid(children[k], status, WNOHANG);
+            if (pid == 0)
+                continue;
+            if (pid > 0)
+                children.erase(children.begin() + k);
+            return pid;
+        }
+        usleep(1000);
+    }
+}
+
+SlabDecomposition::SlabDecomposition(const SlabParams &params):
+    m_params(params), m_shared(NULL), m_shared_size(0),
+    m_barrier(NULL), m_controls(NULL), m_plane_size(0) {
+    int radius = 0;
+    switch (params.stencil_order) {
+        case 2: radius = Stencil<2>::RADIUS; break;
+        case 6: radius = Stencil<6>::RADIUS; break;
+        default: radius = Stencil<4>::RADIUS;
+    }
+    // The particles need the velocity of the rows just past the slab
+    // for interpolating, and the stencil's radius past those for the
+    // gradient, which covers the radius of the time steps as well.
+    m_halo = radius + 1;
+    int n = params.rank_count;
+    if (n < 1 || params.height/n < m_halo) {
+        fprintf(stderr, "Each of the %d slabs must have at least %d rows.\n",
+                n, m_halo);
+        return;
+    }
+    for (int r = 0; r <= n; r++)
+        m_row_begin.push_back((int)((int64_t)params.height*r/n));
+    int largest_height = 0;
+    for (int r = 0; r < n; r++)
+        largest_height = std::max(largest_height,
+                                  m_row_begin[r + 1] - m_row_begin[r]);
+    m_plane_size = align_up(
+        sizeof(float)*(size_t)params.width*(largest_height + 2*m_halo));
+    size_t outbox_size = align_up(
+        2*sizeof(float)*(size_t)params.particle_capacity);
+    size_t offset = align_up(sizeof(SharedBarrier))
+        + align_up(n*sizeof(RankControl));
+    for (int r = 0; r < n; r++) {
+        m_field_offsets.push_back(offset);
+        offset += 2*ARRAY_COUNT*m_plane_size;
+        m_outbox_offsets.push_back(offset);
+        offset += 2*outbox_size;
+    }
+    void *shared = mmap(NULL, offset, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        fprintf(stderr, "Unable to map %zu bytes of shared memory.\n",
+                offset);
+        return;
+    }
+    m_shared = (uint8_t *)shared;
+    m_shared_size = offset;
+    m_barrier = new(m_shared) SharedBarrier();
+    m_barrier->count.store(0);
+    m_barrier->generation.store(0);
+    m_barrier->aborted.store(0);
+    m_barrier->total = n;
+    m_controls = (RankControl *)(m_shared + align_up(sizeof(SharedBarrier)));
+    for (int r = 0; r < n; r++)
+        m_controls[r] = {.outbox_count={0, 0}, .particle_count=0};
+}
+
+bool SlabDecomposition::is_valid() const {
+    return m_shared != NULL;
+}
+
+int SlabDecomposition::row_begin(int rank) const {
+    return m_row_begin[rank];
+}
+
+int SlabDecomposition::row_end(int rank) const {
+    return m_row_begin[rank + 1];
+}
+
+ComplexRows SlabDecomposition::field(int rank, int array) const {
+    uint8_t *planes = m_shared + m_field_offsets[rank]
+        + 2*array*m_plane_size;
+    size_t halo_offset = (size_t)m_params.width*m_halo;
+    return {
+        .width=m_params.width,
+        .height=this->row_end(rank) - this->row_begin(rank),
+        .re=(float *)planes + halo_offset,
+        .im=(float *)(planes + m_plane_size) + halo_offset,
+    };
+}
+
+/* Rank whose slab contains the row at y. */
+int SlabDecomposition::owner(float y) const {
+    float dy = m_params.simulation_height/m_params.height;
+    int row = std::min(std::max((int)floor(y/dy), 0), m_params.height - 1);
+    return int(std::upper_bound(m_row_begin.begin(), m_row_begin.end(), row)
+               - m_row_begin.begin()) - 1;
+}
+
+/* Copy the rows of the neighbouring slabs next to this one
+into its halos. */
+void SlabDecomposition::exchange_halos(int rank, int array) {
+    int n = m_params.rank_count, width = m_params.width;
+    ComplexRows f = this->field(rank, array);
+    ComplexRows up = this->field((rank + 1) % n, array);
+    ComplexRows down = this->field((rank - 1 + n) % n, array);
+    size_t size = sizeof(float)*width*m_halo;
+    ptrdiff_t top = (ptrdiff_t)width*f.height;
+    ptrdiff_t bottom = -(ptrdiff_t)width*m_halo;
+    ptrdiff_t down_top = (ptrdiff_t)width*(down.height - m_halo);
+    memcpy(f.re + top, up.re, size);
+    memcpy(f.im + top, up.im, size);
+    memcpy(f.re + bottom, down.re + down_top, size);
+    memcpy(f.im + bottom, down.im + down_top, size);
+}
+
+/* Bilinear interpolation of a velocity field that has the rows from the
+one below a slab to the one above it, at the point (x, y) of the slab
+in texels. Stages of a step that leave these rows use their edge.*/
+static inline void interpolate_velocity(
+    const VelocityField &v, float x, float y, float &vx, float &vy) {
+    float fx = x - 0.5F, fy = y - 0.5F;
+    int j0 = (int)floor(fx), i0 = (int)floor(fy);
+    float sx = fx - j0, sy = fy - i0;
+    // Row i of the slab is row i + 1 of the velocity field.
+    if (i0 < -1) {
+        i0 = -1;
+        sy = 0.0F;
+    } else if (i0 > v.height - 3) {
+        i0 = v.height - 3;
+        sy = 1.0F;
+    }
+    j0 = (j0 % v.width + v.width) % v.width;
+    int j1 = (j0 + 1) % v.width;
+    size_t row0 = (size_t)v.width*(i0 + 1), row1 = row0 + v.width;
+    vx = (1.0F - sy)*((1.0F - sx)*v.x[row0 + j0] + sx*v.x[row0 + j1])
+        + sy*((1.0F - sx)*v.x[row1 + j0] + sx*v.x[row1 + j1]);
+    vy = (1.0F - sy)*((1.0F - sx)*v.y[row0 + j0] + sx*v.y[row0 + j1])
+        + sy*((1.0F - sx)*v.y[row1 + j0] + sx*v.y[row1 + j1]);
+}
+
+/* If guide is set, move the particles that this rank owns with an RK4
+step, where arrays has the wave functions at the start, middle, and end
+of the step. Then put those that are not in its slab in its outboxes.*/
+void SlabDecomposition::move_particles(
+    int rank, const int arrays[3], bool guide,
+    std::vector<float> &particles, ThreadPool &pool) {
+    const SlabParams &p = m_params;
+    int n = p.rank_count;
+    float dx = p.simulation_width/p.width;
+    float dy = p.simulation_height/p.height;
+    int row0 = this->row_begin(rank);
+    RankControl &control = m_controls[rank];
+    control.outbox_count[0] = control.outbox_count[1] = 0;
+    float *outboxes[2] = {
+        (float *)(m_shared + m_outbox_offsets[rank]),
+        (float *)(m_shared + m_outbox_offsets[rank])
+            + 2*p.particle_capacity};
+    if (guide) {
+        GuideParams guide_params = {
+            .m=p.m, .hbar=p.hbar,
+            .width=p.simulation_width, .height=p.simulation_height,
+            .stencil_order=p.stencil_order,
+            .interpolate_velocity_field=true,
+            .absorbing_boundaries=false,
+            .adaptive_substeps=false,
+            .substep_tolerance=0.0F,
+        };
+        for (int s = 0; s < 3; s++) {
+            ComplexRows psi = this->field(rank, arrays[s]);
+            compute_velocity_field(m_velocity[s], psi, -1, psi.height + 1,
+                                   dx, dy, guide_params, pool);
+        }
+    }
+    size_t kept = 0;
+    for (size_t k = 0; k < particles.size()/2; k++) {
+        float x = particles[2*k], y = particles[2*k + 1];
+        if (guide && this->owner(y) == rank) {
+            // The same stages as ParticleGuide::rk4_step, in texels
+            // relative to the slab.
+            const VelocityField *v[4] = {
+                &m_velocity[0], &m_velocity[1], &m_velocity[1],
+                &m_velocity[2]};
+            float stage_dt[4] = {0.0F, p.dt/2.0F, p.dt/2.0F, p.dt};
+            float tx = x/dx, ty = y/dy - row0;
+            float kx[4], ky[4];
+            for (int s = 0; s < 4; s++) {
+                float sx = tx, sy = ty;
+                if (s > 0) {
+                    sx += stage_dt[s]*kx[s - 1]/dx;
+                    sy += stage_dt[s]*ky[s - 1]/dy;
+                }
+                interpolate_velocity(*v[s], sx, sy, kx[s], ky[s]);
+            }
+            x += p.dt*(kx[0] + 2.0F*kx[1] + 2.0F*kx[2] + kx[3])/6.0F;
+            y += p.dt*(ky[0] + 2.0F*ky[1] + 2.0F*ky[2] + ky[3])/6.0F;
+            x = fmod(x, p.simulation_width);
+            y = fmod(y, p.simulation_height);
+            x = (x < 0.0F)? x + p.simulation_width: x;
+            y = (y < 0.0F)? y + p.simulation_height: y;
+        }
+        int new_owner = this->owner(y);
+        if (new_owner == rank) {
+            particles[2*kept] = x;
+            particles[2*kept + 1] = y;
+            kept++;
+            continue;
+        }
+        // Send it towards its owner the shorter way around,
+        // where outbox 0 goes to the next rank up.
+        int direction = ((new_owner - rank + n) % n <= n/2)? 0: 1;
+        int &count = control.outbox_count[direction];
+        if (count >= p.particle_capacity) {
+            fprintf(stderr, "Rank %d dropped a particle, since its outbox "
+                    "is full.\n", rank);
+            continue;
+        }
+        outboxes[direction][2*count] = x;
+        outboxes[direction][2*count + 1] = y;
+        count++;
+    }
+    particles.resize(2*kept);
+}
+
+/* Take in the particles in the outboxes of the neighbouring ranks
+that are meant for this one. */
+void SlabDecomposition::receive_particles(
+    int rank, std::vector<float> &particles) {
+    int n = m_params.rank_count;
+    // Outbox 0 of the rank below, and outbox 1 of the rank above.
+    int senders[2] = {(rank - 1 + n) % n, (rank + 1) % n};
+    for (int d = 0; d < 2; d++) {
+        const float *outbox = (const float *)(
+            m_shared + m_outbox_offsets[senders[d]])
+            + 2*d*m_params.particle_capacity;
+        int count = m_controls[senders[d]].outbox_count[d];
+        particles.insert(particles.end(), outbox, outbox + 2*count);
+    }
+}
+
+bool SlabDecomposition::run_rank(
+    int rank, int step_count, bool start_with_half_step,
+    const SlabInitializer &initializer,
+    const std::vector<float> &initial_particles) {
+    const SlabParams &p = m_params;
+    ThreadPool pool(p.threads_per_rank);
+    LeapfrogParams leapfrog_params = {
+        .m=p.m, .hbar=p.hbar, .dt=p.dt,
+        .dx=p.simulation_width/p.width, .dy=p.simulation_height/p.height,
+        .stencil_order=p.stencil_order,
+    };
+    ComplexRows fields[ARRAY_COUNT];
+    for (int a = 0; a < ARRAY_COUNT; a++)
+        fields[a] = this->field(rank, a);
+    for (int i = 0; i < fields[PSI0].height; i++) {
+        ptrdiff_t offset = (ptrdiff_t)p.width*i;
+        ComplexRows rows[3];
+        int arrays[3] = {PSI0, PSI1, POTENTIAL};
+        for (int k = 0; k < 3; k++)
+            rows[k] = {.width=p.width, .height=1,
+                       .re=fields[arrays[k]].re + offset,
+                       .im=fields[arrays[k]].im + offset};
+        initializer(this->row_begin(rank) + i, rows[0], rows[1], rows[2]);
+    }
+    std::vector<float> particles;
+    for (size_t k = 0; k < initial_particles.size()/2; k++) {
+        if (this->owner(initial_particles[2*k + 1]) == rank) {
+            particles.push_back(initial_particles[2*k]);
+            particles.push_back(initial_particles[2*k + 1]);
+        }
+    }
+    if (!m_barrier->wait())
+        return false;
+    this->exchange_halos(rank, PSI0);
+    if (!start_with_half_step) {
+        this->exchange_halos(rank, PSI1);
+    } else {
+        // Every rank has read the psi0 halos before any psi1 is written.
+        if (!m_barrier->wait())
+            return false;
+        LeapfrogParams half_step_params = leapfrog_params;
+        half_step_params.dt = p.dt/2.0F;
+        leapfrog_time_step(fields[PSI1], fields[PSI0], fields[PSI0],
+                           fields[POTENTIAL], half_step_params, pool);
+        if (!m_barrier->wait())
+            return false;
+        this->exchange_halos(rank, PSI1);
+    }
+    int first_step = p.initial_step_count + (start_with_half_step? 1: 0);
+    for (int s = 0; s < step_count; s++) {
+        int previous = s % 3, current = (s + 1) % 3, next = (s + 2) % 3;
+        leapfrog_time_step(fields[next], fields[previous], fields[current],
+                           fields[POTENTIAL], leapfrog_params, pool);
+        // Every slab has its next wave function before any are read.
+        if (!m_barrier->wait())
+            return false;
+        this->exchange_halos(rank, next);
+        // As in Simulation::time_step, the particles are moved after
+        // every odd numbered step, over the last three wave functions.
+        int arrays[3] = {previous, current, next};
+        this->move_particles(rank, arrays, (first_step + s) % 2 == 1,
+                             particles, pool);
+        // Every outbox is full before any of them are read.
+        if (!m_barrier->wait())
+            return false;
+        this->receive_particles(rank, particles);
+        // Every outbox has been read before any of them
+        // are written to again.
+        if (!m_barrier->wait())
+            return false;
+    }
+    // Leave the particles in outbox 0 for the parent to collect.
+    float *outbox = (float *)(m_shared + m_outbox_offsets[rank]);
+    int count = std::min((int)particles.size()/2, p.particle_capacity);
+    if (count > 0)
+        memcpy(outbox, &particles[0], 2*sizeof(float)*count);
+    m_controls[rank].particle_count = count;
+    return true;
+}
+
+bool SlabDecomposition::run(
+    int step_count, bool start_with_half_step,
+    const SlabInitializer &initializer,
+    std::vector<float> &particles, int &previous, int &current) {
+    if (!this->is_valid())
+        return false;
+    // A run that was stopped may have left ranks counted at the barrier.
+    m_barrier->count.store(0);
+    m_barrier->aborted.store(0);
+    std::vector<pid_t> children;
+    for (int rank = 0; rank < m_params.rank_count; rank++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            bool finished = this->run_rank(rank, step_count,
+                                           start_with_half_step,
+                                           initializer, particles);
+            _exit((finished)? 0: 1);
+        }
+        if (pid < 0) {
+            perror("fork");
+            m_barrier->abort();
+            for (pid_t child: children) {
+                kill(child, SIGKILL);
+                waitpid(child, NULL, 0);
+            }
+            return false;
+        }
+        children.push_back(pid);
+    }
+    // Wait for the ranks in the order that they finish, so that one
+    // that dies is noticed while the others are still at the barrier.
+    bool success = true;
+    while (!children.empty()) {
+        int status = 0;
+        pid_t child = wait_for_any(children, &status);
+        if (child < 0) {
+            perror("waitpid");
+            m_barrier->abort();
+            for (pid_t c: children) {
+                kill(c, SIGKILL);
+                waitpid(c, NULL, 0);
+            }
+            return false;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (success)
+                fprintf(stderr, "A rank did not finish, so the others "
+                        "are stopped.\n");
+            success = false;
+            m_barrier->abort();
+        }
+    }
+    if (!success)
+        return false;
+    particles.clear();
+    for (int rank = 0; rank < m_params.rank_count; rank++) {
+        const float *outbox
+            = (const float *)(m_shared + m_outbox_offsets[rank]);
+        particles.insert(particles.end(), outbox,
+                         outbox + 2*m_controls[rank].particle_count);
+    }
+    previous = step_count % 3;
+    current = (step_count + 1) % 3;
+    return true;
+}
+
+SlabDecomposition::~SlabDecomposition() {
+    if (m_shared != NULL)
+        munmap(m_shared, m_shared_size);
+}
@@ -0,0 +1,120 @@
+#include "cpu_wave_function.hpp"
+#include "cpu_particle_guide.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifndef _SLAB_DECOMPOSITION_
+#define _SLAB_DECOMPOSITION_
+
+struct SlabParams {
+    int width, height;
+    float simulation_width, simulation_height;
+    float m, hbar, dt;
+    int stencil_order;
+    int rank_count;
+    int threads_per_rank;
+    // Largest number of particles that any rank can hold, which
+    // is also the size of each of its particle outboxes.
+    int particle_capacity;
+    // Number of time steps taken before the first one of run, including
+    // the half step, which decides which steps the particles are moved
+    // on, so that they are moved on the same steps as in the GUI.
+    int initial_step_count;
+};
+
+/* Barrier for processes that share memory, which spins on an
+atomic generation count instead of sleeping, since the ranks
+reach it at nearly the same time every step. Once it is aborted,
+because a rank has died, wait returns false instead of waiting
+for a rank that never comes.*/
+struct SharedBarrier {
+    std::atomic<int> count;
+    std::atomic<int> generation;
+    std::atomic<int> aborted;
+    int total;
+    bool wait();
+    void abort();
+};
+
+/* Fill in the row of the initial wave function, the one before it,
+and the potential, that are at the given row of the whole grid. */
+typedef std::function<void(int row, ComplexRows &psi0, ComplexRows &psi1,
+                           ComplexRows &potential)> SlabInitializer;
+
+/*
+Leapfrog time steps of a grid that is too large for a single texture,
+split across several processes on one machine.
+
+The rows of the grid are split into slabs of nearly equal height,
+one for each rank, and the ranks are forked processes that share a
+single anonymous memory mapping. Each rank's wave functions have halo
+rows above and below its slab, at least two, or the stencil's radius
+if that is larger. After each step, every rank copies the edge rows of
+its neighbours into its halos, which is the only data that moves
+between ranks. The slabs are first touched by the rank that owns them,
+so on a NUMA machine each one is in the memory nearest its rank.
+
+Particles are moved by each rank using the wave function of its own
+slab and halos, with the same RK4 step as ParticleGuide with its
+velocity fields interpolated, taken on every other time step as in the
+GUI. The stages of the step use the wave functions before and after
+the step, and the one in the middle. Those particles that leave the slab
+are put in an outbox for the neighbouring rank in the direction of
+their new owner, and are taken in by that rank after the halo
+exchange. Rows wrap around, so the first and last ranks
+are neighbours.
+
+Every rank, including the first, is a child of the calling process,
+which waits for them. If any of them dies, the barrier is aborted, so
+that the others stop at their next wait instead of spinning forever.
+*/
+class SlabDecomposition {
+    struct RankControl {
+        int outbox_count[2];
+        int particle_count;
+    };
+    SlabParams m_params;
+    int m_halo;
+    std::vector<int> m_row_begin;
+    uint8_t *m_shared;
+    size_t m_shared_size;
+    SharedBarrier *m_barrier;
+    RankControl *m_controls;
+    // Offsets into the shared memory for each rank.
+    std::vector<size_t> m_field_offsets, m_outbox_offsets;
+    size_t m_plane_size;
+    int owner(float y) const;
+    void exchange_halos(int rank, int array);
+    VelocityField m_velocity[3];
+    void move_particles(int rank, const int arrays[3], bool guide,
+                        std::vector<float> &particles, ThreadPool &pool);
+    void receive_particles(int rank, std::vector<float> &particles);
+    bool run_rank(int rank, int step_count, bool start_with_half_step,
+                  const SlabInitializer &initializer,
+                  const std::vector<float> &initial_particles);
+    SlabDecomposition(const SlabDecomposition &);
+    SlabDecomposition& operator=(const SlabDecomposition &);
+    public:
+    enum {PSI0=0, PSI1=1, PSI2=2, POTENTIAL=3, ARRAY_COUNT=4};
+    SlabDecomposition(const SlabParams &params);
+    bool is_valid() const;
+    int row_begin(int rank) const;
+    int row_end(int rank) const;
+    /* Rows of the slab of the given rank. The halo rows are at
+    rows -halo to -1 and height to height + halo - 1.*/
+    ComplexRows field(int rank, int array) const;
+    /* Run for step_count steps, where initializer is called by each rank
+    for the rows of its slab. If start_with_half_step is set, psi1 is
+    found from psi0 with a half step, in the same way as the GUI does for
+    a new wave function. Afterwards, psi(t - dt) and psi(t) are in
+    field(rank, previous) and field(rank, current), and the particles
+    of every rank are in particles.*/
+    bool run(int step_count, bool start_with_half_step,
+             const SlabInitializer &initializer,
+             std::vector<float> &particles, int &previous, int &current);
+    ~SlabDecomposition();
+};
+
+#endif
@@ -8,26 +8,54 @@ const ENUM_CODES = {
     WAVE_FUNC_SIZE: 6,
     M: 7,
     DT: 8,
-    MOUSE_USAGE_ENTRY: 9,
-    NUMBER_OF_PARTICLES: 10,
-    SHOW_TRAILS: 11,
-    LINE_DIV: 12,
-    SLIDER_SET_WAVE_FUNC_TITLE: 13,
-    SLIDER_NEW_WAVE_FUNC_MOMENTUM: 14,
-    SLIDER_NEW_WAVE_FUNC_POSITION: 15,
-    ENTER_WAVE_FUNC: 16,
-    LINE_DIV2: 17,
-    WAVE_DISCRETIZATION_DIMENSIONS: 18,
-    POTENTIAL_GRID_WIDTH: 19,
-    POTENTIAL_GRID_HEIGHT: 20,
-    WAVE_SIMULATION_DIMENSIONS: 21,
-    PRESET_POTENTIAL_DROPDOWN: 22,
-    USER_TEXT_ENTRY: 23,
-    USER_WARNING_LABEL: 24,
-    ADD_ABSORBING_BOUNDARIES: 25,
-    IMAGE_POTENTIAL: 26,
-    TAKE_SCREENSHOTS: 27,
-    DUMMY_VALUE: 28,
+    TIME_STEP_BACKEND: 9,
+    STENCIL_ORDER: 10,
+    CHEBYSHEV_DIGITS: 11,
+    MONITOR_DRIFT: 12,
+    DRIFT_CHECK_INTERVAL: 13,
+    DRIFT_THRESHOLD: 14,
+    DRIFT_ACTION: 15,
+    MOUSE_USAGE_ENTRY: 16,
+    NUMBER_OF_PARTICLES: 17,
+    PARTICLE_PLACEMENT: 18,
+    SHOW_TRAILS: 19,
+    PARTICLE_DENSITY_BUDGET: 20,
+    INTERPOLATE_VELOCITY_FIELD: 21,
+    ADAPTIVE_SUBSTEPS: 22,
+    SUBSTEP_TOLERANCE: 23,
+    SORT_PARTICLES: 24,
+    PARTICLE_SORT_INTERVAL: 25,
+    WEIGHTED_PARTICLES: 26,
+    LINE_DIV: 27,
+    SLIDER_SET_WAVE_FUNC_TITLE: 28,
+    SLIDER_NEW_WAVE_FUNC_MOMENTUM: 29,
+    SLIDER_NEW_WAVE_FUNC_POSITION: 30,
+    ENTER_WAVE_FUNC: 31,
+    LINE_DIV2: 32,
+    WAVE_DISCRETIZATION_DIMENSIONS: 33,
+    POTENTIAL_GRID_WIDTH: 34,
+    POTENTIAL_GRID_HEIGHT: 35,
+    WAVE_SIMULATION_DIMENSIONS: 36,
+    PRESET_POTENTIAL_DROPDOWN: 37,
+    USER_TEXT_ENTRY: 38,
+    USER_WARNING_LABEL: 39,
+    ADD_ABSORBING_BOUNDARIES: 40,
+    COMPACTION_INTERVAL: 41,
+    LIVE_PARTICLES_LABEL: 42,
+    IMAGE_POTENTIAL: 43,
+    TAKE_SCREENSHOTS: 44,
+    SCREENSHOT_POLICY: 45,
+    VIDEO_RECORD: 46,
+    VIDEO_FORMAT: 47,
+    SAVE_CHECKPOINT: 48,
+    LOAD_CHECKPOINT: 49,
+    LINE_DIV3: 50,
+    SIMULATE3_D: 51,
+    VOLUME_TEXEL_DIMENSIONS3_D: 52,
+    WAVE_SIMULATION_DIMENSIONS3_D: 53,
+    PLANAR_SLICE_SELECT: 54,
+    PLANAR_NORM_COORD_OFFSETS: 55,
+    DUMMY_VALUE: 56,
 };
 
 function createScalarParameterSlider(
@@ -375,20 +403,47 @@ createScalarParameterSlider(controls, 3, "Potential brightness", "float", {'valu
 createScalarParameterSlider(controls, 4, "Particle brightness", "float", {'value': 1.0, 'min': 0.0, 'max': 1.0, 'step': 0.01});
 createScalarParameterSlider(controls, 6, "New wave function size", "float", {'value': 0.025, 'min': 0.02, 'max': 0.05, 'step': 0.001});
 createScalarParameterSlider(controls, 7, "Mass", "float", {'value': 1.0, 'min': 1.0, 'max': 5.0, 'step': 0.01});
-createScalarParameterSlider(controls, 8, "Time step", "float", {'value': 0.3, 'min': 0.0, 'max': 0.3, 'step': 0.01});
-createSelectionList(controls, 9, 0, "Use mouse to:", [ "Create new wave function",  "Draw potential barrier",  "Erase potential barrier"]);
-createScalarParameterSlider(controls, 10, "Particle count upon placement of new wave function", "int", {'value': 65536, 'min': 4096, 'max': 1048576, 'step': 4096});
-createCheckbox(controls, 11, "Show particle trails", false);
+createScalarParameterSlider(controls, 8, "Time step (limited to 0.3 for the leapfrog steps, which are unstable above it)", "float", {'value': 0.3, 'min': 0.0, 'max': 3.0, 'step': 0.01});
+createSelectionList(controls, 9, 0, "Compute time steps on", [ "GPU",  "CPU (multithreaded)",  "CPU split-operator (FFT)",  "CPU implicit ADI Crank-Nicolson (2nd order Laplacian only)",  "GPU Chebyshev propagator"]);
+createSelectionList(controls, 10, 1, "Finite difference stencil order", [ "2nd order",  "4th order",  "6th order"]);
+createScalarParameterSlider(controls, 11, "Chebyshev propagator accuracy (digits)", "int", {'value': 6, 'min': 2, 'max': 7});
+createCheckbox(controls, 12, "Monitor norm and energy drift (logged to pilot2d_drift.csv)", false);
+createScalarParameterSlider(controls, 13, "Steps between drift checks", "int", {'value': 60, 'min': 1, 'max': 600});
+createScalarParameterSlider(controls, 14, "Relative drift threshold", "float", {'value': 0.01, 'min': 0.0001, 'max': 0.5, 'step': 0.0001});
+createSelectionList(controls, 15, 0, "When the drift exceeds the threshold", [ "Only log it",  "Halve the time step",  "Stop the simulation"]);
+createSelectionList(controls, 16, 0, "Use mouse to:", [ "Create new wave function",  "Draw potential barrier",  "Erase potential barrier"]);
+createScalarParameterSlider(controls, 17, "Particle count upon placement of new wave function", "int", {'value': 65536, 'min': 4096, 'max': 1048576, 'step': 4096});
+createSelectionList(controls, 18, 0, "Place new particles with", [ "Random points",  "Quasi-random points (scrambled Sobol,  smoother for fewer particles)"]);
+createCheckbox(controls, 19, "Show particle trails", false);
+createScalarParameterSlider(controls, 20, "Draw the particles as a density above this many particles", "int", {'value': 262144, 'min': 4096, 'max': 1048576, 'step': 4096});
+createCheckbox(controls, 21, "Guide particles with a precomputed velocity field (faster, but less accurate near nodes)", true);
+createCheckbox(controls, 22, "Substep particles whose step error is too large (near nodes)", false);
+createScalarParameterSlider(controls, 23, "Largest particle step error (texels)", "float", {'value': 0.05, 'min': 0.001, 'max': 1.0, 'step': 0.001});
+createCheckbox(controls, 24, "Periodically sort particles in Z-order (faster guiding for many particles)", false);
+createScalarParameterSlider(controls, 25, "Particle steps between sorts", "int", {'value': 50, 'min': 1, 'max': 1000});
+createCheckbox(controls, 26, "Place new particles as weighted particles (more of them in the tails of |psi|^2)", false);
 createLineDivider(controls);
-createLabel(controls, 13, "Use sliders to place new wave function:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
-createVectorParameterSliders(controls, 14, "Initial wavenumber w.r.t. simulation domain dimensions", "Vec2", {'value': [0.0, 40.0], 'min': [-40.0, -40.0], 'max': [40.0, 40.0]});
-createVectorParameterSliders(controls, 15, "Initial position", "Vec2", {'value': [128.0, 128.0], 'min': [0.0, 0.0], 'max': [512.0, 512.0]});
-createButton(controls, 16, "Initialize new wave function");
+createLabel(controls, 28, "Use sliders to place new wave function:", "color:white; font-family:Arial, Helvetica, sans-serif; font-weight: bold;");
+createVectorParameterSliders(controls, 29, "Initial wavenumber w.r.t. simulation domain dimensions", "Vec2", {'value': [0.0, 40.0], 'min': [-40.0, -40.0], 'max': [40.0, 40.0]});
+createVectorParameterSliders(controls, 30, "Initial position", "Vec2", {'value': [128.0, 128.0], 'min': [0.0, 0.0], 'max': [512.0, 512.0]});
+createButton(controls, 31, "Initialize new wave function");
 createLineDivider(controls);
-createSelectionList(controls, 22, 0, "Preset V(x, y, t)", [ "((x/width)^2 + (y/height)^2)",  "0",  "amp*((x/width)^2 + (y/height)^2)",  "0.4*(step(-y^2+(height*0.04)^2)+step(y^2-(height*0.06)^2))*step(-x^2+(width*0.01)^2)",  "1.0/sqrt(x^2+y^2)+1.0/sqrt((x-0.25*width)^2+(y-0.25*height)^2)",  "(x*cos(w*t/200) + y*sin(w*t/200))/500+0.01",  "0.5*(tanh(75.0*(((x/width)^2+(y/height)^2)^0.5-0.45))+1.0)"]);
-createEntryBoxes(controls, 23, "Enter potential V(x, y, t)", 1, []);
-createLabel(controls, 24, "(Please note: to ensure stability, clamping is applied to the potential so that |V(x, y, t)| < 1.)", "");
-createCheckbox(controls, 25, "Add absorbing boundaries (MAY INCUR INSTABILITY, particularly if the potential is non-zero at the boundaries!)", false);
-createUploadImage(controls, 26, "Set V(x, y) using image", "POTENTIAL_GRID_WIDTH", "POTENTIAL_GRID_HEIGHT");
-createBMPRecordCheckbox(controls, 27, "Take screenshots at every frame (uncompressed bitmap)", false);
+createSelectionList(controls, 37, 0, "Preset V(x, y, t)", [ "((x/width)^2 + (y/height)^2)",  "0",  "amp*((x/width)^2 + (y/height)^2)",  "0.4*(step(-y^2+(height*0.04)^2)+step(y^2-(height*0.06)^2))*step(-x^2+(width*0.01)^2)",  "1.0/sqrt(x^2+y^2)+1.0/sqrt((x-0.25*width)^2+(y-0.25*height)^2)",  "(x*cos(w*t/200) + y*sin(w*t/200))/500+0.01",  "0.5*(tanh(75.0*(((x/width)^2+(y/height)^2)^0.5-0.45))+1.0)"]);
+createEntryBoxes(controls, 38, "Enter potential V(x, y, t)", 1, []);
+createLabel(controls, 39, "(Please note: to ensure stability, clamping is applied to the potential so that |V(x, y, t)| < 1.)", "");
+createCheckbox(controls, 40, "Add absorbing boundaries (MAY INCUR INSTABILITY, particularly if the potential is non-zero at the boundaries!)", false);
+createScalarParameterSlider(controls, 41, "Particle steps between removals of absorbed particles", "int", {'value': 50, 'min': 1, 'max': 1000});
+createLabel(controls, 42, "Live particles: all", "");
+createUploadImage(controls, 43, "Set V(x, y) using image", "POTENTIAL_GRID_WIDTH", "POTENTIAL_GRID_HEIGHT");
+createBMPRecordCheckbox(controls, 44, "Take screenshots at every frame (uncompressed bitmap)", false);
+createSelectionList(controls, 45, 0, "When screenshots cannot be saved fast enough", [ "Drop frames",  "Slow down the simulation"]);
+createCheckbox(controls, 46, "Record video", false);
+createSelectionList(controls, 47, 0, "Video format", [ "YUV4MPEG2 file",  "Raw RGB file",  "YUV4MPEG2 to standard output",  "Raw RGB to standard output"]);
+createButton(controls, 48, "Save checkpoint (pilot2d.checkpoint)");
+createButton(controls, 49, "Restart from checkpoint (pilot2d.checkpoint)");
+createLineDivider(controls);
+createCheckbox(controls, 51, "Simulate in 3D (new wave functions and particles are placed on the slice)", false);
+createVectorParameterSliders(controls, 52, "Volume dimensions", "IVec3", {'value': [128, 128, 128], 'min': [16, 16, 16], 'max': [512, 512, 512], 'step': [2, 2, 4]});
+createSelectionList(controls, 54, 0, "Show planar slice", [ "xy",  "yz",  "xz"]);
+createVectorParameterSliders(controls, 55, "Planar slices offsets (in normalized coordinates) for xy, yz, xz", "Vec3", {'value': [0.5, 0.5, 0.5], 'min': [0.0, 0.0, 0.0], 'max': [1.0, 1.0, 1.0], 'step': [0.001, 0.001, 0.001]});
 
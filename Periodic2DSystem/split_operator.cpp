@@ -0,0 +1,109 @@
+#include "split_operator.hpp"
+#include <cmath>
+
+SplitOperator::SplitOperator():
+    m_params({.m=0.0, .hbar=0.0, .dt=0.0, .width=0.0, .height=0.0}),
+    m_potential_changed(true) {}
+
+bool SplitOperator::supports(int width, int height) {
+    return is_power_of_two(width) && is_power_of_two(height);
+}
+
+/* Mark the potential phase to be remade on the next step. */
+void SplitOperator::set_potential_changed() {
+    m_potential_changed = true;
+}
+
+/* Make the factors exp(-i hbar k^2 dt/(2m)) for the wave numbers of each
+column and row, in the order that the FFT outputs them. The 1/(width*height)
+normalization of the inverse FFT is folded into the column factors.*/
+void SplitOperator::make_kinetic_phase(const SplitOperatorParams &params) {
+    int width = m_row_plan.size, height = m_column_plan.size;
+    auto make = [&](std::vector<float> &re, std::vector<float> &im,
+                    int n, double length, double scale) {
+        re.resize(n);
+        im.resize(n);
+        for (int i = 0; i < n; i++) {
+            double k = 2.0*M_PI*((i < n/2)? i: i - n)/length;
+            double phase = -params.hbar*k*k*params.dt/(2.0*params.m);
+            re[i] = scale*cos(phase);
+            im[i] = scale*sin(phase);
+        }
+    };
+    make(m_kinetic_x_re, m_kinetic_x_im,
+         width, params.width, 1.0/((double)width*(double)height));
+    make(m_kinetic_y_re, m_kinetic_y_im, height, params.height, 1.0);
+}
+
+/* Make the factors exp(-i V dt/(2 hbar)), where the imaginary part of the
+potential gives the decay exp(Im(V) dt/(2 hbar)).*/
+void SplitOperator::make_potential_phase(
+    const ComplexField &potential, const SplitOperatorParams &params,
+    ThreadPool &pool) {
+    m_potential_phase.resize(potential.width, potential.height);
+    double s = params.dt/(2.0*params.hbar);
+    pool.parallel_for(0, potential.height, [&](int row_begin, int row_end) {
+        for (int k = row_begin*potential.width;
+             k < row_end*potential.width; k++) {
+            double decay = exp(s*potential.im[k]);
+            m_potential_phase.re[k] = decay*cos(-s*potential.re[k]);
+            m_potential_phase.im[k] = decay*sin(-s*potential.re[k]);
+        }
+    });
+}
+
+void SplitOperator::apply_potential_phase(
+    ComplexField &psi, ThreadPool &pool) {
+    const ComplexField &p = m_potential_phase;
+    pool.parallel_for(0, psi.height, [&](int row_begin, int row_end) {
+        for (int k = row_begin*psi.width; k < row_end*psi.width; k++) {
+            float re = psi.re[k]*p.re[k] - psi.im[k]*p.im[k];
+            float im = psi.re[k]*p.im[k] + psi.im[k]*p.re[k];
+            psi.re[k] = re;
+            psi.im[k] = im;
+        }
+    });
+}
+
+/* Advance psi by a single time step in place.*/
+void SplitOperator::step(
+    ComplexField &psi, const ComplexField &potential,
+    const SplitOperatorParams &params, ThreadPool &pool) {
+    int width = psi.width, height = psi.height;
+    bool grid_changed = (m_row_plan.size != width
+                         || m_column_plan.size != height);
+    if (grid_changed) {
+        m_row_plan = FFTPlan(width);
+        m_column_plan = (height == width)? m_row_plan: FFTPlan(height);
+    }
+    bool params_changed = (params.m != m_params.m
+                           || params.hbar != m_params.hbar
+                           || params.dt != m_params.dt
+                           || params.width != m_params.width
+                           || params.height != m_params.height);
+    if (grid_changed || params_changed)
+        this->make_kinetic_phase(params);
+    if (grid_changed || params_changed || m_potential_changed)
+        this->make_potential_phase(potential, params, pool);
+    m_params = params;
+    m_potential_changed = false;
+    this->apply_potential_phase(psi, pool);
+    fft2d(psi, m_row_plan, m_column_plan, false, pool);
+    pool.parallel_for(0, height, [&](int row_begin, int row_end) {
+        for (int i = row_begin; i < row_end; i++) {
+            float *re = &psi.re[width*i], *im = &psi.im[width*i];
+            float ky_re = m_kinetic_y_re[i], ky_im = m_kinetic_y_im[i];
+            for (int j = 0; j < width; j++) {
+                float k_re = m_kinetic_x_re[j]*ky_re
+                    - m_kinetic_x_im[j]*ky_im;
+                float k_im = m_kinetic_x_re[j]*ky_im
+                    + m_kinetic_x_im[j]*ky_re;
+                float r = re[j]*k_re - im[j]*k_im;
+                im[j] = re[j]*k_im + im[j]*k_re;
+                re[j] = r;
+            }
+        }
+    });
+    fft2d(psi, m_row_plan, m_column_plan, true, pool);
+    this->apply_potential_phase(psi, pool);
+}
@@ -0,0 +1,55 @@
+#include "cpu_wave_function.hpp"
+#include "fft.hpp"
+
+#ifndef _SPLIT_OPERATOR_
+#define _SPLIT_OPERATOR_
+
+struct SplitOperatorParams {
+    float m, hbar, dt;
+    float width, height;
+};
+
+/*
+Second order (Strang) split-operator time step for the periodic
+wave function, where
+
+    psi(t + dt) = exp(-i V dt/(2 hbar)) F^-1 exp(-i hbar k^2 dt/(2m)) F
+                  exp(-i V dt/(2 hbar)) psi(t),
+
+and F is the 2D Fourier transform. Without an imaginary (absorbing)
+part of the potential each factor is unitary, so unlike the
+leapfrog scheme this stays stable for any time step, although
+the accuracy still depends on it.
+
+The FFT plans and the phase factors are kept between steps and
+are only remade when the grid, the parameters, or the potential
+change. Both dimensions of the grid must be powers of two.
+
+Reference:
+
+Wikipedia - Split-step method
+https://en.wikipedia.org/wiki/Split-step_method
+*/
+class SplitOperator {
+    FFTPlan m_row_plan, m_column_plan;
+    // The kinetic phase is separable, so it is kept as
+    // one factor for each column and one for each row.
+    std::vector<float> m_kinetic_x_re, m_kinetic_x_im;
+    std::vector<float> m_kinetic_y_re, m_kinetic_y_im;
+    ComplexField m_potential_phase;
+    SplitOperatorParams m_params;
+    bool m_potential_changed;
+    void make_kinetic_phase(const SplitOperatorParams &params);
+    void make_potential_phase(const ComplexField &potential,
+                              const SplitOperatorParams &params,
+                              ThreadPool &pool);
+    void apply_potential_phase(ComplexField &psi, ThreadPool &pool);
+    public:
+    SplitOperator();
+    static bool supports(int width, int height);
+    void set_potential_changed();
+    void step(ComplexField &psi, const ComplexField &potential,
+              const SplitOperatorParams &params, ThreadPool &pool);
+};
+
+#endif
@@ -0,0 +1,115 @@
+/* Compare the accuracy and cost of each order of the finite difference
+stencil used by the CPU time step, for several grid sizes, so that the
+cheapest stencil that meets some error budget can be picked.
+
+The accuracy is the relative L2 error of the Laplacian of a moving
+Gaussian wave packet, compared to its exact Laplacian, and the cost is
+the average wall clock time of one leapfrog time step.
+
+Build with make stencil_benchmark, and run as
+
+    ./stencil_benchmark [error budget] [thread count]
+
+*/
+#include "cpu_wave_function.hpp"
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+
+#define REPEAT_COUNT 20
+
+typedef std::complex<double> Complex;
+
+static const int GRID_SIZES[] = {128, 256, 512, 1024, 2048};
+
+/* Wave packet in the unit square, and its exact Laplacian. It is narrow
+enough that the parts that wrap around the periodic boundaries are
+far smaller than single precision can represent.*/
+static const double SIGMA = 0.05, X0 = 0.5, Y0 = 0.5;
+static const double KX = 60.0, KY = -40.0;
+
+static Complex wave_packet(double x, double y) {
+    double r2 = (x - X0)*(x - X0) + (y - Y0)*(y - Y0);
+    return exp(-0.5*r2/(SIGMA*SIGMA))*Complex(cos(KX*x + KY*y),
+                                              sin(KX*x + KY*y));
+}
+
+static Complex wave_packet_laplacian(double x, double y) {
+    Complex gx = Complex(-(x - X0)/(SIGMA*SIGMA), KX);
+    Complex gy = Complex(-(y - Y0)/(SIGMA*SIGMA), KY);
+    return wave_packet(x, y)*(gx*gx + gy*gy - 2.0/(SIGMA*SIGMA));
+}
+
+struct Result {
+    double error;
+    double milliseconds;
+};
+
+static Result measure(int n, int order, ThreadPool &pool) {
+    ComplexField psi0, psi1, psi2, potential;
+    psi0.resize(n, n);
+    psi1.resize(n, n);
+    potential.resize(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Complex z = wave_packet(j/double(n), i/double(n));
+            psi1.re[i*n + j] = z.real();
+            psi1.im[i*n + j] = z.imag();
+        }
+    }
+    // With hbar = 1, m = 1/2, dt = 1, psi0 = 0 and V = 0,
+    // the time step gives psi2 = i L psi1.
+    LeapfrogParams params = {
+        .m=0.5F, .hbar=1.0F, .dt=1.0F,
+        .dx=1.0F/n, .dy=1.0F/n,
+        .stencil_order=order,
+    };
+    leapfrog_time_step(psi2, psi0, psi1, potential, params, pool);
+    double error2 = 0.0, norm2 = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Complex exact = wave_packet_laplacian(j/double(n), i/double(n));
+            Complex approx = Complex(psi2.im[i*n + j], -psi2.re[i*n + j]);
+            error2 += std::norm(approx - exact);
+            norm2 += std::norm(exact);
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT_COUNT; r++)
+        leapfrog_time_step(psi2, psi0, psi1, potential, params, pool);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    return {.error=sqrt(error2/norm2),
+            .milliseconds=elapsed.count()/REPEAT_COUNT};
+}
+
+int main(int argc, char **argv) {
+    double error_budget = (argc > 1)? atof(argv[1]): 1e-3;
+    int thread_count = (argc > 2)? atoi(argv[2]): 0;
+    ThreadPool pool(thread_count);
+    printf("%d threads, error budget %g\n\n",
+           pool.thread_count(), error_budget);
+    printf("%10s %6s %14s %12s\n", "grid", "order", "rel. error", "ms/step");
+    for (int n: GRID_SIZES) {
+        int cheapest = 0;
+        double cheapest_time = 0.0;
+        for (int k = 0; k < STENCIL_ORDER_COUNT; k++) {
+            int order = STENCIL_ORDERS[k];
+            Result result = measure(n, order, pool);
+            printf("%4d x %-4d %6d %14.3e %12.3f\n",
+                   n, n, order, result.error, result.milliseconds);
+            if (result.error <= error_budget
+                && (cheapest == 0 || result.milliseconds < cheapest_time)) {
+                cheapest = order;
+                cheapest_time = result.milliseconds;
+            }
+        }
+        if (cheapest)
+            printf("Cheapest within budget: order %d\n\n", cheapest);
+        else
+            printf("No order is within budget\n\n");
+    }
+    return 0;
+}
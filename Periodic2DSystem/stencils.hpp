@@ -0,0 +1,68 @@
+#ifndef _STENCILS_
+#define _STENCILS_
+
+/* Central finite difference stencils, for each supported order of
+accuracy. For the Laplacian, the second derivative along one direction
+at index j is
+
+    (LAPLACIAN[0] f_j + sum_k LAPLACIAN[k] (f_(j+k) + f_(j-k)))/dx^2,
+
+and for the gradient the first derivative is
+
+    sum_k GRADIENT[k] (f_(j+k) - f_(j-k))/dx,
+
+where k goes from 1 to RADIUS. These are the same as the ones used by
+the shaders when STENCIL_ORDER is defined (see make_stencil_program).
+
+Reference:
+
+Wikipedia - Finite difference coefficient
+https://en.wikipedia.org/wiki/Finite_difference_coefficient
+*/
+template <int ORDER> struct Stencil;
+
+template <> struct Stencil<2> {
+    static constexpr int RADIUS = 1;
+    static constexpr float LAPLACIAN[2] = {-2.0F, 1.0F};
+    static constexpr float GRADIENT[2] = {0.0F, 1.0F/2.0F};
+};
+
+template <> struct Stencil<4> {
+    static constexpr int RADIUS = 2;
+    static constexpr float LAPLACIAN[3] = {-5.0F/2.0F, 4.0F/3.0F, -1.0F/12.0F};
+    static constexpr float GRADIENT[3] = {0.0F, 2.0F/3.0F, -1.0F/12.0F};
+};
+
+template <> struct Stencil<6> {
+    static constexpr int RADIUS = 3;
+    static constexpr float LAPLACIAN[4] = {
+        -49.0F/18.0F, 3.0F/2.0F, -3.0F/20.0F, 1.0F/90.0F};
+    static constexpr float GRADIENT[4] = {
+        0.0F, 3.0F/4.0F, -3.0F/20.0F, 1.0F/60.0F};
+};
+
+/* Orders of the stencils, in the same order as the
+options of the stencilOrder parameter. */
+static const int STENCIL_ORDERS[3] = {2, 4, 6};
+#define STENCIL_ORDER_COUNT 3
+
+/* Largest magnitude of the eigenvalues of the one dimensional
+Laplacian stencil of the given order with unit grid spacing,
+which is at the highest (Nyquist) frequency.*/
+template <int ORDER>
+constexpr float laplacian_spectral_radius() {
+    float sum = -Stencil<ORDER>::LAPLACIAN[0];
+    for (int k = 1; k <= Stencil<ORDER>::RADIUS; k++)
+        sum -= 2.0F*Stencil<ORDER>::LAPLACIAN[k]*((k % 2)? -1.0F: 1.0F);
+    return sum;
+}
+
+inline float laplacian_spectral_radius(int order) {
+    switch (order) {
+        case 2: return laplacian_spectral_radius<2>();
+        case 6: return laplacian_spectral_radius<6>();
+        default: return laplacian_spectral_radius<4>();
+    }
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "thread_pool.hpp"
+#include <thread>
+
+/* Number of chunks that each thread gets on average, so that
+threads that finish early can take on more of the work. */
+#define CHUNKS_PER_THREAD 4
+
+/* Create a pool with the given number of threads, including the
+thread that calls parallel_for. If this is zero, as many threads
+as there are hardware threads are used.*/
+ThreadPool::ThreadPool(int thread_count):
+    m_task(NULL), m_next(0), m_end(0), m_chunk_size(1),
+    m_active_count(0), m_stop(false) {
+    #ifndef __EMSCRIPTEN__
+    if (thread_count <= 0)
+        thread_count = std::thread::hardware_concurrency();
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_task_cond, NULL);
+    pthread_cond_init(&m_done_cond, NULL);
+    m_threads = std::vector<pthread_t>(
+        (thread_count > 1)? thread_count - 1: 0);
+    for (auto &thread: m_threads)
+        pthread_create(&thread, NULL, ThreadPool::work_loop, this);
+    #endif
+}
+
+int ThreadPool::thread_count() const {
+    #ifndef __EMSCRIPTEN__
+    return m_threads.size() + 1;
+    #else
+    return 1;
+    #endif
+}
+
+#ifndef __EMSCRIPTEN__
+/* Take chunks of the current task and run them, until
+there are none left.*/
+void ThreadPool::run_chunks() {
+    pthread_mutex_lock(&m_mutex);
+    while (m_task != NULL && m_next < m_end) {
+        const std::function<void(int, int)> &task = *m_task;
+        int begin = m_next;
+        int end = (m_end - begin > m_chunk_size)?
+            begin + m_chunk_size: m_end;
+        m_next = end;
+        m_active_count++;
+        pthread_mutex_unlock(&m_mutex);
+        task(begin, end);
+        pthread_mutex_lock(&m_mutex);
+        m_active_count--;
+        if (m_active_count == 0 && m_next >= m_end)
+            pthread_cond_broadcast(&m_done_cond);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void *ThreadPool::work_loop(void *void_pool) {
+    ThreadPool *pool = (ThreadPool *)void_pool;
+    pthread_mutex_lock(&pool->m_mutex);
+    while (true) {
+        while (!pool->m_stop
+               && (pool->m_task == NULL || pool->m_next >= pool->m_end))
+            pthread_cond_wait(&pool->m_task_cond, &pool->m_mutex);
+        if (pool->m_stop)
+            break;
+        pthread_mutex_unlock(&pool->m_mutex);
+        pool->run_chunks();
+        pthread_mutex_lock(&pool->m_mutex);
+    }
+    pthread_mutex_unlock(&pool->m_mutex);
+    return NULL;
+}
+#endif
+
+/* Call f(chunk_begin, chunk_end) over chunks that together cover
+[begin, end), where each chunk except the last has at least
+min_chunk_size indices.*/
+void ThreadPool::parallel_for(
+    int begin, int end, const std::function<void(int, int)> &f,
+    int min_chunk_size) {
+    if (end <= begin)
+        return;
+    #ifndef __EMSCRIPTEN__
+    int chunk_size = (end - begin)/(CHUNKS_PER_THREAD*this->thread_count());
+    chunk_size = (chunk_size > min_chunk_size)? chunk_size: min_chunk_size;
+    if (m_threads.empty() || chunk_size >= end - begin) {
+        f(begin, end);
+        return;
+    }
+    pthread_mutex_lock(&m_mutex);
+    m_task = &f;
+    m_next = begin;
+    m_end = end;
+    m_chunk_size = chunk_size;
+    pthread_cond_broadcast(&m_task_cond);
+    pthread_mutex_unlock(&m_mutex);
+    this->run_chunks();
+    pthread_mutex_lock(&m_mutex);
+    while (m_active_count > 0 || m_next < m_end)
+        pthread_cond_wait(&m_done_cond, &m_mutex);
+    m_task = NULL;
+    pthread_mutex_unlock(&m_mutex);
+    #else
+    f(begin, end);
+    #endif
+}
+
+ThreadPool::~ThreadPool() {
+    #ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_task_cond);
+    pthread_mutex_unlock(&m_mutex);
+    for (auto &thread: m_threads)
+        pthread_join(thread, NULL);
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_task_cond);
+    pthread_cond_destroy(&m_done_cond);
+    #endif
+}
@@ -0,0 +1,47 @@
+#include <functional>
+#include <vector>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#ifndef _THREAD_POOL_
+#define _THREAD_POOL_
+
+/*
+Pool of threads for splitting loops over a range of indices,
+such as the rows of a grid.
+
+A call to parallel_for divides its range into chunks, which are handed
+out to the worker threads and to the calling thread as each of them
+becomes free, and only returns once every chunk is done. The workers
+wait on a condition variable between calls.
+
+When compiling with Emscripten, parallel_for runs the whole range
+on the calling thread.
+*/
+class ThreadPool {
+    const std::function<void(int, int)> *m_task;
+    int m_next, m_end, m_chunk_size;
+    int m_active_count;
+    bool m_stop;
+    #ifndef __EMSCRIPTEN__
+    std::vector<pthread_t> m_threads;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_task_cond;
+    pthread_cond_t m_done_cond;
+    static void *work_loop(void *void_pool);
+    void run_chunks();
+    #endif
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+    public:
+    ThreadPool(int thread_count=0);
+    int thread_count() const;
+    void parallel_for(int begin, int end,
+                      const std::function<void(int, int)> &f,
+                      int min_chunk_size=1);
+    ~ThreadPool();
+};
+
+#endif
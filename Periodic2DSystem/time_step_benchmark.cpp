@@ -0,0 +1,161 @@
+/* Check that every CPU backend moves the wave function forward by the
+same time in each call of Simulation::time_step, by comparing the phase
+of a plane wave after the same number of calls with each of them. Each
+call moves psi forward by dt/2, except for the first, which also takes
+the initial half step, so that the particles' RK4 stages see the wave
+function at t, t + dt/2, and t + dt. The time steps are done here in
+the same way as in Simulation, and the phases are compared with the
+exact phase -hbar k^2 t/(2m), along with the time each backend takes. The
+leapfrog step uses the fourth order Laplacian, while the ADI step only
+has the second order one, so its phase is further off.
+
+Build with make time_step_benchmark, and run as
+
+    ./time_step_benchmark [dt] [thread count]
+
+where dt is at most MAX_LEAPFROG_DT, which the leapfrog steps are
+limited to.
+
+It exits with a nonzero status if any phase is off by more than
+PHASE_TOLERANCE, relative to the exact phase.
+*/
+#include "cpu_wave_function.hpp"
+#include "split_operator.hpp"
+#include "adi.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#define GRID_SIZE 256
+#define CALL_COUNT 100
+#define PHASE_TOLERANCE 0.01
+
+/* Wave number of the plane wave, in periods across the grid. */
+static const int NX = 8;
+
+/* Moves psi[2] forward from psi[0] and psi[1], as one call of
+Simulation::time_step does for a backend, after the initial half
+step, which is done with first set.*/
+typedef std::function<void(ComplexField *psi, bool first)> TimeStep;
+
+/* Phase of psi relative to the plane wave at t = 0. */
+static double relative_phase(const ComplexField &psi) {
+    int n = psi.width;
+    double re = 0.0, im = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double phase = 2.0*M_PI*NX*j/n;
+            double c = cos(phase), s = sin(phase);
+            re += psi.re[i*n + j]*c + psi.im[i*n + j]*s;
+            im += psi.im[i*n + j]*c - psi.re[i*n + j]*s;
+        }
+    }
+    return atan2(im, re);
+}
+
+/* Make CALL_COUNT calls of the given time step, rotating the wave
+functions after each in the same way as Simulation::time_step, and
+return the phase of the newest one. The time taken is put in
+elapsed_time, in seconds.*/
+static double phase_after_calls(const TimeStep &time_step,
+                                double &elapsed_time) {
+    int n = GRID_SIZE;
+    ComplexField psi[3];
+    for (int k = 0; k < 3; k++) {
+        psi[k].resize(n, n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                double phase = 2.0*M_PI*NX*j/n;
+                psi[k].re[i*n + j] = cos(phase);
+                psi[k].im[i*n + j] = sin(phase);
+            }
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < CALL_COUNT; c++) {
+        time_step(psi, c == 0);
+        std::swap(psi[0], psi[1]);
+        std::swap(psi[1], psi[2]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    elapsed_time = std::chrono::duration<double>(end - start).count();
+    return relative_phase(psi[1]);
+}
+
+int main(int argc, char **argv) {
+    float dt = (argc > 1)? atof(argv[1]): 0.3F;
+    int thread_count = (argc > 2)? atoi(argv[2]): 0;
+    if (dt <= 0.0F || dt > MAX_LEAPFROG_DT) {
+        fprintf(stderr, "dt must be above 0 and at most %g.\n",
+                MAX_LEAPFROG_DT);
+        return 1;
+    }
+    ThreadPool pool(thread_count);
+    int n = GRID_SIZE;
+    float m = 1.0F, hbar = 1.0F;
+    ComplexField potential;
+    potential.resize(n, n);
+    LeapfrogParams leapfrog_params = {
+        .m=m, .hbar=hbar, .dt=dt, .dx=1.0F, .dy=1.0F, .stencil_order=4,
+    };
+    TimeStep leapfrog = [&](ComplexField *psi, bool first) {
+        if (first) {
+            LeapfrogParams half_step_params = leapfrog_params;
+            half_step_params.dt = dt/2.0F;
+            leapfrog_time_step(psi[1], psi[0], psi[0], potential,
+                               half_step_params, pool);
+        }
+        leapfrog_time_step(psi[2], psi[0], psi[1], potential,
+                           leapfrog_params, pool);
+    };
+    SplitOperator split_operator;
+    SplitOperatorParams split_operator_params = {
+        .m=m, .hbar=hbar, .dt=dt/2.0F,
+        .width=float(n), .height=float(n),
+    };
+    TimeStep split_operator_step = [&](ComplexField *psi, bool first) {
+        if (first) {
+            psi[1] = psi[0];
+            split_operator.step(psi[1], potential,
+                                split_operator_params, pool);
+        }
+        psi[2] = psi[1];
+        split_operator.step(psi[2], potential, split_operator_params, pool);
+    };
+    ADICrankNicolson adi;
+    ADIParams adi_params = {
+        .m=m, .hbar=hbar, .dt=dt/2.0F, .dx=1.0F, .dy=1.0F,
+    };
+    TimeStep adi_step = [&](ComplexField *psi, bool first) {
+        if (first) {
+            psi[1] = psi[0];
+            adi.step(psi[1], potential, adi_params, pool);
+        }
+        psi[2] = psi[1];
+        adi.step(psi[2], potential, adi_params, pool);
+    };
+    const char *names[] = {"leapfrog", "split-operator", "ADI"};
+    const TimeStep *time_steps[] = {
+        &leapfrog, &split_operator_step, &adi_step};
+    // The first call moves psi forward by all of dt.
+    double t = (CALL_COUNT + 1)*dt/2.0;
+    double k = 2.0*M_PI*NX/n;
+    double exact = remainder(-hbar*k*k*t/(2.0*m), 2.0*M_PI);
+    printf("Phase of a plane wave after %d calls with dt = %g, "
+           "t = %g:\n", CALL_COUNT, dt, t);
+    printf("%16s %10s %16s %10s\n",
+           "backend", "phase", "relative error", "time (ms)");
+    printf("%16s %10.4f\n", "exact", exact);
+    bool all_close = true;
+    for (int b = 0; b < 3; b++) {
+        double elapsed_time;
+        double phase = phase_after_calls(*time_steps[b], elapsed_time);
+        double error = fabs(remainder(phase - exact, 2.0*M_PI)/exact);
+        all_close = all_close && error <= PHASE_TOLERANCE;
+        printf("%16s %10.4f %16.2e %10.2f\n",
+               names[b], phase, error, 1000.0*elapsed_time);
+    }
+    return (all_close)? 0: 1;
+}
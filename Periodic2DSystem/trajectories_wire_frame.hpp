@@ -3,7 +3,14 @@
 
 #include "gl_wrappers.hpp"
 
-WireFrame get_trajectories_wire_frame(IVec2 d_2d);
+/* A single circle, made from a fan of triangles, which is drawn once
+for each particle by setting its instance count to the number of
+particles.*/
+WireFrame get_circle_wire_frame();
 
+/* A single point, which is drawn once for each particle in the same
+way, for adding up the particles into a density.*/
+WireFrame get_point_wire_frame();
 
-#endif
\ No newline at end of file
+
+#endif
@@ -0,0 +1,211 @@
+#include "video_stream.hpp"
+#include <cstring>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Size of the file buffer. Frames are written in a single call,
+so this mainly keeps the headers together with the frame data. */
+#define FILE_BUFFER_SIZE (1 << 22)
+
+static const char Y4M_FRAME_HEADER[] = "FRAME\n";
+
+/* Convert a row of pixels to the Y, U, and V planes, using the integer
+approximation of the BT.601 limited range transform.
+
+Reference:
+
+Wikipedia - Y′UV
+https://en.wikipedia.org/wiki/Y%E2%80%B2UV
+
+*/
+static void pixels_to_yuv_row(
+    const uint8_t *src, int channels, int width,
+    uint8_t *y, uint8_t *u, uint8_t *v) {
+    int j = 0;
+    #ifdef __SSE2__
+    if (channels == 4) {
+        // Every intermediate is kept to 16 bits. For U and V, an offset
+        // of 32768 keeps the sums positive, and after the shift it
+        // also becomes the 128 that is added to the chroma.
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        const __m128i y_offset = _mm_set1_epi16(128);
+        const __m128i y_black = _mm_set1_epi16(16);
+        const __m128i uv_offset = _mm_set1_epi16((short)(0x8080));
+        for (; j + 8 <= width; j += 8) {
+            __m128i p0 = _mm_loadu_si128((const __m128i *)(src + 4*j));
+            __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 4*j + 16));
+            __m128i r = _mm_packs_epi32(
+                _mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+            __m128i g = _mm_packs_epi32(
+                _mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+            __m128i b = _mm_packs_epi32(
+                _mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+            __m128i yy = _mm_add_epi16(
+                _mm_add_epi16(
+                    _mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                    _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+                _mm_add_epi16(
+                    _mm_mullo_epi16(b, _mm_set1_epi16(25)), y_offset));
+            yy = _mm_add_epi16(_mm_srli_epi16(yy, 8), y_black);
+            __m128i uu = _mm_sub_epi16(
+                _mm_add_epi16(
+                    _mm_mullo_epi16(b, _mm_set1_epi16(112)), uv_offset),
+                _mm_add_epi16(
+                    _mm_mullo_epi16(r, _mm_set1_epi16(38)),
+                    _mm_mullo_epi16(g, _mm_set1_epi16(74))));
+            uu = _mm_srli_epi16(uu, 8);
+            __m128i vv = _mm_sub_epi16(
+                _mm_add_epi16(
+                    _mm_mullo_epi16(r, _mm_set1_epi16(112)), uv_offset),
+                _mm_add_epi16(
+                    _mm_mullo_epi16(g, _mm_set1_epi16(94)),
+                    _mm_mullo_epi16(b, _mm_set1_epi16(18))));
+            vv = _mm_srli_epi16(vv, 8);
+            _mm_storel_epi64((__m128i *)(y + j), _mm_packus_epi16(yy, yy));
+            _mm_storel_epi64((__m128i *)(u + j), _mm_packus_epi16(uu, uu));
+            _mm_storel_epi64((__m128i *)(v + j), _mm_packus_epi16(vv, vv));
+        }
+    }
+    #endif
+    for (; j < width; j++) {
+        int r = src[channels*j];
+        int g = src[channels*j + 1];
+        int b = src[channels*j + 2];
+        y[j] = (uint8_t)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+        u[j] = (uint8_t)(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+        v[j] = (uint8_t)(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+    }
+}
+
+static void pixels_to_rgb_row(
+    const uint8_t *src, int channels, int width, uint8_t *dst) {
+    if (channels == 3) {
+        memcpy(dst, src, 3*width);
+        return;
+    }
+    for (int j = 0; j < width; j++) {
+        dst[3*j] = src[channels*j];
+        dst[3*j + 1] = src[channels*j + 1];
+        dst[3*j + 2] = src[channels*j + 2];
+    }
+}
+
+VideoStream::VideoStream():
+    m_file(NULL), m_to_stdout(false), m_width(0), m_height(0),
+    m_format(Y4M), m_size_mismatch_reported(false) {}
+
+bool VideoStream::open(
+    const std::string &fname, int width, int height,
+    int format, int frames_per_second) {
+    this->close();
+    if (fname == "-") {
+        // The stream gets its own copy of standard output, and
+        // standard output is pointed at standard error, so that
+        // nothing else that is printed ends up inside of the video.
+        fflush(stdout);
+        int fd = dup(fileno(stdout));
+        if (fd < 0 || (m_file = fdopen(fd, "wb")) == NULL) {
+            fprintf(stderr, "Unable to write video to standard output.\n");
+            if (fd >= 0)
+                ::close(fd);
+            return false;
+        }
+        dup2(fileno(stderr), fileno(stdout));
+        m_to_stdout = true;
+    } else {
+        m_file = fopen(fname.c_str(), "wb");
+        if (m_file == NULL) {
+            fprintf(stderr,
+                    "Unable to open %s for writing.\n", fname.c_str());
+            return false;
+        }
+    }
+    setvbuf(m_file, NULL, _IOFBF, FILE_BUFFER_SIZE);
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_size_mismatch_reported = false;
+    if (format == Y4M) {
+        fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                width, height, frames_per_second);
+        m_buffer.resize(strlen(Y4M_FRAME_HEADER) + 3*width*height);
+        memcpy(&m_buffer[0], Y4M_FRAME_HEADER, strlen(Y4M_FRAME_HEADER));
+    } else {
+        m_buffer.resize(3*width*height);
+    }
+    fprintf(stdout, "Recording %dx%d video to %s.\n",
+            width, height, (m_to_stdout)? "standard output": fname.c_str());
+    return true;
+}
+
+bool VideoStream::is_open() const {
+    return m_file != NULL;
+}
+
+/* Write a frame to the stream, where the pixels are stored row by row
+from the bottom of the frame, with pixels.size()/(width*height) channels.*/
+void VideoStream::write_frame(
+    const std::vector<uint8_t> &pixels, int width, int height) {
+    if (m_file == NULL)
+        return;
+    if (width != m_width || height != m_height) {
+        if (!m_size_mismatch_reported)
+            fprintf(stderr, "Skipping %dx%d frames, "
+                    "since the video stream is %dx%d.\n",
+                    width, height, m_width, m_height);
+        m_size_mismatch_reported = true;
+        return;
+    }
+    int channels = pixels.size()/(width*height);
+    if (channels < 3)
+        return;
+    int plane_size = width*height;
+    if (m_format == Y4M) {
+        uint8_t *y = &m_buffer[strlen(Y4M_FRAME_HEADER)];
+        uint8_t *u = y + plane_size, *v = u + plane_size;
+        for (int i = 0; i < height; i++) {
+            // Video frames are stored from the top row down.
+            int row = height - 1 - i;
+            pixels_to_yuv_row(
+                &pixels[(size_t)channels*width*row], channels, width,
+                y + width*i, u + width*i, v + width*i);
+        }
+    } else {
+        for (int i = 0; i < height; i++) {
+            int row = height - 1 - i;
+            pixels_to_rgb_row(
+                &pixels[(size_t)channels*width*row], channels, width,
+                &m_buffer[(size_t)3*width*i]);
+        }
+    }
+    fwrite(&m_buffer[0], sizeof(uint8_t), m_buffer.size(), m_file);
+}
+
+void VideoStream::close() {
+    if (m_file == NULL)
+        return;
+    if (m_to_stdout) {
+        // Give standard output back its original destination.
+        fflush(m_file);
+        fflush(stdout);
+        dup2(fileno(m_file), fileno(stdout));
+        m_to_stdout = false;
+    }
+    fclose(m_file);
+    m_file = NULL;
+}
+
+void VideoStream::encode(
+    [[maybe_unused]] const std::string &fname, std::vector<uint8_t> &pixels,
+    int width, int height, void *void_stream) {
+    ((VideoStream *)void_stream)->write_frame(pixels, width, height);
+}
+
+VideoStream::~VideoStream() {
+    this->close();
+}
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#ifndef _VIDEO_STREAM_
+#define _VIDEO_STREAM_
+
+/*
+Write frames to a single uncompressed video stream, instead of
+writing one image file for each frame.
+
+Two formats are supported. YUV4MPEG2 stores each frame as full
+resolution Y, U, and V planes (4:4:4 chroma, BT.601 limited range),
+and can be read directly by most video tools, for example
+
+    ./program | ffmpeg -i - out.mp4
+
+when writing to standard output. The raw format stores each frame
+as packed 8 bit RGB with no header, so the frame dimensions and rate
+must be given to whatever reads it.
+
+The file name "-" refers to standard output. While such a stream is
+open, whatever else is printed to standard output goes to standard
+error instead, so that it cannot corrupt the video. Each frame is
+converted into a single buffer, which is then written with one call,
+so that recording is limited by the disk bandwidth rather than by
+the overhead of creating and writing many small files. The conversion
+to YUV uses SSE2 when available.
+
+Frames are only written from whichever thread calls write_frame,
+so a stream must not be opened or closed while a frame is written.
+*/
+class VideoStream {
+    FILE *m_file;
+    bool m_to_stdout;
+    int m_width, m_height;
+    int m_format;
+    bool m_size_mismatch_reported;
+    std::vector<uint8_t> m_buffer;
+    VideoStream(const VideoStream &);
+    VideoStream& operator=(const VideoStream &);
+    public:
+    enum {Y4M=0, RAW_RGB=1};
+    VideoStream();
+    bool open(const std::string &fname, int width, int height,
+              int format=Y4M, int frames_per_second=30);
+    bool is_open() const;
+    void write_frame(const std::vector<uint8_t> &pixels,
+                     int width, int height);
+    void close();
+    /* Write a frame to the stream that is pointed to by void_stream.
+    This matches the FrameEncoder signature, so frames can be given
+    to a stream through a FrameRecorder.*/
+    static void encode(
+        const std::string &fname, std::vector<uint8_t> &pixels,
+        int width, int height, void *void_stream);
+    ~VideoStream();
+};
+
+#endif